@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstddef>
+#include <filesystem>
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+#include "falcon/ocr/OcrTypes.h"
+#include "falcon/ocr/OutputWriter.h"
+
+namespace falcon::app {
+
+struct BatchOptions {
+  falcon::ocr::OcrOptions ocr{};
+  // Images decoded ahead of recognition, and results waiting to be written. At most
+  // 2 * queue_depth + ocr_workers images are between decoding and writing at any time, so stream
+  // output, which keeps input order, never buffers more than that behind a slow page.
+  std::size_t queue_depth{4};
+  // Concurrent RunOcr calls; each page is additionally split across the shared thread pool.
+  std::size_t ocr_workers{1};
+  falcon::ocr::OutputFormat format{falcon::ocr::OutputFormat::kText};
+  // When set, results for `scan.bmp` go to `<output_dir>/scan.txt` (or .tsv/.hocr/.json);
+  // otherwise to the output stream.
+  std::filesystem::path output_dir;
+  // When set, results are cached on disk under this directory, keyed by the file's content hash
+  // and the recognition settings (see falcon::ocr::ResultCache). Hits skip decoding and OCR.
+  // Multi-page PNM files are recognized every time, since an entry holds one page.
+  std::filesystem::path cache_dir;
+  std::size_t cache_bytes{std::size_t{256} << 20};
+};
+
+struct BatchFileResult {
+  std::filesystem::path path;
+  std::string error;  // empty on success
+  double decode_ms{0.0};
+  double ocr_ms{0.0};
+  double write_ms{0.0};
+  double latency_ms{0.0};  // decode start to write end
+  falcon::ocr::OcrMemoryUsage memory{};
+  bool cached{false};  // served from the result cache
+};
+
+struct BatchReport {
+  std::vector<BatchFileResult> files;  // in input order
+  std::size_t failed{0};
+  std::size_t cache_hits{0};
+  double wall_ms{0.0};
+};
+
+// Expands command-line inputs: image files, directories (their .bmp/.pgm/.ppm/.pnm files, sorted),
+// `@list.txt` files with one path per line, and `-` for the same manifest format on `manifest`.
+std::vector<std::filesystem::path> CollectBatchInputs(const std::vector<std::string>& arguments,
+                                                      std::istream& manifest);
+
+// Decodes, recognizes and writes every input through a three-stage pipeline with bounded queues,
+// so decoding image N+1 overlaps recognition of image N. Every page of a multi-page PNM is
+// recognized, one at a time, into that file's output. Failures are recorded per file.
+BatchReport RunBatch(const std::vector<std::filesystem::path>& inputs, const BatchOptions& options,
+                     std::ostream& output);
+
+// Throughput and latency percentiles.
+void PrintBatchSummary(const BatchReport& report, std::ostream& stream);
+// One tab-separated line per file: path, status, decode/ocr/write/latency in milliseconds, and the
+// OCR working set in bytes at the end of each stage, and 1 if the result came from the cache.
+void WriteBatchLatencies(const BatchReport& report, std::ostream& stream);
+
+// OcrOptions configured from FALCON_LANGS, FALCON_TARGET_DPI, FALCON_CHARSET, FALCON_GLYPH_SIZE,
+// FALCON_CLEANUP, FALCON_TILE_SIZE and FALCON_MEMORY_BUDGET_MB.
+falcon::ocr::OcrOptions OcrOptionsFromEnvironment();
+
+}  // namespace falcon::app
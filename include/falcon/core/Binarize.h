@@ -7,8 +7,17 @@
 
 namespace falcon::core {
 
-uint8_t OtsuThreshold(const Raster& image);
-BinaryImage ApplyThreshold(const Raster& image, uint8_t threshold);
-BinaryImage BinarizeOtsu(const Raster& image);
+// All of these read rasters through a RasterView, so strided caller-owned pixels binarize in place.
+uint8_t OtsuThreshold(const RasterView& image);
+BinaryImage ApplyThreshold(const RasterView& image, uint8_t threshold);
+BinaryImage BinarizeOtsu(const RasterView& image);
+
+// In-place variants that reuse the storage already owned by `out`.
+void ApplyThreshold(const RasterView& image, uint8_t threshold, BinaryImage& out);
+void BinarizeOtsu(const RasterView& image, BinaryImage& out);
+
+// Same result as BinarizeOtsu, with the histogram and the thresholding split across the shared
+// thread pool in bands of `band_rows` rows.
+void BinarizeOtsuParallel(const RasterView& image, BinaryImage& out, int band_rows = 256);
 
 }  // namespace falcon::core
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace falcon::core {
+
+struct CodepointRange {
+  char32_t first{};
+  char32_t last{};  // inclusive
+};
+
+// Whitelist of codepoints a recognition request may return. A default-constructed charset is
+// unrestricted; every other charset holds at least one codepoint.
+class Charset {
+ public:
+  Charset() = default;
+
+  static Charset Digits();
+  static Charset Ascii();
+  // Union of the given ranges (e.g. Unicode blocks). Throws std::invalid_argument if empty.
+  static Charset FromRanges(std::vector<CodepointRange> ranges);
+  // Explicit set of codepoints. Throws std::invalid_argument if empty.
+  static Charset FromCodepoints(std::u32string_view codepoints);
+  // Parses "digits", "ascii", or a comma-separated list of "U+0370-U+03FF" ranges, "U+20AC"
+  // codepoints and literal UTF-8 characters.
+  static Charset Parse(std::string_view spec);
+
+  [[nodiscard]] bool Unrestricted() const noexcept { return ranges_.empty(); }
+  [[nodiscard]] bool Contains(char32_t codepoint) const noexcept;
+  [[nodiscard]] const std::vector<CodepointRange>& Ranges() const noexcept { return ranges_; }
+
+  bool operator==(const Charset& other) const noexcept;
+  bool operator!=(const Charset& other) const noexcept { return !(*this == other); }
+
+ private:
+  // Sorted, non-overlapping, non-adjacent.
+  std::vector<CodepointRange> ranges_;
+};
+
+}  // namespace falcon::core
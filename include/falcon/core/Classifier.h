@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstddef>
 #include <string>
 #include <vector>
 
@@ -13,7 +14,64 @@ struct ClassificationResult {
   float confidence{};  // 0-1
 };
 
+// Template set laid out for batched classification: bitmaps back to back, Size * Size bytes each.
+template <int Size>
+struct SizedTemplateMatrix {
+  std::size_t count{};
+  std::vector<uint8_t> cells;
+  std::vector<char32_t> codepoints;
+
+  [[nodiscard]] const uint8_t* Template(std::size_t index) const noexcept {
+    return cells.data() + index * kGlyphCellsOf<Size>;
+  }
+};
+
+using TemplateMatrix = SizedTemplateMatrix<kGlyphSize>;
+
+// Packs `templates` into a matrix, resampling their kGlyphSize bitmaps to Size if needed.
+template <int Size = kGlyphSize>
+SizedTemplateMatrix<Size> BuildTemplateMatrix(const std::vector<GlyphTemplate>& templates);
+template <int Size = kGlyphSize>
+SizedTemplateMatrix<Size> BuildTemplateMatrix(const std::vector<const GlyphTemplate*>& templates);
+
+// Sum of absolute differences between two normalized glyphs.
+template <int Size = kGlyphSize>
+uint32_t GlyphDistance(const uint8_t* lhs, const uint8_t* rhs) noexcept;
+
 ClassificationResult ClassifyGlyph(const GlyphBitmap& glyph, const std::vector<GlyphTemplate>& templates);
+
+template <int Size>
+ClassificationResult ClassifyGlyph(const SizedGlyphBitmap<Size>& glyph, const SizedTemplateMatrix<Size>& templates);
+
+// Classifies every glyph in `glyphs` against `templates` in cache-sized tiles, reusing the storage
+// of `results`. Matches ClassifyGlyph exactly, including tie-breaking by template order.
+template <int Size>
+void ClassifyGlyphs(const SizedGlyphMatrix<Size>& glyphs, const SizedTemplateMatrix<Size>& templates,
+                    std::vector<ClassificationResult>& results);
+
+// Classifies glyphs [begin, end) into the matching entries of `results`, which must already hold
+// glyphs.count entries. Disjoint ranges may be classified from different threads.
+template <int Size>
+void ClassifyGlyphRange(const SizedGlyphMatrix<Size>& glyphs, std::size_t begin, std::size_t end,
+                        const SizedTemplateMatrix<Size>& templates, std::vector<ClassificationResult>& results);
+
 std::u32string GlyphsToString(const std::vector<ClassificationResult>& glyphs);
 
+#define FALCON_DECLARE_CLASSIFIER(Size)                                                                   \
+  extern template SizedTemplateMatrix<Size> BuildTemplateMatrix<Size>(const std::vector<GlyphTemplate>&); \
+  extern template SizedTemplateMatrix<Size> BuildTemplateMatrix<Size>(                                   \
+      const std::vector<const GlyphTemplate*>&);                                                          \
+  extern template uint32_t GlyphDistance<Size>(const uint8_t*, const uint8_t*) noexcept;                  \
+  extern template ClassificationResult ClassifyGlyph<Size>(const SizedGlyphBitmap<Size>&,                 \
+                                                           const SizedTemplateMatrix<Size>&);             \
+  extern template void ClassifyGlyphs<Size>(const SizedGlyphMatrix<Size>&, const SizedTemplateMatrix<Size>&, \
+                                            std::vector<ClassificationResult>&);                          \
+  extern template void ClassifyGlyphRange<Size>(const SizedGlyphMatrix<Size>&, std::size_t, std::size_t,  \
+                                                const SizedTemplateMatrix<Size>&,                         \
+                                                std::vector<ClassificationResult>&);
+FALCON_DECLARE_CLASSIFIER(8)
+FALCON_DECLARE_CLASSIFIER(16)
+FALCON_DECLARE_CLASSIFIER(32)
+#undef FALCON_DECLARE_CLASSIFIER
+
 }  // namespace falcon::core
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace falcon::core {
+
+// Interleaved 8-bit pixel layouts that decoders hand to the gray conversion kernels.
+enum class PixelFormat {
+  kGray8,
+  kRgb24,   // PPM
+  kBgr24,   // 24-bpp BMP
+  kBgrx32,  // 32-bpp BMP; the fourth byte is ignored
+  kRgbx32,
+};
+
+[[nodiscard]] constexpr std::size_t BytesPerPixel(PixelFormat format) noexcept {
+  switch (format) {
+    case PixelFormat::kGray8:
+      return 1;
+    case PixelFormat::kRgb24:
+    case PixelFormat::kBgr24:
+      return 3;
+    default:
+      return 4;
+  }
+}
+
+// BT.601 luma in 8.8 fixed point: (77 r + 150 g + 29 b + 128) >> 8. Every kernel below produces
+// exactly this value. Also exact for 16-bit samples.
+[[nodiscard]] constexpr uint32_t GrayFromRgb(uint32_t r, uint32_t g, uint32_t b) noexcept {
+  return (77 * r + 150 * g + 29 * b + 128) >> 8;
+}
+
+// Converts `width` pixels of `src` to gray in `dst`.
+using GrayRowKernel = void (*)(const uint8_t* src, std::size_t width, uint8_t* dst);
+
+// The fastest kernel for `format` on this CPU (SSSE3 shuffles when available, scalar otherwise).
+// Resolve it once per image, outside the row loop.
+GrayRowKernel GrayRowKernelFor(PixelFormat format);
+// The portable scalar kernel, for comparison and testing.
+GrayRowKernel ScalarGrayRowKernelFor(PixelFormat format);
+
+}  // namespace falcon::core
@@ -9,6 +9,11 @@ namespace falcon::core {
 constexpr int kFeatureCount = 16;
 using FeatureVector = std::array<float, kFeatureCount>;
 
-FeatureVector ComputeZoningFeatures(const GlyphBitmap& bitmap);
+template <int Size = kGlyphSize>
+FeatureVector ComputeZoningFeatures(const SizedGlyphBitmap<Size>& bitmap);
+
+extern template FeatureVector ComputeZoningFeatures<8>(const SizedGlyphBitmap<8>&);
+extern template FeatureVector ComputeZoningFeatures<16>(const SizedGlyphBitmap<16>&);
+extern template FeatureVector ComputeZoningFeatures<32>(const SizedGlyphBitmap<32>&);
 
 }  // namespace falcon::core
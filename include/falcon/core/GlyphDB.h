@@ -1,5 +1,7 @@
 #pragma once
 
+#include <filesystem>
+#include <iosfwd>
 #include <string>
 #include <vector>
 
@@ -13,11 +15,31 @@ struct GlyphTemplate {
   std::string language;
 };
 
+// The built-in 5x7 ASCII font as templates (language "builtin"). The font is expanded to
+// kGlyphSize at compile time; first use only copies the expanded table.
 const std::vector<GlyphTemplate>& BuiltInGlyphTemplates();
 
+// Merges the builtin fallback and the requested packs (every discovered pack if `languages` is
+// empty). A codepoint from an earlier source shadows later packs. Packs are served by
+// PackRegistry::Shared().
 std::vector<GlyphTemplate> CollectGlyphTemplates(const std::vector<std::string>& languages,
                                                  bool include_ascii_fallback);
 
 std::vector<std::string> DiscoverLanguagePacks();
 
+// Existing pack search roots: FALCON_LANG_PATHS entries, then assets/langpacks in the current
+// directory or up to three of its parents. Re-evaluated on every call.
+std::vector<std::filesystem::path> LanguagePackRoots();
+
+// Parses every glyphs file of the pack in the first search root that has it, or `language` as a
+// direct file path if no pack directory matches. Bypasses the registry cache.
+std::vector<GlyphTemplate> LoadLanguagePack(const std::string& language);
+
+// Reads one glyphs.txt file; malformed entries are skipped. Returns an empty list if the file
+// cannot be opened.
+std::vector<GlyphTemplate> LoadGlyphPack(const std::filesystem::path& file, const std::string& language);
+
+// Writes templates in the glyphs.txt format understood by LoadGlyphPack.
+void WriteGlyphPack(std::ostream& stream, const std::vector<GlyphTemplate>& templates);
+
 }  // namespace falcon::core
@@ -1,17 +1,74 @@
 #pragma once
 
+#include <cstdint>
 #include <filesystem>
+#include <iosfwd>
+#include <memory>
 #include <string>
+#include <vector>
 
 #include "falcon/core/Raster.h"
 
 namespace falcon::core {
 
+struct ImageInfo {
+  SizeI size{};
+  int dpi_x{96};
+  int dpi_y{96};
+};
+
+// Extension checks, ignoring case: .bmp and the PNM family (.pgm, .ppm, .pnm) are images
+// LoadImage reads; PNM files may hold several pages (see PnmPageReader).
+bool IsImagePath(const std::filesystem::path& path);
+bool IsPnmPath(const std::filesystem::path& path);
+
 Raster LoadImage(const std::filesystem::path& path);
+// Reads only the header of a BMP or PNM file (the first image of a multi-image PNM), so callers
+// can size or reject a page before decoding it.
+ImageInfo ProbeImage(const std::filesystem::path& path);
+ImageInfo ProbeImage(const std::vector<uint8_t>& bytes);
 Raster LoadBmp(const std::filesystem::path& path);
 Raster LoadPnm(const std::filesystem::path& path);  // supports PGM/PPM (P2/P3/P5/P6)
+// Decodes a BMP or PNM file already in memory; the format is taken from its magic bytes. Headers
+// describing more pixels than the data holds are rejected before anything is allocated.
+Raster DecodeImage(const std::vector<uint8_t>& bytes);
+
+// Reads a PNM stream holding several concatenated images (as multi-page scanners emit) one page
+// at a time, so only the page being decoded is resident.
+class PnmPageReader {
+ public:
+  explicit PnmPageReader(std::istream& stream);
+  explicit PnmPageReader(const std::filesystem::path& path);
+  // Reads a file already in memory, which the reader keeps.
+  explicit PnmPageReader(std::vector<uint8_t> bytes);
+  ~PnmPageReader();
+
+  PnmPageReader(const PnmPageReader&) = delete;
+  PnmPageReader& operator=(const PnmPageReader&) = delete;
+
+  // Decodes the next page into `page`. Returns false once only whitespace and comments remain;
+  // throws on malformed data.
+  bool Next(Raster& page);
+  [[nodiscard]] std::size_t PagesRead() const noexcept { return pages_; }
+
+ private:
+  std::vector<uint8_t> bytes_;
+  std::unique_ptr<std::streambuf> buffer_;
+  std::unique_ptr<std::istream> owned_;
+  std::istream* stream_;
+  std::size_t pages_{0};
+};
 
 Raster ConvertToGrayscale(const Raster& src);
 Raster ResizeNearest(const Raster& src, int new_width, int new_height);
 
+// Area-averaging reduction: every factor_x * factor_y block becomes its rounded mean. Blocks cut off
+// by the right or bottom edge average the pixels they cover. DPI metadata is divided accordingly.
+Raster DownscaleBox(const RasterView& src, int factor_x, int factor_y);
+void DownscaleBox(const RasterView& src, int factor_x, int factor_y, Raster& out);
+
+// Successive 2x2 reductions of `src` (level 0 is a copy) until either side would drop below
+// `min_size` or `max_levels` levels exist.
+std::vector<Raster> BuildPyramid(const Raster& src, int min_size, int max_levels = 8);
+
 }  // namespace falcon::core
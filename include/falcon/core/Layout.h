@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+#include "falcon/core/Geometry.h"
+#include "falcon/core/Segment.h"
+
+namespace falcon::core {
+
+struct LayoutOptions {
+  bool reject_non_text{true};
+  std::size_t min_area{4};
+  // Components shorter than this do not contribute to the text height estimate.
+  int min_text_height{6};
+  // Ratios below are relative to the estimated text height of the page.
+  float max_height_ratio{4.0f};     // taller components are pictures or vertical rules
+  float rule_length_ratio{4.0f};    // wider components this thin are horizontal rules
+  float rule_thickness_ratio{0.3f};
+  float speck_ratio{0.15f};         // components smaller in both dimensions are noise
+  float block_gap_ratio{1.5f};      // vertical whitespace that separates blocks
+  float column_gap_ratio{1.5f};     // horizontal whitespace that separates columns
+  // Lines inside a block are separated by at least this many empty pixel rows. Line pieces
+  // shorter than min_line_height_ratio (i-dots, accents) join the line below them.
+  int min_line_spacing{1};
+  float min_line_height_ratio{0.5f};
+  // Blocks with at least this many components whose median height is below
+  // halftone_height_ratio are treated as halftone/texture and dropped.
+  std::size_t halftone_min_components{32};
+  float halftone_height_ratio{0.4f};
+};
+
+// Contiguous range [begin, end) of the component list handed to AnalyzeLayout.
+struct TextLine {
+  RectI bounds{};
+  std::size_t begin{};
+  std::size_t end{};
+};
+
+// Components [begin, end), made up of lines [first_line, last_line).
+struct TextBlock {
+  RectI bounds{};
+  std::size_t begin{};
+  std::size_t end{};
+  std::size_t first_line{};
+  std::size_t last_line{};
+};
+
+struct LayoutScratch {
+  std::vector<int> heights;
+  std::vector<std::pair<std::size_t, std::size_t>> pending;
+};
+
+// Height of a typical text glyph on the page, or 0 if no component qualifies.
+int EstimateTextHeight(const std::vector<ConnectedComponent>& components, const LayoutOptions& options,
+                       std::vector<int>& heights);
+
+// Drops components that cannot be text, splits the rest into blocks and columns with recursive
+// projection-profile (X-Y) cuts over the component boxes, then splits each block into lines at
+// empty rows of its vertical profile. `components` is reordered so that blocks and lines are
+// contiguous and in reading order, with every line sorted left to right.
+void AnalyzeLayout(std::vector<ConnectedComponent>& components, const LayoutOptions& options, LayoutScratch& scratch,
+                   std::vector<TextBlock>& blocks, std::vector<TextLine>& lines);
+
+}  // namespace falcon::core
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+#include "falcon/core/Raster.h"
+
+namespace falcon::core {
+
+// Binary image with 64 pixels per word: pixel x of a row is bit x % 64 of word x / 64. Bits past
+// `width` in the last word of a row are always zero. Morphology on this layout touches 64 pixels
+// per instruction.
+struct PackedBinaryImage {
+  int width{};
+  int height{};
+  std::size_t words_per_row{};
+  std::vector<uint64_t> bits;
+
+  [[nodiscard]] uint64_t* Row(int y) noexcept { return bits.data() + static_cast<std::size_t>(y) * words_per_row; }
+  [[nodiscard]] const uint64_t* Row(int y) const noexcept {
+    return bits.data() + static_cast<std::size_t>(y) * words_per_row;
+  }
+};
+
+void PackBinaryImage(const BinaryImage& image, PackedBinaryImage& out);
+void UnpackBinaryImage(const PackedBinaryImage& image, BinaryImage& out);
+
+enum class StructuringShape {
+  kRectangle,  // (2 radius_x + 1) x (2 radius_y + 1)
+  kCross,      // the horizontal and vertical arms of that rectangle
+};
+
+struct StructuringElement {
+  int radius_x{0};
+  int radius_y{0};
+  StructuringShape shape{StructuringShape::kRectangle};
+
+  [[nodiscard]] bool Empty() const noexcept { return radius_x <= 0 && radius_y <= 0; }
+  bool operator==(const StructuringElement& other) const noexcept {
+    return radius_x == other.radius_x && radius_y == other.radius_y && shape == other.shape;
+  }
+  bool operator!=(const StructuringElement& other) const noexcept { return !(*this == other); }
+};
+
+// Buffers reused by the operations below; they keep their capacity between calls.
+struct MorphologyScratch {
+  PackedBinaryImage image;
+  std::array<PackedBinaryImage, 4> temp;
+  std::vector<uint64_t> padded_row;
+};
+
+// Erosion treats pixels outside the image as ink and dilation as background, so an opening never
+// adds ink and a closing never removes it, at the borders too.
+void Erode(const PackedBinaryImage& image, const StructuringElement& element, PackedBinaryImage& out,
+           MorphologyScratch& scratch);
+void Dilate(const PackedBinaryImage& image, const StructuringElement& element, PackedBinaryImage& out,
+            MorphologyScratch& scratch);
+// In place on `image`.
+void Open(PackedBinaryImage& image, const StructuringElement& element, MorphologyScratch& scratch);
+void Close(PackedBinaryImage& image, const StructuringElement& element, MorphologyScratch& scratch);
+// Clears ink that fits in a `size` x `size` square whose surrounding one-pixel ring is background,
+// i.e. isolated specks up to that size, without touching anything connected to larger strokes.
+void Despeckle(PackedBinaryImage& image, int size, MorphologyScratch& scratch);
+
+// Noise cleanup between binarization and segmentation, applied in order: opening (drops ink
+// thinner than the element), closing (fills gaps and pinholes narrower than it), despeckle.
+// Everything is off by default.
+struct CleanupOptions {
+  StructuringElement opening{};
+  StructuringElement closing{};
+  int despeckle_size{0};
+
+  [[nodiscard]] bool Enabled() const noexcept {
+    return !opening.Empty() || !closing.Empty() || despeckle_size > 0;
+  }
+  bool operator==(const CleanupOptions& other) const noexcept {
+    return opening == other.opening && closing == other.closing && despeckle_size == other.despeckle_size;
+  }
+  bool operator!=(const CleanupOptions& other) const noexcept { return !(*this == other); }
+
+  // Parses a comma-separated list such as "despeckle=3,open=1,close=2x1,open=cross1": "open" and
+  // "close" take a radius or RXxRY radii, optionally prefixed with "cross". Throws
+  // std::invalid_argument on anything else.
+  static CleanupOptions Parse(std::string_view spec);
+};
+
+// Packs `image`, applies `options` and unpacks the result into `image`. Does nothing when no
+// step is enabled.
+void CleanupBinaryImage(BinaryImage& image, const CleanupOptions& options, MorphologyScratch& scratch);
+
+}  // namespace falcon::core
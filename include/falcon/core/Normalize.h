@@ -1,15 +1,87 @@
 #pragma once
 
 #include <array>
+#include <cstddef>
+#include <vector>
 
 #include "falcon/core/Geometry.h"
 #include "falcon/core/Raster.h"
+#include "falcon/core/Segment.h"
 
 namespace falcon::core {
 
+// Side length of stored templates (built-in font and pack files) and of the default engine.
 constexpr int kGlyphSize = 16;
-using GlyphBitmap = std::array<uint8_t, kGlyphSize * kGlyphSize>;
 
-GlyphBitmap NormalizeGlyph(const BinaryImage& image, const RectI& bounds);
+// Engines can normalize and classify at 8x8 (fast, clean print), 16x16 or 32x32 (complex scripts).
+// Kernels are instantiated for exactly these sizes. Templates only exist at kGlyphSize, so at 32x32
+// the page glyphs are finer but every template is a 2x2-replicated 16x16 one (see ResampleGlyph).
+constexpr std::array<int, 3> kSupportedGlyphSizes{8, 16, 32};
+
+constexpr bool IsSupportedGlyphSize(int size) noexcept {
+  for (int supported : kSupportedGlyphSizes) {
+    if (supported == size) {
+      return true;
+    }
+  }
+  return false;
+}
+
+template <int Size>
+constexpr std::size_t kGlyphCellsOf = static_cast<std::size_t>(Size) * Size;
+
+constexpr std::size_t kGlyphCells = kGlyphCellsOf<kGlyphSize>;
+
+template <int Size>
+using SizedGlyphBitmap = std::array<uint8_t, kGlyphCellsOf<Size>>;
+
+using GlyphBitmap = SizedGlyphBitmap<kGlyphSize>;
+
+// Row-major batch of normalized glyphs stored back to back, Size * Size bytes per glyph.
+template <int Size>
+struct SizedGlyphMatrix {
+  std::size_t count{};
+  std::vector<uint8_t> cells;
+
+  [[nodiscard]] const uint8_t* Glyph(std::size_t index) const noexcept {
+    return cells.data() + index * kGlyphCellsOf<Size>;
+  }
+};
+
+using GlyphMatrix = SizedGlyphMatrix<kGlyphSize>;
+
+template <int Size = kGlyphSize>
+SizedGlyphBitmap<Size> NormalizeGlyph(const BinaryImage& image, const RectI& bounds);
+
+// Normalizes every component into `out`, reusing its storage. Produces exactly the same cells as
+// calling NormalizeGlyph per component.
+template <int Size>
+void NormalizeGlyphs(const BinaryImage& image, const std::vector<ConnectedComponent>& components,
+                     SizedGlyphMatrix<Size>& out);
+
+// Fills rows [begin, end) of `out`, which must already be sized for all components. Disjoint
+// ranges may be filled from different threads.
+template <int Size>
+void NormalizeGlyphRange(const BinaryImage& image, const std::vector<ConnectedComponent>& components,
+                         std::size_t begin, std::size_t end, SizedGlyphMatrix<Size>& out);
+
+// Converts a template stored at kGlyphSize to another engine size: 2x2 area averaging when
+// shrinking, pixel replication when growing. Growing adds no detail; a 32x32 engine matches
+// against blocky upsampled templates.
+template <int Size>
+SizedGlyphBitmap<Size> ResampleGlyph(const GlyphBitmap& source);
+
+#define FALCON_DECLARE_NORMALIZE(Size)                                                                  \
+  extern template SizedGlyphBitmap<Size> NormalizeGlyph<Size>(const BinaryImage&, const RectI&);        \
+  extern template void NormalizeGlyphs<Size>(const BinaryImage&, const std::vector<ConnectedComponent>&, \
+                                             SizedGlyphMatrix<Size>&);                                   \
+  extern template void NormalizeGlyphRange<Size>(const BinaryImage&,                                     \
+                                                 const std::vector<ConnectedComponent>&, std::size_t,    \
+                                                 std::size_t, SizedGlyphMatrix<Size>&);                  \
+  extern template SizedGlyphBitmap<Size> ResampleGlyph<Size>(const GlyphBitmap&);
+FALCON_DECLARE_NORMALIZE(8)
+FALCON_DECLARE_NORMALIZE(16)
+FALCON_DECLARE_NORMALIZE(32)
+#undef FALCON_DECLARE_NORMALIZE
 
 }  // namespace falcon::core
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "falcon/core/GlyphDB.h"
+#include "falcon/util/Epoch.h"
+
+namespace falcon::core {
+
+// Parsed templates of one language pack. Immutable once published by the registry, apart from
+// the recency stamp used for eviction.
+struct LanguagePack {
+  std::string language;
+  std::vector<GlyphTemplate> templates;
+  mutable std::atomic<uint64_t> last_use{0};
+
+  [[nodiscard]] std::size_t Bytes() const noexcept;
+};
+
+using PackHandle = std::shared_ptr<const LanguagePack>;
+
+// Process-wide cache of parsed language packs. Packs are parsed on first use and shared between
+// every language combination through reference-counted handles. When resident packs exceed the
+// memory budget, the least recently used packs that nobody else holds are evicted. Thread-safe.
+//
+// Resident packs are published as an immutable snapshot behind an atomic pointer: Acquire of a
+// resident pack and Generation() never lock. Writers (loads, reloads, evictions) copy the
+// snapshot, swap the pointer and retire the old one through epoch-based reclamation, so readers
+// keep whatever snapshot and handles they already hold.
+class PackRegistry {
+ public:
+  static constexpr std::size_t kDefaultMemoryBudget = std::size_t{256} << 20;
+
+  explicit PackRegistry(std::size_t memory_budget = kDefaultMemoryBudget);
+  ~PackRegistry();
+
+  PackRegistry(const PackRegistry&) = delete;
+  PackRegistry& operator=(const PackRegistry&) = delete;
+
+  static PackRegistry& Shared();
+
+  // Returns the cached pack, parsing it first if needed. Unknown packs yield an empty pack.
+  PackHandle Acquire(const std::string& language);
+  // Re-parses a resident pack and publishes the new version. Non-resident packs are ignored.
+  void Reload(const std::string& language);
+  // Bumps Generation() without changing packs, e.g. after pack directories were added.
+  void Invalidate() noexcept;
+  // Changes whenever a reload may have altered pack contents; merged template caches compare it.
+  [[nodiscard]] uint64_t Generation() const noexcept { return generation_.load(std::memory_order_acquire); }
+  [[nodiscard]] std::vector<std::string> ResidentLanguages() const;
+  // Parses every pack in `languages` that is not resident yet, in parallel on the shared pool.
+  void Warm(const std::vector<std::string>& languages);
+  // Same merge as CollectGlyphTemplates, served from the cache.
+  std::vector<GlyphTemplate> Collect(const std::vector<std::string>& languages, bool include_ascii_fallback);
+  // Same merge as Collect without copying: the result points into the built-in table and the
+  // packs appended to `packs`, and stays valid while those handles are held.
+  std::vector<const GlyphTemplate*> Select(const std::vector<std::string>& languages, bool include_ascii_fallback,
+                                           std::vector<PackHandle>& packs);
+
+  void SetMemoryBudget(std::size_t bytes);
+  [[nodiscard]] std::size_t MemoryBudget() const;
+  [[nodiscard]] std::size_t ResidentBytes() const;
+  [[nodiscard]] std::size_t ResidentPacks() const;
+  // Drops every pack not held elsewhere.
+  void Clear();
+
+ private:
+  struct Snapshot {
+    std::unordered_map<std::string, PackHandle> packs;
+  };
+
+  PackHandle PublishLocked(const std::string& language, PackHandle pack);
+  void SwapLocked(std::unique_ptr<Snapshot> next);
+  void EvictLocked();
+
+  mutable std::mutex writer_mutex_;
+  mutable falcon::util::EpochDomain epochs_;
+  std::atomic<const Snapshot*> snapshot_;
+  std::atomic<uint64_t> generation_{1};
+  std::atomic<uint64_t> clock_{0};
+  std::size_t budget_;
+  std::size_t resident_bytes_{0};
+};
+
+}  // namespace falcon::core
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "falcon/core/PackRegistry.h"
+
+namespace falcon::core {
+
+// Reloads resident packs into a PackRegistry when their files change, so long-running processes
+// pick up edited packs (and FALCON_LANG_PATHS changes) without restarting. The background thread
+// wakes on inotify events on Linux and otherwise rescans every poll interval; Stop() wakes it at
+// once. The reload itself parses off the registry lock and publishes a new snapshot.
+class PackWatcher {
+ public:
+  explicit PackWatcher(PackRegistry& registry = PackRegistry::Shared(),
+                       std::chrono::milliseconds interval = std::chrono::seconds(2));
+  ~PackWatcher();
+
+  PackWatcher(const PackWatcher&) = delete;
+  PackWatcher& operator=(const PackWatcher&) = delete;
+
+  void Start();
+  void Stop();
+
+  // Compares pack files with the previous scan and reloads every resident pack that changed.
+  // Returns the number of packs reloaded. Safe to call with or without the background thread.
+  std::size_t Poll();
+
+ private:
+  void Run();
+  void Rewatch();
+  bool WaitForChange();
+
+  PackRegistry& registry_;
+  std::chrono::milliseconds interval_;
+  std::thread thread_;
+  std::atomic<bool> stopping_{false};
+  std::atomic<bool> rewatch_{true};
+  int notify_fd_{-1};
+  int wake_fd_{-1};  // eventfd Stop() signals on Linux
+  std::mutex wake_mutex_;
+  std::condition_variable wake_;
+
+  std::mutex poll_mutex_;
+  bool scanned_{false};
+  std::vector<std::filesystem::path> roots_;
+  std::vector<std::string> discovered_;
+  std::unordered_map<std::string, std::string> signatures_;
+};
+
+}  // namespace falcon::core
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstddef>
 #include <cstdint>
 #include <vector>
 
@@ -18,6 +19,34 @@ struct Raster {
   [[nodiscard]] SizeI Size() const noexcept { return SizeI{width, height}; }
 };
 
+// Borrowed grayscale pixels whose rows are `stride` bytes apart, e.g. a caller's frame buffer or a
+// sub-rectangle of a larger image. The pixels must outlive every use of the view.
+struct RasterView {
+  const uint8_t* pixels{nullptr};
+  int width{};
+  int height{};
+  std::size_t stride{};  // bytes from one row to the next, at least `width`
+  int dpi_x{96};
+  int dpi_y{96};
+
+  RasterView() = default;
+  RasterView(const uint8_t* pixels, int width, int height, std::size_t stride, int dpi_x = 96, int dpi_y = 96) noexcept
+      : pixels(pixels), width(width), height(height), stride(stride), dpi_x(dpi_x), dpi_y(dpi_y) {}
+  // Implicit, so everything that reads a view also reads a Raster.
+  RasterView(const Raster& raster) noexcept  // NOLINT(google-explicit-constructor)
+      : pixels(raster.pixels.data()),
+        width(raster.width),
+        height(raster.height),
+        stride(static_cast<std::size_t>(raster.width)),
+        dpi_x(raster.dpi_x),
+        dpi_y(raster.dpi_y) {}
+
+  [[nodiscard]] bool Empty() const noexcept { return width <= 0 || height <= 0 || pixels == nullptr; }
+  [[nodiscard]] SizeI Size() const noexcept { return SizeI{width, height}; }
+  [[nodiscard]] bool Contiguous() const noexcept { return stride == static_cast<std::size_t>(width); }
+  [[nodiscard]] const uint8_t* Row(int y) const noexcept { return pixels + static_cast<std::size_t>(y) * stride; }
+};
+
 struct BinaryImage {
   int width{};
   int height{};
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <cstddef>
+#include <cstdint>
 #include <vector>
 
 #include "falcon/core/Geometry.h"
@@ -13,6 +15,37 @@ struct ConnectedComponent {
   std::size_t area{};
 };
 
+// Reusable working memory for ConnectedComponents. Buffers keep their capacity between calls.
+struct SegmentScratch {
+  std::vector<uint8_t> visited;
+  std::vector<PointI> queue;
+};
+
+// Per-tile labels and the stitching state of ConnectedComponentsTiled, kept between calls.
+struct TiledSegmentScratch {
+  struct Tile {
+    std::vector<ConnectedComponent> components;  // bounds in image coordinates
+    std::vector<PointI> seeds;                   // first pixel of each component in scan order
+    // Tile-local component index of every edge pixel, or -1 for background.
+    std::vector<int32_t> top, bottom, left, right;
+  };
+  std::vector<Tile> tiles;
+  std::vector<std::size_t> offsets;  // first global id of each tile
+  std::vector<uint32_t> parent;
+  std::vector<ConnectedComponent> merged;
+  std::vector<PointI> merged_seeds;
+  std::vector<uint32_t> roots;
+};
+
 std::vector<ConnectedComponent> ConnectedComponents(const BinaryImage& image);
+void ConnectedComponents(const BinaryImage& image, SegmentScratch& scratch,
+                         std::vector<ConnectedComponent>& components);
+
+// Same components, labels and order as ConnectedComponents, computed tile by tile on the shared
+// thread pool: each tile_size x tile_size tile is labeled independently (worker memory is bounded
+// by the tile), then components that touch across tile borders are united with a union-find pass
+// over the tile edges.
+void ConnectedComponentsTiled(const BinaryImage& image, int tile_size, TiledSegmentScratch& scratch,
+                              std::vector<ConnectedComponent>& components);
 
 }  // namespace falcon::core
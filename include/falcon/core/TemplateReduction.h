@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include "falcon/core/GlyphDB.h"
+
+namespace falcon::core {
+
+struct TemplateReductionOptions {
+  // Same-codepoint templates differing by at most this many fully inked pixels share a prototype.
+  int merge_pixels{8};
+  // Largest accepted drop in validation accuracy (0..1) relative to the unreduced set.
+  double accuracy_tolerance{0.0};
+  // k-medoids refinement passes per codepoint after the initial clustering.
+  int medoid_iterations{4};
+};
+
+struct TemplateReductionReport {
+  std::size_t input_count{0};
+  std::size_t output_count{0};
+  double full_accuracy{1.0};
+  double reduced_accuracy{1.0};
+};
+
+// Fraction of `validation` samples whose nearest template carries the same codepoint.
+double MeasureAccuracy(const std::vector<GlyphTemplate>& templates, const std::vector<GlyphTemplate>& validation);
+
+// Returns a subset of `templates` (in their original order) that classifies `validation` within
+// the accuracy tolerance. Near-duplicates of one codepoint are clustered with k-medoids, then a
+// condensed nearest neighbour pass keeps only the medoids needed to separate codepoints. An empty
+// validation set validates against the input templates themselves.
+std::vector<GlyphTemplate> ReduceTemplates(const std::vector<GlyphTemplate>& templates,
+                                           const std::vector<GlyphTemplate>& validation,
+                                           const TemplateReductionOptions& options = {},
+                                           TemplateReductionReport* report = nullptr);
+
+}  // namespace falcon::core
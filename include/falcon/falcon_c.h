@@ -0,0 +1,143 @@
+#pragma once
+
+/*
+ * Stable C interface to the OCR pipeline, exported by the falcon_c shared library.
+ *
+ * Only plain C types cross this boundary: engines are opaque handles, every call reports
+ * failure through a falcon_status code (no exception ever escapes), and each result is one
+ * malloc'd block the caller releases with falcon_result_free.
+ *
+ * Thread safety: an engine is immutable once created, so any number of threads may call
+ * falcon_recognize on the same engine at the same time. Each thread recognizes with its own
+ * scratch buffers, which persist between calls, so a long-lived worker thread reaches steady
+ * state after its first page; falcon_thread_release returns them before a thread goes idle or
+ * exits. Only falcon_engine_destroy needs exclusive access: no call on the
+ * engine may be in progress or start afterwards. Results are independent of the engine and of
+ * each other and may be read, and freed, from any thread.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(_WIN32)
+#if defined(FALCON_C_BUILD)
+#define FALCON_C_API __declspec(dllexport)
+#else
+#define FALCON_C_API __declspec(dllimport)
+#endif
+#else
+#define FALCON_C_API __attribute__((visibility("default")))
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Bumped on any incompatible change to the declarations below. */
+#define FALCON_C_ABI_VERSION 1
+
+typedef enum falcon_status {
+  FALCON_OK = 0,
+  FALCON_ERROR_INVALID_ARGUMENT = 1, /* null pointers, bad dimensions or stride, bad option specs */
+  FALCON_ERROR_MEMORY_BUDGET = 2,    /* the page does not fit falcon_engine_options.memory_budget */
+  FALCON_ERROR_OUT_OF_MEMORY = 3,
+  FALCON_ERROR_FAILED = 4 /* anything else, e.g. no glyph templates for the requested languages */
+} falcon_status;
+
+typedef enum falcon_pixel_format {
+  FALCON_PIXEL_GRAY8 = 0, /* read in place */
+  FALCON_PIXEL_RGB24 = 1, /* color formats are converted to gray into per-thread scratch, counted as
+                           * the input against memory_budget */
+  FALCON_PIXEL_BGR24 = 2,
+  FALCON_PIXEL_BGRX32 = 3, /* the fourth byte is ignored */
+  FALCON_PIXEL_RGBX32 = 4
+} falcon_pixel_format;
+
+/* Engine configuration. Initialize with falcon_engine_options_init, then override fields;
+ * struct_size lets later versions append fields without breaking older callers. String fields
+ * are copied by falcon_engine_create and may be NULL. */
+typedef struct falcon_engine_options {
+  size_t struct_size;
+  const char* languages; /* comma-separated pack names; NULL or "" probes every pack */
+  const char* charset;   /* "digits", "ascii" or codepoint ranges, as FALCON_CHARSET */
+  const char* cleanup;   /* e.g. "despeckle=3,open=1", as FALCON_CLEANUP */
+  int32_t ascii_only;
+  int32_t target_dpi;    /* reduce pages scanned above this resolution; 0 keeps them */
+  int32_t glyph_size;    /* 8, 16 or 32; templates at 32 are upsampled from 16x16 */
+  int32_t tile_size;     /* 0 segments pages whole */
+  uint64_t memory_budget; /* bytes per page; 0 for no limit */
+} falcon_engine_options;
+
+/* Caller-owned pixels. Rows start `stride` bytes apart; the buffer is only read, and only during
+ * the call. */
+typedef struct falcon_image {
+  const uint8_t* pixels;
+  int32_t width;
+  int32_t height;
+  size_t stride;
+  falcon_pixel_format format;
+  int32_t dpi_x; /* 0 means 96 */
+  int32_t dpi_y;
+} falcon_image;
+
+typedef struct falcon_rect {
+  int32_t x;
+  int32_t y;
+  int32_t width;
+  int32_t height;
+} falcon_rect;
+
+typedef struct falcon_char {
+  uint32_t codepoint;
+  float confidence; /* 0-1 */
+  falcon_rect bounds; /* source image pixels */
+} falcon_char;
+
+typedef struct falcon_line {
+  size_t first_char; /* index into falcon_result.chars */
+  size_t char_count;
+  int32_t rtl;
+} falcon_line;
+
+/* One contiguous allocation: the arrays and the text live in the same block as this header. */
+typedef struct falcon_result {
+  int32_t image_width;
+  int32_t image_height;
+  size_t line_count;
+  const falcon_line* lines;
+  size_t char_count;
+  const falcon_char* chars; /* all lines back to back, in reading order */
+  const char* text;         /* UTF-8, one '\n'-terminated line per line, NUL-terminated */
+  size_t text_size;         /* bytes before the NUL */
+} falcon_result;
+
+typedef struct falcon_engine falcon_engine;
+
+FALCON_C_API uint32_t falcon_abi_version(void);
+
+FALCON_C_API void falcon_engine_options_init(falcon_engine_options* options);
+
+/* `options` may be NULL for the defaults. On success stores a new engine in *engine. */
+FALCON_C_API falcon_status falcon_engine_create(const falcon_engine_options* options, falcon_engine** engine);
+/* Accepts NULL. */
+FALCON_C_API void falcon_engine_destroy(falcon_engine* engine);
+
+/* Recognizes `image`, or only the components intersecting `region` when it is not NULL. On
+ * success stores a result in *result that the caller releases with falcon_result_free. Repeated
+ * regions of the same image on one thread reuse its segmentation. */
+FALCON_C_API falcon_status falcon_recognize(const falcon_engine* engine, const falcon_image* image,
+                                            const falcon_rect* region, falcon_result** result);
+/* Accepts NULL. */
+FALCON_C_API void falcon_result_free(falcon_result* result);
+
+/* Frees the calling thread's scratch buffers and cached templates; the next falcon_recognize on
+ * this thread allocates them again. Results are unaffected. */
+FALCON_C_API void falcon_thread_release(void);
+
+/* Message of the last call on this thread that failed; empty until one does. Valid until the
+ * next failing call on this thread. */
+FALCON_C_API const char* falcon_last_error(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <chrono>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <stdexcept>
+
+#include "falcon/core/Raster.h"
+#include "falcon/ocr/OcrControl.h"
+#include "falcon/ocr/OcrTypes.h"
+
+namespace falcon::ocr {
+
+struct AsyncOcrOptions {
+  // Zero means no deadline. Otherwise the page comes back partial (OcrStatus::kTimedOut) once this
+  // much time has passed since submission, including time spent queued.
+  std::chrono::milliseconds timeout{0};
+  OcrControl::ProgressCallback on_progress;
+  // Runs on the worker thread just before the future becomes ready; `error` is set (and `page`
+  // empty) when recognition threw. A page rejected by a full queue completes on the calling thread.
+  std::function<void(const OcrPage& page, std::exception_ptr error)> on_complete;
+};
+
+struct OcrTask {
+  // Cancel() stops the page at the next check; Progress() reports how far it got.
+  std::shared_ptr<OcrControl> control;
+  std::future<OcrPage> result;
+};
+
+// Thrown through OcrTask::result when the page could not be queued.
+class AsyncQueueFullError : public std::runtime_error {
+ public:
+  using std::runtime_error::runtime_error;
+};
+
+// Recognizes `raster` on a small set of background workers that keep their OcrContexts warm; each
+// page still spreads across the shared thread pool. Never blocks: when 1024 pages are already
+// waiting, the task fails at once with AsyncQueueFullError instead.
+OcrTask RunOcrAsync(falcon::core::Raster raster, OcrOptions options = {}, AsyncOcrOptions async = {});
+
+}  // namespace falcon::ocr
@@ -0,0 +1,149 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "falcon/core/Geometry.h"
+#include "falcon/ocr/OcrTypes.h"
+
+namespace falcon::ocr {
+
+// Recognition result stored as a few contiguous arrays instead of one heap block per line:
+// codepoints, confidences and boxes per character, and a table of line start offsets. Boxes are
+// kept as 16-bit fields whenever every coordinate fits, so a character costs 16 bytes instead of
+// the 24 of an OcrChar, and pages of any size take five allocations. Serialize is a header plus
+// one memcpy per array.
+//
+// Iterate through the views, which read the arrays in place:
+//   for (const auto line : compact.Lines()) {
+//     for (const auto ch : line) { use(ch.Codepoint(), ch.Bounds()); }
+//   }
+class CompactPage {
+ public:
+  template <typename View>
+  class Iterator;
+
+  class CharView {
+   public:
+    [[nodiscard]] char32_t Codepoint() const noexcept { return page_->codepoints_[index_]; }
+    [[nodiscard]] float Confidence() const noexcept { return page_->confidences_[index_]; }
+    [[nodiscard]] falcon::core::RectI Bounds() const noexcept { return page_->Box(index_); }
+
+   private:
+    friend class CompactPage;
+    friend class Iterator<CharView>;
+    CharView(const CompactPage* page, std::size_t index) : page_(page), index_(index) {}
+
+    const CompactPage* page_;
+    std::size_t index_;
+  };
+
+  // Forward iterator yielding views by value, over characters or lines.
+  template <typename View>
+  class Iterator {
+   public:
+    Iterator(const CompactPage* page, std::size_t index) : page_(page), index_(index) {}
+    View operator*() const { return View(page_, index_); }
+    Iterator& operator++() noexcept {
+      ++index_;
+      return *this;
+    }
+    bool operator==(const Iterator& other) const noexcept { return index_ == other.index_; }
+    bool operator!=(const Iterator& other) const noexcept { return index_ != other.index_; }
+
+   private:
+    const CompactPage* page_;
+    std::size_t index_;
+  };
+
+  class LineView {
+   public:
+    [[nodiscard]] std::size_t Size() const noexcept { return End() - Begin(); }
+    [[nodiscard]] bool Empty() const noexcept { return Size() == 0; }
+    [[nodiscard]] bool Rtl() const noexcept { return page_->line_rtl_[line_] != 0; }
+    [[nodiscard]] CharView operator[](std::size_t i) const noexcept { return CharView(page_, Begin() + i); }
+    [[nodiscard]] Iterator<CharView> begin() const noexcept { return {page_, Begin()}; }
+    [[nodiscard]] Iterator<CharView> end() const noexcept { return {page_, End()}; }
+
+   private:
+    friend class CompactPage;
+    friend class Iterator<LineView>;
+    LineView(const CompactPage* page, std::size_t line) : page_(page), line_(line) {}
+    [[nodiscard]] std::size_t Begin() const noexcept { return page_->line_offsets_[line_]; }
+    [[nodiscard]] std::size_t End() const noexcept { return page_->line_offsets_[line_ + 1]; }
+
+    const CompactPage* page_;
+    std::size_t line_;
+  };
+
+  struct LineRange {
+    Iterator<LineView> first;
+    Iterator<LineView> last;
+    [[nodiscard]] Iterator<LineView> begin() const noexcept { return first; }
+    [[nodiscard]] Iterator<LineView> end() const noexcept { return last; }
+  };
+
+  CompactPage() = default;
+  explicit CompactPage(const OcrPage& page);
+
+  // Appends one line, e.g. from a LineSink as lines are recognized. Boxes switch to the 32-bit
+  // layout the first time a coordinate does not fit in 16 bits.
+  void AppendLine(const OcrLine& line);
+  void SetImageSize(falcon::core::SizeI size) noexcept { image_size_ = size; }
+  void SetStatus(OcrStatus status) noexcept { status_ = status; }
+
+  [[nodiscard]] falcon::core::SizeI ImageSize() const noexcept { return image_size_; }
+  [[nodiscard]] OcrStatus Status() const noexcept { return status_; }
+  [[nodiscard]] std::size_t LineCount() const noexcept { return line_rtl_.size(); }
+  [[nodiscard]] std::size_t CharCount() const noexcept { return codepoints_.size(); }
+  [[nodiscard]] bool NarrowBoxes() const noexcept { return !wide_; }
+  [[nodiscard]] LineView Line(std::size_t line) const noexcept { return LineView(this, line); }
+  [[nodiscard]] LineRange Lines() const noexcept { return {{this, 0}, {this, LineCount()}}; }
+
+  // Contiguous per-character arrays, for bulk consumers.
+  [[nodiscard]] const std::vector<char32_t>& Codepoints() const noexcept { return codepoints_; }
+  [[nodiscard]] const std::vector<float>& Confidences() const noexcept { return confidences_; }
+  // line_offsets[i] is the first character of line i; the last entry is CharCount().
+  [[nodiscard]] const std::vector<uint32_t>& LineOffsets() const noexcept { return line_offsets_; }
+
+  [[nodiscard]] OcrPage ToPage() const;
+  // Heap bytes held by the arrays.
+  [[nodiscard]] std::size_t Bytes() const noexcept;
+
+  // Native byte order, which the header records; Deserialize rejects data from the other order.
+  [[nodiscard]] std::vector<uint8_t> Serialize() const;
+  // Throws std::runtime_error on truncated or malformed data.
+  static CompactPage Deserialize(const uint8_t* data, std::size_t size);
+
+ private:
+  struct NarrowBox {
+    uint16_t x, y, width, height;
+  };
+
+  [[nodiscard]] falcon::core::RectI Box(std::size_t index) const noexcept {
+    if (!wide_) {
+      const NarrowBox& box = narrow_boxes_[index];
+      return {box.x, box.y, box.width, box.height};
+    }
+    return wide_boxes_[index];
+  }
+  void Widen();
+
+  falcon::core::SizeI image_size_{};
+  OcrStatus status_{OcrStatus::kComplete};
+  std::vector<char32_t> codepoints_;
+  std::vector<float> confidences_;
+  // Exactly one of these holds the boxes, as selected by `wide_`.
+  bool wide_{false};
+  std::vector<NarrowBox> narrow_boxes_;
+  std::vector<falcon::core::RectI> wide_boxes_;
+  std::vector<uint32_t> line_offsets_{0};
+  std::vector<uint8_t> line_rtl_;
+};
+
+// UTF-8 text, one line per line as PageText(const OcrPage&) writes it.
+std::string PageText(const CompactPage& page);
+
+}  // namespace falcon::ocr
@@ -0,0 +1,145 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "falcon/core/Charset.h"
+#include "falcon/core/Classifier.h"
+#include "falcon/core/GlyphDB.h"
+#include "falcon/core/Layout.h"
+#include "falcon/core/Morphology.h"
+#include "falcon/core/PackRegistry.h"
+#include "falcon/core/Raster.h"
+#include "falcon/core/Segment.h"
+
+namespace falcon::ocr {
+
+// Per-page working memory for RunOcr. Every buffer is cleared between pages but keeps its
+// capacity, so once a context has processed a page of similar size, recognition only allocates
+// the returned OcrPage. A context must not be shared between threads running RunOcr at once.
+struct OcrContext {
+  // Templates admitted by one charset, with matrices resampled lazily per glyph size.
+  struct TemplateIndex {
+    falcon::core::Charset charset;
+    bool ascii_only{false};
+    uint64_t language_mask{~uint64_t{0}};  // bit i admits TemplateSet::pack_languages[i]
+    std::vector<const falcon::core::GlyphTemplate*> templates;  // into the owning TemplateSet
+    std::tuple<falcon::core::SizedTemplateMatrix<8>, falcon::core::SizedTemplateMatrix<16>,
+               falcon::core::SizedTemplateMatrix<32>>
+        matrices;
+    std::array<bool, 3> matrices_valid{};
+
+    template <int Size>
+    [[nodiscard]] const falcon::core::SizedTemplateMatrix<Size>& Matrix() {
+      constexpr std::size_t slot = Size == 8 ? 0 : (Size == 16 ? 1 : 2);
+      auto& matrix = std::get<falcon::core::SizedTemplateMatrix<Size>>(matrices);
+      if (!matrices_valid[slot]) {
+        matrix = falcon::core::BuildTemplateMatrix<Size>(templates);
+        matrices_valid[slot] = true;
+      }
+      return matrix;
+    }
+  };
+
+  // Merged templates for one language selection and the sub-indexes built from them, most
+  // recently used last. Templates point into the registry's immutable packs, held by `packs`, and
+  // the built-in table; only templates reduced at load time are owned here.
+  struct TemplateSet {
+    uint64_t generation{0};  // PackRegistry::Generation() the templates were merged at
+    int merge_pixels{0};
+    std::vector<std::string> languages;
+    std::vector<falcon::core::PackHandle> packs;
+    std::vector<falcon::core::GlyphTemplate> reduced;
+    std::vector<const falcon::core::GlyphTemplate*> templates;
+    std::vector<std::string> pack_languages;  // distinct GlyphTemplate::language values
+    std::vector<std::size_t> language_of;     // pack_languages index of each template
+    std::list<TemplateIndex> indexes;
+  };
+
+  // Template sets of the language selections used recently, most recent last, so callers that
+  // alternate between a few selections do not re-merge on every switch.
+  struct TemplateCache {
+    std::list<TemplateSet> sets;
+
+    // The set the last lookup returned.
+    [[nodiscard]] TemplateSet& Current() { return sets.back(); }
+  };
+
+  // Binarization and segmentation of the last page recognized with a region, kept so requests for
+  // other regions of the same raster go straight to layout and skip glyphs classified before.
+  // Only valid while `binary` still holds that page; every other run clears `valid`.
+  struct PageAnalysis {
+    bool valid{false};
+    // Identity of the analyzed raster (pixel hash, size, DPI) and the preprocessing applied to it.
+    uint64_t content_hash{0};
+    falcon::core::SizeI size{};
+    int dpi_x{0};
+    int dpi_y{0};
+    int factor_x{1};
+    int factor_y{1};
+    falcon::core::CleanupOptions cleanup{};
+    std::vector<falcon::core::ConnectedComponent> components;  // whole page, in label order
+    // Uniform grid over the binary image: cell c lists the components overlapping it in
+    // cell_entries[cell_begin[c], cell_begin[c + 1]).
+    int columns{0};
+    int rows{0};
+    std::vector<uint32_t> cell_begin;
+    std::vector<uint32_t> cell_entries;
+    std::vector<uint32_t> query_stamp;  // per component, so a query reports it once
+    uint32_t query{0};
+    std::vector<uint32_t> hits;
+    // Results per component for the classification settings hashed in `classify_key`, with the
+    // language mask each was computed under (0 while unclassified).
+    uint64_t classify_key{0};
+    std::vector<falcon::core::ClassificationResult> classifications;
+    std::vector<uint64_t> classified_mask;
+  };
+
+  // Glyph batch for one engine glyph size.
+  template <int Size>
+  struct SizedBuffers {
+    falcon::core::SizedGlyphMatrix<Size> glyphs;
+  };
+
+  std::array<falcon::core::Raster, 2> scaled;  // ping-pong buffers for DPI reduction
+  falcon::core::BinaryImage binary;
+  falcon::core::MorphologyScratch morphology;
+  falcon::core::SegmentScratch segment;
+  falcon::core::TiledSegmentScratch tiles;
+  std::vector<falcon::core::ConnectedComponent> components;
+  falcon::core::LayoutScratch layout;
+  std::vector<falcon::core::TextBlock> blocks;
+  std::vector<falcon::core::TextLine> lines;
+  std::vector<std::pair<std::size_t, std::size_t>> tasks;
+  std::vector<falcon::core::ClassificationResult> classifications;
+  // Per glyph, set once classified; only maintained for cancellable calls.
+  std::vector<uint8_t> recognized;
+  PageAnalysis analysis;
+  TemplateCache templates;
+  std::tuple<SizedBuffers<8>, SizedBuffers<16>, SizedBuffers<32>> sized;
+
+  template <int Size>
+  [[nodiscard]] SizedBuffers<Size>& Sized() noexcept {
+    return std::get<SizedBuffers<Size>>(sized);
+  }
+
+  // Drops cached templates and returns all scratch memory to the allocator.
+  void Release();
+  // Returns the per-page buffers to the allocator but keeps the cached templates.
+  void ReleaseScratch();
+  // Capacity of the per-page buffers only, and of everything including cached template indexes
+  // (pack templates themselves belong to the registry).
+  [[nodiscard]] std::size_t ScratchBytes() const noexcept;
+  [[nodiscard]] std::size_t ReservedBytes() const noexcept;
+};
+
+// Context used by RunOcr overloads that do not take one explicitly; one instance per thread.
+OcrContext& ThreadLocalContext();
+
+}  // namespace falcon::ocr
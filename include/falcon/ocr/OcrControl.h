@@ -0,0 +1,62 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <utility>
+
+#include "falcon/ocr/OcrTypes.h"
+
+namespace falcon::ocr {
+
+// Cooperative cancellation, deadline and progress for one RunOcr call. The pipeline polls it
+// between stages and every few dozen glyphs during recognition; once it trips, RunOcr returns the
+// glyphs recognized so far with OcrPage::status saying why. Cancel() and Progress() may be called
+// from any thread while the call runs.
+class OcrControl {
+ public:
+  using Clock = std::chrono::steady_clock;
+  using ProgressCallback = std::function<void(const OcrProgress&)>;
+
+  OcrControl() = default;
+  OcrControl(const OcrControl&) = delete;
+  OcrControl& operator=(const OcrControl&) = delete;
+
+  void Cancel() noexcept { cancelled_.store(true, std::memory_order_relaxed); }
+  [[nodiscard]] bool Cancelled() const noexcept { return cancelled_.load(std::memory_order_relaxed); }
+
+  void SetDeadline(Clock::time_point deadline) noexcept {
+    deadline_.store(deadline.time_since_epoch().count(), std::memory_order_relaxed);
+  }
+  void SetTimeout(Clock::duration timeout) { SetDeadline(Clock::now() + timeout); }
+
+  // Called after each stage and as recognition advances. Calls are serialized but may come from
+  // any pool thread, so the callback should only record or post the value. May be replaced while a
+  // call runs, but not from inside the callback.
+  void SetProgressCallback(ProgressCallback callback);
+
+  [[nodiscard]] OcrProgress Progress() const noexcept;
+
+  // kComplete while the call may continue; otherwise why it has to stop.
+  [[nodiscard]] OcrStatus Check() const noexcept;
+
+  // Pipeline side: enter a stage, and count recognized glyphs.
+  void BeginStage(OcrStage stage, std::size_t glyphs_total = 0);
+  void AddRecognized(std::size_t glyphs);
+
+ private:
+  void Notify();
+
+  std::atomic<bool> cancelled_{false};
+  std::atomic<Clock::rep> deadline_{Clock::time_point::max().time_since_epoch().count()};
+  std::atomic<OcrStage> stage_{OcrStage::kQueued};
+  std::atomic<std::size_t> glyphs_done_{0};
+  std::atomic<std::size_t> glyphs_total_{0};
+  std::atomic<bool> has_callback_{false};
+  std::mutex callback_mutex_;
+  ProgressCallback callback_;
+};
+
+}  // namespace falcon::ocr
@@ -1,10 +1,15 @@
 #pragma once
 
+#include <algorithm>
+#include <cstddef>
 #include <string>
 #include <vector>
 
+#include "falcon/core/Charset.h"
 #include "falcon/core/Classifier.h"
 #include "falcon/core/Geometry.h"
+#include "falcon/core/Layout.h"
+#include "falcon/core/Morphology.h"
 
 namespace falcon::ocr {
 
@@ -18,17 +23,91 @@ struct OcrLine {
   bool rtl{false};
 };
 
+enum class OcrStatus {
+  kComplete,
+  kCancelled,  // stopped through OcrControl::Cancel()
+  kTimedOut,   // stopped at the OcrControl deadline
+};
+
+// Bytes held by the input raster and the OcrContext's per-page buffers at the end of each stage,
+// i.e. the request's working set excluding the returned page and cached templates.
+struct OcrMemoryUsage {
+  std::size_t preprocess{0};  // input, DPI reduction and binary image
+  std::size_t segment{0};
+  std::size_t layout{0};
+  std::size_t recognize{0};
+
+  [[nodiscard]] std::size_t Peak() const noexcept {
+    return std::max(std::max(preprocess, segment), std::max(layout, recognize));
+  }
+};
+
 struct OcrPage {
   std::vector<OcrLine> lines;
   falcon::core::SizeI image_size{};
+  // Pages that stopped early hold only the glyphs recognized before the stop, in reading order.
+  OcrStatus status{OcrStatus::kComplete};
+  OcrMemoryUsage memory{};
+};
+
+enum class OcrStage {
+  kQueued,
+  kPreprocess,  // DPI reduction and binarization
+  kSegment,
+  kLayout,
+  kRecognize,
+  kDone,
+};
+
+struct OcrProgress {
+  OcrStage stage{OcrStage::kQueued};
+  std::size_t glyphs_done{0};
+  std::size_t glyphs_total{0};
 };
 
 struct OcrOptions {
   std::vector<std::string> languages;
+  // With no explicit languages, the first N glyphs are matched against every pack and the rest of
+  // the page only against the packs that won confident matches (0 disables).
+  int script_probe_glyphs{32};
+  // Confidence a probe needs to vote for its pack; narrowed glyphs below it retry every pack.
+  float script_min_confidence{0.85f};
+  // Only templates whose codepoints the charset admits are compared (see falcon::core::Charset).
+  falcon::core::Charset charset{};
+  // Restricts recognition to ASCII templates, on top of `charset`.
   bool ascii_only{false};
   bool detect_orientation{true};
+  // Restricts recognition to components intersecting `region`. The context keeps the page's
+  // binarization, components and classifications, so further regions of the same raster (e.g. an
+  // adjusted selection) only classify glyphs not seen before (see OcrContext::PageAnalysis).
   falcon::core::RectI region{};
   bool has_region{false};
+  // Morphological noise cleanup of the binary image before segmentation. Off by default; on dirty
+  // scans despeckling and a small opening remove most of the specks that would otherwise be
+  // classified as characters.
+  falcon::core::CleanupOptions cleanup{};
+  falcon::core::LayoutOptions layout{};
+  // When positive, pages scanned above this resolution (per Raster::dpi_x/dpi_y) are area-averaged
+  // down by whole factors before binarization. Result boxes stay in source pixel coordinates.
+  int target_dpi{0};
+  // When positive, near-duplicate templates of one codepoint within this many pixels are merged
+  // at load time (see falcon::core::ReduceTemplates).
+  int template_merge_pixels{0};
+  // Normalization/classification resolution: 8 (fast, clean print), 16 or 32 (complex scripts).
+  // Templates are stored at 16x16 and resampled; at 32 they are pixel-replicated, so only the page
+  // glyphs gain detail.
+  int glyph_size{falcon::core::kGlyphSize};
+  // Recognize independent text blocks on the shared thread pool.
+  bool parallel{true};
+  // When positive (and `parallel` is set), binarization and connected-component labeling run on
+  // the shared thread pool in square tiles of this many pixels. Worth it for very large pages;
+  // results are identical to the untiled pass.
+  int tile_size{0};
+  // When positive, the working set (see OcrMemoryUsage) is kept under this many bytes. Pages that
+  // would not fit are first segmented in tiles, then reduced by whole factors as long as they stay
+  // at or above 150 DPI; pages that still do not fit fail with MemoryBudgetError before the large
+  // buffers are allocated.
+  std::size_t memory_budget{0};
 };
 
 }  // namespace falcon::ocr
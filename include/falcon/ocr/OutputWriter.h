@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstddef>
+#include <iosfwd>
+#include <memory>
+#include <string>
+#include <string_view>
+
+#include "falcon/ocr/Pipeline.h"
+
+namespace falcon::ocr {
+
+enum class OutputFormat {
+  kText,  // one line of UTF-8 text per OcrLine
+  kTsv,   // header row, then line number, box, mean confidence and text per line
+  kHocr,  // hOCR 1.2 document with one ocr_line span per line
+  kJson,  // {"width", "height", "lines": [{"bbox", "confidence", "text"}], "status"}; "failed"
+          // closes a page whose recognition threw
+};
+
+// Accepts "text", "tsv", "hocr" and "json"; throws std::invalid_argument otherwise.
+OutputFormat ParseOutputFormat(std::string_view name);
+// File extension for the format, including the dot.
+const char* OutputExtension(OutputFormat format);
+
+// LineSink that formats lines as they arrive into a reusable buffer, encoding UTF-8 straight from
+// the codepoints (ASCII takes a single store), and writes it to the stream in large chunks.
+// Reusable across pages; the buffer is flushed at the end of every page, and after every line
+// when `line_buffered` is set (for interactive output).
+class OutputWriter : public LineSink {
+ public:
+  explicit OutputWriter(std::ostream& stream, bool line_buffered = false);
+  ~OutputWriter() override;
+
+  OutputWriter(const OutputWriter&) = delete;
+  OutputWriter& operator=(const OutputWriter&) = delete;
+
+  // Writes a whole page at once.
+  void WritePage(const OcrPage& page);
+  void Flush();
+
+ protected:
+  static constexpr std::size_t kFlushBytes = 64 * 1024;
+
+  // Called after each line: flushes once the buffer passes kFlushBytes, or always when line
+  // buffered.
+  void MaybeFlush() {
+    if (line_buffered_ || buffer_.size() >= kFlushBytes) {
+      Flush();
+    }
+  }
+
+  std::string buffer_;
+
+ private:
+  std::ostream& stream_;
+  bool line_buffered_;
+};
+
+std::unique_ptr<OutputWriter> MakeOutputWriter(OutputFormat format, std::ostream& stream, bool line_buffered = false);
+
+}  // namespace falcon::ocr
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+
+#include "falcon/core/Raster.h"
+#include "falcon/ocr/OcrTypes.h"
+
+namespace falcon::ocr {
+
+// Produces the pages of a document in order: fills `page` and returns true, or returns false at
+// the end. core::PnmPageReader::Next fits directly.
+using PageSource = std::function<bool(falcon::core::Raster& page)>;
+// Receives each recognized page, in page order, on the thread that called RunOcrPages.
+using PageCallback = std::function<void(std::size_t index, OcrPage& page)>;
+
+struct PageStreamOptions {
+  OcrOptions ocr{};
+  // Pages recognized at once; each page is additionally split across the shared thread pool.
+  std::size_t workers{2};
+  // Pages decoded but not yet delivered, which bounds how many rasters are resident no matter
+  // how long the document is. Raised to `workers` if smaller.
+  std::size_t max_pages_in_flight{4};
+};
+
+// Recognizes every page `source` yields. Decoding runs on its own thread ahead of recognition and
+// recognition of later pages overlaps delivery of earlier ones. Returns the number of pages
+// delivered. The first decode, recognition or callback error stops the stream and is rethrown
+// after the pages before it have been delivered.
+std::size_t RunOcrPages(const PageSource& source, const PageStreamOptions& options, const PageCallback& on_page);
+
+}  // namespace falcon::ocr
@@ -1,10 +1,94 @@
 #pragma once
 
+#include <cstddef>
+#include <filesystem>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
 #include "falcon/core/Raster.h"
+#include "falcon/ocr/OcrContext.h"
 #include "falcon/ocr/OcrTypes.h"
 
 namespace falcon::ocr {
 
+class OcrControl;
+
+// Receives a page line by line while it is being recognized. OnLine calls arrive in reading order,
+// once per line and never concurrently, but may come from thread-pool workers. No pipeline lock
+// is held during any call. Every BeginPage is matched by EndPage or AbortPage.
+class LineSink {
+ public:
+  virtual ~LineSink() = default;
+  virtual void BeginPage(falcon::core::SizeI /*image_size*/) {}
+  virtual void OnLine(const OcrLine& line) = 0;
+  // `page` is the complete result that RunOcr is about to return.
+  virtual void EndPage(const OcrPage& /*page*/) {}
+  // Called instead of EndPage when recognition throws, after the lines already delivered; RunOcr
+  // then rethrows.
+  virtual void AbortPage() {}
+};
+
 OcrPage RunOcr(const falcon::core::Raster& raster, const OcrOptions& options = {});
+OcrPage RunOcr(const falcon::core::Raster& raster, const OcrOptions& options, OcrContext& context);
+
+// Recognizes borrowed pixels in place, without copying them into a Raster (rows may be padded or
+// belong to a larger image). `control` may be null.
+OcrPage RunOcr(const falcon::core::RasterView& image, const OcrOptions& options, OcrContext& context,
+               OcrControl* control = nullptr);
+
+// Cancellable variants: stop early when `control` is cancelled or past its deadline and return the
+// glyphs recognized so far (see OcrPage::status). Progress is published through `control`.
+OcrPage RunOcr(const falcon::core::Raster& raster, const OcrOptions& options, OcrControl& control);
+OcrPage RunOcr(const falcon::core::Raster& raster, const OcrOptions& options, OcrContext& context,
+               OcrControl& control);
+
+// Streaming variants: each line goes to `sink` as soon as it and every line before it are final,
+// so output can start while later blocks are still being classified. The full page is returned
+// as well.
+OcrPage RunOcr(const falcon::core::Raster& raster, const OcrOptions& options, LineSink& sink);
+OcrPage RunOcr(const falcon::core::Raster& raster, const OcrOptions& options, OcrContext& context, LineSink& sink,
+               OcrControl* control = nullptr);
+
+// Thrown when a page cannot be recognized within OcrOptions::memory_budget.
+class MemoryBudgetError : public std::runtime_error {
+ public:
+  MemoryBudgetError(const std::string& what, std::size_t required, std::size_t budget)
+      : std::runtime_error(what), required_(required), budget_(budget) {}
+
+  // Smallest working set the pipeline could plan for the page (or stage) that failed.
+  [[nodiscard]] std::size_t Required() const noexcept { return required_; }
+  [[nodiscard]] std::size_t Budget() const noexcept { return budget_; }
+
+ private:
+  std::size_t required_;
+  std::size_t budget_;
+};
+
+// Throws MemoryBudgetError if a `size` page scanned at `dpi_x` x `dpi_y` cannot fit the budget
+// even with the fallbacks RunOcr applies, so callers can reject it before decoding. Does nothing
+// without a budget. Only the page size is known here; RunOcr also bounds what grows with the ink
+// (labeling queue, component lists) once the page is binarized, before segmenting it.
+void CheckMemoryBudget(falcon::core::SizeI size, int dpi_x, int dpi_y, const OcrOptions& options);
+
+// Resolution reduction RunOcr plans for such a page from options.target_dpi and
+// options.memory_budget. `ink_dependent` is set when the ink could still force a coarser reduction
+// under the budget, i.e. the result may depend on the budget beyond these factors. Throws
+// MemoryBudgetError like CheckMemoryBudget.
+struct PlannedReduction {
+  int factor_x{1};
+  int factor_y{1};
+  bool ink_dependent{false};
+};
+PlannedReduction PlanReduction(falcon::core::SizeI size, int dpi_x, int dpi_y, const OcrOptions& options);
+
+// LoadImage that first checks the image header against options.memory_budget, so oversized
+// uploads fail before their pixels are decoded.
+falcon::core::Raster LoadImageForOcr(const std::filesystem::path& path, const OcrOptions& options);
+// The same for an image received in memory, e.g. over a socket.
+falcon::core::Raster DecodeImageForOcr(const std::vector<uint8_t>& bytes, const OcrOptions& options);
+
+// UTF-8 text of the page, one line per OcrLine, each terminated by '\n'.
+std::string PageText(const OcrPage& page);
 
 }  // namespace falcon::ocr
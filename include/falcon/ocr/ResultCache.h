@@ -0,0 +1,130 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "falcon/core/GlyphDB.h"
+#include "falcon/core/Image.h"
+#include "falcon/core/Raster.h"
+#include "falcon/ocr/OcrTypes.h"
+
+namespace falcon::ocr {
+
+// Identifies one result: the input's content hash and size, and a fingerprint of everything else
+// the result depends on (options and template set).
+struct ResultCacheKey {
+  uint64_t content{0};
+  uint64_t content_size{0};
+  uint64_t config{0};
+
+  bool operator==(const ResultCacheKey& other) const noexcept {
+    return content == other.content && content_size == other.content_size && config == other.config;
+  }
+};
+
+// Hashes the options that can change a page's result. Scheduling-only options (parallel,
+// tile_size) are left out since they produce identical pages, and so is memory_budget, which only
+// matters through the reduction it plans for a given page (see ResultCache::KeyFor).
+uint64_t OptionsFingerprint(const OcrOptions& options);
+// Hashes codepoints, bitmaps and pack names, so edited packs invalidate cached results.
+uint64_t TemplateFingerprint(const std::vector<falcon::core::GlyphTemplate>& templates);
+
+// A page's lines, characters and image size (not its memory usage) in the CompactPage encoding.
+std::vector<uint8_t> SerializePage(const OcrPage& page);
+// Throws std::runtime_error on truncated or malformed data.
+OcrPage DeserializePage(const uint8_t* data, std::size_t size);
+
+struct ResultCacheStats {
+  std::size_t hits{0};
+  std::size_t misses{0};
+  std::size_t stores{0};
+  std::size_t evictions{0};
+};
+
+// Persistent cache of recognized pages in a local directory, one write-once file per result.
+// Files are written to a temporary name and renamed into place, so several processes may share
+// the directory: a lookup that misses the in-memory index checks the disk, and stores re-index the
+// directory at most once per kRescanInterval to pick up the other processes' entries. When the
+// indexed files exceed `max_bytes`, the least recently used ones are deleted; recency is kept in
+// file modification times, so it is shared between processes and survives restarts. Temporary
+// files left by crashed writers are deleted when the directory is indexed. Thread-safe.
+class ResultCache {
+ public:
+  static constexpr std::size_t kDefaultMaxBytes = std::size_t{256} << 20;
+  static constexpr std::chrono::seconds kRescanInterval{30};
+
+  // Creates the directory if needed and indexes the results already in it.
+  explicit ResultCache(std::filesystem::path directory, std::size_t max_bytes = kDefaultMaxBytes);
+
+  ResultCache(const ResultCache&) = delete;
+  ResultCache& operator=(const ResultCache&) = delete;
+
+  // Key of an encoded image file, so a hit needs no decoding at all. Under a memory budget only
+  // the header is probed, and pages the budget reduces alike share keys.
+  ResultCacheKey KeyFor(const std::vector<uint8_t>& file_bytes, const OcrOptions& options);
+  // Key of a decoded page, for callers that never see the encoded bytes.
+  ResultCacheKey KeyFor(const falcon::core::Raster& raster, const OcrOptions& options);
+
+  // Fills `page` and returns true on a hit, including entries other processes stored. Unreadable
+  // or corrupt entries count as misses and are removed.
+  bool Lookup(const ResultCacheKey& key, OcrPage& page);
+  // Saves a complete page; pages that stopped early are ignored. Write failures are ignored too,
+  // the cache only ever costs a recomputation.
+  void Store(const ResultCacheKey& key, const OcrPage& page);
+
+  [[nodiscard]] std::size_t Bytes() const;
+  [[nodiscard]] std::size_t Entries() const;
+  [[nodiscard]] ResultCacheStats Stats() const;
+  [[nodiscard]] const std::filesystem::path& Directory() const noexcept { return directory_; }
+
+ private:
+  struct Entry {
+    std::size_t bytes{0};
+    uint64_t stamp{0};
+  };
+  struct DiskEntry {
+    std::filesystem::file_time_type time;
+    std::string name;
+    std::size_t bytes{0};
+  };
+
+  // Entry files in the directory, least recently used first. Deletes stale temporary files.
+  std::vector<DiskEntry> Scan();
+  // Replaces the index with `found`, keeping its order as the recency order.
+  void IndexLocked(std::vector<DiskEntry> found);
+
+  uint64_t ConfigFingerprint(const OcrOptions& options, const falcon::core::ImageInfo* info);
+  std::filesystem::path PathFor(const std::string& name) const;
+  void TouchLocked(const std::string& name, Entry& entry);
+  // Records the recency in the file; done without holding mutex_.
+  void TouchFile(const std::string& name) const;
+  void EraseLocked(const std::string& name);
+  void EvictLocked();
+
+  std::filesystem::path directory_;
+  std::size_t max_bytes_;
+  mutable std::mutex mutex_;
+  std::unordered_map<std::string, Entry> entries_;
+  std::map<uint64_t, std::string> recency_;  // stamp -> name, least recent first
+  uint64_t clock_{0};
+  std::size_t bytes_{0};
+  std::chrono::steady_clock::time_point last_scan_;
+  uint64_t temp_counter_{0};
+  ResultCacheStats stats_;
+
+  // Template fingerprint of the last language selection, recomputed when packs change.
+  std::mutex template_mutex_;
+  bool template_valid_{false};
+  std::vector<std::string> template_languages_;
+  uint64_t template_generation_{0};
+  uint64_t template_fingerprint_{0};
+};
+
+}  // namespace falcon::ocr
@@ -0,0 +1,160 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <future>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "falcon/core/PackWatcher.h"
+#include "falcon/core/Raster.h"
+#include "falcon/ocr/OcrTypes.h"
+#include "falcon/util/BoundedQueue.h"
+
+namespace falcon::ocr {
+
+// Line-oriented protocol spoken over the daemon socket. Requests:
+//   PATH <path>\n          recognize an image file readable by the server (see path_root)
+//   DATA <bytes>\n<data>   recognize BMP/PNM data sent inline
+//   QUIT\n                 close the connection
+// Each request is answered with `OK <bytes>\n<utf-8 text>` or `ERR <bytes>\n<message>`, in request
+// order. Clients may pipeline several requests before reading the answers.
+struct ServerOptions {
+  OcrOptions ocr{};
+  // Unix domain socket to listen on. When empty the server listens on 127.0.0.1:tcp_port instead;
+  // port 0 picks a free port (see OcrServer::Port()).
+  std::filesystem::path socket_path;
+  int tcp_port{0};
+  // PATH requests may only name files under this directory, after resolving symlinks; relative
+  // paths are taken from it. When empty, PATH is only accepted on the Unix socket, whose file
+  // permissions decide who may connect, and TCP clients have to send DATA.
+  std::filesystem::path path_root;
+  // Connections beyond this are answered with ERR and closed.
+  std::size_t max_connections{64};
+  // Decoded images waiting for recognition; connections block (backpressure) while it is full.
+  std::size_t max_pending{64};
+  // Requests a single connection may have in flight when it pipelines.
+  std::size_t max_pipelined{16};
+  // Requests arriving within `batch_window` of each other are recognized together, up to
+  // `max_batch` pages spread across the thread pool.
+  std::size_t max_batch{8};
+  std::chrono::microseconds batch_window{2000};
+  std::size_t max_request_bytes{64u << 20};
+  // A client that takes none of its answers for this long is disconnected.
+  std::chrono::milliseconds send_timeout{30000};
+  // How long Stop() lets connections finish answering before it cuts off the ones still writing.
+  std::chrono::milliseconds stop_grace{2000};
+  // Reload edited language packs while running.
+  bool watch_packs{true};
+};
+
+struct ServerStats {
+  uint64_t requests{0};
+  uint64_t failed{0};
+  uint64_t batches{0};
+  uint64_t rejected_connections{0};
+};
+
+// Long-running OCR service: language packs, template indexes and thread-pool contexts are warmed
+// once at Start() and reused by every request, and concurrent requests are micro-batched so a burst
+// of small pages costs one pass over the pool rather than one fork/join each. POSIX only.
+class OcrServer {
+ public:
+  explicit OcrServer(ServerOptions options);
+  ~OcrServer();
+
+  OcrServer(const OcrServer&) = delete;
+  OcrServer& operator=(const OcrServer&) = delete;
+
+  // Warms the recognizer, binds the socket and starts serving. Throws std::runtime_error when the
+  // socket cannot be bound.
+  void Start();
+  // Stops accepting, answers everything already queued and joins all threads. Connections still
+  // writing after ServerOptions::stop_grace are shut down, so this returns even when clients stop
+  // reading.
+  void Stop();
+
+  [[nodiscard]] int Port() const noexcept { return port_; }
+  [[nodiscard]] ServerStats Stats() const;
+
+ private:
+  struct Reply {
+    bool ok{false};
+    std::string body;
+  };
+  struct Job {
+    falcon::core::Raster raster;
+    std::promise<Reply> reply;
+  };
+  struct Connection {
+    int fd{-1};
+    std::thread thread;
+    std::atomic<bool> done{false};
+  };
+
+  void Warm();
+  void Bind();
+  void AcceptLoop();
+  void Serve(Connection& connection);
+  [[nodiscard]] std::filesystem::path ResolveRequestPath(const std::string& argument) const;
+  std::future<Reply> Submit(falcon::core::Raster raster);
+  void BatchLoop();
+  void Recognize(std::vector<Job>& batch);
+  void ReapConnections(bool all);
+
+  ServerOptions options_;
+  std::filesystem::path path_root_;
+  std::unique_ptr<falcon::core::PackWatcher> watcher_;
+  falcon::util::BoundedQueue<Job> queue_;
+  std::atomic<bool> stopping_{false};
+  int listen_fd_{-1};
+  int port_{0};
+  std::thread acceptor_;
+  std::thread batcher_;
+  std::mutex connections_mutex_;
+  std::condition_variable connections_done_;
+  std::list<Connection> connections_;
+
+  std::atomic<uint64_t> requests_{0};
+  std::atomic<uint64_t> failed_{0};
+  std::atomic<uint64_t> batches_{0};
+  std::atomic<uint64_t> rejected_{0};
+};
+
+// Blocking client for OcrServer. Recognize* throw std::runtime_error on transport errors and on ERR
+// replies.
+class OcrClient {
+ public:
+  static OcrClient ConnectUnix(const std::filesystem::path& socket_path);
+  static OcrClient ConnectTcp(int port);
+
+  OcrClient(OcrClient&& other) noexcept;
+  OcrClient& operator=(OcrClient&& other) noexcept;
+  OcrClient(const OcrClient&) = delete;
+  OcrClient& operator=(const OcrClient&) = delete;
+  ~OcrClient();
+
+  std::string RecognizeFile(const std::filesystem::path& path);
+  std::string RecognizeBytes(const std::vector<uint8_t>& bytes);
+
+  // Pipelining: queue several requests with Send*, then collect the answers in order with Receive.
+  void SendFile(const std::filesystem::path& path);
+  void SendBytes(const std::vector<uint8_t>& bytes);
+  std::string Receive();
+
+ private:
+  explicit OcrClient(int fd) : fd_(fd) {}
+
+  int fd_{-1};
+  std::string buffer_;
+};
+
+}  // namespace falcon::ocr
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+namespace falcon::util {
+
+// Small process-wide index for the calling thread, reused after the thread exits. Throws
+// std::runtime_error if more than kMaxThreadSlots threads ask for one at the same time.
+constexpr std::size_t kMaxThreadSlots = 512;
+std::size_t ThisThreadSlot();
+
+// Epoch-based reclamation for read-mostly objects published through atomic pointers (RCU style).
+// Readers pin the current epoch in their thread's slot without locking; writers retire replaced
+// objects, which are destroyed once no reader pinned at or before the retiring epoch remains.
+class EpochDomain {
+ public:
+  class Guard {
+   public:
+    explicit Guard(EpochDomain& domain);
+    ~Guard();
+    Guard(const Guard&) = delete;
+    Guard& operator=(const Guard&) = delete;
+
+   private:
+    EpochDomain& domain_;
+    std::size_t slot_;
+  };
+
+  EpochDomain() = default;
+  // Destroys every retired object; no reader may be pinned.
+  ~EpochDomain();
+  EpochDomain(const EpochDomain&) = delete;
+  EpochDomain& operator=(const EpochDomain&) = delete;
+
+  [[nodiscard]] Guard Pin() { return Guard(*this); }
+
+  // Defers `destroy(object)` until no reader can still hold `object`. Call after unpublishing it.
+  template <typename T>
+  void Retire(const T* object) {
+    RetireErased(const_cast<T*>(object), [](void* p) { delete static_cast<T*>(p); });
+  }
+
+  // Destroys retired objects that are no longer reachable by any pinned reader.
+  void Reclaim();
+  [[nodiscard]] std::size_t PendingCount() const;
+
+ private:
+  static constexpr uint64_t kIdle = ~uint64_t{0};
+
+  struct alignas(64) Slot {
+    std::atomic<uint64_t> epoch{kIdle};
+    std::size_t depth{0};  // touched only by the owning thread
+  };
+
+  struct Retired {
+    void* object;
+    void (*destroy)(void*);
+    uint64_t epoch;
+  };
+
+  void RetireErased(void* object, void (*destroy)(void*));
+
+  std::array<Slot, kMaxThreadSlots> slots_{};
+  std::atomic<uint64_t> epoch_{1};
+  mutable std::mutex retired_mutex_;
+  std::vector<Retired> retired_;
+};
+
+}  // namespace falcon::util
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <type_traits>
+
+namespace falcon::util {
+
+// Fast non-cryptographic 64-bit hash (the xxHash64 construction: four multiply-rotate lanes over
+// 32-byte stripes, several GB/s). Stable across runs and platforms of the same endianness, so it
+// can key persistent caches.
+uint64_t Hash64(const void* data, std::size_t size, uint64_t seed = 0) noexcept;
+
+// Chains values into one fingerprint; feeding the same values in the same order always gives the
+// same Digest().
+class Hasher {
+ public:
+  explicit Hasher(uint64_t seed = 0) noexcept : state_(seed) {}
+
+  Hasher& Add(const void* data, std::size_t size) noexcept {
+    state_ = Hash64(data, size, state_);
+    return *this;
+  }
+  Hasher& Add(std::string_view text) noexcept {
+    // The length keeps {"ab", "c"} and {"a", "bc"} apart.
+    Add(static_cast<uint64_t>(text.size()));
+    return Add(text.data(), text.size());
+  }
+  template <typename T, typename = std::enable_if_t<std::is_arithmetic_v<T> || std::is_enum_v<T>>>
+  Hasher& Add(T value) noexcept {
+    return Add(&value, sizeof(value));
+  }
+
+  [[nodiscard]] uint64_t Digest() const noexcept { return state_; }
+
+ private:
+  uint64_t state_;
+};
+
+}  // namespace falcon::util
@@ -7,4 +7,19 @@ namespace falcon::util {
 
 std::string ToUtf8(std::u32string_view input);
 
+void AppendUtf8Multibyte(std::string& out, char32_t codepoint);
+
+// Appends the UTF-8 encoding of `codepoint` to `out`; ASCII stays inline. Throws
+// std::runtime_error for values past U+10FFFF.
+inline void AppendUtf8(std::string& out, char32_t codepoint) {
+  if (codepoint < 0x80) {
+    out.push_back(static_cast<char>(codepoint));
+  } else {
+    AppendUtf8Multibyte(out, codepoint);
+  }
+}
+// Decodes well-formed UTF-8 (RFC 3629). Throws std::invalid_argument on invalid lead or
+// continuation bytes, truncated sequences, overlong forms, surrogates and values past U+10FFFF.
+std::u32string FromUtf8(std::string_view input);
+
 }  // namespace falcon::util
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+
+namespace falcon::util {
+
+// cv.wait(lock, pred).
+template <typename Predicate>
+void WaitFor(std::condition_variable& cv, std::unique_lock<std::mutex>& lock, Predicate pred) {
+#if defined(FALCON_OLD_LIBSTDCXX_RUNTIME)
+  // GCC 12 binds the untimed wait to a GLIBCXX_3.4.30 symbol, which older runtimes lack; the
+  // steady-clock overload is inlined. With no deadline it still blocks until notified.
+  cv.wait_until(lock, std::chrono::steady_clock::time_point::max(), pred);
+#else
+  cv.wait(lock, pred);
+#endif
+}
+
+}  // namespace falcon::util
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace falcon::util {
+
+// Fixed set of worker threads that help callers run index-parallel loops. The calling thread
+// always takes part, so a pool with zero workers simply runs loops inline. Submitting a loop does
+// not allocate.
+class ThreadPool {
+ public:
+  explicit ThreadPool(std::size_t worker_count);
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  // Process-wide pool with one worker per hardware thread minus the caller.
+  static ThreadPool& Shared();
+
+  [[nodiscard]] std::size_t WorkerCount() const noexcept { return workers_.size(); }
+
+  // Calls fn(i) for every i in [0, count) and returns once all calls have finished. The first
+  // exception thrown by fn is rethrown here after the remaining indices have run.
+  template <typename Fn>
+  void ParallelFor(std::size_t count, Fn&& fn) {
+    if (count == 0) {
+      return;
+    }
+    if (count == 1 || workers_.empty()) {
+      for (std::size_t i = 0; i < count; ++i) {
+        fn(i);
+      }
+      return;
+    }
+    using Callable = std::remove_reference_t<Fn>;
+    Job job;
+    job.invoke = [](void* context, std::size_t index) { (*static_cast<Callable*>(context))(index); };
+    job.context = const_cast<void*>(static_cast<const void*>(&fn));
+    job.count = count;
+    Run(job);
+  }
+
+ private:
+  struct Job {
+    void (*invoke)(void*, std::size_t){};
+    void* context{};
+    std::size_t count{};
+    std::size_t next{};
+    std::size_t done{};
+    std::exception_ptr error;
+    Job* link{};
+  };
+
+  void Run(Job& job);
+  // Claims the next index of the front job; requires mutex_ to be held.
+  bool ClaimLocked(Job*& job, std::size_t& index);
+  void Execute(Job& job, std::size_t index, std::unique_lock<std::mutex>& lock);
+  void WorkerLoop();
+
+  std::mutex mutex_;
+  std::condition_variable work_available_;
+  std::condition_variable job_finished_;
+  Job* head_{};
+  Job* tail_{};
+  bool stopping_{false};
+  std::vector<std::thread> workers_;
+};
+
+}  // namespace falcon::util
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <iosfwd>
+
+// Builds configured with FALCON_TRACING=OFF define this to 0, which turns every
+// FALCON_TRACE_SCOPE into nothing.
+#ifndef FALCON_TRACING
+#define FALCON_TRACING 1
+#endif
+
+namespace falcon::util {
+
+// Opt-in timeline of named scopes per thread, written as Chrome trace-event JSON (open it in
+// Perfetto or chrome://tracing). Each thread appends to its own buffer without locks, so a
+// recorded scope costs two clock reads and a store; while tracing is off a scope is one relaxed
+// load.
+class Tracer {
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  static void Start();
+  static void Stop() noexcept { enabled_.store(false, std::memory_order_relaxed); }
+  [[nodiscard]] static bool Enabled() noexcept { return enabled_.load(std::memory_order_relaxed); }
+
+  // Names the calling thread's track in the trace; ignored while tracing is off. `name` must
+  // outlive the trace, like every event name. Each traced thread keeps a small buffer for the
+  // rest of the process, so tracing is meant for profiling runs.
+  static void SetThreadName(const char* name);
+  // Records a scope of the calling thread. Events past the per-thread cap are counted as dropped.
+  static void Record(const char* name, Clock::time_point begin, Clock::time_point end) noexcept;
+
+  // Write and clear only while no thread is recording (after Stop and once traced work finished).
+  static void WriteJson(std::ostream& stream);
+  static void WriteJson(const std::filesystem::path& path);
+  static void Clear();
+  [[nodiscard]] static std::size_t EventCount();
+  [[nodiscard]] static std::size_t DroppedCount();
+
+ private:
+  static std::atomic<bool> enabled_;
+};
+
+// Records the enclosing scope as one complete ("X") event while tracing is on.
+class TraceScope {
+ public:
+  explicit TraceScope(const char* name) noexcept
+      : name_(Tracer::Enabled() ? name : nullptr), begin_(name_ != nullptr ? Tracer::Clock::now() : Tracer::Clock::time_point{}) {}
+
+  TraceScope(const TraceScope&) = delete;
+  TraceScope& operator=(const TraceScope&) = delete;
+
+  ~TraceScope() {
+    if (name_ != nullptr) {
+      Tracer::Record(name_, begin_, Tracer::Clock::now());
+    }
+  }
+
+ private:
+  const char* name_;
+  Tracer::Clock::time_point begin_;
+};
+
+}  // namespace falcon::util
+
+#define FALCON_TRACE_CONCAT_INNER(a, b) a##b
+#define FALCON_TRACE_CONCAT(a, b) FALCON_TRACE_CONCAT_INNER(a, b)
+
+#if FALCON_TRACING
+// Traces the rest of the enclosing block under `name`, which must be a string literal.
+#define FALCON_TRACE_SCOPE(name) const ::falcon::util::TraceScope FALCON_TRACE_CONCAT(falcon_trace_scope_, __LINE__)(name)
+#else
+#define FALCON_TRACE_SCOPE(name) static_cast<void>(0)
+#endif
@@ -0,0 +1,385 @@
+#include "falcon/app/Batch.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string_view>
+#include <thread>
+#include <utility>
+
+#include "falcon/core/Image.h"
+#include "falcon/ocr/Pipeline.h"
+#include "falcon/ocr/ResultCache.h"
+#include "falcon/util/BoundedQueue.h"
+#include "falcon/util/Trace.h"
+
+namespace falcon::app {
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct DecodedImage {
+  std::size_t index{0};
+  falcon::core::Raster raster;  // the first page
+  // PNM files may hold more pages, which the recognizer decodes from here one at a time.
+  std::unique_ptr<falcon::core::PnmPageReader> more_pages;
+  falcon::ocr::ResultCacheKey cache_key;
+  bool cached{false};
+  falcon::ocr::OcrPage page;  // the cached result when `cached`
+  std::string error;
+  Clock::time_point start;
+  double decode_ms{0.0};
+};
+
+struct RecognizedImage {
+  std::size_t index{0};
+  std::string text;
+  std::string error;
+  Clock::time_point start;
+  double decode_ms{0.0};
+  double ocr_ms{0.0};
+  falcon::ocr::OcrMemoryUsage memory;
+  bool cached{false};
+};
+
+std::vector<uint8_t> ReadFileBytes(const std::filesystem::path& path) {
+  std::ifstream file(path, std::ios::binary);
+  if (!file) {
+    throw std::runtime_error("Failed to open image file: " + path.string());
+  }
+  return std::vector<uint8_t>((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+}
+
+double MillisecondsSince(Clock::time_point start) {
+  return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+void CheckPageBudget(const falcon::core::ImageInfo& info, const falcon::ocr::OcrOptions& options) {
+  if (options.memory_budget > 0) {
+    falcon::ocr::CheckMemoryBudget(info.size, info.dpi_x, info.dpi_y, options);
+  }
+}
+
+void ReadManifest(std::istream& stream, std::vector<std::filesystem::path>& inputs) {
+  std::string line;
+  while (std::getline(stream, line)) {
+    while (!line.empty() && (line.back() == '\r' || line.back() == ' ' || line.back() == '\t')) {
+      line.pop_back();
+    }
+    if (!line.empty() && line.front() != '#') {
+      inputs.emplace_back(line);
+    }
+  }
+}
+
+double Percentile(std::vector<double> values, double fraction) {
+  if (values.empty()) {
+    return 0.0;
+  }
+  const auto rank = static_cast<std::size_t>(fraction * static_cast<double>(values.size() - 1) + 0.5);
+  std::nth_element(values.begin(), values.begin() + static_cast<std::ptrdiff_t>(rank), values.end());
+  return values[rank];
+}
+
+}  // namespace
+
+std::vector<std::filesystem::path> CollectBatchInputs(const std::vector<std::string>& arguments,
+                                                      std::istream& manifest) {
+  std::vector<std::filesystem::path> inputs;
+  for (const auto& argument : arguments) {
+    if (argument == "-") {
+      ReadManifest(manifest, inputs);
+    } else if (argument.size() > 1 && argument.front() == '@') {
+      std::ifstream list(argument.substr(1));
+      if (!list.is_open()) {
+        throw std::runtime_error("Cannot open file list " + argument.substr(1));
+      }
+      ReadManifest(list, inputs);
+    } else if (std::filesystem::is_directory(argument)) {
+      std::vector<std::filesystem::path> files;
+      for (const auto& entry : std::filesystem::directory_iterator(argument)) {
+        if (entry.is_regular_file() && falcon::core::IsImagePath(entry.path())) {
+          files.push_back(entry.path());
+        }
+      }
+      std::sort(files.begin(), files.end());
+      inputs.insert(inputs.end(), files.begin(), files.end());
+    } else {
+      inputs.emplace_back(argument);
+    }
+  }
+  return inputs;
+}
+
+BatchReport RunBatch(const std::vector<std::filesystem::path>& inputs, const BatchOptions& options,
+                     std::ostream& output) {
+  const auto batch_start = Clock::now();
+  BatchReport report;
+  report.files.resize(inputs.size());
+  for (std::size_t i = 0; i < inputs.size(); ++i) {
+    report.files[i].path = inputs[i];
+  }
+  if (!options.output_dir.empty()) {
+    std::filesystem::create_directories(options.output_dir);
+  }
+
+  std::unique_ptr<falcon::ocr::ResultCache> cache;
+  if (!options.cache_dir.empty()) {
+    cache = std::make_unique<falcon::ocr::ResultCache>(options.cache_dir, options.cache_bytes);
+  }
+
+  falcon::util::BoundedQueue<DecodedImage> decoded(options.queue_depth);
+  falcon::util::BoundedQueue<RecognizedImage> recognized(options.queue_depth);
+  // One ticket per image between the start of its decode and its write. The decoder blocks while
+  // the window is full, so a slow page holds back at most this many results in `pending` below.
+  const std::size_t worker_count = std::max<std::size_t>(options.ocr_workers, 1);
+  falcon::util::BoundedQueue<std::size_t> in_flight(2 * options.queue_depth + worker_count);
+
+  std::thread decoder([&] {
+    falcon::util::Tracer::SetThreadName("batch decoder");
+    for (std::size_t i = 0; i < inputs.size(); ++i) {
+      if (!in_flight.Push(i)) {
+        break;
+      }
+      DecodedImage item;
+      item.index = i;
+      item.start = Clock::now();
+      try {
+        FALCON_TRACE_SCOPE("batch.decode");
+        const bool pnm = falcon::core::IsPnmPath(inputs[i]);
+        if (cache) {
+          // The file is read once: hashed for the lookup, and decoded from memory on a miss.
+          auto bytes = ReadFileBytes(inputs[i]);
+          item.cache_key = cache->KeyFor(bytes, options.ocr);
+          item.cached = cache->Lookup(item.cache_key, item.page);
+          if (!item.cached && pnm) {
+            CheckPageBudget(falcon::core::ProbeImage(bytes), options.ocr);
+            item.more_pages = std::make_unique<falcon::core::PnmPageReader>(std::move(bytes));
+          } else if (!item.cached) {
+            item.raster = falcon::ocr::DecodeImageForOcr(bytes, options.ocr);
+          }
+        } else if (pnm) {
+          CheckPageBudget(falcon::core::ProbeImage(inputs[i]), options.ocr);
+          item.more_pages = std::make_unique<falcon::core::PnmPageReader>(inputs[i]);
+        } else {
+          item.raster = falcon::ocr::LoadImageForOcr(inputs[i], options.ocr);
+        }
+        if (item.more_pages && !item.more_pages->Next(item.raster)) {
+          throw std::runtime_error("No image in " + inputs[i].string());
+        }
+      } catch (const std::exception& ex) {
+        item.error = ex.what();
+      }
+      item.decode_ms = MillisecondsSince(item.start);
+      if (!decoded.Push(std::move(item))) {
+        break;
+      }
+    }
+    decoded.Close();
+  });
+
+  std::atomic<std::size_t> running{worker_count};
+  std::vector<std::thread> recognizers;
+  recognizers.reserve(worker_count);
+  for (std::size_t w = 0; w < worker_count; ++w) {
+    recognizers.emplace_back([&] {
+      falcon::util::Tracer::SetThreadName("batch recognizer");
+      DecodedImage item;
+      while (decoded.Pop(item)) {
+        RecognizedImage result;
+        result.index = item.index;
+        result.start = item.start;
+        result.decode_ms = item.decode_ms;
+        result.error = std::move(item.error);
+        result.cached = item.cached;
+        if (result.error.empty() && item.cached) {
+          std::ostringstream formatted;
+          falcon::ocr::MakeOutputWriter(options.format, formatted)->WritePage(item.page);
+          result.text = formatted.str();
+        } else if (result.error.empty()) {
+          const auto ocr_start = Clock::now();
+          try {
+            FALCON_TRACE_SCOPE("batch.ocr");
+            std::ostringstream formatted;
+            const auto writer = falcon::ocr::MakeOutputWriter(options.format, formatted);
+            auto page = falcon::ocr::RunOcr(item.raster, options.ocr);
+            writer->WritePage(page);
+            result.memory = page.memory;
+            bool single_page = true;
+            while (item.more_pages && item.more_pages->Next(item.raster)) {
+              single_page = false;
+              page = falcon::ocr::RunOcr(item.raster, options.ocr);
+              writer->WritePage(page);
+              if (page.memory.Peak() > result.memory.Peak()) {
+                result.memory = page.memory;
+              }
+            }
+            result.text = formatted.str();
+            // A cache entry holds one page.
+            if (cache && single_page) {
+              cache->Store(item.cache_key, page);
+            }
+          } catch (const std::exception& ex) {
+            result.error = ex.what();
+          }
+          result.ocr_ms = MillisecondsSince(ocr_start);
+        }
+        item.raster = {};
+        item.more_pages.reset();
+        item.page = {};
+        recognized.Push(std::move(result));
+      }
+      if (running.fetch_sub(1) == 1) {
+        recognized.Close();
+      }
+    });
+  }
+
+  // Writer stage on the calling thread. Stream output keeps input order; per-file output does not
+  // need to, so it is written as soon as each result arrives.
+  std::map<std::size_t, RecognizedImage> pending;
+  std::size_t next_index = 0;
+  const auto write = [&](RecognizedImage& item) {
+    FALCON_TRACE_SCOPE("batch.write");
+    auto& file = report.files[item.index];
+    const auto write_start = Clock::now();
+    if (item.error.empty()) {
+      if (options.output_dir.empty()) {
+        output << "==> " << file.path.string() << " <==\n" << item.text;
+      } else {
+        const auto target =
+            options.output_dir / file.path.filename().replace_extension(falcon::ocr::OutputExtension(options.format));
+        std::ofstream stream(target, std::ios::binary);
+        stream << item.text;
+        if (!stream) {
+          item.error = "Cannot write " + target.string();
+        }
+      }
+    }
+    file.error = std::move(item.error);
+    file.decode_ms = item.decode_ms;
+    file.ocr_ms = item.ocr_ms;
+    file.memory = item.memory;
+    file.cached = item.cached;
+    file.write_ms = MillisecondsSince(write_start);
+    file.latency_ms = MillisecondsSince(item.start);
+    if (!file.error.empty()) {
+      ++report.failed;
+    } else if (file.cached) {
+      ++report.cache_hits;
+    }
+    std::size_t ticket = 0;
+    in_flight.Pop(ticket);
+  };
+
+  RecognizedImage item;
+  while (recognized.Pop(item)) {
+    if (!options.output_dir.empty()) {
+      write(item);
+      continue;
+    }
+    const std::size_t index = item.index;
+    pending.emplace(index, std::move(item));
+    for (auto it = pending.find(next_index); it != pending.end(); it = pending.find(next_index)) {
+      write(it->second);
+      pending.erase(it);
+      ++next_index;
+    }
+  }
+  output.flush();
+
+  decoder.join();
+  for (auto& recognizer : recognizers) {
+    recognizer.join();
+  }
+  report.wall_ms = MillisecondsSince(batch_start);
+  return report;
+}
+
+void PrintBatchSummary(const BatchReport& report, std::ostream& stream) {
+  std::vector<double> latencies;
+  double decode_ms = 0.0;
+  double ocr_ms = 0.0;
+  std::size_t peak_bytes = 0;
+  for (const auto& file : report.files) {
+    if (file.error.empty()) {
+      latencies.push_back(file.latency_ms);
+      decode_ms += file.decode_ms;
+      ocr_ms += file.ocr_ms;
+      peak_bytes = std::max(peak_bytes, file.memory.Peak());
+    } else {
+      stream << "failed: " << file.path.string() << ": " << file.error << '\n';
+    }
+  }
+  const double seconds = report.wall_ms / 1000.0;
+  const double throughput = seconds > 0.0 ? static_cast<double>(report.files.size()) / seconds : 0.0;
+  stream << "Processed " << report.files.size() << " files (" << report.failed << " failed) in " << seconds
+         << " s, " << throughput << " files/s\n";
+  stream << "Stage time: decode " << decode_ms << " ms, ocr " << ocr_ms << " ms\n";
+  stream << "Peak OCR working set: " << peak_bytes << " bytes\n";
+  if (report.cache_hits > 0) {
+    stream << "Result cache hits: " << report.cache_hits << '\n';
+  }
+  stream << "Latency ms: p50 " << Percentile(latencies, 0.5) << ", p95 " << Percentile(latencies, 0.95) << ", max "
+         << (latencies.empty() ? 0.0 : *std::max_element(latencies.begin(), latencies.end())) << std::endl;
+}
+
+void WriteBatchLatencies(const BatchReport& report, std::ostream& stream) {
+  stream << "path\tstatus\tdecode_ms\tocr_ms\twrite_ms\tlatency_ms\tpreprocess_bytes\tsegment_bytes\tlayout_bytes"
+            "\trecognize_bytes\tcached\n";
+  for (const auto& file : report.files) {
+    stream << file.path.string() << '\t' << (file.error.empty() ? "ok" : "failed") << '\t' << file.decode_ms << '\t'
+           << file.ocr_ms << '\t' << file.write_ms << '\t' << file.latency_ms << '\t' << file.memory.preprocess << '\t'
+           << file.memory.segment << '\t' << file.memory.layout << '\t' << file.memory.recognize << '\t'
+           << (file.cached ? 1 : 0) << '\n';
+  }
+}
+
+falcon::ocr::OcrOptions OcrOptionsFromEnvironment() {
+  falcon::ocr::OcrOptions options;
+  if (const char* env_langs = std::getenv("FALCON_LANGS"); env_langs != nullptr) {
+    std::string_view view(env_langs);
+    std::size_t start = 0;
+    while (start <= view.size()) {
+      const std::size_t end = view.find_first_of(",;", start);
+      const auto length = (end == std::string_view::npos) ? view.size() - start : end - start;
+      if (length > 0) {
+        options.languages.emplace_back(view.substr(start, length));
+      }
+      if (end == std::string_view::npos) {
+        break;
+      }
+      start = end + 1;
+    }
+  }
+  if (const char* env_dpi = std::getenv("FALCON_TARGET_DPI"); env_dpi != nullptr) {
+    options.target_dpi = std::atoi(env_dpi);
+  }
+  if (const char* env_charset = std::getenv("FALCON_CHARSET"); env_charset != nullptr) {
+    options.charset = falcon::core::Charset::Parse(env_charset);
+  }
+  if (const char* env_size = std::getenv("FALCON_GLYPH_SIZE"); env_size != nullptr) {
+    options.glyph_size = std::atoi(env_size);
+  }
+  if (const char* env_cleanup = std::getenv("FALCON_CLEANUP"); env_cleanup != nullptr) {
+    options.cleanup = falcon::core::CleanupOptions::Parse(env_cleanup);
+  }
+  if (const char* env_tile = std::getenv("FALCON_TILE_SIZE"); env_tile != nullptr) {
+    options.tile_size = std::atoi(env_tile);
+  }
+  if (const char* env_budget = std::getenv("FALCON_MEMORY_BUDGET_MB"); env_budget != nullptr) {
+    options.memory_budget = static_cast<std::size_t>(std::max(std::atoll(env_budget), 0LL)) << 20;
+  }
+  return options;
+}
+
+}  // namespace falcon::app
@@ -8,8 +8,10 @@
 #include <commdlg.h>
 
 #include <algorithm>
+#include <chrono>
 #include <filesystem>
 #include <iterator>
+#include <optional>
 #include <stdexcept>
 #include <string>
 #include <vector>
@@ -17,9 +19,9 @@
 #include "falcon/core/Image.h"
 #include "falcon/core/Raster.h"
 #include "falcon/core/GlyphDB.h"
+#include "falcon/ocr/AsyncOcr.h"
 #include "falcon/ocr/OcrTypes.h"
 #include "falcon/ocr/Pipeline.h"
-#include "falcon/util/String.h"
 #endif
 
 namespace falcon::app {
@@ -34,8 +36,16 @@ enum MenuId : UINT {
   kMenuFileOpen = 1,
   kMenuFileExit = 2,
   kMenuOcrRun = 10,
+  kMenuOcrCancel = 11,
 };
 
+// Posted by the OCR worker: progress carries the percentage in WPARAM.
+constexpr UINT kOcrProgressMessage = WM_APP + 1;
+constexpr UINT kOcrFinishedMessage = WM_APP + 2;
+
+// Pages that take longer come back with what was recognized so far.
+constexpr std::chrono::seconds kOcrTimeout{60};
+
 std::wstring Utf8ToWide(const std::string& text) {
   if (text.empty()) {
     return std::wstring();
@@ -62,6 +72,7 @@ struct MainWindow::Impl {
   falcon::core::Raster raster;
   std::vector<uint32_t> dib;
   std::filesystem::path opened_path;
+  std::optional<falcon::ocr::OcrTask> ocr_task;
 
   static LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM w_param, LPARAM l_param) {
     Impl* impl = nullptr;
@@ -89,6 +100,12 @@ struct MainWindow::Impl {
       case WM_PAINT:
         impl->OnPaint();
         return 0;
+      case kOcrProgressMessage:
+        impl->OnOcrProgress(static_cast<int>(w_param));
+        return 0;
+      case kOcrFinishedMessage:
+        impl->OnOcrFinished();
+        return 0;
       case WM_DESTROY:
         impl->OnDestroy();
         return 0;
@@ -143,6 +160,7 @@ struct MainWindow::Impl {
 
     HMENU ocr_menu = CreateMenu();
     AppendMenuW(ocr_menu, MF_STRING, kMenuOcrRun, L"&Run OCR");
+    AppendMenuW(ocr_menu, MF_STRING | MF_GRAYED, kMenuOcrCancel, L"&Cancel OCR");
 
     menu = CreateMenu();
     AppendMenuW(menu, MF_POPUP, reinterpret_cast<UINT_PTR>(file_menu), L"&File");
@@ -162,12 +180,22 @@ struct MainWindow::Impl {
       case kMenuOcrRun:
         OnRunOcr();
         break;
+      case kMenuOcrCancel:
+        if (ocr_task) {
+          ocr_task->control->Cancel();
+        }
+        break;
       default:
         break;
     }
   }
 
   void OnDestroy() {
+    if (ocr_task) {
+      ocr_task->control->Cancel();
+      ocr_task->result.wait();
+      ocr_task.reset();
+    }
     if (menu) {
       DestroyMenu(menu);
       menu = nullptr;
@@ -235,10 +263,7 @@ struct MainWindow::Impl {
       raster = falcon::core::LoadImage(opened_path);
       BuildDibFromRaster();
 
-      std::wstring title = kWindowTitle;
-      title += L" - ";
-      title += opened_path.filename().wstring();
-      SetWindowTextW(hwnd, title.c_str());
+      UpdateTitle(L"");
 
       InvalidateRect(hwnd, nullptr, TRUE);
     } catch (const std::exception& ex) {
@@ -247,31 +272,81 @@ struct MainWindow::Impl {
     }
   }
 
+  void UpdateTitle(const std::wstring& status) {
+    std::wstring title = kWindowTitle;
+    if (!opened_path.empty()) {
+      title += L" - ";
+      title += opened_path.filename().wstring();
+    }
+    title += status;
+    SetWindowTextW(hwnd, title.c_str());
+  }
+
+  // Recognition runs on a background worker so the window keeps painting; the worker posts
+  // progress and completion back to this thread.
   void OnRunOcr() {
     if (raster.Empty()) {
       MessageBoxW(hwnd, L"Load an image before running OCR.", kWindowTitle, MB_ICONINFORMATION | MB_OK);
       return;
     }
+    if (ocr_task) {
+      return;
+    }
+
+    const HWND target = hwnd;
+    falcon::ocr::AsyncOcrOptions async;
+    async.timeout = kOcrTimeout;
+    async.on_progress = [target, last = -1](const falcon::ocr::OcrProgress& progress) mutable {
+      if (progress.stage != falcon::ocr::OcrStage::kRecognize || progress.glyphs_total == 0) {
+        return;
+      }
+      const int percent = static_cast<int>(progress.glyphs_done * 100 / progress.glyphs_total);
+      if (percent != last) {
+        last = percent;
+        PostMessageW(target, kOcrProgressMessage, static_cast<WPARAM>(percent), 0);
+      }
+    };
+    async.on_complete = [target](const falcon::ocr::OcrPage&, std::exception_ptr) {
+      PostMessageW(target, kOcrFinishedMessage, 0, 0);
+    };
+    ocr_task = falcon::ocr::RunOcrAsync(raster, falcon::ocr::OcrOptions{}, std::move(async));
+    EnableMenuItem(menu, kMenuOcrRun, MF_BYCOMMAND | MF_GRAYED);
+    EnableMenuItem(menu, kMenuOcrCancel, MF_BYCOMMAND | MF_ENABLED);
+    UpdateTitle(L" - Running OCR…");
+  }
+
+  void OnOcrProgress(int percent) {
+    if (ocr_task) {
+      UpdateTitle(L" - Running OCR… " + std::to_wstring(percent) + L"%");
+    }
+  }
+
+  void OnOcrFinished() {
+    if (!ocr_task) {
+      return;
+    }
+    auto task = std::move(*ocr_task);
+    ocr_task.reset();
+    EnableMenuItem(menu, kMenuOcrRun, MF_BYCOMMAND | MF_ENABLED);
+    EnableMenuItem(menu, kMenuOcrCancel, MF_BYCOMMAND | MF_GRAYED);
+    UpdateTitle(L"");
 
     try {
-      falcon::ocr::OcrOptions options;
-      const auto page = falcon::ocr::RunOcr(raster, options);
+      const auto page = task.result.get();
       const auto languages = falcon::core::DiscoverLanguagePacks();
 
-      std::u32string text32;
-      for (const auto& line : page.lines) {
-        for (const auto& ch : line.characters) {
-          text32.push_back(ch.classification.codepoint);
-        }
-        text32.push_back(U'\n');
-      }
-
-      auto utf8 = falcon::util::ToUtf8(text32);
+      auto utf8 = falcon::ocr::PageText(page);
       if (utf8.empty()) {
         utf8 = "(No text recognized)";
       }
 
-      std::string header = "Languages: ";
+      std::string header;
+      if (page.status == falcon::ocr::OcrStatus::kTimedOut) {
+        header = "Timed out; showing partial result.\n";
+      } else if (page.status == falcon::ocr::OcrStatus::kCancelled) {
+        header = "Cancelled; showing partial result.\n";
+      }
+      header += "Languages: ";
       if (languages.empty()) {
         header += "(builtin ASCII fallback)";
       } else {
@@ -1,12 +1,24 @@
+#include "falcon/app/Batch.h"
 #include "falcon/app/MainWindow.h"
 #include "falcon/core/Image.h"
+#include "falcon/ocr/OutputWriter.h"
+#include "falcon/ocr/PageStream.h"
 #include "falcon/ocr/Pipeline.h"
-#include "falcon/util/String.h"
+#include "falcon/ocr/Server.h"
+#include "falcon/util/Trace.h"
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <csignal>
 #include <cstdlib>
 #include <filesystem>
+#include <fstream>
 #include <iostream>
+#include <string>
 #include <string_view>
+#include <thread>
+#include <vector>
 
 #ifdef _WIN32
 #include <windows.h>
@@ -16,45 +28,164 @@ namespace {
 
 #ifndef _WIN32
 void RunCli(int argc, char** argv) {
-  std::cout << "FalconOCR CLI preview" << std::endl;
-  if (argc < 2) {
-    std::cout << "Usage: falcon_app <image.bmp/pgm/ppm>" << std::endl;
+  std::cerr << "FalconOCR CLI preview" << std::endl;
+  auto format = falcon::ocr::OutputFormat::kText;
+  int first = 1;
+  if (argc > 2 && std::string_view(argv[1]) == "--format") {
+    try {
+      format = falcon::ocr::ParseOutputFormat(argv[2]);
+    } catch (const std::exception& ex) {
+      std::cerr << ex.what() << std::endl;
+      return;
+    }
+    first = 3;
+  }
+  if (argc <= first) {
+    std::cout << "Usage: falcon_app [--format text|tsv|hocr|json] <image.bmp/pgm/ppm>\n"
+                 "       falcon_app --batch [--format FMT] [--out DIR] [--jobs N] [--queue N] [--latency-log FILE]"
+                 " [--cache DIR] [--cache-mb N] <image|dir|@list.txt|->...\n"
+                 "       falcon_app --serve (--socket PATH | --port N) [--path-root DIR] [--max-connections N]"
+                 " [--max-batch N] [--batch-window-us N]"
+              << std::endl;
     return;
   }
 
-  const std::filesystem::path path = argv[1];
+  const std::filesystem::path path = argv[first];
   try {
-    const auto raster = falcon::core::LoadImage(path);
-    falcon::ocr::OcrOptions options;
-    if (const char* env_langs = std::getenv("FALCON_LANGS"); env_langs != nullptr) {
-      std::string_view view(env_langs);
-      std::size_t start = 0;
-      while (start <= view.size()) {
-        const std::size_t end = view.find_first_of(",;", start);
-        const auto length = (end == std::string_view::npos) ? view.size() - start : end - start;
-        if (length > 0) {
-          options.languages.emplace_back(view.substr(start, length));
-        }
-        if (end == std::string_view::npos) {
-          break;
-        }
-        start = end + 1;
-      }
+    const auto options = falcon::app::OcrOptionsFromEnvironment();
+    const auto writer = falcon::ocr::MakeOutputWriter(format, std::cout, true);
+    if (options.memory_budget > 0) {
+      const auto info = falcon::core::ProbeImage(path);
+      falcon::ocr::CheckMemoryBudget(info.size, info.dpi_x, info.dpi_y, options);
     }
-    options.ascii_only = false;
-    const auto page = falcon::ocr::RunOcr(raster, options);
-
-    for (const auto& line : page.lines) {
-      std::u32string text;
-      for (const auto& ch : line.characters) {
-        text.push_back(ch.classification.codepoint);
-      }
-      std::cout << falcon::util::ToUtf8(text) << std::endl;
+    if (falcon::core::IsPnmPath(path)) {
+      // PNM files may hold several pages; later pages are decoded while earlier ones are recognized.
+      falcon::core::PnmPageReader reader(path);
+      falcon::ocr::PageStreamOptions pages;
+      pages.ocr = options;
+      falcon::ocr::RunOcrPages([&reader](falcon::core::Raster& page) { return reader.Next(page); }, pages,
+                               [&writer](std::size_t, falcon::ocr::OcrPage& page) { writer->WritePage(page); });
+    } else {
+      // Lines are written as they are recognized rather than after the whole page.
+      falcon::ocr::RunOcr(falcon::core::LoadImage(path), options, *writer);
     }
+    std::cout.flush();
   } catch (const std::exception& ex) {
     std::cerr << "OCR failed: " << ex.what() << std::endl;
   }
 }
+
+// Batch mode: falcon_app --batch [options] <inputs...>. Text goes to stdout (or --out DIR), the
+// summary to stderr. Returns non-zero if any file failed.
+int RunBatchCli(int argc, char** argv) {
+  falcon::app::BatchOptions options;
+  std::filesystem::path latency_log;
+  std::string format = "text";
+  std::vector<std::string> arguments;
+  for (int i = 2; i < argc; ++i) {
+    const std::string_view arg = argv[i];
+    const bool has_value = i + 1 < argc;
+    if (arg == "--out" && has_value) {
+      options.output_dir = argv[++i];
+    } else if (arg == "--format" && has_value) {
+      format = argv[++i];
+    } else if (arg == "--jobs" && has_value) {
+      options.ocr_workers = static_cast<std::size_t>(std::max(std::atoi(argv[++i]), 1));
+    } else if (arg == "--queue" && has_value) {
+      options.queue_depth = static_cast<std::size_t>(std::max(std::atoi(argv[++i]), 1));
+    } else if (arg == "--latency-log" && has_value) {
+      latency_log = argv[++i];
+    } else if (arg == "--cache" && has_value) {
+      options.cache_dir = argv[++i];
+    } else if (arg == "--cache-mb" && has_value) {
+      options.cache_bytes = static_cast<std::size_t>(std::max(std::atoll(argv[++i]), 1LL)) << 20;
+    } else {
+      arguments.emplace_back(arg);
+    }
+  }
+
+  try {
+    options.ocr = falcon::app::OcrOptionsFromEnvironment();
+    options.format = falcon::ocr::ParseOutputFormat(format);
+    const auto inputs = falcon::app::CollectBatchInputs(arguments, std::cin);
+    if (inputs.empty()) {
+      std::cerr << "No input images" << std::endl;
+      return 2;
+    }
+    const auto report = falcon::app::RunBatch(inputs, options, std::cout);
+    falcon::app::PrintBatchSummary(report, std::cerr);
+    if (!latency_log.empty()) {
+      std::ofstream stream(latency_log);
+      falcon::app::WriteBatchLatencies(report, stream);
+    }
+    return report.failed == 0 ? 0 : 1;
+  } catch (const std::exception& ex) {
+    std::cerr << "Batch failed: " << ex.what() << std::endl;
+    return 2;
+  }
+}
+
+std::atomic<bool> g_stop_requested{false};
+
+// Daemon mode: serves OCR requests on a Unix socket or localhost port until SIGINT/SIGTERM.
+int RunServeCli(int argc, char** argv) {
+  falcon::ocr::ServerOptions options;
+  for (int i = 2; i < argc; ++i) {
+    const std::string_view arg = argv[i];
+    const bool has_value = i + 1 < argc;
+    if (arg == "--socket" && has_value) {
+      options.socket_path = argv[++i];
+    } else if (arg == "--port" && has_value) {
+      options.tcp_port = std::atoi(argv[++i]);
+    } else if (arg == "--path-root" && has_value) {
+      options.path_root = argv[++i];
+    } else if (arg == "--max-connections" && has_value) {
+      options.max_connections = static_cast<std::size_t>(std::max(std::atoi(argv[++i]), 1));
+    } else if (arg == "--max-batch" && has_value) {
+      options.max_batch = static_cast<std::size_t>(std::max(std::atoi(argv[++i]), 1));
+    } else if (arg == "--batch-window-us" && has_value) {
+      options.batch_window = std::chrono::microseconds(std::max(std::atoi(argv[++i]), 0));
+    } else {
+      std::cerr << "Unknown option " << arg << std::endl;
+      return 2;
+    }
+  }
+
+  std::signal(SIGINT, [](int) { g_stop_requested = true; });
+  std::signal(SIGTERM, [](int) { g_stop_requested = true; });
+  try {
+    options.ocr = falcon::app::OcrOptionsFromEnvironment();
+    falcon::ocr::OcrServer server(options);
+    server.Start();
+    if (options.socket_path.empty()) {
+      std::cerr << "Listening on 127.0.0.1:" << server.Port() << std::endl;
+    } else {
+      std::cerr << "Listening on " << options.socket_path.string() << std::endl;
+    }
+    while (!g_stop_requested) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+    server.Stop();
+    const auto stats = server.Stats();
+    std::cerr << "Served " << stats.requests << " requests (" << stats.failed << " failed) in " << stats.batches
+              << " batches" << std::endl;
+    return 0;
+  } catch (const std::exception& ex) {
+    std::cerr << "Server failed: " << ex.what() << std::endl;
+    return 2;
+  }
+}
+
+int RunCliCommand(int argc, char** argv) {
+  if (argc > 1 && std::string_view(argv[1]) == "--batch") {
+    return RunBatchCli(argc, argv);
+  }
+  if (argc > 1 && std::string_view(argv[1]) == "--serve") {
+    return RunServeCli(argc, argv);
+  }
+  RunCli(argc, argv);
+  return 0;
+}
 #endif
 
 }  // namespace
@@ -66,8 +197,22 @@ int APIENTRY wWinMain(HINSTANCE, HINSTANCE, LPWSTR, int) {
 #else
 int main(int argc, char** argv) {
   if (argc > 1) {
-    RunCli(argc, argv);
-    return 0;
+    // FALCON_TRACE=<file.json> records a timeline of every pipeline stage for Perfetto.
+    const char* trace_path = std::getenv("FALCON_TRACE");
+    if (trace_path == nullptr || *trace_path == '\0') {
+      return RunCliCommand(argc, argv);
+    }
+    falcon::util::Tracer::Start();
+    falcon::util::Tracer::SetThreadName("main");
+    const int status = RunCliCommand(argc, argv);
+    falcon::util::Tracer::Stop();
+    try {
+      falcon::util::Tracer::WriteJson(std::filesystem::path(trace_path));
+      std::cerr << "Trace written to " << trace_path << std::endl;
+    } catch (const std::exception& ex) {
+      std::cerr << ex.what() << std::endl;
+    }
+    return status;
   }
 
   std::cout << "No input file specified. Launching GUI stub..." << std::endl;
@@ -0,0 +1,274 @@
+#include "falcon/falcon_c.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "falcon/core/Charset.h"
+#include "falcon/core/Color.h"
+#include "falcon/core/Morphology.h"
+#include "falcon/core/Normalize.h"
+#include "falcon/core/Raster.h"
+#include "falcon/ocr/OcrContext.h"
+#include "falcon/ocr/Pipeline.h"
+
+struct falcon_engine {
+  falcon::ocr::OcrOptions options;
+};
+
+namespace {
+
+std::string& LastError() {
+  thread_local std::string message;
+  return message;
+}
+
+falcon_status Fail(falcon_status status, const char* message) {
+  LastError() = message;
+  return status;
+}
+
+// Runs `body`, turning any exception into a status so none crosses the C boundary.
+template <typename Body>
+falcon_status Guard(Body&& body) {
+  try {
+    body();
+    return FALCON_OK;
+  } catch (const falcon::ocr::MemoryBudgetError& error) {
+    return Fail(FALCON_ERROR_MEMORY_BUDGET, error.what());
+  } catch (const std::invalid_argument& error) {
+    return Fail(FALCON_ERROR_INVALID_ARGUMENT, error.what());
+  } catch (const std::bad_alloc&) {
+    return Fail(FALCON_ERROR_OUT_OF_MEMORY, "Out of memory");
+  } catch (const std::exception& error) {
+    return Fail(FALCON_ERROR_FAILED, error.what());
+  } catch (...) {
+    return Fail(FALCON_ERROR_FAILED, "Unknown error");
+  }
+}
+
+void SplitLanguages(std::string_view list, std::vector<std::string>& out) {
+  std::size_t start = 0;
+  while (start <= list.size()) {
+    const std::size_t end = std::min(list.find(',', start), list.size());
+    if (end > start) {
+      out.emplace_back(list.substr(start, end - start));
+    }
+    start = end + 1;
+  }
+}
+
+falcon::core::PixelFormat CorePixelFormat(falcon_pixel_format format) {
+  switch (format) {
+    case FALCON_PIXEL_GRAY8:
+      return falcon::core::PixelFormat::kGray8;
+    case FALCON_PIXEL_RGB24:
+      return falcon::core::PixelFormat::kRgb24;
+    case FALCON_PIXEL_BGR24:
+      return falcon::core::PixelFormat::kBgr24;
+    case FALCON_PIXEL_BGRX32:
+      return falcon::core::PixelFormat::kBgrx32;
+    case FALCON_PIXEL_RGBX32:
+      return falcon::core::PixelFormat::kRgbx32;
+  }
+  throw std::invalid_argument("Unknown pixel format");
+}
+
+falcon::core::Raster& ThreadGrayBuffer() {
+  thread_local falcon::core::Raster gray;
+  return gray;
+}
+
+// Gray pixels are viewed in place; color pixels are converted into a buffer each thread keeps.
+// Under a memory budget the buffer is the input raster RunOcr counts, so it is sized to the page
+// and the page is checked against the budget before converting.
+falcon::core::RasterView GrayView(const falcon_image& image, const falcon::ocr::OcrOptions& options) {
+  if (image.pixels == nullptr || image.width <= 0 || image.height <= 0) {
+    throw std::invalid_argument("falcon_image needs pixels and positive dimensions");
+  }
+  const auto format = CorePixelFormat(image.format);
+  const auto width = static_cast<std::size_t>(image.width);
+  if (image.stride < width * falcon::core::BytesPerPixel(format)) {
+    throw std::invalid_argument("falcon_image stride is shorter than a row");
+  }
+  const int dpi_x = image.dpi_x > 0 ? image.dpi_x : 96;
+  const int dpi_y = image.dpi_y > 0 ? image.dpi_y : 96;
+  if (format == falcon::core::PixelFormat::kGray8) {
+    return {image.pixels, image.width, image.height, image.stride, dpi_x, dpi_y};
+  }
+  auto& gray = ThreadGrayBuffer();
+  const std::size_t pixels = width * static_cast<std::size_t>(image.height);
+  if (options.memory_budget > 0) {
+    falcon::ocr::CheckMemoryBudget({image.width, image.height}, dpi_x, dpi_y, options);
+    if (gray.pixels.capacity() > pixels) {
+      // Capacity left over from a larger page would not be counted against this one.
+      std::vector<uint8_t>().swap(gray.pixels);
+    }
+  }
+  gray.width = image.width;
+  gray.height = image.height;
+  gray.dpi_x = dpi_x;
+  gray.dpi_y = dpi_y;
+  gray.pixels.resize(pixels);
+  const auto kernel = falcon::core::GrayRowKernelFor(format);
+  for (int y = 0; y < image.height; ++y) {
+    kernel(image.pixels + static_cast<std::size_t>(y) * image.stride, width,
+           gray.pixels.data() + static_cast<std::size_t>(y) * width);
+  }
+  return gray;
+}
+
+std::size_t AlignUp(std::size_t offset, std::size_t alignment) {
+  return (offset + alignment - 1) / alignment * alignment;
+}
+
+// Lays the page out in one malloc'd block: header, lines, characters, text.
+falcon_result* FlattenPage(const falcon::ocr::OcrPage& page) {
+  std::size_t chars = 0;
+  for (const auto& line : page.lines) {
+    chars += line.characters.size();
+  }
+  const std::string text = falcon::ocr::PageText(page);
+  const std::size_t lines_offset = AlignUp(sizeof(falcon_result), alignof(falcon_line));
+  const std::size_t chars_offset = AlignUp(lines_offset + page.lines.size() * sizeof(falcon_line), alignof(falcon_char));
+  const std::size_t text_offset = chars_offset + chars * sizeof(falcon_char);
+  auto* block = static_cast<unsigned char*>(std::malloc(text_offset + text.size() + 1));
+  if (block == nullptr) {
+    throw std::bad_alloc();
+  }
+
+  auto* lines = reinterpret_cast<falcon_line*>(block + lines_offset);
+  auto* out = reinterpret_cast<falcon_char*>(block + chars_offset);
+  std::size_t next = 0;
+  for (std::size_t i = 0; i < page.lines.size(); ++i) {
+    const auto& line = page.lines[i];
+    lines[i] = {next, line.characters.size(), line.rtl ? 1 : 0};
+    for (const auto& ch : line.characters) {
+      out[next++] = {static_cast<uint32_t>(ch.classification.codepoint),
+                     ch.classification.confidence,
+                     {ch.bounds.x, ch.bounds.y, ch.bounds.width, ch.bounds.height}};
+    }
+  }
+  auto* text_out = reinterpret_cast<char*>(block + text_offset);
+  std::memcpy(text_out, text.c_str(), text.size() + 1);
+
+  auto* result = reinterpret_cast<falcon_result*>(block);
+  result->image_width = page.image_size.width;
+  result->image_height = page.image_size.height;
+  result->line_count = page.lines.size();
+  result->lines = lines;
+  result->char_count = chars;
+  result->chars = out;
+  result->text = text_out;
+  result->text_size = text.size();
+  return result;
+}
+
+}  // namespace
+
+extern "C" {
+
+uint32_t falcon_abi_version(void) {
+  return FALCON_C_ABI_VERSION;
+}
+
+void falcon_engine_options_init(falcon_engine_options* options) {
+  if (options == nullptr) {
+    return;
+  }
+  const falcon::ocr::OcrOptions defaults;
+  *options = falcon_engine_options{};
+  options->struct_size = sizeof(falcon_engine_options);
+  options->ascii_only = defaults.ascii_only ? 1 : 0;
+  options->target_dpi = defaults.target_dpi;
+  options->glyph_size = defaults.glyph_size;
+  options->tile_size = defaults.tile_size;
+  options->memory_budget = defaults.memory_budget;
+}
+
+falcon_status falcon_engine_create(const falcon_engine_options* options, falcon_engine** engine) {
+  if (engine == nullptr) {
+    return Fail(FALCON_ERROR_INVALID_ARGUMENT, "falcon_engine_create needs an output pointer");
+  }
+  *engine = nullptr;
+  falcon_engine_options resolved;
+  falcon_engine_options_init(&resolved);
+  if (options != nullptr) {
+    if (options->struct_size == 0 || options->struct_size > sizeof(falcon_engine_options)) {
+      return Fail(FALCON_ERROR_INVALID_ARGUMENT, "falcon_engine_options.struct_size is not supported");
+    }
+    // Fields past the caller's struct_size keep their defaults.
+    std::memcpy(&resolved, options, options->struct_size);
+    resolved.struct_size = sizeof(falcon_engine_options);
+  }
+  return Guard([&] {
+    auto created = std::make_unique<falcon_engine>();
+    auto& ocr = created->options;
+    if (resolved.languages != nullptr) {
+      SplitLanguages(resolved.languages, ocr.languages);
+    }
+    if (resolved.charset != nullptr && *resolved.charset != '\0') {
+      ocr.charset = falcon::core::Charset::Parse(resolved.charset);
+    }
+    if (resolved.cleanup != nullptr) {
+      ocr.cleanup = falcon::core::CleanupOptions::Parse(resolved.cleanup);
+    }
+    ocr.ascii_only = resolved.ascii_only != 0;
+    ocr.target_dpi = std::max(resolved.target_dpi, 0);
+    ocr.glyph_size = resolved.glyph_size;
+    if (!falcon::core::IsSupportedGlyphSize(ocr.glyph_size)) {
+      throw std::invalid_argument("Glyph sizes of 8, 16 and 32 are supported");
+    }
+    ocr.tile_size = std::max(resolved.tile_size, 0);
+    ocr.memory_budget = static_cast<std::size_t>(resolved.memory_budget);
+    *engine = created.release();
+  });
+}
+
+void falcon_engine_destroy(falcon_engine* engine) {
+  delete engine;
+}
+
+falcon_status falcon_recognize(const falcon_engine* engine, const falcon_image* image, const falcon_rect* region,
+                               falcon_result** result) {
+  if (engine == nullptr || image == nullptr || result == nullptr) {
+    return Fail(FALCON_ERROR_INVALID_ARGUMENT, "falcon_recognize needs an engine, an image and an output pointer");
+  }
+  *result = nullptr;
+  return Guard([&] {
+    const auto view = GrayView(*image, engine->options);
+    auto& context = falcon::ocr::ThreadLocalContext();
+    falcon::ocr::OcrPage page;
+    if (region == nullptr) {
+      page = falcon::ocr::RunOcr(view, engine->options, context);
+    } else {
+      auto options = engine->options;
+      options.has_region = true;
+      options.region = {region->x, region->y, region->width, region->height};
+      page = falcon::ocr::RunOcr(view, options, context);
+    }
+    *result = FlattenPage(page);
+  });
+}
+
+void falcon_result_free(falcon_result* result) {
+  std::free(result);
+}
+
+void falcon_thread_release(void) {
+  std::vector<uint8_t>().swap(ThreadGrayBuffer().pixels);
+  falcon::ocr::ThreadLocalContext().Release();
+}
+
+const char* falcon_last_error(void) {
+  return LastError().c_str();
+}
+
+}  // extern "C"
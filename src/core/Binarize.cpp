@@ -1,30 +1,28 @@
 #include "falcon/core/Binarize.h"
 
+#include <algorithm>
 #include <array>
 #include <numeric>
 #include <stdexcept>
+#include <vector>
+
+#include "falcon/util/ThreadPool.h"
 
 namespace falcon::core {
 
-uint8_t OtsuThreshold(const Raster& image) {
-  if (image.Empty()) {
-    throw std::invalid_argument("OtsuThreshold requires non-empty image");
-  }
+namespace {
 
-  std::array<int, 256> histogram{};
-  for (uint8_t value : image.pixels) {
-    ++histogram[value];
-  }
+using Histogram = std::array<int64_t, 256>;
 
-  const int total = image.width * image.height;
+uint8_t ThresholdFromHistogram(const Histogram& histogram, int64_t total) {
   double sum = 0.0;
   for (int i = 0; i < 256; ++i) {
     sum += static_cast<double>(i) * histogram[i];
   }
 
   double sum_b = 0.0;
-  int w_b = 0;
-  int w_f = 0;
+  int64_t w_b = 0;
+  int64_t w_f = 0;
   double max_between = -1.0;
   uint8_t threshold = 0;
 
@@ -40,8 +38,8 @@ uint8_t OtsuThreshold(const Raster& image) {
     }
 
     sum_b += static_cast<double>(t) * histogram[t];
-    const double m_b = sum_b / w_b;
-    const double m_f = (sum - sum_b) / w_f;
+    const double m_b = sum_b / static_cast<double>(w_b);
+    const double m_f = (sum - sum_b) / static_cast<double>(w_f);
     const double between = static_cast<double>(w_b) * static_cast<double>(w_f) * (m_b - m_f) * (m_b - m_f);
 
     if (between > max_between) {
@@ -53,26 +51,101 @@ uint8_t OtsuThreshold(const Raster& image) {
   return threshold;
 }
 
-BinaryImage ApplyThreshold(const Raster& image, uint8_t threshold) {
-  if (image.Empty()) {
-    throw std::invalid_argument("ApplyThreshold requires non-empty image");
+void AddRows(const RasterView& image, int begin, int end, Histogram& histogram) {
+  const auto width = static_cast<std::size_t>(image.width);
+  for (int y = begin; y < end; ++y) {
+    const uint8_t* row = image.Row(y);
+    for (std::size_t x = 0; x < width; ++x) {
+      ++histogram[row[x]];
+    }
+  }
+}
+
+void ThresholdRows(const RasterView& image, uint8_t threshold, int begin, int end, BinaryImage& out) {
+  const auto width = static_cast<std::size_t>(image.width);
+  for (int y = begin; y < end; ++y) {
+    const uint8_t* row = image.Row(y);
+    uint8_t* dst = out.data.data() + static_cast<std::size_t>(y) * width;
+    for (std::size_t x = 0; x < width; ++x) {
+      dst[x] = row[x] > threshold ? 1 : 0;
+    }
   }
+}
 
-  BinaryImage binary;
-  binary.width = image.width;
-  binary.height = image.height;
-  binary.data.resize(image.pixels.size());
+void ResizeLike(const RasterView& image, BinaryImage& out) {
+  out.width = image.width;
+  out.height = image.height;
+  out.data.resize(static_cast<std::size_t>(image.width) * static_cast<std::size_t>(image.height));
+}
+
+}  // namespace
 
-  for (std::size_t i = 0; i < image.pixels.size(); ++i) {
-    binary.data[i] = image.pixels[i] > threshold ? 1 : 0;
+uint8_t OtsuThreshold(const RasterView& image) {
+  if (image.Empty()) {
+    throw std::invalid_argument("OtsuThreshold requires non-empty image");
   }
 
+  Histogram histogram{};
+  AddRows(image, 0, image.height, histogram);
+  return ThresholdFromHistogram(histogram, static_cast<int64_t>(image.width) * image.height);
+}
+
+BinaryImage ApplyThreshold(const RasterView& image, uint8_t threshold) {
+  BinaryImage binary;
+  ApplyThreshold(image, threshold, binary);
   return binary;
 }
 
-BinaryImage BinarizeOtsu(const Raster& image) {
+BinaryImage BinarizeOtsu(const RasterView& image) {
   const uint8_t threshold = OtsuThreshold(image);
   return ApplyThreshold(image, threshold);
 }
 
+void ApplyThreshold(const RasterView& image, uint8_t threshold, BinaryImage& out) {
+  if (image.Empty()) {
+    throw std::invalid_argument("ApplyThreshold requires non-empty image");
+  }
+
+  ResizeLike(image, out);
+  ThresholdRows(image, threshold, 0, image.height, out);
+}
+
+void BinarizeOtsu(const RasterView& image, BinaryImage& out) {
+  ApplyThreshold(image, OtsuThreshold(image), out);
+}
+
+void BinarizeOtsuParallel(const RasterView& image, BinaryImage& out, int band_rows) {
+  if (image.Empty()) {
+    throw std::invalid_argument("BinarizeOtsuParallel requires non-empty image");
+  }
+  const int rows = std::max(band_rows, 1);
+  const std::size_t bands = (static_cast<std::size_t>(image.height) + rows - 1) / static_cast<std::size_t>(rows);
+  const auto band_range = [&](std::size_t band) {
+    const int begin = static_cast<int>(band) * rows;
+    return std::make_pair(begin, std::min(begin + rows, image.height));
+  };
+
+  std::vector<Histogram> histograms(bands);
+  auto& pool = falcon::util::ThreadPool::Shared();
+  pool.ParallelFor(bands, [&](std::size_t band) {
+    auto& histogram = histograms[band];
+    histogram.fill(0);
+    const auto [begin, end] = band_range(band);
+    AddRows(image, begin, end, histogram);
+  });
+  Histogram histogram{};
+  for (const auto& band : histograms) {
+    for (std::size_t value = 0; value < histogram.size(); ++value) {
+      histogram[value] += band[value];
+    }
+  }
+  const uint8_t threshold = ThresholdFromHistogram(histogram, static_cast<int64_t>(image.width) * image.height);
+
+  ResizeLike(image, out);
+  pool.ParallelFor(bands, [&](std::size_t band) {
+    const auto [begin, end] = band_range(band);
+    ThresholdRows(image, threshold, begin, end, out);
+  });
+}
+
 }  // namespace falcon::core
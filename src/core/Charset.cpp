@@ -0,0 +1,133 @@
+#include "falcon/core/Charset.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <iterator>
+#include <stdexcept>
+#include <utility>
+
+#include "falcon/util/String.h"
+
+namespace falcon::core {
+
+namespace {
+
+std::string_view TrimView(std::string_view text) {
+  while (!text.empty() && (text.front() == ' ' || text.front() == '\t')) {
+    text.remove_prefix(1);
+  }
+  while (!text.empty() && (text.back() == ' ' || text.back() == '\t')) {
+    text.remove_suffix(1);
+  }
+  return text;
+}
+
+bool ParseHexCodepoint(std::string_view token, char32_t& codepoint) {
+  if (token.size() < 3 || (token[0] != 'U' && token[0] != 'u') || token[1] != '+' || token.size() > 8) {
+    return false;
+  }
+  const std::string hex(token.substr(2));
+  char* end = nullptr;
+  const unsigned long value = std::strtoul(hex.c_str(), &end, 16);
+  if (end == nullptr || *end != '\0' || value > 0x10FFFFUL) {
+    return false;
+  }
+  codepoint = static_cast<char32_t>(value);
+  return true;
+}
+
+}  // namespace
+
+Charset Charset::Digits() {
+  return FromRanges({{U'0', U'9'}});
+}
+
+Charset Charset::Ascii() {
+  return FromRanges({{0x00, 0x7F}});
+}
+
+Charset Charset::FromRanges(std::vector<CodepointRange> ranges) {
+  if (ranges.empty()) {
+    throw std::invalid_argument("Charset requires at least one codepoint");
+  }
+  for (auto& range : ranges) {
+    if (range.last < range.first) {
+      std::swap(range.first, range.last);
+    }
+  }
+  std::sort(ranges.begin(), ranges.end(),
+            [](const CodepointRange& a, const CodepointRange& b) { return a.first < b.first; });
+  Charset charset;
+  for (const auto& range : ranges) {
+    if (!charset.ranges_.empty() && range.first <= charset.ranges_.back().last + 1) {
+      charset.ranges_.back().last = std::max(charset.ranges_.back().last, range.last);
+    } else {
+      charset.ranges_.push_back(range);
+    }
+  }
+  return charset;
+}
+
+Charset Charset::FromCodepoints(std::u32string_view codepoints) {
+  std::vector<CodepointRange> ranges;
+  ranges.reserve(codepoints.size());
+  for (char32_t codepoint : codepoints) {
+    ranges.push_back({codepoint, codepoint});
+  }
+  return FromRanges(std::move(ranges));
+}
+
+Charset Charset::Parse(std::string_view spec) {
+  const std::string_view trimmed = TrimView(spec);
+  if (trimmed == "digits") {
+    return Digits();
+  }
+  if (trimmed == "ascii") {
+    return Ascii();
+  }
+
+  std::vector<CodepointRange> ranges;
+  std::size_t start = 0;
+  while (start <= spec.size()) {
+    const std::size_t end = spec.find(',', start);
+    const auto item = TrimView(spec.substr(start, end == std::string_view::npos ? spec.size() - start : end - start));
+    if (!item.empty()) {
+      const std::size_t dash = item.find('-', 1);
+      char32_t first = 0;
+      char32_t last = 0;
+      if (dash != std::string_view::npos && ParseHexCodepoint(TrimView(item.substr(0, dash)), first) &&
+          ParseHexCodepoint(TrimView(item.substr(dash + 1)), last)) {
+        ranges.push_back({first, last});
+      } else if (ParseHexCodepoint(item, first)) {
+        ranges.push_back({first, first});
+      } else {
+        for (char32_t codepoint : falcon::util::FromUtf8(item)) {
+          ranges.push_back({codepoint, codepoint});
+        }
+      }
+    }
+    if (end == std::string_view::npos) {
+      break;
+    }
+    start = end + 1;
+  }
+  return FromRanges(std::move(ranges));
+}
+
+bool Charset::Contains(char32_t codepoint) const noexcept {
+  if (ranges_.empty()) {
+    return true;
+  }
+  const auto it = std::upper_bound(ranges_.begin(), ranges_.end(), codepoint,
+                                   [](char32_t value, const CodepointRange& range) { return value < range.first; });
+  return it != ranges_.begin() && codepoint <= std::prev(it)->last;
+}
+
+bool Charset::operator==(const Charset& other) const noexcept {
+  return std::equal(ranges_.begin(), ranges_.end(), other.ranges_.begin(), other.ranges_.end(),
+                    [](const CodepointRange& a, const CodepointRange& b) {
+                      return a.first == b.first && a.last == b.last;
+                    });
+}
+
+}  // namespace falcon::core
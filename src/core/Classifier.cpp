@@ -1,38 +1,176 @@
 #include "falcon/core/Classifier.h"
 
 #include <algorithm>
+#include <array>
+#include <cstdlib>
 #include <limits>
 #include <numeric>
 #include <stdexcept>
+#include <utility>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define FALCON_HAS_SSE2 1
+#endif
 
 #include "falcon/core/GlyphDB.h"
 
 namespace falcon::core {
 
+namespace {
+
+// Tile sizes for ClassifyGlyphs. A block of templates spans 16 KiB, small enough to stay in L1/L2
+// while every glyph of the current glyph block is compared against it.
+template <int Size>
+constexpr std::size_t kTemplateBlock = 16384 / kGlyphCellsOf<Size>;
+constexpr std::size_t kGlyphBlock = 16;
+
+template <int Size>
+float ConfidenceFromDistance(uint32_t distance) {
+  constexpr double kMaxDistance = 255.0 * static_cast<double>(kGlyphCellsOf<Size>);
+  return static_cast<float>(std::clamp(1.0 - static_cast<double>(distance) / kMaxDistance, 0.0, 1.0));
+}
+
+#ifdef FALCON_HAS_SSE2
+// One psadbw per 16-byte lane, expanded at compile time so every size is fully unrolled.
+template <std::size_t... Lanes>
+uint32_t SadLanes(const uint8_t* lhs, const uint8_t* rhs, std::index_sequence<Lanes...>) noexcept {
+  __m128i sum = _mm_setzero_si128();
+  ((sum = _mm_add_epi64(sum, _mm_sad_epu8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(lhs + Lanes * 16)),
+                                          _mm_loadu_si128(reinterpret_cast<const __m128i*>(rhs + Lanes * 16))))),
+   ...);
+  return static_cast<uint32_t>(_mm_cvtsi128_si32(sum) + _mm_cvtsi128_si32(_mm_srli_si128(sum, 8)));
+}
+#endif
+
+}  // namespace
+
+template <int Size>
+SizedTemplateMatrix<Size> BuildTemplateMatrix(const std::vector<GlyphTemplate>& templates) {
+  std::vector<const GlyphTemplate*> pointers;
+  pointers.reserve(templates.size());
+  for (const auto& tmpl : templates) {
+    pointers.push_back(&tmpl);
+  }
+  return BuildTemplateMatrix<Size>(pointers);
+}
+
+template <int Size>
+SizedTemplateMatrix<Size> BuildTemplateMatrix(const std::vector<const GlyphTemplate*>& templates) {
+  SizedTemplateMatrix<Size> matrix;
+  matrix.count = templates.size();
+  matrix.cells.resize(templates.size() * kGlyphCellsOf<Size>);
+  matrix.codepoints.reserve(templates.size());
+  for (std::size_t i = 0; i < templates.size(); ++i) {
+    const SizedGlyphBitmap<Size> bitmap = ResampleGlyph<Size>(templates[i]->bitmap);
+    std::copy(bitmap.begin(), bitmap.end(), matrix.cells.begin() + static_cast<std::ptrdiff_t>(i * kGlyphCellsOf<Size>));
+    matrix.codepoints.push_back(templates[i]->codepoint);
+  }
+  return matrix;
+}
+
+template <int Size>
+uint32_t GlyphDistance(const uint8_t* lhs, const uint8_t* rhs) noexcept {
+#ifdef FALCON_HAS_SSE2
+  static_assert(kGlyphCellsOf<Size> % 16 == 0, "SSE2 distance kernel expects whole 16-byte lanes");
+  return SadLanes(lhs, rhs, std::make_index_sequence<kGlyphCellsOf<Size> / 16>{});
+#else
+  uint32_t distance = 0;
+  for (std::size_t i = 0; i < kGlyphCellsOf<Size>; ++i) {
+    distance += static_cast<uint32_t>(std::abs(static_cast<int>(lhs[i]) - static_cast<int>(rhs[i])));
+  }
+  return distance;
+#endif
+}
+
 ClassificationResult ClassifyGlyph(const GlyphBitmap& glyph, const std::vector<GlyphTemplate>& templates) {
   if (templates.empty()) {
     throw std::runtime_error("No glyph templates available");
   }
 
   ClassificationResult best{};
-  double best_distance = std::numeric_limits<double>::max();
+  uint32_t best_distance = std::numeric_limits<uint32_t>::max();
 
   for (const auto& tmpl : templates) {
-    double distance = 0.0;
-    for (std::size_t i = 0; i < glyph.size(); ++i) {
-      distance += std::abs(static_cast<int>(glyph[i]) - static_cast<int>(tmpl.bitmap[i]));
-    }
-    distance /= (255.0 * static_cast<double>(glyph.size()));
+    const uint32_t distance = GlyphDistance<kGlyphSize>(glyph.data(), tmpl.bitmap.data());
     if (distance < best_distance) {
       best_distance = distance;
       best.codepoint = tmpl.codepoint;
-      best.confidence = static_cast<float>(std::clamp(1.0 - distance, 0.0, 1.0));
+      best.confidence = ConfidenceFromDistance<kGlyphSize>(distance);
     }
   }
 
   return best;
 }
 
+template <int Size>
+ClassificationResult ClassifyGlyph(const SizedGlyphBitmap<Size>& glyph, const SizedTemplateMatrix<Size>& templates) {
+  if (templates.count == 0) {
+    throw std::runtime_error("No glyph templates available");
+  }
+
+  std::size_t best_index = 0;
+  uint32_t best_distance = std::numeric_limits<uint32_t>::max();
+  for (std::size_t t = 0; t < templates.count; ++t) {
+    const uint32_t distance = GlyphDistance<Size>(glyph.data(), templates.Template(t));
+    if (distance < best_distance) {
+      best_distance = distance;
+      best_index = t;
+    }
+  }
+  return ClassificationResult{templates.codepoints[best_index], ConfidenceFromDistance<Size>(best_distance)};
+}
+
+template <int Size>
+void ClassifyGlyphs(const SizedGlyphMatrix<Size>& glyphs, const SizedTemplateMatrix<Size>& templates,
+                    std::vector<ClassificationResult>& results) {
+  results.resize(glyphs.count);
+  ClassifyGlyphRange(glyphs, 0, glyphs.count, templates, results);
+}
+
+template <int Size>
+void ClassifyGlyphRange(const SizedGlyphMatrix<Size>& glyphs, std::size_t begin, std::size_t end,
+                        const SizedTemplateMatrix<Size>& templates, std::vector<ClassificationResult>& results) {
+  if (templates.count == 0) {
+    throw std::runtime_error("No glyph templates available");
+  }
+  if (end > glyphs.count || end > results.size() || begin > end) {
+    throw std::out_of_range("ClassifyGlyphRange outside of glyph matrix");
+  }
+
+  std::array<uint32_t, kGlyphBlock> best_distance{};
+  std::array<std::size_t, kGlyphBlock> best_index{};
+
+  for (std::size_t g0 = begin; g0 < end; g0 += kGlyphBlock) {
+    const std::size_t g1 = std::min(g0 + kGlyphBlock, end);
+    best_distance.fill(std::numeric_limits<uint32_t>::max());
+    best_index.fill(0);
+
+    // Template blocks are visited in order and only a strictly smaller distance replaces the best,
+    // so ties resolve to the earliest template just like ClassifyGlyph.
+    for (std::size_t t0 = 0; t0 < templates.count; t0 += kTemplateBlock<Size>) {
+      const std::size_t t1 = std::min(t0 + kTemplateBlock<Size>, templates.count);
+      for (std::size_t g = g0; g < g1; ++g) {
+        const uint8_t* glyph = glyphs.Glyph(g);
+        uint32_t& glyph_best = best_distance[g - g0];
+        std::size_t& glyph_index = best_index[g - g0];
+        for (std::size_t t = t0; t < t1; ++t) {
+          const uint32_t distance = GlyphDistance<Size>(glyph, templates.Template(t));
+          if (distance < glyph_best) {
+            glyph_best = distance;
+            glyph_index = t;
+          }
+        }
+      }
+    }
+
+    for (std::size_t g = g0; g < g1; ++g) {
+      results[g].codepoint = templates.codepoints[best_index[g - g0]];
+      results[g].confidence = ConfidenceFromDistance<Size>(best_distance[g - g0]);
+    }
+  }
+}
+
 std::u32string GlyphsToString(const std::vector<ClassificationResult>& glyphs) {
   std::u32string result;
   result.reserve(glyphs.size());
@@ -42,4 +180,19 @@ std::u32string GlyphsToString(const std::vector<ClassificationResult>& glyphs) {
   return result;
 }
 
+#define FALCON_INSTANTIATE_CLASSIFIER(Size)                                                                 \
+  template SizedTemplateMatrix<Size> BuildTemplateMatrix<Size>(const std::vector<GlyphTemplate>&);          \
+  template SizedTemplateMatrix<Size> BuildTemplateMatrix<Size>(const std::vector<const GlyphTemplate*>&);   \
+  template uint32_t GlyphDistance<Size>(const uint8_t*, const uint8_t*) noexcept;                           \
+  template ClassificationResult ClassifyGlyph<Size>(const SizedGlyphBitmap<Size>&,                          \
+                                                    const SizedTemplateMatrix<Size>&);                      \
+  template void ClassifyGlyphs<Size>(const SizedGlyphMatrix<Size>&, const SizedTemplateMatrix<Size>&,       \
+                                     std::vector<ClassificationResult>&);                                   \
+  template void ClassifyGlyphRange<Size>(const SizedGlyphMatrix<Size>&, std::size_t, std::size_t,           \
+                                         const SizedTemplateMatrix<Size>&, std::vector<ClassificationResult>&);
+FALCON_INSTANTIATE_CLASSIFIER(8)
+FALCON_INSTANTIATE_CLASSIFIER(16)
+FALCON_INSTANTIATE_CLASSIFIER(32)
+#undef FALCON_INSTANTIATE_CLASSIFIER
+
 }  // namespace falcon::core
@@ -0,0 +1,141 @@
+#include "falcon/core/Color.h"
+
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64)
+#define FALCON_HAS_SSSE3_KERNELS 1
+#include <tmmintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#define FALCON_TARGET_SSSE3
+#else
+// Compiled for SSSE3 regardless of -march; only called after the CPU check below.
+#define FALCON_TARGET_SSSE3 __attribute__((target("ssse3")))
+#endif
+#endif
+
+namespace falcon::core {
+
+namespace {
+
+void CopyGrayRow(const uint8_t* src, std::size_t width, uint8_t* dst) {
+  std::memcpy(dst, src, width);
+}
+
+template <std::size_t Stride, std::size_t R, std::size_t G, std::size_t B>
+void GrayRowScalar(const uint8_t* src, std::size_t width, uint8_t* dst) {
+  for (std::size_t x = 0; x < width; ++x, src += Stride) {
+    dst[x] = static_cast<uint8_t>(GrayFromRgb(src[R], src[G], src[B]));
+  }
+}
+
+#ifdef FALCON_HAS_SSSE3_KERNELS
+
+bool CpuHasSsse3() {
+#if defined(_MSC_VER) && !defined(__clang__)
+  int info[4];
+  __cpuid(info, 1);
+  return (info[2] & (1 << 9)) != 0;
+#else
+  return __builtin_cpu_supports("ssse3");
+#endif
+}
+
+// Luma of four 32-bit pixels whose first three bytes are weighted by `weights` (8 x 16-bit, the
+// fourth weight of each pixel zero).
+FALCON_TARGET_SSSE3 inline __m128i Luma4(__m128i pixels, __m128i weights) {
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i low = _mm_madd_epi16(_mm_unpacklo_epi8(pixels, zero), weights);
+  const __m128i high = _mm_madd_epi16(_mm_unpackhi_epi8(pixels, zero), weights);
+  return _mm_srli_epi32(_mm_add_epi32(_mm_hadd_epi32(low, high), _mm_set1_epi32(128)), 8);
+}
+
+FALCON_TARGET_SSSE3 inline void StoreLuma16(uint8_t* dst, __m128i p0, __m128i p1, __m128i p2, __m128i p3,
+                                            __m128i weights) {
+  const __m128i first = _mm_packs_epi32(Luma4(p0, weights), Luma4(p1, weights));
+  const __m128i second = _mm_packs_epi32(Luma4(p2, weights), Luma4(p3, weights));
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(dst), _mm_packus_epi16(first, second));
+}
+
+FALCON_TARGET_SSSE3 inline __m128i ChannelWeights(bool rgb) {
+  return rgb ? _mm_setr_epi16(77, 150, 29, 0, 77, 150, 29, 0) : _mm_setr_epi16(29, 150, 77, 0, 29, 150, 77, 0);
+}
+
+// 16 pixels per step: three 16-byte loads are realigned and spread to one pixel per 32-bit lane.
+template <bool Rgb>
+FALCON_TARGET_SSSE3 void GrayRow24Ssse3(const uint8_t* src, std::size_t width, uint8_t* dst) {
+  const __m128i spread = _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+  const __m128i weights = ChannelWeights(Rgb);
+  std::size_t x = 0;
+  for (; x + 16 <= width; x += 16, src += 48) {
+    const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+    const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 16));
+    const __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 32));
+    StoreLuma16(dst + x, _mm_shuffle_epi8(a, spread), _mm_shuffle_epi8(_mm_alignr_epi8(b, a, 12), spread),
+                _mm_shuffle_epi8(_mm_alignr_epi8(c, b, 8), spread), _mm_shuffle_epi8(_mm_srli_si128(c, 4), spread),
+                weights);
+  }
+  if (Rgb) {
+    GrayRowScalar<3, 0, 1, 2>(src, width - x, dst + x);
+  } else {
+    GrayRowScalar<3, 2, 1, 0>(src, width - x, dst + x);
+  }
+}
+
+template <bool Rgb>
+FALCON_TARGET_SSSE3 void GrayRow32Ssse3(const uint8_t* src, std::size_t width, uint8_t* dst) {
+  const __m128i weights = ChannelWeights(Rgb);
+  std::size_t x = 0;
+  for (; x + 16 <= width; x += 16, src += 64) {
+    const auto* pixels = reinterpret_cast<const __m128i*>(src);
+    StoreLuma16(dst + x, _mm_loadu_si128(pixels), _mm_loadu_si128(pixels + 1), _mm_loadu_si128(pixels + 2),
+                _mm_loadu_si128(pixels + 3), weights);
+  }
+  if (Rgb) {
+    GrayRowScalar<4, 0, 1, 2>(src, width - x, dst + x);
+  } else {
+    GrayRowScalar<4, 2, 1, 0>(src, width - x, dst + x);
+  }
+}
+
+#endif  // FALCON_HAS_SSSE3_KERNELS
+
+}  // namespace
+
+GrayRowKernel ScalarGrayRowKernelFor(PixelFormat format) {
+  switch (format) {
+    case PixelFormat::kRgb24:
+      return &GrayRowScalar<3, 0, 1, 2>;
+    case PixelFormat::kBgr24:
+      return &GrayRowScalar<3, 2, 1, 0>;
+    case PixelFormat::kBgrx32:
+      return &GrayRowScalar<4, 2, 1, 0>;
+    case PixelFormat::kRgbx32:
+      return &GrayRowScalar<4, 0, 1, 2>;
+    default:
+      return &CopyGrayRow;
+  }
+}
+
+GrayRowKernel GrayRowKernelFor(PixelFormat format) {
+#ifdef FALCON_HAS_SSSE3_KERNELS
+  static const bool has_ssse3 = CpuHasSsse3();
+  if (has_ssse3) {
+    switch (format) {
+      case PixelFormat::kRgb24:
+        return &GrayRow24Ssse3<true>;
+      case PixelFormat::kBgr24:
+        return &GrayRow24Ssse3<false>;
+      case PixelFormat::kBgrx32:
+        return &GrayRow32Ssse3<false>;
+      case PixelFormat::kRgbx32:
+        return &GrayRow32Ssse3<true>;
+      default:
+        break;
+    }
+  }
+#endif
+  return ScalarGrayRowKernelFor(format);
+}
+
+}  // namespace falcon::core
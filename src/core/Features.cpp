@@ -4,10 +4,12 @@
 
 namespace falcon::core {
 
-FeatureVector ComputeZoningFeatures(const GlyphBitmap& bitmap) {
+template <int Size>
+FeatureVector ComputeZoningFeatures(const SizedGlyphBitmap<Size>& bitmap) {
   FeatureVector features{};
-  const int zones = 4;
-  const int zone_size = kGlyphSize / zones;
+  constexpr int zones = 4;
+  constexpr int zone_size = Size / zones;
+  static_assert(zone_size * zones == Size, "Glyph size must split evenly into zones");
 
   for (int zy = 0; zy < zones; ++zy) {
     for (int zx = 0; zx < zones; ++zx) {
@@ -16,7 +18,7 @@ FeatureVector ComputeZoningFeatures(const GlyphBitmap& bitmap) {
         for (int x = 0; x < zone_size; ++x) {
           const int gx = zx * zone_size + x;
           const int gy = zy * zone_size + y;
-          const std::size_t idx = static_cast<std::size_t>(gy) * kGlyphSize + gx;
+          const std::size_t idx = static_cast<std::size_t>(gy) * Size + gx;
           sum += static_cast<float>(bitmap[idx]) / 255.0f;
         }
       }
@@ -27,4 +29,8 @@ FeatureVector ComputeZoningFeatures(const GlyphBitmap& bitmap) {
   return features;
 }
 
+template FeatureVector ComputeZoningFeatures<8>(const SizedGlyphBitmap<8>&);
+template FeatureVector ComputeZoningFeatures<16>(const SizedGlyphBitmap<16>&);
+template FeatureVector ComputeZoningFeatures<32>(const SizedGlyphBitmap<32>&);
+
 }  // namespace falcon::core
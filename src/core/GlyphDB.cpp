@@ -1,10 +1,15 @@
 #include "falcon/core/GlyphDB.h"
 
+#include <algorithm>
 #include <array>
 #include <cctype>
+#include <cstdint>
+#include <cstdio>
 #include <cstdlib>
 #include <filesystem>
 #include <fstream>
+#include <iterator>
+#include <ostream>
 #include <optional>
 #include <set>
 #include <sstream>
@@ -13,6 +18,8 @@
 #include <unordered_set>
 #include <vector>
 
+#include "falcon/core/PackRegistry.h"
+
 namespace falcon::core {
 
 namespace {
@@ -22,108 +29,110 @@ struct RawGlyph {
   std::array<const char*, 7> rows;
 };
 
-GlyphBitmap From5x7(const RawGlyph& glyph) {
+// One glyph of the built-in font, expanded to kGlyphSize.
+struct BuiltInGlyph {
+  char32_t codepoint{};
+  GlyphBitmap bitmap{};
+};
+
+constexpr RawGlyph kFont5x7[] = {
+    RawGlyph{U' ', {".....", ".....", ".....", ".....", ".....", ".....", "....."}},
+    RawGlyph{U'.', {".....", ".....", ".....", ".....", ".....", "..##.", "..##."}},
+    RawGlyph{U',', {".....", ".....", ".....", ".....", "..##.", "..##.", ".##.."}},
+    RawGlyph{U'-', {".....", ".....", ".....", "#####", ".....", ".....", "....."}},
+    RawGlyph{U':', {".....", "..##.", "..##.", ".....", "..##.", "..##.", "....."}},
+    RawGlyph{U'!', {"..#..", "..#..", "..#..", "..#..", "..#..", ".....", "..#.."}},
+    RawGlyph{U'?', {".###.", "#...#", "....#", "..##.", "..#..", ".....", "..#.."}},
+    RawGlyph{U'0', {".###.", "#...#", "#...#", "#...#", "#...#", "#...#", ".###."}},
+    RawGlyph{U'1', {"..#..", ".##..", "..#..", "..#..", "..#..", "..#..", ".###."}},
+    RawGlyph{U'2', {".###.", "#...#", "....#", "..##.", ".#...", "#....", "#####"}},
+    RawGlyph{U'3', {".###.", "#...#", "....#", "..##.", "....#", "#...#", ".###."}},
+    RawGlyph{U'4', {"...#.", "..##.", ".#.#.", "#..#.", "#####", "...#.", "...#."}},
+    RawGlyph{U'5', {"#####", "#....", "#....", "####.", "....#", "#...#", ".###."}},
+    RawGlyph{U'6', {".###.", "#....", "#....", "####.", "#...#", "#...#", ".###."}},
+    RawGlyph{U'7', {"#####", "....#", "...#.", "..#..", ".#...", ".#...", ".#..."}},
+    RawGlyph{U'8', {".###.", "#...#", "#...#", ".###.", "#...#", "#...#", ".###."}},
+    RawGlyph{U'9', {".###.", "#...#", "#...#", ".####", "....#", "....#", ".###."}},
+    RawGlyph{U'A', {".###.", "#...#", "#...#", "#####", "#...#", "#...#", "#...#"}},
+    RawGlyph{U'B', {"####.", "#...#", "#...#", "####.", "#...#", "#...#", "####."}},
+    RawGlyph{U'C', {".###.", "#...#", "#....", "#....", "#....", "#...#", ".###."}},
+    RawGlyph{U'D', {"####.", "#...#", "#...#", "#...#", "#...#", "#...#", "####."}},
+    RawGlyph{U'E', {"#####", "#....", "#....", "####.", "#....", "#....", "#####"}},
+    RawGlyph{U'F', {"#####", "#....", "#....", "####.", "#....", "#....", "#...."}},
+    RawGlyph{U'G', {".###.", "#...#", "#....", "#.###", "#...#", "#...#", ".###."}},
+    RawGlyph{U'H', {"#...#", "#...#", "#...#", "#####", "#...#", "#...#", "#...#"}},
+    RawGlyph{U'I', {".###.", "..#..", "..#..", "..#..", "..#..", "..#..", ".###."}},
+    RawGlyph{U'J', {"..###", "...#.", "...#.", "...#.", "...#.", "#..#.", ".##.."}},
+    RawGlyph{U'K', {"#...#", "#..#.", "#.#..", "##...", "#.#..", "#..#.", "#...#"}},
+    RawGlyph{U'L', {"#....", "#....", "#....", "#....", "#....", "#....", "#####"}},
+    RawGlyph{U'M', {"#...#", "##.##", "#.#.#", "#.#.#", "#...#", "#...#", "#...#"}},
+    RawGlyph{U'N', {"#...#", "##..#", "#.#.#", "#..##", "#...#", "#...#", "#...#"}},
+    RawGlyph{U'O', {".###.", "#...#", "#...#", "#...#", "#...#", "#...#", ".###."}},
+    RawGlyph{U'P', {"####.", "#...#", "#...#", "####.", "#....", "#....", "#...."}},
+    RawGlyph{U'Q', {".###.", "#...#", "#...#", "#...#", "#.#.#", "#..#.", ".##.#"}},
+    RawGlyph{U'R', {"####.", "#...#", "#...#", "####.", "#.#..", "#..#.", "#...#"}},
+    RawGlyph{U'S', {".####", "#....", "#....", ".###.", "....#", "....#", "####."}},
+    RawGlyph{U'T', {"#####", "..#..", "..#..", "..#..", "..#..", "..#..", "..#.."}},
+    RawGlyph{U'U', {"#...#", "#...#", "#...#", "#...#", "#...#", "#...#", ".###."}},
+    RawGlyph{U'V', {"#...#", "#...#", "#...#", "#...#", "#...#", ".#.#.", "..#.."}},
+    RawGlyph{U'W', {"#...#", "#...#", "#...#", "#.#.#", "#.#.#", "##.##", "#...#"}},
+    RawGlyph{U'X', {"#...#", "#...#", ".#.#.", "..#..", ".#.#.", "#...#", "#...#"}},
+    RawGlyph{U'Y', {"#...#", "#...#", ".#.#.", "..#..", "..#..", "..#..", "..#.."}},
+    RawGlyph{U'Z', {"#####", "....#", "...#.", "..#..", ".#...", "#....", "#####"}},
+    RawGlyph{U'a', {".....", "..##.", "...#.", ".###.", "#..#.", "#..#.", ".###."}},
+    RawGlyph{U'b', {"#....", "#....", "#....", "####.", "#...#", "#...#", "####."}},
+    RawGlyph{U'c', {".....", ".###.", "#...#", "#....", "#....", "#...#", ".###."}},
+    RawGlyph{U'd', {"....#", "....#", "....#", ".####", "#...#", "#...#", ".####"}},
+    RawGlyph{U'e', {".....", ".###.", "#...#", "#####", "#....", "#...#", ".###."}},
+    RawGlyph{U'f', {"..##.", ".#..#", ".#...", "###..", ".#...", ".#...", ".#..."}},
+    RawGlyph{U'g', {".....", ".####", "#...#", "#...#", ".####", "....#", ".###."}},
+    RawGlyph{U'h', {"#....", "#....", "#....", "####.", "#...#", "#...#", "#...#"}},
+    RawGlyph{U'i', {"..#..", ".....", ".##..", "..#..", "..#..", "..#..", ".###."}},
+    RawGlyph{U'j', {"...#.", ".....", "..##.", "...#.", "...#.", "#..#.", ".##.."}},
+    RawGlyph{U'k', {"#....", "#....", "#..#.", "#.#..", "##...", "#.#..", "#..#."}},
+    RawGlyph{U'l', {".##..", "..#..", "..#..", "..#..", "..#..", "..#..", ".###."}},
+    RawGlyph{U'm', {".....", "##.##", "#.#.#", "#.#.#", "#.#.#", "#.#.#", "#.#.#"}},
+    RawGlyph{U'n', {".....", "####.", "#...#", "#...#", "#...#", "#...#", "#...#"}},
+    RawGlyph{U'o', {".....", ".###.", "#...#", "#...#", "#...#", "#...#", ".###."}},
+    RawGlyph{U'p', {".....", "####.", "#...#", "#...#", "####.", "#....", "#...."}},
+    RawGlyph{U'q', {".....", ".####", "#...#", "#...#", ".####", "....#", "....#"}},
+    RawGlyph{U'r', {".....", "#.##.", "##..#", "#....", "#....", "#....", "#...."}},
+    RawGlyph{U's', {".....", ".####", "#....", ".###.", "....#", "....#", "####."}},
+    RawGlyph{U't', {".#...", ".#...", "###..", ".#...", ".#...", ".#..#", "..##."}},
+    RawGlyph{U'u', {".....", "#...#", "#...#", "#...#", "#...#", "#..##", ".##.#"}},
+    RawGlyph{U'v', {".....", "#...#", "#...#", "#...#", ".#.#.", ".#.#.", "..#.."}},
+    RawGlyph{U'w', {".....", "#...#", "#...#", "#.#.#", "#.#.#", "#.#.#", ".#.#."}},
+    RawGlyph{U'x', {".....", "#...#", ".#.#.", "..#..", ".#.#.", "#...#", "#...#"}},
+    RawGlyph{U'y', {".....", "#...#", "#...#", ".####", "....#", "#...#", ".###."}},
+    RawGlyph{U'z', {".....", "#####", "...#.", "..#..", ".#...", "#....", "#####"}},
+};
+
+constexpr std::size_t kBuiltInCount = sizeof(kFont5x7) / sizeof(kFont5x7[0]);
+
+// Nearest-neighbour upsampling of a 5x7 glyph, sampling each target pixel's centre.
+constexpr GlyphBitmap From5x7(const RawGlyph& glyph) {
   GlyphBitmap bitmap{};
   for (int y = 0; y < kGlyphSize; ++y) {
-    const float src_y = (static_cast<float>(y) + 0.5f) * 7.0f / static_cast<float>(kGlyphSize);
-    int iy = static_cast<int>(src_y);
-    if (iy < 0) {
-      iy = 0;
-    }
-    if (iy > 6) {
-      iy = 6;
-    }
+    const int iy = std::min((2 * y + 1) * 7 / (2 * kGlyphSize), 6);
     for (int x = 0; x < kGlyphSize; ++x) {
-      const float src_x = (static_cast<float>(x) + 0.5f) * 5.0f / static_cast<float>(kGlyphSize);
-      int ix = static_cast<int>(src_x);
-      if (ix < 0) {
-        ix = 0;
-      }
-      if (ix > 4) {
-        ix = 4;
-      }
-      const char ch = glyph.rows[static_cast<std::size_t>(iy)][static_cast<std::size_t>(ix)];
-      bitmap[static_cast<std::size_t>(y) * kGlyphSize + x] = (ch == '#') ? 255 : 0;
+      const int ix = std::min((2 * x + 1) * 5 / (2 * kGlyphSize), 4);
+      const char ch = glyph.rows[static_cast<std::size_t>(iy)][ix];
+      bitmap[static_cast<std::size_t>(y) * kGlyphSize + static_cast<std::size_t>(x)] = (ch == '#') ? 255 : 0;
     }
   }
   return bitmap;
 }
 
-std::vector<RawGlyph> BuildRawGlyphs() {
-  using RG = RawGlyph;
-  return {
-      RG{U' ', {".....", ".....", ".....", ".....", ".....", ".....", "....."}},
-      RG{U'.', {".....", ".....", ".....", ".....", ".....", "..##.", "..##."}},
-      RG{U',', {".....", ".....", ".....", ".....", "..##.", "..##.", ".##.."}},
-      RG{U'-', {".....", ".....", ".....", "#####", ".....", ".....", "....."}},
-      RG{U':', {".....", "..##.", "..##.", ".....", "..##.", "..##.", "....."}},
-      RG{U'!', {"..#..", "..#..", "..#..", "..#..", "..#..", ".....", "..#.."}},
-      RG{U'?', {".###.", "#...#", "....#", "..##.", "..#..", ".....", "..#.."}},
-      RG{U'0', {".###.", "#...#", "#...#", "#...#", "#...#", "#...#", ".###."}},
-      RG{U'1', {"..#..", ".##..", "..#..", "..#..", "..#..", "..#..", ".###."}},
-      RG{U'2', {".###.", "#...#", "....#", "..##.", ".#...", "#....", "#####"}},
-      RG{U'3', {".###.", "#...#", "....#", "..##.", "....#", "#...#", ".###."}},
-      RG{U'4', {"...#.", "..##.", ".#.#.", "#..#.", "#####", "...#.", "...#."}},
-      RG{U'5', {"#####", "#....", "#....", "####.", "....#", "#...#", ".###."}},
-      RG{U'6', {".###.", "#....", "#....", "####.", "#...#", "#...#", ".###."}},
-      RG{U'7', {"#####", "....#", "...#.", "..#..", ".#...", ".#...", ".#..."}},
-      RG{U'8', {".###.", "#...#", "#...#", ".###.", "#...#", "#...#", ".###."}},
-      RG{U'9', {".###.", "#...#", "#...#", ".####", "....#", "....#", ".###."}},
-      RG{U'A', {".###.", "#...#", "#...#", "#####", "#...#", "#...#", "#...#"}},
-      RG{U'B', {"####.", "#...#", "#...#", "####.", "#...#", "#...#", "####."}},
-      RG{U'C', {".###.", "#...#", "#....", "#....", "#....", "#...#", ".###."}},
-      RG{U'D', {"####.", "#...#", "#...#", "#...#", "#...#", "#...#", "####."}},
-      RG{U'E', {"#####", "#....", "#....", "####.", "#....", "#....", "#####"}},
-      RG{U'F', {"#####", "#....", "#....", "####.", "#....", "#....", "#...."}},
-      RG{U'G', {".###.", "#...#", "#....", "#.###", "#...#", "#...#", ".###."}},
-      RG{U'H', {"#...#", "#...#", "#...#", "#####", "#...#", "#...#", "#...#"}},
-      RG{U'I', {".###.", "..#..", "..#..", "..#..", "..#..", "..#..", ".###."}},
-      RG{U'J', {"..###", "...#.", "...#.", "...#.", "...#.", "#..#.", ".##.."}},
-      RG{U'K', {"#...#", "#..#.", "#.#..", "##...", "#.#..", "#..#.", "#...#"}},
-      RG{U'L', {"#....", "#....", "#....", "#....", "#....", "#....", "#####"}},
-      RG{U'M', {"#...#", "##.##", "#.#.#", "#.#.#", "#...#", "#...#", "#...#"}},
-      RG{U'N', {"#...#", "##..#", "#.#.#", "#..##", "#...#", "#...#", "#...#"}},
-      RG{U'O', {".###.", "#...#", "#...#", "#...#", "#...#", "#...#", ".###."}},
-      RG{U'P', {"####.", "#...#", "#...#", "####.", "#....", "#....", "#...."}},
-      RG{U'Q', {".###.", "#...#", "#...#", "#...#", "#.#.#", "#..#.", ".##.#"}},
-      RG{U'R', {"####.", "#...#", "#...#", "####.", "#.#..", "#..#.", "#...#"}},
-      RG{U'S', {".####", "#....", "#....", ".###.", "....#", "....#", "####."}},
-      RG{U'T', {"#####", "..#..", "..#..", "..#..", "..#..", "..#..", "..#.."}},
-      RG{U'U', {"#...#", "#...#", "#...#", "#...#", "#...#", "#...#", ".###."}},
-      RG{U'V', {"#...#", "#...#", "#...#", "#...#", "#...#", ".#.#.", "..#.."}},
-      RG{U'W', {"#...#", "#...#", "#...#", "#.#.#", "#.#.#", "##.##", "#...#"}},
-      RG{U'X', {"#...#", "#...#", ".#.#.", "..#..", ".#.#.", "#...#", "#...#"}},
-      RG{U'Y', {"#...#", "#...#", ".#.#.", "..#..", "..#..", "..#..", "..#.."}},
-      RG{U'Z', {"#####", "....#", "...#.", "..#..", ".#...", "#....", "#####"}},
-      RG{U'a', {".....", "..##.", "...#.", ".###.", "#..#.", "#..#.", ".###."}},
-      RG{U'b', {"#....", "#....", "#....", "####.", "#...#", "#...#", "####."}},
-      RG{U'c', {".....", ".###.", "#...#", "#....", "#....", "#...#", ".###."}},
-      RG{U'd', {"....#", "....#", "....#", ".####", "#...#", "#...#", ".####"}},
-      RG{U'e', {".....", ".###.", "#...#", "#####", "#....", "#...#", ".###."}},
-      RG{U'f', {"..##.", ".#..#", ".#...", "###..", ".#...", ".#...", ".#..."}},
-      RG{U'g', {".....", ".####", "#...#", "#...#", ".####", "....#", ".###."}},
-      RG{U'h', {"#....", "#....", "#....", "####.", "#...#", "#...#", "#...#"}},
-      RG{U'i', {"..#..", ".....", ".##..", "..#..", "..#..", "..#..", ".###."}},
-      RG{U'j', {"...#.", ".....", "..##.", "...#.", "...#.", "#..#.", ".##.."}},
-      RG{U'k', {"#....", "#....", "#..#.", "#.#..", "##...", "#.#..", "#..#."}},
-      RG{U'l', {".##..", "..#..", "..#..", "..#..", "..#..", "..#..", ".###."}},
-      RG{U'm', {".....", "##.##", "#.#.#", "#.#.#", "#.#.#", "#.#.#", "#.#.#"}},
-      RG{U'n', {".....", "####.", "#...#", "#...#", "#...#", "#...#", "#...#"}},
-      RG{U'o', {".....", ".###.", "#...#", "#...#", "#...#", "#...#", ".###."}},
-      RG{U'p', {".....", "####.", "#...#", "#...#", "####.", "#....", "#...."}},
-      RG{U'q', {".....", ".####", "#...#", "#...#", ".####", "....#", "....#"}},
-      RG{U'r', {".....", "#.##.", "##..#", "#....", "#....", "#....", "#...."}},
-      RG{U's', {".....", ".####", "#....", ".###.", "....#", "....#", "####."}},
-      RG{U't', {".#...", ".#...", "###..", ".#...", ".#...", ".#..#", "..##."}},
-      RG{U'u', {".....", "#...#", "#...#", "#...#", "#...#", "#..##", ".##.#"}},
-      RG{U'v', {".....", "#...#", "#...#", "#...#", ".#.#.", ".#.#.", "..#.."}},
-      RG{U'w', {".....", "#...#", "#...#", "#.#.#", "#.#.#", "#.#.#", ".#.#."}},
-      RG{U'x', {".....", "#...#", ".#.#.", "..#..", ".#.#.", "#...#", "#...#"}},
-      RG{U'y', {".....", "#...#", "#...#", ".####", "....#", "#...#", ".###."}},
-      RG{U'z', {".....", "#####", "...#.", "..#..", ".#...", "#....", "#####"}},
-  };
+constexpr std::array<BuiltInGlyph, kBuiltInCount> ExpandFont() {
+  std::array<BuiltInGlyph, kBuiltInCount> glyphs{};
+  for (std::size_t i = 0; i < kBuiltInCount; ++i) {
+    glyphs[i] = BuiltInGlyph{kFont5x7[i].codepoint, From5x7(kFont5x7[i])};
+  }
+  return glyphs;
 }
 
+alignas(64) constexpr std::array<BuiltInGlyph, kBuiltInCount> kBuiltInGlyphs = ExpandFont();
+
 std::string Trim(std::string_view value) {
   const auto is_space = [](unsigned char ch) { return std::isspace(ch) != 0; };
   std::size_t start = 0;
@@ -185,6 +194,53 @@ GlyphBitmap GlyphFromRasterLines(const std::vector<std::string>& rows) {
   return bitmap;
 }
 
+}  // namespace
+
+std::vector<std::filesystem::path> LanguagePackRoots() {
+  std::vector<std::filesystem::path> paths;
+  const char* env = std::getenv("FALCON_LANG_PATHS");
+  if (env != nullptr) {
+    std::string_view view(env);
+    std::size_t start = 0;
+    while (start <= view.size()) {
+      const std::size_t end = view.find_first_of(";:", start);
+      const auto length = (end == std::string_view::npos) ? view.size() - start : end - start;
+      if (length > 0) {
+        paths.emplace_back(std::string(view.substr(start, length)));
+      }
+      if (end == std::string_view::npos) {
+        break;
+      }
+      start = end + 1;
+    }
+  }
+
+  std::filesystem::path current = std::filesystem::current_path();
+  for (int depth = 0; depth < 4; ++depth) {
+    const std::filesystem::path candidate = current / "assets" / "langpacks";
+    if (std::filesystem::exists(candidate)) {
+      paths.push_back(candidate);
+    }
+    if (!current.has_parent_path()) {
+      break;
+    }
+    current = current.parent_path();
+  }
+
+  std::unordered_set<std::string> dedupe;
+  std::vector<std::filesystem::path> result;
+  for (const auto& path : paths) {
+    if (!std::filesystem::exists(path)) {
+      continue;
+    }
+    const std::string canonical = std::filesystem::weakly_canonical(path).string();
+    if (dedupe.insert(canonical).second) {
+      result.emplace_back(canonical);
+    }
+  }
+  return result;
+}
+
 std::vector<GlyphTemplate> LoadGlyphPack(const std::filesystem::path& file, const std::string& language) {
   std::ifstream stream(file);
   if (!stream.is_open()) {
@@ -228,64 +284,27 @@ std::vector<GlyphTemplate> LoadGlyphPack(const std::filesystem::path& file, cons
   return templates;
 }
 
-std::vector<std::filesystem::path> CandidateSearchPaths() {
-  std::vector<std::filesystem::path> paths;
-  const char* env = std::getenv("FALCON_LANG_PATHS");
-  if (env != nullptr) {
-    std::string_view view(env);
-    std::size_t start = 0;
-    while (start <= view.size()) {
-      const std::size_t end = view.find_first_of(";:", start);
-      const auto length = (end == std::string_view::npos) ? view.size() - start : end - start;
-      if (length > 0) {
-        paths.emplace_back(std::string(view.substr(start, length)));
+void WriteGlyphPack(std::ostream& stream, const std::vector<GlyphTemplate>& templates) {
+  char codepoint[16];
+  for (const GlyphTemplate& tmpl : templates) {
+    std::snprintf(codepoint, sizeof(codepoint), "U+%04X", static_cast<unsigned>(tmpl.codepoint));
+    stream << "glyph " << codepoint << '\n';
+    for (int y = 0; y < kGlyphSize; ++y) {
+      for (int x = 0; x < kGlyphSize; ++x) {
+        stream << (tmpl.bitmap[static_cast<std::size_t>(y) * kGlyphSize + x] >= 128 ? '#' : '.');
       }
-      if (end == std::string_view::npos) {
-        break;
-      }
-      start = end + 1;
+      stream << '\n';
     }
   }
-
-  std::filesystem::path current = std::filesystem::current_path();
-  for (int depth = 0; depth < 4; ++depth) {
-    const std::filesystem::path candidate = current / "assets" / "langpacks";
-    if (std::filesystem::exists(candidate)) {
-      paths.push_back(candidate);
-    }
-    if (!current.has_parent_path()) {
-      break;
-    }
-    current = current.parent_path();
-  }
-
-  std::unordered_set<std::string> dedupe;
-  std::vector<std::filesystem::path> result;
-  for (const auto& path : paths) {
-    if (!std::filesystem::exists(path)) {
-      continue;
-    }
-    const std::string canonical = std::filesystem::weakly_canonical(path).string();
-    if (dedupe.insert(canonical).second) {
-      result.emplace_back(canonical);
-    }
-  }
-  return result;
 }
 
-}  // namespace
-
 const std::vector<GlyphTemplate>& BuiltInGlyphTemplates() {
   static const std::vector<GlyphTemplate> templates = [] {
-    std::vector<GlyphTemplate> result;
-    const auto raw = BuildRawGlyphs();
-    result.reserve(raw.size());
-    for (const RawGlyph& glyph : raw) {
-      GlyphTemplate tmpl{};
-      tmpl.codepoint = glyph.codepoint;
-      tmpl.bitmap = From5x7(glyph);
-      tmpl.language = "builtin";
-      result.push_back(std::move(tmpl));
+    std::vector<GlyphTemplate> result(kBuiltInGlyphs.size());
+    for (std::size_t i = 0; i < kBuiltInGlyphs.size(); ++i) {
+      result[i].codepoint = kBuiltInGlyphs[i].codepoint;
+      result[i].bitmap = kBuiltInGlyphs[i].bitmap;
+      result[i].language = "builtin";
     }
     return result;
   }();
@@ -295,7 +314,7 @@ const std::vector<GlyphTemplate>& BuiltInGlyphTemplates() {
 
 std::vector<std::string> DiscoverLanguagePacks() {
   std::set<std::string> languages;
-  for (const auto& root : CandidateSearchPaths()) {
+  for (const auto& root : LanguagePackRoots()) {
     if (!std::filesystem::exists(root) || !std::filesystem::is_directory(root)) {
       continue;
     }
@@ -308,70 +327,43 @@ std::vector<std::string> DiscoverLanguagePacks() {
   return {languages.begin(), languages.end()};
 }
 
-std::vector<GlyphTemplate> CollectGlyphTemplates(const std::vector<std::string>& languages,
-                                                 bool include_ascii_fallback) {
+std::vector<GlyphTemplate> LoadLanguagePack(const std::string& language) {
   std::vector<GlyphTemplate> templates;
-  if (include_ascii_fallback) {
-    const auto& builtin = BuiltInGlyphTemplates();
-    templates.insert(templates.end(), builtin.begin(), builtin.end());
-  }
-
-  std::vector<std::string> packs;
-  if (languages.empty()) {
-    packs = DiscoverLanguagePacks();
-  } else {
-    packs = languages;
-  }
-
-  if (packs.empty()) {
-    return templates;
-  }
-
-  std::unordered_set<char32_t> seen;
-  for (const auto& tmpl : templates) {
-    seen.insert(tmpl.codepoint);
-  }
-
-  const auto roots = CandidateSearchPaths();
-  for (const std::string& language : packs) {
-    bool loaded = false;
-    for (const auto& root : roots) {
-      const auto lang_root = root / language;
-      if (!std::filesystem::exists(lang_root) || !std::filesystem::is_directory(lang_root)) {
+  bool loaded = false;
+  for (const auto& root : LanguagePackRoots()) {
+    const auto lang_root = root / language;
+    if (!std::filesystem::exists(lang_root) || !std::filesystem::is_directory(lang_root)) {
+      continue;
+    }
+    // The first root holding the pack wins, so a user pack replaces the stock one rather than
+    // adding its variants to it.
+    loaded = true;
+    for (const auto& file_entry : std::filesystem::directory_iterator(lang_root)) {
+      if (!file_entry.is_regular_file()) {
         continue;
       }
-      for (const auto& file_entry : std::filesystem::directory_iterator(lang_root)) {
-        if (!file_entry.is_regular_file()) {
-          continue;
-        }
-        const auto& file_path = file_entry.path();
-        if (file_path.extension() != ".txt") {
-          continue;
-        }
-        auto pack_templates = LoadGlyphPack(file_path, language);
-        for (auto& tmpl : pack_templates) {
-          if (seen.insert(tmpl.codepoint).second) {
-            templates.push_back(std::move(tmpl));
-          }
-        }
-        loaded = true;
+      const auto& file_path = file_entry.path();
+      if (file_path.extension() != ".txt") {
+        continue;
       }
+      auto pack_templates = LoadGlyphPack(file_path, language);
+      templates.insert(templates.end(), std::make_move_iterator(pack_templates.begin()),
+                       std::make_move_iterator(pack_templates.end()));
     }
-    if (!loaded) {
-      std::filesystem::path direct(language);
-      if (std::filesystem::exists(direct)) {
-        auto pack_templates = LoadGlyphPack(direct, direct.stem().string());
-        for (auto& tmpl : pack_templates) {
-          if (seen.insert(tmpl.codepoint).second) {
-            templates.push_back(std::move(tmpl));
-          }
-        }
-      }
+    break;
+  }
+  if (!loaded) {
+    std::filesystem::path direct(language);
+    if (std::filesystem::exists(direct)) {
+      templates = LoadGlyphPack(direct, direct.stem().string());
     }
   }
-
   return templates;
 }
 
-}  // namespace falcon::core
+std::vector<GlyphTemplate> CollectGlyphTemplates(const std::vector<std::string>& languages,
+                                                 bool include_ascii_fallback) {
+  return PackRegistry::Shared().Collect(languages, include_ascii_fallback);
+}
 
+}  // namespace falcon::core
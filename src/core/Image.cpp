@@ -3,12 +3,23 @@
 #include <algorithm>
 #include <array>
 #include <cctype>
+#include <cmath>
 #include <cstdint>
 #include <fstream>
+#include <limits>
+#include <sstream>
 #include <stdexcept>
 #include <string>
+#include <utility>
 #include <vector>
 
+#include "falcon/core/Color.h"
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define FALCON_HAS_SSE2 1
+#endif
+
 namespace falcon::core {
 
 namespace {
@@ -23,6 +34,14 @@ uint32_t ReadLE32(const std::vector<uint8_t>& data, std::size_t offset) {
                                (static_cast<uint32_t>(data[offset + 3]) << 24));
 }
 
+// BMP headers store resolution in pixels per metre; 23622 px/m is 600 DPI, not 599.
+int DpiAt(const std::vector<uint8_t>& data, std::size_t offset) {
+  return static_cast<int>(std::lround(ReadLE32(data, offset) * 0.0254));
+}
+
+constexpr uint32_t kBmpRgb = 0;
+constexpr uint32_t kBmpBitfields = 3;
+
 Raster LoadBmpFromMemory(const std::vector<uint8_t>& data) {
   if (data.size() < 54) {
     throw std::runtime_error("BMP file too small");
@@ -45,42 +64,109 @@ Raster LoadBmpFromMemory(const std::vector<uint8_t>& data) {
   const uint16_t bpp = ReadLE16(data, 28);
   const uint32_t compression = ReadLE32(data, 30);
 
-  if (planes != 1 || (bpp != 24 && bpp != 8) || compression != 0) {
-    throw std::runtime_error("Unsupported BMP format (expecting 24-bit or 8-bit uncompressed)");
+  // 32-bpp pixels may be described by bit masks; only the usual byte-aligned BGRX layout is read.
+  const bool standard_masks = compression == kBmpBitfields && data.size() >= 66 &&
+                              ReadLE32(data, 54) == 0x00FF0000 && ReadLE32(data, 58) == 0x0000FF00 &&
+                              ReadLE32(data, 62) == 0x000000FF;
+  const bool supported = planes == 1 && ((bpp == 8 && compression == kBmpRgb) ||
+                                         (bpp == 24 && compression == kBmpRgb) ||
+                                         (bpp == 32 && (compression == kBmpRgb || standard_masks)));
+  if (!supported) {
+    throw std::runtime_error("Unsupported BMP format (expecting uncompressed 8-bit palette, 24-bit or 32-bit)");
+  }
+  if (width <= 0 || height == 0) {
+    throw std::runtime_error("Invalid BMP dimensions");
   }
 
   Raster raster;
   raster.width = width;
   raster.height = std::abs(height);
-  raster.dpi_x = static_cast<int>(ReadLE32(data, 38) * 0.0254);
-  raster.dpi_y = static_cast<int>(ReadLE32(data, 42) * 0.0254);
-  raster.pixels.resize(static_cast<std::size_t>(raster.width) * raster.height);
+  raster.dpi_x = DpiAt(data, 38);
+  raster.dpi_y = DpiAt(data, 42);
 
   const bool bottom_up = height > 0;
-  const int row_stride = ((bpp * width + 31) / 32) * 4;
+  const std::size_t row_stride = ((static_cast<std::size_t>(bpp) * static_cast<std::size_t>(width) + 31) / 32) * 4;
+  if (pixel_offset > data.size() || (data.size() - pixel_offset) / row_stride < static_cast<std::size_t>(raster.height)) {
+    throw std::runtime_error("BMP pixel data truncated");
+  }
+  raster.pixels.resize(static_cast<std::size_t>(raster.width) * raster.height);
+
+  // Palette indices map through a gray lookup table; direct color rows go through a row kernel
+  // chosen once here.
+  std::array<uint8_t, 256> palette{};
+  if (bpp == 8) {
+    const std::size_t palette_offset = 14 + static_cast<std::size_t>(dib_header_size);
+    const uint32_t colors_used = ReadLE32(data, 46);
+    const std::size_t entries = std::min<std::size_t>(colors_used == 0 ? 256 : colors_used, 256);
+    if (palette_offset + entries * 4 > pixel_offset) {
+      throw std::runtime_error("BMP palette truncated");
+    }
+    for (std::size_t i = 0; i < entries; ++i) {
+      const uint8_t* entry = data.data() + palette_offset + i * 4;
+      palette[i] = static_cast<uint8_t>(GrayFromRgb(entry[2], entry[1], entry[0]));
+    }
+  }
+  const GrayRowKernel kernel = GrayRowKernelFor(bpp == 24 ? PixelFormat::kBgr24 : PixelFormat::kBgrx32);
 
   for (int row = 0; row < raster.height; ++row) {
     const int src_row = bottom_up ? (raster.height - 1 - row) : row;
-    const std::size_t row_start = static_cast<std::size_t>(pixel_offset) + static_cast<std::size_t>(src_row) * row_stride;
-    for (int col = 0; col < raster.width; ++col) {
-      if (bpp == 24) {
-        const std::size_t idx = row_start + static_cast<std::size_t>(col) * 3;
-        const uint8_t b = data[idx];
-        const uint8_t g = data[idx + 1];
-        const uint8_t r = data[idx + 2];
-        const uint8_t gray = static_cast<uint8_t>(0.299 * r + 0.587 * g + 0.114 * b);
-        raster.pixels[static_cast<std::size_t>(row) * raster.width + col] = gray;
-      } else {  // 8-bit indexed
-        const std::size_t idx = row_start + static_cast<std::size_t>(col);
-        const uint8_t value = data[idx];
-        raster.pixels[static_cast<std::size_t>(row) * raster.width + col] = value;
+    const uint8_t* src = data.data() + pixel_offset + static_cast<std::size_t>(src_row) * row_stride;
+    uint8_t* dst = raster.pixels.data() + static_cast<std::size_t>(row) * raster.width;
+    if (bpp == 8) {
+      for (int col = 0; col < raster.width; ++col) {
+        dst[col] = palette[src[col]];
       }
+    } else {
+      kernel(src, static_cast<std::size_t>(raster.width), dst);
     }
   }
 
   return raster;
 }
 
+// Read-only stream over bytes already in memory, so in-memory images are parsed without a copy.
+class MemoryBuffer : public std::streambuf {
+ public:
+  explicit MemoryBuffer(const std::vector<uint8_t>& bytes) {
+    char* begin = const_cast<char*>(reinterpret_cast<const char*>(bytes.data()));
+    setg(begin, begin, begin + bytes.size());
+  }
+
+ protected:
+  pos_type seekoff(off_type offset, std::ios_base::seekdir dir, std::ios_base::openmode which) override {
+    if ((which & std::ios_base::in) == 0) {
+      return pos_type(off_type(-1));
+    }
+    const off_type base = dir == std::ios_base::beg ? 0 : dir == std::ios_base::cur ? gptr() - eback() : egptr() - eback();
+    return seekpos(pos_type(base + offset), which);
+  }
+  pos_type seekpos(pos_type position, std::ios_base::openmode which) override {
+    const off_type offset = position;
+    if ((which & std::ios_base::in) == 0 || offset < 0 || offset > egptr() - eback()) {
+      return pos_type(off_type(-1));
+    }
+    setg(eback(), eback() + offset, egptr());
+    return position;
+  }
+};
+
+// Bytes between the stream position and its end, or the maximum for streams that cannot seek.
+std::size_t RemainingBytes(std::istream& stream) {
+  const auto here = stream.tellg();
+  if (here < 0) {
+    return std::numeric_limits<std::size_t>::max();
+  }
+  stream.seekg(0, std::ios::end);
+  const auto end = stream.tellg();
+  stream.seekg(here);
+  return end < here ? std::numeric_limits<std::size_t>::max() : static_cast<std::size_t>(end - here);
+}
+
+// Maps a sample in [0, max_value] to [0, 255], rounding to nearest.
+uint8_t ScaleSample(uint32_t value, uint32_t max_value) {
+  return static_cast<uint8_t>(std::min<uint32_t>((value * 255 + max_value / 2) / max_value, 255));
+}
+
 std::string ReadNextToken(std::istream& stream) {
   std::string token;
   char ch;
@@ -111,57 +197,65 @@ Raster LoadAsciiPnm(std::istream& stream, int width, int height, int max_value,
   raster.height = height;
   raster.pixels.resize(static_cast<std::size_t>(width) * height);
 
-  for (int y = 0; y < height; ++y) {
-    for (int x = 0; x < width; ++x) {
-      if (is_color) {
-        const int r = std::stoi(ReadNextToken(stream));
-        const int g = std::stoi(ReadNextToken(stream));
-        const int b = std::stoi(ReadNextToken(stream));
-        const float gray = 0.299f * static_cast<float>(r) + 0.587f * static_cast<float>(g) +
-                           0.114f * static_cast<float>(b);
-        raster.pixels[static_cast<std::size_t>(y) * width + x] =
-            static_cast<uint8_t>(std::clamp(gray / static_cast<float>(max_value), 0.0f, 1.0f) * 255.0f + 0.5f);
-      } else {
-        const int v = std::stoi(ReadNextToken(stream));
-        raster.pixels[static_cast<std::size_t>(y) * width + x] =
-            static_cast<uint8_t>(std::clamp(static_cast<float>(v) / static_cast<float>(max_value), 0.0f, 1.0f) * 255.0f +
-                                 0.5f);
-      }
+  const auto max = static_cast<uint32_t>(max_value);
+  const auto read_sample = [&stream, max] {
+    return std::min(static_cast<uint32_t>(std::stoul(ReadNextToken(stream))), max);
+  };
+  for (auto& pixel : raster.pixels) {
+    if (is_color) {
+      const uint32_t r = read_sample();
+      const uint32_t g = read_sample();
+      const uint32_t b = read_sample();
+      pixel = ScaleSample(GrayFromRgb(r, g, b), max);
+    } else {
+      pixel = ScaleSample(read_sample(), max);
     }
   }
 
   return raster;
 }
 
+// Rows are read in one call each and converted by the shared row kernels; samples above 255 take
+// two big-endian bytes. Reading exactly the image keeps the stream positioned at the next image
+// of a multi-image file.
 Raster LoadBinaryPnm(std::istream& stream, int width, int height, int max_value, bool is_color) {
   Raster raster;
   raster.width = width;
   raster.height = height;
   raster.pixels.resize(static_cast<std::size_t>(width) * height);
 
-  const auto read_byte = [&stream]() -> uint8_t {
-    const int value = stream.get();
-    if (value == EOF) {
-      throw std::runtime_error("Unexpected EOF while reading PNM file");
-    }
-    return static_cast<uint8_t>(value);
-  };
+  const bool wide = max_value > 255;
+  const std::size_t channels = is_color ? 3 : 1;
+  const std::size_t row_bytes = static_cast<std::size_t>(width) * channels * (wide ? 2 : 1);
+  std::vector<uint8_t> row(row_bytes);
+  const GrayRowKernel kernel = GrayRowKernelFor(is_color ? PixelFormat::kRgb24 : PixelFormat::kGray8);
+  const auto max = static_cast<uint32_t>(max_value);
+  std::array<uint8_t, 256> scale{};
+  for (uint32_t value = 0; value < scale.size(); ++value) {
+    scale[value] = ScaleSample(std::min(value, max), max);
+  }
 
   for (int y = 0; y < height; ++y) {
-    for (int x = 0; x < width; ++x) {
-      if (is_color) {
-        const uint8_t r = read_byte();
-        const uint8_t g = read_byte();
-        const uint8_t b = read_byte();
-        const float gray = 0.299f * static_cast<float>(r) + 0.587f * static_cast<float>(g) +
-                           0.114f * static_cast<float>(b);
-        raster.pixels[static_cast<std::size_t>(y) * width + x] =
-            static_cast<uint8_t>(std::clamp(gray / static_cast<float>(max_value), 0.0f, 1.0f) * 255.0f + 0.5f);
-      } else {
-        const uint8_t v = read_byte();
-        raster.pixels[static_cast<std::size_t>(y) * width + x] =
-            static_cast<uint8_t>(std::clamp(static_cast<float>(v) / static_cast<float>(max_value), 0.0f, 1.0f) * 255.0f +
-                                 0.5f);
+    if (!stream.read(reinterpret_cast<char*>(row.data()), static_cast<std::streamsize>(row_bytes))) {
+      throw std::runtime_error("Unexpected EOF while reading PNM file");
+    }
+    uint8_t* dst = raster.pixels.data() + static_cast<std::size_t>(y) * width;
+    if (wide) {
+      const auto sample = [&row](std::size_t index) {
+        return static_cast<uint32_t>(row[2 * index]) << 8 | row[2 * index + 1];
+      };
+      for (std::size_t x = 0; x < static_cast<std::size_t>(width); ++x) {
+        const uint32_t value = is_color ? GrayFromRgb(std::min(sample(3 * x), max), std::min(sample(3 * x + 1), max),
+                                                      std::min(sample(3 * x + 2), max))
+                                        : std::min(sample(x), max);
+        dst[x] = ScaleSample(value, max);
+      }
+      continue;
+    }
+    kernel(row.data(), static_cast<std::size_t>(width), dst);
+    if (max != 255) {
+      for (std::size_t x = 0; x < static_cast<std::size_t>(width); ++x) {
+        dst[x] = scale[dst[x]];
       }
     }
   }
@@ -189,10 +283,18 @@ Raster LoadPnmStream(std::istream& stream) {
   if (max_value <= 0 || max_value > 65535) {
     throw std::runtime_error("Unsupported PNM max value");
   }
-
-  if (is_binary) {
-    stream.get();  // consume single whitespace
+  if (width <= 0 || height <= 0) {
+    throw std::runtime_error("Invalid PNM dimensions");
   }
+  // Every sample takes at least one byte (two when binary and wider than 8 bits), so a header that
+  // promises more pixels than the data can hold fails before the raster is allocated.
+  const std::size_t sample_bytes = (is_color ? 3 : 1) * (is_binary && max_value > 255 ? 2 : 1);
+  if (static_cast<std::size_t>(width) * static_cast<std::size_t>(height) > RemainingBytes(stream) / sample_bytes) {
+    throw std::runtime_error("PNM pixel data truncated");
+  }
+
+  // ReadNextToken already consumed the single whitespace byte that separates the header from
+  // binary pixel data.
 
   if (is_binary) {
     return LoadBinaryPnm(stream, width, height, max_value, is_color);
@@ -201,19 +303,100 @@ Raster LoadPnmStream(std::istream& stream) {
   return LoadAsciiPnm(stream, width, height, max_value, is_color);
 }
 
+// 2x2 mean of rows `top` and `bottom` (which may alias for an odd final row).
+void HalveRow(const uint8_t* top, const uint8_t* bottom, int src_width, uint8_t* out) {
+  const int full_pairs = src_width / 2;
+  int x = 0;
+#ifdef FALCON_HAS_SSE2
+  const __m128i low_bytes = _mm_set1_epi16(0x00FF);
+  const __m128i rounding = _mm_set1_epi16(2);
+  for (; x + 16 <= full_pairs; x += 16) {
+    const auto pair_sums = [&](int offset) {
+      const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(top + 2 * (x + offset)));
+      const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(bottom + 2 * (x + offset)));
+      const __m128i even = _mm_add_epi16(_mm_and_si128(a, low_bytes), _mm_and_si128(b, low_bytes));
+      const __m128i odd = _mm_add_epi16(_mm_srli_epi16(a, 8), _mm_srli_epi16(b, 8));
+      return _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(even, odd), rounding), 2);
+    };
+    const __m128i result = _mm_packus_epi16(pair_sums(0), pair_sums(8));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out + x), result);
+  }
+#endif
+  for (; x < full_pairs; ++x) {
+    const int sum = top[2 * x] + top[2 * x + 1] + bottom[2 * x] + bottom[2 * x + 1];
+    out[x] = static_cast<uint8_t>((sum + 2) >> 2);
+  }
+  if (src_width % 2 != 0) {
+    out[full_pairs] = static_cast<uint8_t>((top[src_width - 1] + bottom[src_width - 1] + 1) >> 1);
+  }
+}
+
+// Header of the BMP or PNM image at the start of `file`.
+ImageInfo ProbeStream(std::istream& file) {
+  ImageInfo info;
+  if (file.peek() == 'B') {
+    std::vector<uint8_t> header(54);
+    if (!file.read(reinterpret_cast<char*>(header.data()), static_cast<std::streamsize>(header.size())) ||
+        ReadLE16(header, 0) != 0x4D42) {
+      throw std::runtime_error("Not a BMP file");
+    }
+    info.size.width = static_cast<int32_t>(ReadLE32(header, 18));
+    info.size.height = std::abs(static_cast<int32_t>(ReadLE32(header, 22)));
+    info.dpi_x = DpiAt(header, 38);
+    info.dpi_y = DpiAt(header, 42);
+    return info;
+  }
+  const std::string magic = ReadNextToken(file);
+  if (magic.size() != 2 || magic[0] != 'P') {
+    throw std::runtime_error("Unsupported image data");
+  }
+  info.size.width = std::stoi(ReadNextToken(file));
+  info.size.height = std::stoi(ReadNextToken(file));
+  return info;
+}
+
+std::string LowercaseExtension(const std::filesystem::path& path) {
+  std::string extension = path.extension().string();
+  std::transform(extension.begin(), extension.end(), extension.begin(),
+                 [](unsigned char ch) { return static_cast<char>(std::tolower(ch)); });
+  return extension;
+}
+
 }  // namespace
 
+bool IsImagePath(const std::filesystem::path& path) {
+  return LowercaseExtension(path) == ".bmp" || IsPnmPath(path);
+}
+
+bool IsPnmPath(const std::filesystem::path& path) {
+  const std::string extension = LowercaseExtension(path);
+  return extension == ".pgm" || extension == ".ppm" || extension == ".pnm";
+}
+
 Raster LoadImage(const std::filesystem::path& path) {
-  const auto ext = path.extension().string();
-  if (ext == ".bmp" || ext == ".BMP") {
-    return LoadBmp(path);
-  }
-  if (ext == ".pgm" || ext == ".PGM" || ext == ".ppm" || ext == ".PPM" || ext == ".pnm" || ext == ".PNM") {
+  if (IsPnmPath(path)) {
     return LoadPnm(path);
   }
+  if (IsImagePath(path)) {
+    return LoadBmp(path);
+  }
   throw std::runtime_error("Unsupported image extension");
 }
 
+ImageInfo ProbeImage(const std::filesystem::path& path) {
+  std::ifstream file(path, std::ios::binary);
+  if (!file) {
+    throw std::runtime_error("Failed to open image file: " + path.string());
+  }
+  return ProbeStream(file);
+}
+
+ImageInfo ProbeImage(const std::vector<uint8_t>& bytes) {
+  MemoryBuffer buffer(bytes);
+  std::istream stream(&buffer);
+  return ProbeStream(stream);
+}
+
 Raster LoadBmp(const std::filesystem::path& path) {
   std::ifstream file(path, std::ios::binary);
   if (!file) {
@@ -231,6 +414,50 @@ Raster LoadPnm(const std::filesystem::path& path) {
   return LoadPnmStream(file);
 }
 
+Raster DecodeImage(const std::vector<uint8_t>& bytes) {
+  if (bytes.size() >= 2 && bytes[0] == 'B' && bytes[1] == 'M') {
+    return LoadBmpFromMemory(bytes);
+  }
+  if (bytes.size() >= 2 && bytes[0] == 'P' && bytes[1] >= '1' && bytes[1] <= '6') {
+    MemoryBuffer buffer(bytes);
+    std::istream stream(&buffer);
+    return LoadPnmStream(stream);
+  }
+  throw std::runtime_error("Unsupported image data");
+}
+
+PnmPageReader::PnmPageReader(std::istream& stream) : stream_(&stream) {}
+
+PnmPageReader::PnmPageReader(const std::filesystem::path& path)
+    : owned_(std::make_unique<std::ifstream>(path, std::ios::binary)), stream_(owned_.get()) {
+  if (!*owned_) {
+    throw std::runtime_error("Failed to open PNM file: " + path.string());
+  }
+}
+
+PnmPageReader::PnmPageReader(std::vector<uint8_t> bytes)
+    : bytes_(std::move(bytes)),
+      buffer_(std::make_unique<MemoryBuffer>(bytes_)),
+      owned_(std::make_unique<std::istream>(buffer_.get())),
+      stream_(owned_.get()) {}
+
+PnmPageReader::~PnmPageReader() = default;
+
+bool PnmPageReader::Next(Raster& page) {
+  for (int ch = stream_->peek(); ch != EOF; ch = stream_->peek()) {
+    if (ch == '#') {
+      stream_->ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+    } else if (std::isspace(ch)) {
+      stream_->get();
+    } else {
+      page = LoadPnmStream(*stream_);
+      ++pages_;
+      return true;
+    }
+  }
+  return false;
+}
+
 Raster ConvertToGrayscale(const Raster& src) {
   // Already stored as grayscale. Return copy to keep API symmetrical.
   return src;
@@ -248,16 +475,84 @@ Raster ResizeNearest(const Raster& src, int new_width, int new_height) {
   out.dpi_y = src.dpi_y;
   out.pixels.resize(static_cast<std::size_t>(new_width) * new_height);
 
+  std::vector<int> columns(static_cast<std::size_t>(new_width));
+  for (int x = 0; x < new_width; ++x) {
+    columns[static_cast<std::size_t>(x)] = static_cast<int>(static_cast<int64_t>(x) * src.width / new_width);
+  }
+
   for (int y = 0; y < new_height; ++y) {
-    const int src_y = static_cast<int>(static_cast<float>(y) * src.height / new_height);
+    const int src_y = static_cast<int>(static_cast<int64_t>(y) * src.height / new_height);
+    const uint8_t* src_row = src.pixels.data() + static_cast<std::size_t>(src_y) * src.width;
+    uint8_t* dst_row = out.pixels.data() + static_cast<std::size_t>(y) * new_width;
     for (int x = 0; x < new_width; ++x) {
-      const int src_x = static_cast<int>(static_cast<float>(x) * src.width / new_width);
-      out.pixels[static_cast<std::size_t>(y) * new_width + x] =
-          src.pixels[static_cast<std::size_t>(src_y) * src.width + src_x];
+      dst_row[x] = src_row[columns[static_cast<std::size_t>(x)]];
     }
   }
 
   return out;
 }
 
+Raster DownscaleBox(const RasterView& src, int factor_x, int factor_y) {
+  Raster out;
+  DownscaleBox(src, factor_x, factor_y, out);
+  return out;
+}
+
+void DownscaleBox(const RasterView& src, int factor_x, int factor_y, Raster& out) {
+  if (src.Empty()) {
+    throw std::invalid_argument("DownscaleBox requires a non-empty raster");
+  }
+  if (factor_x <= 0 || factor_y <= 0) {
+    throw std::invalid_argument("DownscaleBox expects positive factors");
+  }
+
+  out.width = (src.width + factor_x - 1) / factor_x;
+  out.height = (src.height + factor_y - 1) / factor_y;
+  out.dpi_x = std::max(1, src.dpi_x / factor_x);
+  out.dpi_y = std::max(1, src.dpi_y / factor_y);
+  out.pixels.resize(static_cast<std::size_t>(out.width) * out.height);
+
+  for (int y = 0; y < out.height; ++y) {
+    const int y0 = y * factor_y;
+    const int rows = std::min(factor_y, src.height - y0);
+    const uint8_t* first_row = src.Row(y0);
+    uint8_t* dst_row = out.pixels.data() + static_cast<std::size_t>(y) * out.width;
+
+    if (factor_x == 2 && factor_y == 2) {
+      HalveRow(first_row, rows == 2 ? first_row + src.stride : first_row, src.width, dst_row);
+      continue;
+    }
+
+    for (int x = 0; x < out.width; ++x) {
+      const int x0 = x * factor_x;
+      const int columns = std::min(factor_x, src.width - x0);
+      uint32_t sum = 0;
+      for (int row = 0; row < rows; ++row) {
+        const uint8_t* block = first_row + static_cast<std::size_t>(row) * src.stride + x0;
+        for (int col = 0; col < columns; ++col) {
+          sum += block[col];
+        }
+      }
+      const uint32_t count = static_cast<uint32_t>(rows * columns);
+      dst_row[x] = static_cast<uint8_t>((sum + count / 2) / count);
+    }
+  }
+}
+
+std::vector<Raster> BuildPyramid(const Raster& src, int min_size, int max_levels) {
+  std::vector<Raster> levels;
+  if (src.Empty() || max_levels <= 0) {
+    return levels;
+  }
+  levels.push_back(src);
+  while (static_cast<int>(levels.size()) < max_levels) {
+    const Raster& last = levels.back();
+    if ((last.width + 1) / 2 < min_size || (last.height + 1) / 2 < min_size) {
+      break;
+    }
+    levels.push_back(DownscaleBox(last, 2, 2));
+  }
+  return levels;
+}
+
 }  // namespace falcon::core
@@ -0,0 +1,218 @@
+#include "falcon/core/Layout.h"
+
+#include <algorithm>
+
+namespace falcon::core {
+
+namespace {
+
+using Range = std::pair<std::size_t, std::size_t>;
+
+RectI Union(const RectI& a, const RectI& b) {
+  const int x = std::min(a.x, b.x);
+  const int y = std::min(a.y, b.y);
+  return RectI{x, y, std::max(a.Right(), b.Right()) - x, std::max(a.Bottom(), b.Bottom()) - y};
+}
+
+RectI BoundsOf(const std::vector<ConnectedComponent>& components, std::size_t begin, std::size_t end) {
+  RectI bounds = components[begin].bounds;
+  for (std::size_t i = begin + 1; i < end; ++i) {
+    bounds = Union(bounds, components[i].bounds);
+  }
+  return bounds;
+}
+
+// Splits a block that is already sorted by y into lines and sorts each line by x.
+void SplitLines(std::vector<ConnectedComponent>& components, std::size_t begin, std::size_t end, int text_height,
+                const LayoutOptions& options, std::vector<TextLine>& lines) {
+  const int min_height = static_cast<int>(options.min_line_height_ratio * static_cast<float>(text_height));
+  const std::size_t first_line = lines.size();
+  std::size_t line_begin = begin;
+  int line_top = components[begin].bounds.y;
+  int extent = components[begin].bounds.Bottom();
+  const auto emit = [&](std::size_t line_end) {
+    TextLine line;
+    line.begin = line_begin;
+    line.end = line_end;
+    lines.push_back(line);
+    line_begin = line_end;
+  };
+  for (std::size_t i = begin + 1; i < end; ++i) {
+    const auto& bounds = components[i].bounds;
+    if (bounds.y - extent >= options.min_line_spacing && extent - line_top >= min_height) {
+      emit(i);
+      line_top = bounds.y;
+    }
+    extent = std::max(extent, bounds.Bottom());
+  }
+  if (lines.size() > first_line && extent - line_top < min_height) {
+    // A short trailing piece (underline dots, a stray accent) belongs to the line above.
+    line_begin = lines.back().begin;
+    lines.pop_back();
+  }
+  emit(end);
+
+  for (std::size_t i = first_line; i < lines.size(); ++i) {
+    auto& line = lines[i];
+    std::sort(components.begin() + static_cast<std::ptrdiff_t>(line.begin),
+              components.begin() + static_cast<std::ptrdiff_t>(line.end),
+              [](const auto& lhs, const auto& rhs) { return lhs.bounds.x < rhs.bounds.x; });
+    line.bounds = BoundsOf(components, line.begin, line.end);
+  }
+}
+
+bool IsText(const ConnectedComponent& component, int text_height, const LayoutOptions& options) {
+  if (component.area < options.min_area) {
+    return false;
+  }
+  if (text_height <= 0) {
+    return true;
+  }
+  const float height = static_cast<float>(text_height);
+  const float w = static_cast<float>(component.bounds.width);
+  const float h = static_cast<float>(component.bounds.height);
+  if (h > options.max_height_ratio * height) {
+    return false;
+  }
+  if (w >= options.rule_length_ratio * height && h <= options.rule_thickness_ratio * height) {
+    return false;
+  }
+  return !(w < options.speck_ratio * height && h < options.speck_ratio * height);
+}
+
+// Sorts [begin, end) along one axis and pushes the pieces separated by at least `min_gap` pixels
+// of whitespace onto `pending`, first piece on top. Returns false if the range has no such gap.
+template <typename Start, typename Stop>
+bool SplitAtGaps(std::vector<ConnectedComponent>& components, const Range& range, int min_gap, Start start, Stop stop,
+                 std::vector<Range>& pending) {
+  const auto first = components.begin() + static_cast<std::ptrdiff_t>(range.first);
+  const auto last = components.begin() + static_cast<std::ptrdiff_t>(range.second);
+  std::sort(first, last, [&](const auto& lhs, const auto& rhs) { return start(lhs) < start(rhs); });
+
+  const std::size_t pending_before = pending.size();
+  std::size_t piece_begin = range.first;
+  int extent = stop(components[range.first]);
+  for (std::size_t i = range.first + 1; i < range.second; ++i) {
+    if (start(components[i]) - extent >= min_gap) {
+      pending.emplace_back(piece_begin, i);
+      piece_begin = i;
+    }
+    extent = std::max(extent, stop(components[i]));
+  }
+  if (piece_begin == range.first) {
+    return false;
+  }
+  pending.emplace_back(piece_begin, range.second);
+  std::reverse(pending.begin() + static_cast<std::ptrdiff_t>(pending_before), pending.end());
+  return true;
+}
+
+bool IsHalftone(const std::vector<ConnectedComponent>& components, const Range& range, int text_height,
+                const LayoutOptions& options, std::vector<int>& heights) {
+  const std::size_t count = range.second - range.first;
+  if (text_height <= 0 || count < options.halftone_min_components) {
+    return false;
+  }
+  heights.clear();
+  for (std::size_t i = range.first; i < range.second; ++i) {
+    heights.push_back(components[i].bounds.height);
+  }
+  const auto middle = heights.begin() + static_cast<std::ptrdiff_t>(heights.size() / 2);
+  std::nth_element(heights.begin(), middle, heights.end());
+  return static_cast<float>(*middle) < options.halftone_height_ratio * static_cast<float>(text_height);
+}
+
+}  // namespace
+
+int EstimateTextHeight(const std::vector<ConnectedComponent>& components, const LayoutOptions& options,
+                       std::vector<int>& heights) {
+  heights.clear();
+  for (const auto& component : components) {
+    if (component.area >= options.min_area && component.bounds.height >= options.min_text_height) {
+      heights.push_back(component.bounds.height);
+    }
+  }
+  if (heights.empty()) {
+    return 0;
+  }
+  const auto middle = heights.begin() + static_cast<std::ptrdiff_t>(heights.size() / 2);
+  std::nth_element(heights.begin(), middle, heights.end());
+  return *middle;
+}
+
+void AnalyzeLayout(std::vector<ConnectedComponent>& components, const LayoutOptions& options, LayoutScratch& scratch,
+                   std::vector<TextBlock>& blocks, std::vector<TextLine>& lines) {
+  blocks.clear();
+  lines.clear();
+
+  const int text_height = options.reject_non_text ? EstimateTextHeight(components, options, scratch.heights) : 0;
+  components.erase(std::remove_if(components.begin(), components.end(),
+                                  [&](const auto& component) {
+                                    return options.reject_non_text ? !IsText(component, text_height, options)
+                                                                   : component.area < options.min_area;
+                                  }),
+                   components.end());
+  if (components.empty()) {
+    return;
+  }
+
+  const int gap_height = std::max(text_height, options.min_text_height);
+  const int block_gap = std::max(1, static_cast<int>(options.block_gap_ratio * static_cast<float>(gap_height)));
+  const int column_gap = std::max(1, static_cast<int>(options.column_gap_ratio * static_cast<float>(gap_height)));
+  const auto top = [](const ConnectedComponent& c) { return c.bounds.y; };
+  const auto bottom = [](const ConnectedComponent& c) { return c.bounds.Bottom(); };
+  const auto left = [](const ConnectedComponent& c) { return c.bounds.x; };
+  const auto right = [](const ConnectedComponent& c) { return c.bounds.Right(); };
+
+  // Depth-first X-Y cut. Pieces are pushed in reverse so leaves come out in reading order and
+  // cover the component list left to right.
+  auto& pending = scratch.pending;
+  pending.clear();
+  pending.emplace_back(0, components.size());
+  while (!pending.empty()) {
+    const Range range = pending.back();
+    pending.pop_back();
+    if (SplitAtGaps(components, range, block_gap, top, bottom, pending) ||
+        SplitAtGaps(components, range, column_gap, left, right, pending)) {
+      continue;
+    }
+    if (options.reject_non_text && IsHalftone(components, range, text_height, options, scratch.heights)) {
+      continue;
+    }
+
+    // The failed column split left the range sorted by x; lines need it sorted by y.
+    std::sort(components.begin() + static_cast<std::ptrdiff_t>(range.first),
+              components.begin() + static_cast<std::ptrdiff_t>(range.second),
+              [](const auto& lhs, const auto& rhs) { return lhs.bounds.y < rhs.bounds.y; });
+
+    TextBlock block;
+    block.bounds = BoundsOf(components, range.first, range.second);
+    block.begin = range.first;
+    block.end = range.second;
+    block.first_line = lines.size();
+    SplitLines(components, range.first, range.second, gap_height, options, lines);
+    block.last_line = lines.size();
+    blocks.push_back(block);
+  }
+
+  // Close the holes left by dropped halftone blocks.
+  std::size_t write = 0;
+  for (auto& block : blocks) {
+    const std::size_t size = block.end - block.begin;
+    if (block.begin != write) {
+      std::move(components.begin() + static_cast<std::ptrdiff_t>(block.begin),
+                components.begin() + static_cast<std::ptrdiff_t>(block.end),
+                components.begin() + static_cast<std::ptrdiff_t>(write));
+    }
+    for (std::size_t line = block.first_line; line < block.last_line; ++line) {
+      lines[line].begin = lines[line].begin - block.begin + write;
+      lines[line].end = lines[line].end - block.begin + write;
+    }
+    block.begin = write;
+    block.end = write + size;
+    write += size;
+  }
+  components.resize(write);
+}
+
+}  // namespace falcon::core
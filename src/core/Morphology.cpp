@@ -0,0 +1,280 @@
+#include "falcon/core/Morphology.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define FALCON_HAS_SSE2 1
+#endif
+
+namespace falcon::core {
+
+namespace {
+
+constexpr uint64_t kAllInk = ~uint64_t{0};
+
+// Valid bits of the last word of each row.
+uint64_t TailMask(int width) {
+  const int used = width % 64;
+  return used == 0 ? kAllInk : (uint64_t{1} << used) - 1;
+}
+
+void Resize(PackedBinaryImage& image, int width, int height) {
+  image.width = width;
+  image.height = height;
+  image.words_per_row = (static_cast<std::size_t>(width) + 63) / 64;
+  image.bits.resize(image.words_per_row * static_cast<std::size_t>(height));
+}
+
+void ClearTails(PackedBinaryImage& image) {
+  const uint64_t mask = TailMask(image.width);
+  if (mask == kAllInk) {
+    return;
+  }
+  for (int y = 0; y < image.height; ++y) {
+    image.Row(y)[image.words_per_row - 1] &= mask;
+  }
+}
+
+// `And` selects erosion-style combination (outside pixels read as ink) over dilation-style (outside
+// pixels read as background).
+template <bool And>
+uint64_t Combine(uint64_t a, uint64_t b) {
+  return And ? (a & b) : (a | b);
+}
+
+// out(x, y) = combination over dx in [lo, hi] of image(x + dx, y). Each row is copied between
+// padding words once so every shifted word is two loads, a pair of shifts and an or.
+template <bool And>
+void HorizontalRange(const PackedBinaryImage& image, int lo, int hi, PackedBinaryImage& out,
+                     std::vector<uint64_t>& padded) {
+  Resize(out, image.width, image.height);
+  const std::size_t words = image.words_per_row;
+  const std::size_t pad_words = static_cast<std::size_t>((std::max(std::abs(lo), std::abs(hi)) + 63) / 64);
+  const uint64_t pad = And ? kAllInk : 0;
+  const uint64_t tail = TailMask(image.width);
+  padded.assign(words + 2 * pad_words + 1, pad);
+  for (int y = 0; y < image.height; ++y) {
+    std::copy(image.Row(y), image.Row(y) + words, padded.begin() + static_cast<std::ptrdiff_t>(pad_words));
+    padded[pad_words + words - 1] |= pad & ~tail;
+    uint64_t* dst = out.Row(y);
+    for (std::size_t i = 0; i < words; ++i) {
+      uint64_t acc = And ? kAllInk : 0;
+      for (int dx = lo; dx <= hi; ++dx) {
+        const auto bit = static_cast<std::size_t>(static_cast<std::ptrdiff_t>((pad_words + i) * 64) + dx);
+        const std::size_t word = bit / 64;
+        const unsigned shift = bit % 64;
+        const uint64_t shifted =
+            shift == 0 ? padded[word] : (padded[word] >> shift) | (padded[word + 1] << (64 - shift));
+        acc = Combine<And>(acc, shifted);
+      }
+      dst[i] = acc;
+    }
+    dst[words - 1] &= tail;
+  }
+}
+
+// out(x, y) = combination over dy in [lo, hi] of image(x, y + dy), whole words at a time.
+template <bool And>
+void VerticalRange(const PackedBinaryImage& image, int lo, int hi, PackedBinaryImage& out) {
+  Resize(out, image.width, image.height);
+  const std::size_t words = image.words_per_row;
+  for (int y = 0; y < image.height; ++y) {
+    uint64_t* dst = out.Row(y);
+    std::fill(dst, dst + words, And ? kAllInk : 0);
+    for (int dy = std::max(lo, -y); dy <= std::min(hi, image.height - 1 - y); ++dy) {
+      const uint64_t* src = image.Row(y + dy);
+      for (std::size_t i = 0; i < words; ++i) {
+        dst[i] = Combine<And>(dst[i], src[i]);
+      }
+    }
+  }
+  ClearTails(out);
+}
+
+template <bool And>
+void Apply(const PackedBinaryImage& image, const StructuringElement& element, PackedBinaryImage& out,
+           MorphologyScratch& scratch) {
+  const int rx = std::max(element.radius_x, 0);
+  const int ry = std::max(element.radius_y, 0);
+  auto& horizontal = scratch.temp[0];
+  HorizontalRange<And>(image, -rx, rx, horizontal, scratch.padded_row);
+  if (element.shape == StructuringShape::kRectangle) {
+    // Separable: the rectangle is a horizontal segment swept vertically.
+    VerticalRange<And>(horizontal, -ry, ry, out);
+    return;
+  }
+  // A union of elements erodes to the intersection of the erosions and dilates to the union.
+  VerticalRange<And>(image, -ry, ry, out);
+  for (std::size_t i = 0; i < out.bits.size(); ++i) {
+    out.bits[i] = Combine<And>(out.bits[i], horizontal.bits[i]);
+  }
+}
+
+}  // namespace
+
+void PackBinaryImage(const BinaryImage& image, PackedBinaryImage& out) {
+  Resize(out, image.width, image.height);
+  std::fill(out.bits.begin(), out.bits.end(), 0);
+  const auto width = static_cast<std::size_t>(image.width);
+  for (int y = 0; y < image.height; ++y) {
+    const uint8_t* src = image.data.data() + static_cast<std::size_t>(y) * width;
+    uint64_t* dst = out.Row(y);
+    std::size_t x = 0;
+#ifdef FALCON_HAS_SSE2
+    // Sixteen pixels per compare; the byte sign mask is exactly the packed bit pattern.
+    const __m128i zero = _mm_setzero_si128();
+    for (; x + 16 <= width; x += 16) {
+      const __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + x));
+      const auto ink = static_cast<uint64_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(pixels, zero)) ^ 0xFFFF);
+      dst[x / 64] |= ink << (x % 64);
+    }
+#endif
+    for (; x < width; ++x) {
+      dst[x / 64] |= static_cast<uint64_t>(src[x] != 0) << (x % 64);
+    }
+  }
+}
+
+void UnpackBinaryImage(const PackedBinaryImage& image, BinaryImage& out) {
+  out.width = image.width;
+  out.height = image.height;
+  const auto width = static_cast<std::size_t>(image.width);
+  out.data.resize(width * static_cast<std::size_t>(image.height));
+  for (int y = 0; y < image.height; ++y) {
+    const uint64_t* src = image.Row(y);
+    uint8_t* dst = out.data.data() + static_cast<std::size_t>(y) * width;
+    for (std::size_t x = 0; x < width; ++x) {
+      dst[x] = static_cast<uint8_t>((src[x / 64] >> (x % 64)) & 1U);
+    }
+  }
+}
+
+void Erode(const PackedBinaryImage& image, const StructuringElement& element, PackedBinaryImage& out,
+           MorphologyScratch& scratch) {
+  Apply<true>(image, element, out, scratch);
+}
+
+void Dilate(const PackedBinaryImage& image, const StructuringElement& element, PackedBinaryImage& out,
+            MorphologyScratch& scratch) {
+  Apply<false>(image, element, out, scratch);
+}
+
+void Open(PackedBinaryImage& image, const StructuringElement& element, MorphologyScratch& scratch) {
+  auto& eroded = scratch.temp[1];
+  Erode(image, element, eroded, scratch);
+  Dilate(eroded, element, image, scratch);
+}
+
+void Close(PackedBinaryImage& image, const StructuringElement& element, MorphologyScratch& scratch) {
+  auto& dilated = scratch.temp[1];
+  Dilate(image, element, dilated, scratch);
+  Erode(dilated, element, image, scratch);
+}
+
+void Despeckle(PackedBinaryImage& image, int size, MorphologyScratch& scratch) {
+  if (size <= 0 || image.width == 0 || image.height == 0) {
+    return;
+  }
+  auto& background = scratch.temp[0];
+  auto& run = scratch.temp[1];
+  auto& edge = scratch.temp[2];
+  auto& ring = scratch.temp[3];
+  auto& padded = scratch.padded_row;
+
+  Resize(background, image.width, image.height);
+  for (std::size_t i = 0; i < image.bits.size(); ++i) {
+    background.bits[i] = ~image.bits[i];
+  }
+  ClearTails(background);
+
+  // ring(x, y): the one-pixel frame around the size x size square whose top-left is (x, y) is all
+  // background. Pixels outside the image count as background.
+  HorizontalRange<true>(background, -1, size, run, padded);
+  VerticalRange<true>(run, -1, -1, ring);  // top edge
+  VerticalRange<true>(run, size, size, edge);  // bottom edge
+  for (std::size_t i = 0; i < ring.bits.size(); ++i) {
+    ring.bits[i] &= edge.bits[i];
+  }
+  VerticalRange<true>(background, -1, size, run);
+  HorizontalRange<true>(run, -1, -1, edge, padded);  // left edge
+  for (std::size_t i = 0; i < ring.bits.size(); ++i) {
+    ring.bits[i] &= edge.bits[i];
+  }
+  HorizontalRange<true>(run, size, size, edge, padded);  // right edge
+  for (std::size_t i = 0; i < ring.bits.size(); ++i) {
+    ring.bits[i] &= edge.bits[i];
+  }
+
+  // Clear every square with a clear frame: spread each anchor over its square.
+  HorizontalRange<false>(ring, -(size - 1), 0, run, padded);
+  VerticalRange<false>(run, -(size - 1), 0, edge);
+  for (std::size_t i = 0; i < image.bits.size(); ++i) {
+    image.bits[i] &= ~edge.bits[i];
+  }
+}
+
+CleanupOptions CleanupOptions::Parse(std::string_view spec) {
+  const auto fail = [spec] { throw std::invalid_argument("Invalid cleanup spec: " + std::string(spec)); };
+  const auto parse_int = [&fail](std::string_view text) {
+    if (text.empty() || text.size() > 4 || text.find_first_not_of("0123456789") != std::string_view::npos) {
+      fail();
+    }
+    return std::stoi(std::string(text));
+  };
+  CleanupOptions options;
+  std::size_t start = 0;
+  while (start <= spec.size()) {
+    const std::size_t end = std::min(spec.find(',', start), spec.size());
+    const std::string_view item = spec.substr(start, end - start);
+    start = end + 1;
+    if (item.empty()) {
+      continue;
+    }
+    const std::size_t equals = item.find('=');
+    if (equals == std::string_view::npos) {
+      fail();
+    }
+    const std::string_view name = item.substr(0, equals);
+    std::string_view value = item.substr(equals + 1);
+    if (name == "despeckle") {
+      options.despeckle_size = parse_int(value);
+      continue;
+    }
+    if (name != "open" && name != "close") {
+      fail();
+    }
+    StructuringElement element;
+    if (value.substr(0, 5) == "cross") {
+      element.shape = StructuringShape::kCross;
+      value.remove_prefix(5);
+    }
+    const std::size_t by = value.find('x');
+    element.radius_x = parse_int(value.substr(0, by));
+    element.radius_y = by == std::string_view::npos ? element.radius_x : parse_int(value.substr(by + 1));
+    (name == "open" ? options.opening : options.closing) = element;
+  }
+  return options;
+}
+
+void CleanupBinaryImage(BinaryImage& image, const CleanupOptions& options, MorphologyScratch& scratch) {
+  if (!options.Enabled() || image.Empty()) {
+    return;
+  }
+  auto& packed = scratch.image;
+  PackBinaryImage(image, packed);
+  if (!options.opening.Empty()) {
+    Open(packed, options.opening, scratch);
+  }
+  if (!options.closing.Empty()) {
+    Close(packed, options.closing, scratch);
+  }
+  Despeckle(packed, options.despeckle_size, scratch);
+  UnpackBinaryImage(packed, image);
+}
+
+}  // namespace falcon::core
@@ -1,40 +1,130 @@
 #include "falcon/core/Normalize.h"
 
 #include <algorithm>
-#include <cmath>
 #include <stdexcept>
 
 namespace falcon::core {
 
-GlyphBitmap NormalizeGlyph(const BinaryImage& image, const RectI& bounds) {
-  if (image.Empty() || bounds.width <= 0 || bounds.height <= 0) {
-    throw std::invalid_argument("NormalizeGlyph requires a valid component");
+namespace {
+
+template <int Size>
+using SampleTable = std::array<int, Size>;
+
+// Nearest-neighbour source coordinates for one axis of a box, letterboxed into a square of side
+// `max_dim`. Output cell i samples the source point origin - (max_dim - extent) / 2 +
+// (i + 0.5) * max_dim / Size, and the source pixel containing that point is its floor.
+// Multiplying through by 2 * Size keeps the whole computation in integers.
+template <int Size>
+void BuildSampleTable(int origin, int extent, int max_dim, int limit, SampleTable<Size>& table) {
+  constexpr int kDenominator = 2 * Size;
+  const int base = kDenominator * origin - Size * (max_dim - extent);
+  for (int i = 0; i < Size; ++i) {
+    const int fixed = base + (2 * i + 1) * max_dim;
+    const int coord = fixed < 0 ? 0 : fixed / kDenominator;
+    table[static_cast<std::size_t>(i)] = std::min(coord, limit - 1);
   }
+}
 
-  GlyphBitmap bitmap{};
+template <int Size>
+void NormalizeInto(const BinaryImage& image, const RectI& bounds, uint8_t* out) {
+  if (bounds.width <= 0 || bounds.height <= 0) {
+    throw std::invalid_argument("NormalizeGlyph requires a valid component");
+  }
 
   const int max_dim = std::max(bounds.width, bounds.height);
-  const float scale = static_cast<float>(max_dim) / static_cast<float>(kGlyphSize);
-  const float pad_x = static_cast<float>(max_dim - bounds.width) / 2.0f;
-  const float pad_y = static_cast<float>(max_dim - bounds.height) / 2.0f;
+  SampleTable<Size> xs{};
+  SampleTable<Size> ys{};
+  BuildSampleTable<Size>(bounds.x, bounds.width, max_dim, image.width, xs);
+  BuildSampleTable<Size>(bounds.y, bounds.height, max_dim, image.height, ys);
 
-  for (int y = 0; y < kGlyphSize; ++y) {
-    for (int x = 0; x < kGlyphSize; ++x) {
-      const float sample_x = static_cast<float>(bounds.x) - pad_x + (static_cast<float>(x) + 0.5f) * scale;
-      const float sample_y = static_cast<float>(bounds.y) - pad_y + (static_cast<float>(y) + 0.5f) * scale;
+  for (int y = 0; y < Size; ++y) {
+    const uint8_t* row = image.data.data() + static_cast<std::size_t>(ys[static_cast<std::size_t>(y)]) * image.width;
+    uint8_t* dst = out + static_cast<std::size_t>(y) * Size;
+    for (int x = 0; x < Size; ++x) {
+      dst[x] = row[xs[static_cast<std::size_t>(x)]] ? 255 : 0;
+    }
+  }
+}
 
-      int src_x = static_cast<int>(std::round(sample_x));
-      int src_y = static_cast<int>(std::round(sample_y));
+}  // namespace
 
-      src_x = std::clamp(src_x, 0, image.width - 1);
-      src_y = std::clamp(src_y, 0, image.height - 1);
+template <int Size>
+SizedGlyphBitmap<Size> NormalizeGlyph(const BinaryImage& image, const RectI& bounds) {
+  if (image.Empty()) {
+    throw std::invalid_argument("NormalizeGlyph requires a valid component");
+  }
 
-      const std::size_t src_idx = static_cast<std::size_t>(src_y) * image.width + src_x;
-      bitmap[static_cast<std::size_t>(y) * kGlyphSize + x] = image.data[src_idx] ? 255 : 0;
-    }
+  SizedGlyphBitmap<Size> bitmap{};
+  NormalizeInto<Size>(image, bounds, bitmap.data());
+  return bitmap;
+}
+
+template <int Size>
+void NormalizeGlyphs(const BinaryImage& image, const std::vector<ConnectedComponent>& components,
+                     SizedGlyphMatrix<Size>& out) {
+  if (image.Empty()) {
+    throw std::invalid_argument("NormalizeGlyphs requires a non-empty image");
+  }
+
+  out.count = components.size();
+  out.cells.resize(components.size() * kGlyphCellsOf<Size>);
+  NormalizeGlyphRange(image, components, 0, components.size(), out);
+}
+
+template <int Size>
+void NormalizeGlyphRange(const BinaryImage& image, const std::vector<ConnectedComponent>& components,
+                         std::size_t begin, std::size_t end, SizedGlyphMatrix<Size>& out) {
+  if (end > out.count || end > components.size() || begin > end) {
+    throw std::out_of_range("NormalizeGlyphRange outside of glyph matrix");
   }
+  for (std::size_t i = begin; i < end; ++i) {
+    NormalizeInto<Size>(image, components[i].bounds, out.cells.data() + i * kGlyphCellsOf<Size>);
+  }
+}
 
+template <int Size>
+SizedGlyphBitmap<Size> ResampleGlyph(const GlyphBitmap& source) {
+  SizedGlyphBitmap<Size> bitmap{};
+  if constexpr (Size == kGlyphSize) {
+    bitmap = source;
+  } else if constexpr (Size < kGlyphSize) {
+    static_assert(kGlyphSize % Size == 0, "Shrinking requires a whole reduction factor");
+    constexpr int kFactor = kGlyphSize / Size;
+    constexpr int kArea = kFactor * kFactor;
+    for (int y = 0; y < Size; ++y) {
+      for (int x = 0; x < Size; ++x) {
+        int sum = 0;
+        for (int dy = 0; dy < kFactor; ++dy) {
+          for (int dx = 0; dx < kFactor; ++dx) {
+            sum += source[static_cast<std::size_t>(y * kFactor + dy) * kGlyphSize + x * kFactor + dx];
+          }
+        }
+        bitmap[static_cast<std::size_t>(y) * Size + x] = static_cast<uint8_t>((sum + kArea / 2) / kArea);
+      }
+    }
+  } else {
+    static_assert(Size % kGlyphSize == 0, "Growing requires a whole replication factor");
+    constexpr int kFactor = Size / kGlyphSize;
+    for (int y = 0; y < Size; ++y) {
+      for (int x = 0; x < Size; ++x) {
+        bitmap[static_cast<std::size_t>(y) * Size + x] =
+            source[static_cast<std::size_t>(y / kFactor) * kGlyphSize + x / kFactor];
+      }
+    }
+  }
   return bitmap;
 }
 
+#define FALCON_INSTANTIATE_NORMALIZE(Size)                                                               \
+  template SizedGlyphBitmap<Size> NormalizeGlyph<Size>(const BinaryImage&, const RectI&);                \
+  template void NormalizeGlyphs<Size>(const BinaryImage&, const std::vector<ConnectedComponent>&,        \
+                                      SizedGlyphMatrix<Size>&);                                          \
+  template void NormalizeGlyphRange<Size>(const BinaryImage&, const std::vector<ConnectedComponent>&,    \
+                                          std::size_t, std::size_t, SizedGlyphMatrix<Size>&);            \
+  template SizedGlyphBitmap<Size> ResampleGlyph<Size>(const GlyphBitmap&);
+FALCON_INSTANTIATE_NORMALIZE(8)
+FALCON_INSTANTIATE_NORMALIZE(16)
+FALCON_INSTANTIATE_NORMALIZE(32)
+#undef FALCON_INSTANTIATE_NORMALIZE
+
 }  // namespace falcon::core
@@ -0,0 +1,258 @@
+#include "falcon/core/PackRegistry.h"
+
+#include <algorithm>
+#include <unordered_set>
+#include <utility>
+
+#include "falcon/util/ThreadPool.h"
+
+namespace falcon::core {
+
+namespace {
+
+PackHandle ParsePack(const std::string& language) {
+  auto pack = std::make_shared<LanguagePack>();
+  pack->language = language;
+  pack->templates = LoadLanguagePack(language);
+  pack->templates.shrink_to_fit();
+  return pack;
+}
+
+}  // namespace
+
+std::size_t LanguagePack::Bytes() const noexcept {
+  std::size_t total = sizeof(LanguagePack) + language.capacity() + templates.capacity() * sizeof(GlyphTemplate);
+  for (const auto& tmpl : templates) {
+    total += tmpl.language.capacity();
+  }
+  return total;
+}
+
+PackRegistry::PackRegistry(std::size_t memory_budget) : snapshot_(new Snapshot{}), budget_(memory_budget) {}
+
+PackRegistry::~PackRegistry() {
+  delete snapshot_.load();
+}
+
+PackRegistry& PackRegistry::Shared() {
+  static PackRegistry registry;
+  return registry;
+}
+
+PackHandle PackRegistry::Acquire(const std::string& language) {
+  {
+    const auto guard = epochs_.Pin();
+    const Snapshot* snapshot = snapshot_.load();
+    const auto it = snapshot->packs.find(language);
+    if (it != snapshot->packs.end()) {
+      it->second->last_use.store(clock_.fetch_add(1, std::memory_order_relaxed), std::memory_order_relaxed);
+      return it->second;
+    }
+  }
+  // Parse outside the lock; if another thread published the pack meanwhile, theirs wins.
+  PackHandle pack = ParsePack(language);
+  std::lock_guard<std::mutex> lock(writer_mutex_);
+  return PublishLocked(language, std::move(pack));
+}
+
+void PackRegistry::Reload(const std::string& language) {
+  {
+    const auto guard = epochs_.Pin();
+    if (snapshot_.load()->packs.count(language) == 0) {
+      return;
+    }
+  }
+  PackHandle pack = ParsePack(language);
+  pack->last_use.store(clock_.fetch_add(1, std::memory_order_relaxed), std::memory_order_relaxed);
+
+  std::lock_guard<std::mutex> lock(writer_mutex_);
+  const Snapshot* current = snapshot_.load();
+  const auto it = current->packs.find(language);
+  if (it == current->packs.end()) {
+    return;
+  }
+  auto next = std::make_unique<Snapshot>(*current);
+  resident_bytes_ = resident_bytes_ - it->second->Bytes() + pack->Bytes();
+  next->packs[language] = std::move(pack);
+  SwapLocked(std::move(next));
+  generation_.fetch_add(1, std::memory_order_acq_rel);
+  EvictLocked();
+}
+
+void PackRegistry::Invalidate() noexcept {
+  generation_.fetch_add(1, std::memory_order_acq_rel);
+}
+
+std::vector<std::string> PackRegistry::ResidentLanguages() const {
+  std::vector<std::string> languages;
+  {
+    const auto guard = epochs_.Pin();
+    for (const auto& [language, pack] : snapshot_.load()->packs) {
+      languages.push_back(language);
+    }
+  }
+  std::sort(languages.begin(), languages.end());
+  return languages;
+}
+
+void PackRegistry::Warm(const std::vector<std::string>& languages) {
+  std::vector<std::string> missing;
+  {
+    const auto guard = epochs_.Pin();
+    const Snapshot* snapshot = snapshot_.load();
+    std::unordered_set<std::string> queued;
+    for (const auto& language : languages) {
+      if (snapshot->packs.count(language) == 0 && queued.insert(language).second) {
+        missing.push_back(language);
+      }
+    }
+  }
+  if (missing.empty()) {
+    return;
+  }
+  std::vector<PackHandle> parsed(missing.size());
+  falcon::util::ThreadPool::Shared().ParallelFor(missing.size(),
+                                                 [&](std::size_t i) { parsed[i] = ParsePack(missing[i]); });
+  std::lock_guard<std::mutex> lock(writer_mutex_);
+  for (std::size_t i = 0; i < missing.size(); ++i) {
+    PublishLocked(missing[i], std::move(parsed[i]));
+  }
+}
+
+std::vector<GlyphTemplate> PackRegistry::Collect(const std::vector<std::string>& languages,
+                                                 bool include_ascii_fallback) {
+  std::vector<PackHandle> packs;
+  const auto selected = Select(languages, include_ascii_fallback, packs);
+  std::vector<GlyphTemplate> templates;
+  templates.reserve(selected.size());
+  for (const GlyphTemplate* tmpl : selected) {
+    templates.push_back(*tmpl);
+  }
+  return templates;
+}
+
+std::vector<const GlyphTemplate*> PackRegistry::Select(const std::vector<std::string>& languages,
+                                                       bool include_ascii_fallback, std::vector<PackHandle>& packs) {
+  std::vector<const GlyphTemplate*> templates;
+  if (include_ascii_fallback) {
+    for (const auto& tmpl : BuiltInGlyphTemplates()) {
+      templates.push_back(&tmpl);
+    }
+  }
+
+  const std::vector<std::string> names = languages.empty() ? DiscoverLanguagePacks() : languages;
+  if (names.empty()) {
+    return templates;
+  }
+  Warm(names);
+
+  std::unordered_set<char32_t> seen;
+  for (const GlyphTemplate* tmpl : templates) {
+    seen.insert(tmpl->codepoint);
+  }
+  // A codepoint supplied by an earlier source shadows later packs, but a pack may carry several
+  // variants (fonts) of the same codepoint.
+  std::unordered_set<char32_t> added;
+  for (const std::string& language : names) {
+    packs.push_back(Acquire(language));
+    for (const auto& tmpl : packs.back()->templates) {
+      if (seen.count(tmpl.codepoint) == 0) {
+        added.insert(tmpl.codepoint);
+        templates.push_back(&tmpl);
+      }
+    }
+    seen.insert(added.begin(), added.end());
+    added.clear();
+  }
+  return templates;
+}
+
+void PackRegistry::SetMemoryBudget(std::size_t bytes) {
+  std::lock_guard<std::mutex> lock(writer_mutex_);
+  budget_ = bytes;
+  EvictLocked();
+}
+
+std::size_t PackRegistry::MemoryBudget() const {
+  std::lock_guard<std::mutex> lock(writer_mutex_);
+  return budget_;
+}
+
+std::size_t PackRegistry::ResidentBytes() const {
+  std::lock_guard<std::mutex> lock(writer_mutex_);
+  return resident_bytes_;
+}
+
+std::size_t PackRegistry::ResidentPacks() const {
+  std::lock_guard<std::mutex> lock(writer_mutex_);
+  return snapshot_.load()->packs.size();
+}
+
+void PackRegistry::Clear() {
+  std::lock_guard<std::mutex> lock(writer_mutex_);
+  const std::size_t budget = budget_;
+  budget_ = 0;
+  EvictLocked();
+  budget_ = budget;
+}
+
+PackHandle PackRegistry::PublishLocked(const std::string& language, PackHandle pack) {
+  const Snapshot* current = snapshot_.load();
+  const auto it = current->packs.find(language);
+  if (it != current->packs.end()) {
+    it->second->last_use.store(clock_.fetch_add(1, std::memory_order_relaxed), std::memory_order_relaxed);
+    return it->second;
+  }
+  pack->last_use.store(clock_.fetch_add(1, std::memory_order_relaxed), std::memory_order_relaxed);
+  auto next = std::make_unique<Snapshot>(*current);
+  next->packs.emplace(language, pack);
+  resident_bytes_ += pack->Bytes();
+  SwapLocked(std::move(next));
+  EvictLocked();
+  return pack;
+}
+
+void PackRegistry::SwapLocked(std::unique_ptr<Snapshot> next) {
+  const Snapshot* previous = snapshot_.exchange(next.release());
+  epochs_.Retire(previous);
+}
+
+void PackRegistry::EvictLocked() {
+  if (resident_bytes_ <= budget_) {
+    return;
+  }
+  // Retired snapshots still count towards a pack's use_count until reclaimed.
+  epochs_.Reclaim();
+
+  const Snapshot* current = snapshot_.load();
+  std::vector<const std::pair<const std::string, PackHandle>*> coldest;
+  for (const auto& entry : current->packs) {
+    coldest.push_back(&entry);
+  }
+  std::sort(coldest.begin(), coldest.end(), [](const auto* a, const auto* b) {
+    return a->second->last_use.load(std::memory_order_relaxed) < b->second->last_use.load(std::memory_order_relaxed);
+  });
+
+  std::vector<std::string> victims;
+  for (const auto* entry : coldest) {
+    if (resident_bytes_ <= budget_) {
+      break;
+    }
+    // Packs still held by callers are skipped; evicting them would not free memory.
+    if (entry->second.use_count() > 1) {
+      continue;
+    }
+    resident_bytes_ -= entry->second->Bytes();
+    victims.push_back(entry->first);
+  }
+  if (victims.empty()) {
+    return;
+  }
+  auto next = std::make_unique<Snapshot>(*current);
+  for (const auto& language : victims) {
+    next->packs.erase(language);
+  }
+  SwapLocked(std::move(next));
+}
+
+}  // namespace falcon::core
@@ -0,0 +1,201 @@
+#include "falcon/core/PackWatcher.h"
+
+#include <algorithm>
+#include <array>
+#include <climits>
+#include <cstdint>
+#include <system_error>
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace falcon::core {
+
+namespace {
+
+constexpr std::chrono::milliseconds kSettleDelay{50};
+
+// Path, size and modification time of every file a pack is loaded from.
+std::string PackSignature(const std::vector<std::filesystem::path>& roots, const std::string& language) {
+  std::string signature;
+  std::error_code error;
+  const auto append = [&](const std::filesystem::path& file) {
+    const auto size = std::filesystem::file_size(file, error);
+    const auto time = std::filesystem::last_write_time(file, error);
+    signature += file.string();
+    signature += ':';
+    signature += std::to_string(error ? 0 : size);
+    signature += ':';
+    signature += std::to_string(error ? 0 : time.time_since_epoch().count());
+    signature += ';';
+  };
+
+  for (const auto& root : roots) {
+    const auto directory = root / language;
+    if (!std::filesystem::is_directory(directory, error)) {
+      continue;
+    }
+    std::vector<std::filesystem::path> files;
+    for (const auto& entry : std::filesystem::directory_iterator(directory, error)) {
+      if (entry.is_regular_file(error) && entry.path().extension() == ".txt") {
+        files.push_back(entry.path());
+      }
+    }
+    std::sort(files.begin(), files.end());
+    for (const auto& file : files) {
+      append(file);
+    }
+  }
+  if (signature.empty() && std::filesystem::is_regular_file(language, error)) {
+    append(language);
+  }
+  return signature;
+}
+
+}  // namespace
+
+PackWatcher::PackWatcher(PackRegistry& registry, std::chrono::milliseconds interval)
+    : registry_(registry), interval_(interval) {}
+
+PackWatcher::~PackWatcher() {
+  Stop();
+}
+
+void PackWatcher::Start() {
+  if (thread_.joinable()) {
+    return;
+  }
+  Poll();
+  stopping_ = false;
+  rewatch_ = true;
+#ifdef __linux__
+  wake_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+#endif
+  thread_ = std::thread([this] { Run(); });
+}
+
+void PackWatcher::Stop() {
+  if (!thread_.joinable()) {
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock(wake_mutex_);
+    stopping_ = true;
+  }
+  wake_.notify_all();
+#ifdef __linux__
+  if (wake_fd_ >= 0) {
+    const uint64_t one = 1;
+    [[maybe_unused]] const auto written = write(wake_fd_, &one, sizeof(one));
+  }
+#endif
+  thread_.join();
+#ifdef __linux__
+  for (int* fd : {&notify_fd_, &wake_fd_}) {
+    if (*fd >= 0) {
+      close(*fd);
+      *fd = -1;
+    }
+  }
+#endif
+}
+
+std::size_t PackWatcher::Poll() {
+  std::lock_guard<std::mutex> lock(poll_mutex_);
+  auto roots = LanguagePackRoots();
+  auto discovered = DiscoverLanguagePacks();
+  if (scanned_ && (roots != roots_ || discovered != discovered_)) {
+    // New or removed pack directories change what automatic language selection merges.
+    registry_.Invalidate();
+    rewatch_ = true;
+  }
+  roots_ = std::move(roots);
+  discovered_ = std::move(discovered);
+  scanned_ = true;
+
+  std::size_t reloaded = 0;
+  for (const auto& language : registry_.ResidentLanguages()) {
+    std::string signature = PackSignature(roots_, language);
+    const auto it = signatures_.find(language);
+    if (it == signatures_.end()) {
+      signatures_.emplace(language, std::move(signature));
+    } else if (it->second != signature) {
+      registry_.Reload(language);
+      it->second = std::move(signature);
+      ++reloaded;
+    }
+  }
+  return reloaded;
+}
+
+void PackWatcher::Run() {
+  while (!stopping_) {
+    if (rewatch_.exchange(false)) {
+      Rewatch();
+    }
+    if (WaitForChange()) {
+      Poll();
+    }
+  }
+}
+
+void PackWatcher::Rewatch() {
+#ifdef __linux__
+  if (notify_fd_ >= 0) {
+    close(notify_fd_);
+  }
+  notify_fd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if (notify_fd_ < 0) {
+    return;
+  }
+  constexpr uint32_t kMask = IN_CLOSE_WRITE | IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_ATTRIB;
+  std::vector<std::filesystem::path> roots;
+  std::vector<std::string> languages;
+  {
+    std::lock_guard<std::mutex> lock(poll_mutex_);
+    roots = roots_;
+    languages = discovered_;
+  }
+  std::error_code error;
+  for (const auto& root : roots) {
+    inotify_add_watch(notify_fd_, root.c_str(), kMask);
+    for (const auto& language : languages) {
+      const auto directory = root / language;
+      if (std::filesystem::is_directory(directory, error)) {
+        inotify_add_watch(notify_fd_, directory.c_str(), kMask);
+      }
+    }
+  }
+#endif
+}
+
+// Returns true when pack files may have changed: an inotify event arrived, or the poll interval
+// elapsed. Returns false when stopping.
+bool PackWatcher::WaitForChange() {
+#ifdef __linux__
+  if (wake_fd_ >= 0) {
+    const auto timeout = static_cast<int>(std::min<std::chrono::milliseconds::rep>(interval_.count(), INT_MAX));
+    std::array<pollfd, 2> descriptors{{{wake_fd_, POLLIN, 0}, {notify_fd_, POLLIN, 0}}};
+    const nfds_t count = notify_fd_ >= 0 ? 2 : 1;
+    if (poll(descriptors.data(), count, timeout) > 0 && count == 2 && (descriptors[1].revents & POLLIN) != 0) {
+      // Let a burst of writes settle, then drain the queue; Poll() works out what changed.
+      if (poll(descriptors.data(), 1, static_cast<int>(kSettleDelay.count())) > 0) {
+        return false;
+      }
+      alignas(inotify_event) char buffer[4096];
+      while (read(notify_fd_, buffer, sizeof(buffer)) > 0) {
+      }
+    }
+    return !stopping_;
+  }
+#endif
+  std::unique_lock<std::mutex> lock(wake_mutex_);
+  wake_.wait_for(lock, interval_, [this] { return stopping_.load(); });
+  return !stopping_;
+}
+
+}  // namespace falcon::core
@@ -1,18 +1,139 @@
 #include "falcon/core/Segment.h"
 
+#include <algorithm>
 #include <array>
-#include <queue>
+#include <numeric>
 #include <stdexcept>
 
+#include "falcon/util/ThreadPool.h"
+#include "falcon/util/Trace.h"
+
 namespace falcon::core {
 
+namespace {
+
+// Worker-local labeling buffers for one tile.
+struct TileLabels {
+  std::vector<int32_t> labels;
+  std::vector<PointI> queue;
+};
+
+void ExtendBounds(RectI& bounds, PointI point) {
+  if (point.x < bounds.x) {
+    bounds.width += bounds.x - point.x;
+    bounds.x = point.x;
+  }
+  if (point.y < bounds.y) {
+    bounds.height += bounds.y - point.y;
+    bounds.y = point.y;
+  }
+  if (point.x >= bounds.x + bounds.width) {
+    bounds.width = point.x - bounds.x + 1;
+  }
+  if (point.y >= bounds.y + bounds.height) {
+    bounds.height = point.y - bounds.y + 1;
+  }
+}
+
+// Labels the ink of `image` inside `rect` as if nothing existed outside it.
+void LabelTile(const BinaryImage& image, const RectI& rect, TileLabels& scratch, TiledSegmentScratch::Tile& tile) {
+  auto& labels = scratch.labels;
+  auto& queue = scratch.queue;
+  labels.assign(static_cast<std::size_t>(rect.width) * rect.height, -1);
+  tile.components.clear();
+  tile.seeds.clear();
+  const auto local = [&rect](int x, int y) {
+    return static_cast<std::size_t>(y - rect.y) * rect.width + (x - rect.x);
+  };
+  const auto ink = [&image](int x, int y) { return image.data[static_cast<std::size_t>(y) * image.width + x] != 0; };
+
+  for (int y = rect.y; y < rect.Bottom(); ++y) {
+    for (int x = rect.x; x < rect.Right(); ++x) {
+      if (labels[local(x, y)] >= 0 || !ink(x, y)) {
+        continue;
+      }
+      const auto id = static_cast<int32_t>(tile.components.size());
+      ConnectedComponent component;
+      component.bounds = RectI{x, y, 1, 1};
+      queue.clear();
+      queue.push_back(PointI{x, y});
+      labels[local(x, y)] = id;
+      for (std::size_t head = 0; head < queue.size(); ++head) {
+        const PointI current = queue[head];
+        ++component.area;
+        ExtendBounds(component.bounds, current);
+        const std::array<PointI, 4> neighbors{{
+            PointI{current.x - 1, current.y},
+            PointI{current.x + 1, current.y},
+            PointI{current.x, current.y - 1},
+            PointI{current.x, current.y + 1},
+        }};
+        for (const PointI& nb : neighbors) {
+          if (nb.x < rect.x || nb.x >= rect.Right() || nb.y < rect.y || nb.y >= rect.Bottom()) {
+            continue;
+          }
+          auto& label = labels[local(nb.x, nb.y)];
+          if (label >= 0 || !ink(nb.x, nb.y)) {
+            continue;
+          }
+          label = id;
+          queue.push_back(nb);
+        }
+      }
+      tile.components.push_back(component);
+      tile.seeds.push_back(PointI{x, y});
+    }
+  }
+
+  tile.top.assign(labels.begin(), labels.begin() + rect.width);
+  tile.bottom.assign(labels.end() - rect.width, labels.end());
+  tile.left.resize(static_cast<std::size_t>(rect.height));
+  tile.right.resize(static_cast<std::size_t>(rect.height));
+  for (int y = 0; y < rect.height; ++y) {
+    tile.left[static_cast<std::size_t>(y)] = labels[static_cast<std::size_t>(y) * rect.width];
+    tile.right[static_cast<std::size_t>(y)] = labels[static_cast<std::size_t>(y) * rect.width + rect.width - 1];
+  }
+}
+
+uint32_t FindRoot(std::vector<uint32_t>& parent, uint32_t node) {
+  while (parent[node] != node) {
+    parent[node] = parent[parent[node]];
+    node = parent[node];
+  }
+  return node;
+}
+
+void Unite(std::vector<uint32_t>& parent, uint32_t a, uint32_t b) {
+  a = FindRoot(parent, a);
+  b = FindRoot(parent, b);
+  if (a != b) {
+    parent[std::max(a, b)] = std::min(a, b);
+  }
+}
+
+bool ScanOrderLess(PointI a, PointI b) {
+  return a.y != b.y ? a.y < b.y : a.x < b.x;
+}
+
+}  // namespace
+
 std::vector<ConnectedComponent> ConnectedComponents(const BinaryImage& image) {
+  SegmentScratch scratch;
+  std::vector<ConnectedComponent> components;
+  ConnectedComponents(image, scratch, components);
+  return components;
+}
+
+void ConnectedComponents(const BinaryImage& image, SegmentScratch& scratch,
+                         std::vector<ConnectedComponent>& components) {
   if (image.Empty()) {
     throw std::invalid_argument("ConnectedComponents requires non-empty image");
   }
 
-  std::vector<uint8_t> visited(image.data.size(), 0);
-  std::vector<ConnectedComponent> components;
+  std::vector<uint8_t>& visited = scratch.visited;
+  visited.assign(image.data.size(), 0);
+  std::vector<PointI>& queue = scratch.queue;
+  components.clear();
   int label = 1;
 
   const auto index = [&image](int x, int y) {
@@ -31,13 +152,13 @@ std::vector<ConnectedComponent> ConnectedComponents(const BinaryImage& image) {
       component.bounds = RectI{x, y, 1, 1};
       component.area = 0;
 
-      std::queue<PointI> queue;
-      queue.push(PointI{x, y});
+      // FIFO over a flat buffer; entries are never popped, so the head index walks forward.
+      queue.clear();
+      queue.push_back(PointI{x, y});
       visited[idx] = 1;
 
-      while (!queue.empty()) {
-        const PointI current = queue.front();
-        queue.pop();
+      for (std::size_t head = 0; head < queue.size(); ++head) {
+        const PointI current = queue[head];
         ++component.area;
 
         if (current.x < component.bounds.x) {
@@ -71,15 +192,110 @@ std::vector<ConnectedComponent> ConnectedComponents(const BinaryImage& image) {
             continue;
           }
           visited[nb_idx] = 1;
-          queue.push(nb);
+          queue.push_back(nb);
         }
       }
 
       components.push_back(component);
     }
   }
+}
 
-  return components;
+void ConnectedComponentsTiled(const BinaryImage& image, int tile_size, TiledSegmentScratch& scratch,
+                              std::vector<ConnectedComponent>& components) {
+  if (image.Empty()) {
+    throw std::invalid_argument("ConnectedComponentsTiled requires non-empty image");
+  }
+  if (tile_size <= 0) {
+    throw std::invalid_argument("ConnectedComponentsTiled requires a positive tile size");
+  }
+
+  const int columns = (image.width + tile_size - 1) / tile_size;
+  const int rows = (image.height + tile_size - 1) / tile_size;
+  const auto tile_rect = [&](std::size_t t) {
+    const int x = static_cast<int>(t % static_cast<std::size_t>(columns)) * tile_size;
+    const int y = static_cast<int>(t / static_cast<std::size_t>(columns)) * tile_size;
+    return RectI{x, y, std::min(tile_size, image.width - x), std::min(tile_size, image.height - y)};
+  };
+  auto& tiles = scratch.tiles;
+  tiles.resize(static_cast<std::size_t>(columns) * rows);
+  falcon::util::ThreadPool::Shared().ParallelFor(tiles.size(), [&](std::size_t t) {
+    FALCON_TRACE_SCOPE("segment.tile");
+    thread_local TileLabels labels;
+    LabelTile(image, tile_rect(t), labels, tiles[t]);
+  });
+
+  // Global ids are tile-major; union-find joins pixels that touch across a tile edge.
+  auto& offsets = scratch.offsets;
+  offsets.assign(tiles.size() + 1, 0);
+  for (std::size_t t = 0; t < tiles.size(); ++t) {
+    offsets[t + 1] = offsets[t] + tiles[t].components.size();
+  }
+  auto& parent = scratch.parent;
+  parent.resize(offsets.back());
+  std::iota(parent.begin(), parent.end(), 0u);
+  const auto join = [&](std::size_t tile_a, const std::vector<int32_t>& edge_a, std::size_t tile_b,
+                        const std::vector<int32_t>& edge_b) {
+    for (std::size_t i = 0; i < edge_a.size(); ++i) {
+      if (edge_a[i] >= 0 && edge_b[i] >= 0) {
+        Unite(parent, static_cast<uint32_t>(offsets[tile_a] + static_cast<std::size_t>(edge_a[i])),
+              static_cast<uint32_t>(offsets[tile_b] + static_cast<std::size_t>(edge_b[i])));
+      }
+    }
+  };
+  for (int row = 0; row < rows; ++row) {
+    for (int column = 0; column < columns; ++column) {
+      const auto t = static_cast<std::size_t>(row) * columns + column;
+      if (column + 1 < columns) {
+        join(t, tiles[t].right, t + 1, tiles[t + 1].left);
+      }
+      if (row + 1 < rows) {
+        join(t, tiles[t].bottom, t + columns, tiles[t + columns].top);
+      }
+    }
+  }
+
+  // Fold every piece into its root, then order roots by their first pixel in scan order, which is
+  // the order (and labeling) of the whole-image pass.
+  auto& merged = scratch.merged;
+  auto& seeds = scratch.merged_seeds;
+  auto& roots = scratch.roots;
+  merged.resize(parent.size());
+  seeds.resize(parent.size());
+  roots.clear();
+  for (std::size_t t = 0; t < tiles.size(); ++t) {
+    for (std::size_t i = 0; i < tiles[t].components.size(); ++i) {
+      const auto id = static_cast<uint32_t>(offsets[t] + i);
+      const auto root = FindRoot(parent, id);
+      const auto& piece = tiles[t].components[i];
+      if (root == id) {
+        roots.push_back(id);
+        merged[id] = piece;
+        seeds[id] = tiles[t].seeds[i];
+        continue;
+      }
+      // Roots have the smallest id of their set, so the root was already initialized.
+      auto& target = merged[root];
+      const int right = std::max(target.bounds.Right(), piece.bounds.Right());
+      const int bottom = std::max(target.bounds.Bottom(), piece.bounds.Bottom());
+      target.bounds.x = std::min(target.bounds.x, piece.bounds.x);
+      target.bounds.y = std::min(target.bounds.y, piece.bounds.y);
+      target.bounds.width = right - target.bounds.x;
+      target.bounds.height = bottom - target.bounds.y;
+      target.area += piece.area;
+      if (ScanOrderLess(tiles[t].seeds[i], seeds[root])) {
+        seeds[root] = tiles[t].seeds[i];
+      }
+    }
+  }
+  std::sort(roots.begin(), roots.end(), [&seeds](uint32_t a, uint32_t b) { return ScanOrderLess(seeds[a], seeds[b]); });
+
+  components.clear();
+  components.reserve(roots.size());
+  for (const auto root : roots) {
+    components.push_back(merged[root]);
+    components.back().label = static_cast<int>(components.size());
+  }
 }
 
 }  // namespace falcon::core
@@ -0,0 +1,228 @@
+#include "falcon/core/TemplateReduction.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <unordered_map>
+
+#include "falcon/core/Classifier.h"
+
+namespace falcon::core {
+
+namespace {
+
+uint32_t Distance(const GlyphBitmap& lhs, const GlyphBitmap& rhs) {
+  return GlyphDistance<kGlyphSize>(lhs.data(), rhs.data());
+}
+
+// Index of the nearest kept template (earliest on ties, like ClassifyGlyph), or templates.size().
+std::size_t Nearest(const GlyphBitmap& glyph, const std::vector<GlyphTemplate>& templates,
+                    const std::vector<bool>& kept) {
+  std::size_t best = templates.size();
+  uint32_t best_distance = std::numeric_limits<uint32_t>::max();
+  for (std::size_t i = 0; i < templates.size(); ++i) {
+    if (!kept[i]) {
+      continue;
+    }
+    const uint32_t distance = Distance(glyph, templates[i].bitmap);
+    if (distance < best_distance) {
+      best_distance = distance;
+      best = i;
+    }
+  }
+  return best;
+}
+
+bool Matches(const GlyphTemplate& sample, const std::vector<GlyphTemplate>& templates, const std::vector<bool>& kept) {
+  const std::size_t nearest = Nearest(sample.bitmap, templates, kept);
+  return nearest < templates.size() && templates[nearest].codepoint == sample.codepoint;
+}
+
+double Accuracy(const std::vector<GlyphTemplate>& templates, const std::vector<bool>& kept,
+                const std::vector<GlyphTemplate>& validation) {
+  if (validation.empty()) {
+    return 1.0;
+  }
+  std::size_t correct = 0;
+  for (const GlyphTemplate& sample : validation) {
+    correct += Matches(sample, templates, kept) ? 1 : 0;
+  }
+  return static_cast<double>(correct) / static_cast<double>(validation.size());
+}
+
+// Clusters one codepoint's templates: leader clustering at `merge_distance`, then k-medoids
+// refinement with k fixed. Records each member's medoid in `medoid_of` and returns the medoids,
+// largest cluster first.
+std::vector<std::size_t> ClusterMedoids(const std::vector<GlyphTemplate>& templates,
+                                        const std::vector<std::size_t>& members, uint32_t merge_distance,
+                                        int iterations, std::vector<std::size_t>& medoid_of) {
+  std::vector<std::size_t> medoids;
+  std::vector<std::size_t> assignment(members.size());
+  const auto assign_nearest = [&](std::size_t m) {
+    std::size_t best = 0;
+    uint32_t best_distance = std::numeric_limits<uint32_t>::max();
+    for (std::size_t c = 0; c < medoids.size(); ++c) {
+      const uint32_t distance = Distance(templates[members[m]].bitmap, templates[medoids[c]].bitmap);
+      if (distance < best_distance) {
+        best_distance = distance;
+        best = c;
+      }
+    }
+    return std::make_pair(best, best_distance);
+  };
+
+  for (std::size_t m = 0; m < members.size(); ++m) {
+    const auto [cluster, distance] = assign_nearest(m);
+    if (medoids.empty() || distance > merge_distance) {
+      assignment[m] = medoids.size();
+      medoids.push_back(members[m]);
+    } else {
+      assignment[m] = cluster;
+    }
+  }
+
+  for (int iteration = 0; iteration < iterations; ++iteration) {
+    bool changed = false;
+    for (std::size_t c = 0; c < medoids.size(); ++c) {
+      uint64_t best_cost = std::numeric_limits<uint64_t>::max();
+      for (std::size_t m = 0; m < members.size(); ++m) {
+        if (assignment[m] != c) {
+          continue;
+        }
+        uint64_t cost = 0;
+        for (std::size_t other = 0; other < members.size(); ++other) {
+          if (assignment[other] == c) {
+            cost += Distance(templates[members[m]].bitmap, templates[members[other]].bitmap);
+          }
+        }
+        if (cost < best_cost) {
+          best_cost = cost;
+          changed = changed || medoids[c] != members[m];
+          medoids[c] = members[m];
+        }
+      }
+    }
+    for (std::size_t m = 0; m < members.size(); ++m) {
+      const std::size_t cluster = assign_nearest(m).first;
+      changed = changed || assignment[m] != cluster;
+      assignment[m] = cluster;
+    }
+    if (!changed) {
+      break;
+    }
+  }
+
+  std::vector<std::size_t> sizes(medoids.size(), 0);
+  for (std::size_t m = 0; m < members.size(); ++m) {
+    ++sizes[assignment[m]];
+    medoid_of[members[m]] = medoids[assignment[m]];
+  }
+  std::vector<std::size_t> order(medoids.size());
+  for (std::size_t c = 0; c < order.size(); ++c) {
+    order[c] = c;
+  }
+  std::stable_sort(order.begin(), order.end(), [&](std::size_t a, std::size_t b) { return sizes[a] > sizes[b]; });
+  std::vector<std::size_t> result;
+  for (std::size_t c : order) {
+    if (sizes[c] > 0) {
+      result.push_back(medoids[c]);
+    }
+  }
+  return result;
+}
+
+}  // namespace
+
+double MeasureAccuracy(const std::vector<GlyphTemplate>& templates, const std::vector<GlyphTemplate>& validation) {
+  return Accuracy(templates, std::vector<bool>(templates.size(), true), validation);
+}
+
+std::vector<GlyphTemplate> ReduceTemplates(const std::vector<GlyphTemplate>& templates,
+                                           const std::vector<GlyphTemplate>& validation,
+                                           const TemplateReductionOptions& options,
+                                           TemplateReductionReport* report) {
+  const std::vector<GlyphTemplate>& samples = validation.empty() ? templates : validation;
+  const uint32_t merge_distance = static_cast<uint32_t>(std::max(options.merge_pixels, 0)) * 255U;
+
+  std::unordered_map<char32_t, std::size_t> group_of;
+  std::vector<std::vector<std::size_t>> groups;
+  for (std::size_t i = 0; i < templates.size(); ++i) {
+    const auto [it, inserted] = group_of.emplace(templates[i].codepoint, groups.size());
+    if (inserted) {
+      groups.emplace_back();
+    }
+    groups[it->second].push_back(i);
+  }
+
+  // Seed with the medoid of each codepoint's largest cluster.
+  std::vector<std::size_t> medoid_of(templates.size());
+  std::vector<bool> kept(templates.size(), false);
+  for (const auto& members : groups) {
+    const auto medoids = ClusterMedoids(templates, members, merge_distance, options.medoid_iterations, medoid_of);
+    kept[medoids.front()] = true;
+  }
+
+  // Condensed nearest neighbour: add a prototype only where the current set picks the wrong
+  // codepoint, preferring the medoid of the misclassified template's cluster.
+  for (bool changed = true; changed;) {
+    changed = false;
+    for (std::size_t i = 0; i < templates.size(); ++i) {
+      if (Matches(templates[i], templates, kept)) {
+        continue;
+      }
+      const std::size_t candidate = kept[medoid_of[i]] ? i : medoid_of[i];
+      if (!kept[candidate]) {
+        kept[candidate] = true;
+        changed = true;
+      }
+    }
+  }
+
+  // Restore prototypes for misclassified validation samples until within tolerance.
+  const double full_accuracy = Accuracy(templates, std::vector<bool>(templates.size(), true), samples);
+  double reduced_accuracy = Accuracy(templates, kept, samples);
+  while (reduced_accuracy < full_accuracy - options.accuracy_tolerance) {
+    bool added = false;
+    for (const GlyphTemplate& sample : samples) {
+      if (Matches(sample, templates, kept)) {
+        continue;
+      }
+      std::size_t best = templates.size();
+      uint32_t best_distance = std::numeric_limits<uint32_t>::max();
+      for (std::size_t i = 0; i < templates.size(); ++i) {
+        if (kept[i] || templates[i].codepoint != sample.codepoint) {
+          continue;
+        }
+        const uint32_t distance = Distance(sample.bitmap, templates[i].bitmap);
+        if (distance < best_distance) {
+          best_distance = distance;
+          best = i;
+        }
+      }
+      if (best < templates.size()) {
+        kept[best] = true;
+        added = true;
+      }
+    }
+    if (!added) {
+      break;
+    }
+    reduced_accuracy = Accuracy(templates, kept, samples);
+  }
+
+  std::vector<GlyphTemplate> reduced;
+  for (std::size_t i = 0; i < templates.size(); ++i) {
+    if (kept[i]) {
+      reduced.push_back(templates[i]);
+    }
+  }
+  if (report != nullptr) {
+    report->input_count = templates.size();
+    report->output_count = reduced.size();
+    report->full_accuracy = full_accuracy;
+    report->reduced_accuracy = reduced_accuracy;
+  }
+  return reduced;
+}
+
+}  // namespace falcon::core
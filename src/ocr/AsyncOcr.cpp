@@ -0,0 +1,118 @@
+#include "falcon/ocr/AsyncOcr.h"
+
+#include <memory>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "falcon/ocr/Pipeline.h"
+#include "falcon/util/BoundedQueue.h"
+#include "falcon/util/ThreadPool.h"
+#include "falcon/util/Trace.h"
+
+namespace falcon::ocr {
+
+namespace {
+
+constexpr std::size_t kAsyncWorkers = 2;
+constexpr std::size_t kMaxQueuedPages = 1024;
+
+// One submitted page and where its outcome goes.
+struct AsyncJob {
+  falcon::core::Raster raster;
+  OcrOptions options;
+  std::function<void(const OcrPage&, std::exception_ptr)> on_complete;
+  std::shared_ptr<OcrControl> control;
+  std::promise<OcrPage> promise;
+
+  void Finish(OcrPage page, std::exception_ptr error) {
+    if (on_complete) {
+      on_complete(page, error);
+    }
+    if (error) {
+      promise.set_exception(error);
+    } else {
+      promise.set_value(std::move(page));
+    }
+  }
+
+  void Run() {
+    OcrPage page;
+    std::exception_ptr error;
+    if (const auto status = control->Check(); status != OcrStatus::kComplete) {
+      // Cancelled or expired while queued.
+      page.image_size = raster.Size();
+      page.status = status;
+    } else {
+      try {
+        page = RunOcr(raster, options, *control);
+      } catch (...) {
+        error = std::current_exception();
+      }
+    }
+    Finish(std::move(page), error);
+  }
+};
+
+class AsyncExecutor {
+ public:
+  AsyncExecutor() : queue_(kMaxQueuedPages) {
+    // Constructing the pool first makes it outlive this executor at exit, so pages still queued
+    // then can finish.
+    falcon::util::ThreadPool::Shared();
+    for (std::size_t i = 0; i < kAsyncWorkers; ++i) {
+      workers_.emplace_back([this] {
+        falcon::util::Tracer::SetThreadName("async ocr");
+        std::unique_ptr<AsyncJob> job;
+        while (queue_.Pop(job)) {
+          job->Run();
+        }
+      });
+    }
+  }
+
+  ~AsyncExecutor() {
+    queue_.Close();
+    for (auto& worker : workers_) {
+      worker.join();
+    }
+  }
+
+  static AsyncExecutor& Shared() {
+    static AsyncExecutor executor;
+    return executor;
+  }
+
+  // False, keeping `job`, when kMaxQueuedPages pages are already waiting.
+  bool TrySubmit(std::unique_ptr<AsyncJob>& job) { return queue_.TryPush(job); }
+
+ private:
+  falcon::util::BoundedQueue<std::unique_ptr<AsyncJob>> queue_;
+  std::vector<std::thread> workers_;
+};
+
+}  // namespace
+
+OcrTask RunOcrAsync(falcon::core::Raster raster, OcrOptions options, AsyncOcrOptions async) {
+  OcrTask task;
+  task.control = std::make_shared<OcrControl>();
+  if (async.timeout.count() > 0) {
+    task.control->SetTimeout(async.timeout);
+  }
+  if (async.on_progress) {
+    task.control->SetProgressCallback(std::move(async.on_progress));
+  }
+  auto job = std::make_unique<AsyncJob>();
+  job->raster = std::move(raster);
+  job->options = std::move(options);
+  job->on_complete = std::move(async.on_complete);
+  job->control = task.control;
+  task.result = job->promise.get_future();
+
+  if (!AsyncExecutor::Shared().TrySubmit(job)) {
+    job->Finish({}, std::make_exception_ptr(AsyncQueueFullError("Too many pages are waiting for asynchronous OCR")));
+  }
+  return task;
+}
+
+}  // namespace falcon::ocr
@@ -0,0 +1,230 @@
+#include "falcon/ocr/CompactPage.h"
+
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+
+#include "falcon/util/String.h"
+
+namespace falcon::ocr {
+
+namespace {
+
+constexpr uint32_t kMagic = 0x50434F46;  // "FOCP" in little-endian order
+constexpr uint32_t kByteOrderMark = 0x01020304;
+constexpr uint32_t kVersion = 1;
+constexpr uint32_t kWideBoxesFlag = 1;
+
+struct Header {
+  uint32_t magic;
+  uint32_t byte_order;
+  uint32_t version;
+  uint32_t flags;
+  int32_t width;
+  int32_t height;
+  uint32_t status;
+  uint32_t lines;
+  uint64_t characters;
+};
+
+bool FitsNarrow(const falcon::core::RectI& box) {
+  constexpr int kMax = std::numeric_limits<uint16_t>::max();
+  return box.x >= 0 && box.y >= 0 && box.width >= 0 && box.height >= 0 && box.x <= kMax && box.y <= kMax &&
+         box.width <= kMax && box.height <= kMax;
+}
+
+template <typename T>
+void AppendArray(std::vector<uint8_t>& out, const std::vector<T>& values) {
+  const std::size_t offset = out.size();
+  out.resize(offset + values.size() * sizeof(T));
+  if (!values.empty()) {
+    std::memcpy(out.data() + offset, values.data(), values.size() * sizeof(T));
+  }
+}
+
+template <typename T>
+void ReadArray(const uint8_t* data, std::size_t size, std::size_t& offset, std::size_t count, std::vector<T>& out) {
+  if (count > (size - offset) / sizeof(T)) {
+    throw std::runtime_error("Compact page truncated");
+  }
+  out.resize(count);
+  if (count != 0) {
+    std::memcpy(out.data(), data + offset, count * sizeof(T));
+  }
+  offset += count * sizeof(T);
+}
+
+template <typename T>
+std::size_t CapacityBytes(const std::vector<T>& values) {
+  return values.capacity() * sizeof(T);
+}
+
+}  // namespace
+
+CompactPage::CompactPage(const OcrPage& page) : image_size_(page.image_size), status_(page.status) {
+  std::size_t characters = 0;
+  bool narrow = true;
+  for (const auto& line : page.lines) {
+    characters += line.characters.size();
+    for (const auto& ch : line.characters) {
+      narrow = narrow && FitsNarrow(ch.bounds);
+    }
+  }
+  codepoints_.reserve(characters);
+  confidences_.reserve(characters);
+  wide_ = !narrow;
+  if (wide_) {
+    wide_boxes_.reserve(characters);
+  } else {
+    narrow_boxes_.reserve(characters);
+  }
+  line_offsets_.reserve(page.lines.size() + 1);
+  line_rtl_.reserve(page.lines.size());
+  for (const auto& line : page.lines) {
+    AppendLine(line);
+  }
+}
+
+void CompactPage::Widen() {
+  wide_ = true;
+  wide_boxes_.reserve(narrow_boxes_.capacity());
+  for (const auto& box : narrow_boxes_) {
+    wide_boxes_.push_back({box.x, box.y, box.width, box.height});
+  }
+  narrow_boxes_ = {};
+}
+
+void CompactPage::AppendLine(const OcrLine& line) {
+  if (CharCount() + line.characters.size() > std::numeric_limits<uint32_t>::max()) {
+    throw std::length_error("CompactPage holds at most 2^32 - 1 characters");
+  }
+  for (const auto& ch : line.characters) {
+    codepoints_.push_back(ch.classification.codepoint);
+    confidences_.push_back(ch.classification.confidence);
+    if (NarrowBoxes() && !FitsNarrow(ch.bounds)) {
+      Widen();
+    }
+    if (!wide_) {
+      const auto& box = ch.bounds;
+      narrow_boxes_.push_back({static_cast<uint16_t>(box.x), static_cast<uint16_t>(box.y),
+                               static_cast<uint16_t>(box.width), static_cast<uint16_t>(box.height)});
+    } else {
+      wide_boxes_.push_back(ch.bounds);
+    }
+  }
+  line_offsets_.push_back(static_cast<uint32_t>(codepoints_.size()));
+  line_rtl_.push_back(line.rtl ? 1 : 0);
+}
+
+OcrPage CompactPage::ToPage() const {
+  OcrPage page;
+  page.image_size = image_size_;
+  page.status = status_;
+  page.lines.resize(LineCount());
+  for (std::size_t l = 0; l < LineCount(); ++l) {
+    const LineView view = Line(l);
+    auto& line = page.lines[l];
+    line.rtl = view.Rtl();
+    line.characters.reserve(view.Size());
+    for (const CharView ch : view) {
+      OcrChar out;
+      out.bounds = ch.Bounds();
+      out.classification = {ch.Codepoint(), ch.Confidence()};
+      line.characters.push_back(out);
+    }
+  }
+  return page;
+}
+
+std::size_t CompactPage::Bytes() const noexcept {
+  return CapacityBytes(codepoints_) + CapacityBytes(confidences_) + CapacityBytes(narrow_boxes_) +
+         CapacityBytes(wide_boxes_) + CapacityBytes(line_offsets_) + CapacityBytes(line_rtl_);
+}
+
+std::vector<uint8_t> CompactPage::Serialize() const {
+  Header header{};
+  header.magic = kMagic;
+  header.byte_order = kByteOrderMark;
+  header.version = kVersion;
+  header.flags = NarrowBoxes() ? 0 : kWideBoxesFlag;
+  header.width = image_size_.width;
+  header.height = image_size_.height;
+  header.status = static_cast<uint32_t>(status_);
+  header.lines = static_cast<uint32_t>(LineCount());
+  header.characters = CharCount();
+
+  std::vector<uint8_t> out(sizeof(header));
+  std::memcpy(out.data(), &header, sizeof(header));
+  out.reserve(sizeof(header) + Bytes());
+  AppendArray(out, line_offsets_);
+  AppendArray(out, line_rtl_);
+  AppendArray(out, codepoints_);
+  AppendArray(out, confidences_);
+  if (NarrowBoxes()) {
+    AppendArray(out, narrow_boxes_);
+  } else {
+    AppendArray(out, wide_boxes_);
+  }
+  return out;
+}
+
+CompactPage CompactPage::Deserialize(const uint8_t* data, std::size_t size) {
+  Header header{};
+  if (size < sizeof(header)) {
+    throw std::runtime_error("Compact page truncated");
+  }
+  std::memcpy(&header, data, sizeof(header));
+  if (header.magic != kMagic || header.byte_order != kByteOrderMark) {
+    throw std::runtime_error("Not a compact page in this byte order");
+  }
+  if (header.version != kVersion) {
+    throw std::runtime_error("Unsupported compact page version");
+  }
+  if (header.status > static_cast<uint32_t>(OcrStatus::kTimedOut) || header.characters > UINT32_MAX) {
+    throw std::runtime_error("Compact page header is invalid");
+  }
+
+  CompactPage page;
+  page.image_size_ = {header.width, header.height};
+  page.status_ = static_cast<OcrStatus>(header.status);
+  const auto characters = static_cast<std::size_t>(header.characters);
+  std::size_t offset = sizeof(header);
+  ReadArray(data, size, offset, std::size_t{header.lines} + 1, page.line_offsets_);
+  ReadArray(data, size, offset, header.lines, page.line_rtl_);
+  ReadArray(data, size, offset, characters, page.codepoints_);
+  ReadArray(data, size, offset, characters, page.confidences_);
+  page.wide_ = (header.flags & kWideBoxesFlag) != 0;
+  if (page.wide_) {
+    ReadArray(data, size, offset, characters, page.wide_boxes_);
+  } else {
+    ReadArray(data, size, offset, characters, page.narrow_boxes_);
+  }
+  if (offset != size) {
+    throw std::runtime_error("Compact page has trailing data");
+  }
+  // Views index the arrays through the offsets, so they must be sorted and in range.
+  const auto& offsets = page.line_offsets_;
+  if (offsets.front() != 0 || offsets.back() != characters) {
+    throw std::runtime_error("Compact page line table is invalid");
+  }
+  for (std::size_t i = 1; i < offsets.size(); ++i) {
+    if (offsets[i] < offsets[i - 1]) {
+      throw std::runtime_error("Compact page line table is invalid");
+    }
+  }
+  return page;
+}
+
+std::string PageText(const CompactPage& page) {
+  std::string text;
+  text.reserve(page.CharCount() + page.LineCount());
+  for (const auto line : page.Lines()) {
+    for (const auto ch : line) {
+      falcon::util::AppendUtf8(text, ch.Codepoint());
+    }
+    text.push_back('\n');
+  }
+  return text;
+}
+
+}  // namespace falcon::ocr
@@ -0,0 +1,70 @@
+#include "falcon/ocr/OcrContext.h"
+
+#include <utility>
+
+namespace falcon::ocr {
+
+namespace {
+
+template <typename T>
+std::size_t CapacityBytes(const std::vector<T>& values) {
+  return values.capacity() * sizeof(T);
+}
+
+}  // namespace
+
+void OcrContext::Release() {
+  *this = OcrContext{};
+}
+
+void OcrContext::ReleaseScratch() {
+  TemplateCache kept = std::move(templates);
+  *this = OcrContext{};
+  templates = std::move(kept);
+}
+
+std::size_t OcrContext::ScratchBytes() const noexcept {
+  std::size_t total = CapacityBytes(scaled[0].pixels) + CapacityBytes(scaled[1].pixels) +
+                      CapacityBytes(binary.data) + CapacityBytes(segment.visited) + CapacityBytes(segment.queue) +
+                      CapacityBytes(components) + CapacityBytes(layout.heights) + CapacityBytes(layout.pending) +
+                      CapacityBytes(blocks) + CapacityBytes(lines) + CapacityBytes(tasks) +
+                      CapacityBytes(classifications) + CapacityBytes(recognized);
+  for (const auto& tile : tiles.tiles) {
+    total += CapacityBytes(tile.components) + CapacityBytes(tile.seeds) + CapacityBytes(tile.top) +
+             CapacityBytes(tile.bottom) + CapacityBytes(tile.left) + CapacityBytes(tile.right);
+  }
+  total += CapacityBytes(morphology.image.bits) + CapacityBytes(morphology.padded_row);
+  for (const auto& packed : morphology.temp) {
+    total += CapacityBytes(packed.bits);
+  }
+  total += CapacityBytes(tiles.tiles) + CapacityBytes(tiles.offsets) + CapacityBytes(tiles.parent) +
+           CapacityBytes(tiles.merged) + CapacityBytes(tiles.merged_seeds) + CapacityBytes(tiles.roots);
+  total += CapacityBytes(analysis.components) + CapacityBytes(analysis.cell_begin) +
+           CapacityBytes(analysis.cell_entries) + CapacityBytes(analysis.query_stamp) + CapacityBytes(analysis.hits) +
+           CapacityBytes(analysis.classifications) + CapacityBytes(analysis.classified_mask);
+  std::apply([&total](const auto&... buffers) { ((total += CapacityBytes(buffers.glyphs.cells)), ...); }, sized);
+  return total;
+}
+
+std::size_t OcrContext::ReservedBytes() const noexcept {
+  std::size_t total = ScratchBytes();
+  for (const auto& set : templates.sets) {
+    total += CapacityBytes(set.reduced) + CapacityBytes(set.templates) + CapacityBytes(set.language_of);
+    for (const auto& index : set.indexes) {
+      total += CapacityBytes(index.templates);
+      std::apply(
+          [&total](const auto&... matrices) {
+            ((total += CapacityBytes(matrices.cells) + CapacityBytes(matrices.codepoints)), ...);
+          },
+          index.matrices);
+    }
+  }
+  return total;
+}
+
+OcrContext& ThreadLocalContext() {
+  thread_local OcrContext context;
+  return context;
+}
+
+}  // namespace falcon::ocr
@@ -0,0 +1,58 @@
+#include "falcon/ocr/OcrControl.h"
+
+#include <utility>
+
+namespace falcon::ocr {
+
+void OcrControl::SetProgressCallback(ProgressCallback callback) {
+  std::lock_guard<std::mutex> lock(callback_mutex_);
+  callback_ = std::move(callback);
+  has_callback_.store(static_cast<bool>(callback_), std::memory_order_release);
+}
+
+OcrProgress OcrControl::Progress() const noexcept {
+  OcrProgress progress;
+  progress.stage = stage_.load(std::memory_order_relaxed);
+  progress.glyphs_done = glyphs_done_.load(std::memory_order_relaxed);
+  progress.glyphs_total = glyphs_total_.load(std::memory_order_relaxed);
+  return progress;
+}
+
+OcrStatus OcrControl::Check() const noexcept {
+  if (Cancelled()) {
+    return OcrStatus::kCancelled;
+  }
+  const auto deadline = deadline_.load(std::memory_order_relaxed);
+  if (deadline != Clock::time_point::max().time_since_epoch().count() &&
+      Clock::now().time_since_epoch().count() >= deadline) {
+    return OcrStatus::kTimedOut;
+  }
+  return OcrStatus::kComplete;
+}
+
+void OcrControl::BeginStage(OcrStage stage, std::size_t glyphs_total) {
+  if (stage == OcrStage::kRecognize) {
+    glyphs_done_.store(0, std::memory_order_relaxed);
+    glyphs_total_.store(glyphs_total, std::memory_order_relaxed);
+  }
+  stage_.store(stage, std::memory_order_relaxed);
+  Notify();
+}
+
+void OcrControl::AddRecognized(std::size_t glyphs) {
+  glyphs_done_.fetch_add(glyphs, std::memory_order_relaxed);
+  Notify();
+}
+
+void OcrControl::Notify() {
+  // The flag keeps the lock off the recognition loop when nobody listens.
+  if (!has_callback_.load(std::memory_order_acquire)) {
+    return;
+  }
+  std::lock_guard<std::mutex> lock(callback_mutex_);
+  if (callback_) {
+    callback_(Progress());
+  }
+}
+
+}  // namespace falcon::ocr
@@ -0,0 +1,369 @@
+#include "falcon/ocr/OutputWriter.h"
+
+#include <algorithm>
+#include <charconv>
+#include <ostream>
+#include <stdexcept>
+
+#include "falcon/util/String.h"
+
+namespace falcon::ocr {
+
+namespace {
+
+enum class Escape { kNone, kTsv, kXml, kJson };
+
+void AppendInt(std::string& out, long long value) {
+  char digits[24];
+  const auto result = std::to_chars(digits, digits + sizeof(digits), value);
+  out.append(digits, result.ptr);
+}
+
+// Appends `ch` (< 0x80) with the escaping the format needs.
+void AppendEscapedAscii(std::string& out, char ch, Escape escape) {
+  switch (escape) {
+    case Escape::kNone:
+      break;
+    case Escape::kTsv:
+      if (ch == '\t') {
+        out += "\\t";
+        return;
+      }
+      if (ch == '\n') {
+        out += "\\n";
+        return;
+      }
+      if (ch == '\r') {
+        out += "\\r";
+        return;
+      }
+      if (ch == '\\') {
+        out += "\\\\";
+        return;
+      }
+      break;
+    case Escape::kXml:
+      if (ch == '&') {
+        out += "&amp;";
+        return;
+      }
+      if (ch == '<') {
+        out += "&lt;";
+        return;
+      }
+      if (ch == '>') {
+        out += "&gt;";
+        return;
+      }
+      if (ch == '"') {
+        out += "&quot;";
+        return;
+      }
+      if (ch == '\'') {
+        out += "&#39;";
+        return;
+      }
+      break;
+    case Escape::kJson:
+      if (ch == '"' || ch == '\\') {
+        out.push_back('\\');
+      } else if (static_cast<unsigned char>(ch) < 0x20) {
+        constexpr char kHex[] = "0123456789abcdef";
+        out += "\\u00";
+        out.push_back(kHex[(ch >> 4) & 0xF]);
+        out.push_back(kHex[ch & 0xF]);
+        return;
+      }
+      break;
+  }
+  out.push_back(ch);
+}
+
+// Characters that never need escaping in any format, so the common case is one compare and store.
+bool IsPlainAscii(char32_t codepoint) {
+  return codepoint >= 0x20 && codepoint < 0x7F && codepoint != '\\' && codepoint != '"' && codepoint != '&' &&
+         codepoint != '<' && codepoint != '>' && codepoint != '\'';
+}
+
+void AppendLineText(std::string& out, const OcrLine& line, Escape escape) {
+  for (const auto& ch : line.characters) {
+    const char32_t codepoint = ch.classification.codepoint;
+    if (IsPlainAscii(codepoint)) {
+      out.push_back(static_cast<char>(codepoint));
+    } else if (codepoint < 0x80) {
+      AppendEscapedAscii(out, static_cast<char>(codepoint), escape);
+    } else {
+      falcon::util::AppendUtf8Multibyte(out, codepoint);
+    }
+  }
+}
+
+falcon::core::RectI LineBounds(const OcrLine& line) {
+  if (line.characters.empty()) {
+    return {};
+  }
+  int left = line.characters.front().bounds.x;
+  int top = line.characters.front().bounds.y;
+  int right = line.characters.front().bounds.Right();
+  int bottom = line.characters.front().bounds.Bottom();
+  for (const auto& ch : line.characters) {
+    left = std::min(left, ch.bounds.x);
+    top = std::min(top, ch.bounds.y);
+    right = std::max(right, ch.bounds.Right());
+    bottom = std::max(bottom, ch.bounds.Bottom());
+  }
+  return falcon::core::RectI{left, top, right - left, bottom - top};
+}
+
+int ConfidencePercent(const OcrLine& line) {
+  if (line.characters.empty()) {
+    return 0;
+  }
+  float total = 0.0f;
+  for (const auto& ch : line.characters) {
+    total += ch.classification.confidence;
+  }
+  const float mean = total / static_cast<float>(line.characters.size());
+  return std::clamp(static_cast<int>(mean * 100.0f + 0.5f), 0, 100);
+}
+
+const char* StatusName(OcrStatus status) {
+  switch (status) {
+    case OcrStatus::kCancelled:
+      return "cancelled";
+    case OcrStatus::kTimedOut:
+      return "timed_out";
+    default:
+      return "complete";
+  }
+}
+
+class TextWriter final : public OutputWriter {
+ public:
+  using OutputWriter::OutputWriter;
+
+  void OnLine(const OcrLine& line) override {
+    AppendLineText(buffer_, line, Escape::kNone);
+    buffer_.push_back('\n');
+    MaybeFlush();
+  }
+
+  void EndPage(const OcrPage&) override { Flush(); }
+  void AbortPage() override { Flush(); }
+};
+
+class TsvWriter final : public OutputWriter {
+ public:
+  using OutputWriter::OutputWriter;
+
+  void BeginPage(falcon::core::SizeI) override {
+    if (page_ == 0) {
+      buffer_ += "page\tline\tleft\ttop\twidth\theight\tconfidence\ttext\n";
+    }
+    ++page_;
+    line_ = 0;
+  }
+
+  void OnLine(const OcrLine& line) override {
+    const auto bounds = LineBounds(line);
+    AppendInt(buffer_, page_);
+    buffer_.push_back('\t');
+    AppendInt(buffer_, ++line_);
+    for (const int value : {bounds.x, bounds.y, bounds.width, bounds.height, ConfidencePercent(line)}) {
+      buffer_.push_back('\t');
+      AppendInt(buffer_, value);
+    }
+    buffer_.push_back('\t');
+    AppendLineText(buffer_, line, Escape::kTsv);
+    buffer_.push_back('\n');
+    MaybeFlush();
+  }
+
+  void EndPage(const OcrPage&) override { Flush(); }
+  void AbortPage() override { Flush(); }
+
+ private:
+  long long page_{0};
+  long long line_{0};
+};
+
+// One standalone hOCR document per page.
+class HocrWriter final : public OutputWriter {
+ public:
+  using OutputWriter::OutputWriter;
+
+  void BeginPage(falcon::core::SizeI image_size) override {
+    ++page_;
+    line_ = 0;
+    buffer_ +=
+        "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+        "<!DOCTYPE html PUBLIC \"-//W3C//DTD XHTML 1.0 Transitional//EN\" "
+        "\"http://www.w3.org/TR/xhtml1/DTD/xhtml1-transitional.dtd\">\n"
+        "<html xmlns=\"http://www.w3.org/1999/xhtml\">\n<head>\n<title></title>\n"
+        "<meta http-equiv=\"Content-Type\" content=\"text/html;charset=utf-8\"/>\n"
+        "<meta name=\"ocr-system\" content=\"FalconOCR\"/>\n"
+        "<meta name=\"ocr-capabilities\" content=\"ocr_page ocr_line\"/>\n</head>\n<body>\n"
+        "<div class=\"ocr_page\" id=\"page_";
+    AppendInt(buffer_, page_);
+    buffer_ += "\" title=\"bbox 0 0 ";
+    AppendInt(buffer_, image_size.width);
+    buffer_.push_back(' ');
+    AppendInt(buffer_, image_size.height);
+    buffer_ += "\">\n";
+  }
+
+  void OnLine(const OcrLine& line) override {
+    const auto bounds = LineBounds(line);
+    buffer_ += "<span class=\"ocr_line\" id=\"line_";
+    AppendInt(buffer_, page_);
+    buffer_.push_back('_');
+    AppendInt(buffer_, ++line_);
+    buffer_ += "\" title=\"bbox ";
+    for (const int value : {bounds.x, bounds.y, bounds.Right(), bounds.Bottom()}) {
+      AppendInt(buffer_, value);
+      buffer_.push_back(' ');
+    }
+    buffer_.back() = ';';
+    buffer_ += " x_wconf ";
+    AppendInt(buffer_, ConfidencePercent(line));
+    buffer_ += "\">";
+    AppendLineText(buffer_, line, Escape::kXml);
+    buffer_ += "</span>\n";
+    MaybeFlush();
+  }
+
+  void EndPage(const OcrPage&) override {
+    buffer_ += "</div>\n</body>\n</html>\n";
+    Flush();
+  }
+
+  // The document is closed so it stays well-formed; it holds the lines recognized before the error.
+  void AbortPage() override { EndPage({}); }
+
+ private:
+  long long page_{0};
+  long long line_{0};
+};
+
+// One JSON object per page, each on its own line (JSON Lines for multi-page output).
+class JsonWriter final : public OutputWriter {
+ public:
+  using OutputWriter::OutputWriter;
+
+  void BeginPage(falcon::core::SizeI image_size) override {
+    first_line_ = true;
+    buffer_ += "{\"width\":";
+    AppendInt(buffer_, image_size.width);
+    buffer_ += ",\"height\":";
+    AppendInt(buffer_, image_size.height);
+    buffer_ += ",\"lines\":[";
+  }
+
+  void OnLine(const OcrLine& line) override {
+    const auto bounds = LineBounds(line);
+    if (!first_line_) {
+      buffer_.push_back(',');
+    }
+    first_line_ = false;
+    buffer_ += "{\"bbox\":[";
+    AppendInt(buffer_, bounds.x);
+    buffer_.push_back(',');
+    AppendInt(buffer_, bounds.y);
+    buffer_.push_back(',');
+    AppendInt(buffer_, bounds.width);
+    buffer_.push_back(',');
+    AppendInt(buffer_, bounds.height);
+    buffer_ += "],\"confidence\":";
+    AppendInt(buffer_, ConfidencePercent(line));
+    buffer_ += ",\"text\":\"";
+    AppendLineText(buffer_, line, Escape::kJson);
+    buffer_ += "\"}";
+    MaybeFlush();
+  }
+
+  void EndPage(const OcrPage& page) override { Close(StatusName(page.status)); }
+  void AbortPage() override { Close("failed"); }
+
+ private:
+  void Close(const char* status) {
+    buffer_ += "],\"status\":\"";
+    buffer_ += status;
+    buffer_ += "\"}\n";
+    Flush();
+  }
+
+  bool first_line_{true};
+};
+
+}  // namespace
+
+OutputFormat ParseOutputFormat(std::string_view name) {
+  if (name == "text" || name == "txt") {
+    return OutputFormat::kText;
+  }
+  if (name == "tsv") {
+    return OutputFormat::kTsv;
+  }
+  if (name == "hocr") {
+    return OutputFormat::kHocr;
+  }
+  if (name == "json") {
+    return OutputFormat::kJson;
+  }
+  throw std::invalid_argument("Unknown output format: " + std::string(name));
+}
+
+const char* OutputExtension(OutputFormat format) {
+  switch (format) {
+    case OutputFormat::kTsv:
+      return ".tsv";
+    case OutputFormat::kHocr:
+      return ".hocr";
+    case OutputFormat::kJson:
+      return ".json";
+    default:
+      return ".txt";
+  }
+}
+
+OutputWriter::OutputWriter(std::ostream& stream, bool line_buffered)
+    : stream_(stream), line_buffered_(line_buffered) {
+  buffer_.reserve(kFlushBytes + 4096);
+}
+
+OutputWriter::~OutputWriter() {
+  Flush();
+}
+
+void OutputWriter::WritePage(const OcrPage& page) {
+  BeginPage(page.image_size);
+  for (const auto& line : page.lines) {
+    OnLine(line);
+  }
+  EndPage(page);
+}
+
+void OutputWriter::Flush() {
+  if (!buffer_.empty()) {
+    stream_.write(buffer_.data(), static_cast<std::streamsize>(buffer_.size()));
+    buffer_.clear();
+  }
+  if (line_buffered_) {
+    stream_.flush();
+  }
+}
+
+std::unique_ptr<OutputWriter> MakeOutputWriter(OutputFormat format, std::ostream& stream, bool line_buffered) {
+  switch (format) {
+    case OutputFormat::kTsv:
+      return std::make_unique<TsvWriter>(stream, line_buffered);
+    case OutputFormat::kHocr:
+      return std::make_unique<HocrWriter>(stream, line_buffered);
+    case OutputFormat::kJson:
+      return std::make_unique<JsonWriter>(stream, line_buffered);
+    default:
+      return std::make_unique<TextWriter>(stream, line_buffered);
+  }
+}
+
+}  // namespace falcon::ocr
@@ -0,0 +1,162 @@
+#include "falcon/ocr/PageStream.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <exception>
+#include <limits>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "falcon/ocr/Pipeline.h"
+#include "falcon/util/BoundedQueue.h"
+#include "falcon/util/Sync.h"
+#include "falcon/util/Trace.h"
+
+namespace falcon::ocr {
+
+namespace {
+
+struct DecodedPage {
+  std::size_t index{0};
+  falcon::core::Raster raster;
+};
+
+// State shared by the decoder, the recognizers and the delivering caller.
+struct PageStreamState {
+  std::mutex mutex;
+  std::condition_variable changed;
+  std::size_t in_flight{0};  // decoded and not yet delivered
+  std::size_t running{0};    // recognizers still popping
+  // Pages from the first failed one on are abandoned; earlier ones are still delivered.
+  std::size_t stop_index{std::numeric_limits<std::size_t>::max()};
+  std::exception_ptr error;
+  std::map<std::size_t, OcrPage> done;
+
+  bool Stopping() const { return stop_index != std::numeric_limits<std::size_t>::max(); }
+
+  void Fail(std::size_t index, std::exception_ptr failure) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (index < stop_index) {
+      stop_index = index;
+      error = std::move(failure);
+    }
+    changed.notify_all();
+  }
+};
+
+}  // namespace
+
+std::size_t RunOcrPages(const PageSource& source, const PageStreamOptions& options, const PageCallback& on_page) {
+  const std::size_t workers = std::max<std::size_t>(options.workers, 1);
+  const std::size_t window = std::max(options.max_pages_in_flight, workers);
+  PageStreamState state;
+  state.running = workers;
+  falcon::util::BoundedQueue<DecodedPage> decoded(window);
+
+  std::thread decoder([&] {
+    falcon::util::Tracer::SetThreadName("page decoder");
+    for (std::size_t index = 0;; ++index) {
+      {
+        std::unique_lock<std::mutex> lock(state.mutex);
+        falcon::util::WaitFor(state.changed, lock, [&] { return state.Stopping() || state.in_flight < window; });
+        if (state.Stopping()) {
+          break;
+        }
+      }
+      DecodedPage page;
+      page.index = index;
+      try {
+        FALCON_TRACE_SCOPE("pages.decode");
+        if (!source(page.raster)) {
+          break;
+        }
+      } catch (...) {
+        state.Fail(index, std::current_exception());
+        break;
+      }
+      {
+        std::lock_guard<std::mutex> lock(state.mutex);
+        ++state.in_flight;
+      }
+      if (!decoded.Push(std::move(page))) {
+        break;
+      }
+    }
+    decoded.Close();
+  });
+
+  std::vector<std::thread> recognizers;
+  recognizers.reserve(workers);
+  for (std::size_t w = 0; w < workers; ++w) {
+    recognizers.emplace_back([&] {
+      falcon::util::Tracer::SetThreadName("page recognizer");
+      DecodedPage page;
+      while (decoded.Pop(page)) {
+        OcrPage result;
+        bool wanted;
+        {
+          std::lock_guard<std::mutex> lock(state.mutex);
+          wanted = page.index < state.stop_index;
+        }
+        if (wanted) {
+          try {
+            result = RunOcr(page.raster, options.ocr);
+          } catch (...) {
+            state.Fail(page.index, std::current_exception());
+          }
+        }
+        page.raster = {};
+        std::lock_guard<std::mutex> lock(state.mutex);
+        if (page.index < state.stop_index) {
+          state.done.emplace(page.index, std::move(result));
+        }
+        state.changed.notify_all();
+      }
+      std::lock_guard<std::mutex> lock(state.mutex);
+      --state.running;
+      state.changed.notify_all();
+    });
+  }
+
+  // Deliver on the calling thread in page order; a delivered page frees a slot for the decoder.
+  std::size_t delivered = 0;
+  for (;;) {
+    std::unique_lock<std::mutex> lock(state.mutex);
+    falcon::util::WaitFor(state.changed, lock, [&] {
+      return delivered >= state.stop_index || state.running == 0 || state.done.count(delivered) != 0;
+    });
+    const auto it = state.done.find(delivered);
+    if (delivered >= state.stop_index || it == state.done.end()) {
+      break;
+    }
+    OcrPage page = std::move(it->second);
+    state.done.erase(it);
+    lock.unlock();
+    try {
+      FALCON_TRACE_SCOPE("pages.deliver");
+      on_page(delivered, page);
+    } catch (...) {
+      state.Fail(delivered, std::current_exception());
+      break;
+    }
+    lock.lock();
+    ++delivered;
+    --state.in_flight;
+    state.changed.notify_all();
+  }
+
+  decoded.Close();
+  decoder.join();
+  for (auto& recognizer : recognizers) {
+    recognizer.join();
+  }
+  if (state.error) {
+    std::rethrow_exception(state.error);
+  }
+  return delivered;
+}
+
+}  // namespace falcon::ocr
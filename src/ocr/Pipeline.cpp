@@ -1,85 +1,1027 @@
 #include "falcon/ocr/Pipeline.h"
 
 #include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <mutex>
 #include <stdexcept>
+#include <string>
+#include <utility>
 
 #include "falcon/core/Binarize.h"
 #include "falcon/core/Classifier.h"
 #include "falcon/core/GlyphDB.h"
 #include "falcon/core/Image.h"
+#include "falcon/core/Layout.h"
 #include "falcon/core/Normalize.h"
+#include "falcon/core/PackRegistry.h"
 #include "falcon/core/Segment.h"
+#include "falcon/core/TemplateReduction.h"
+#include "falcon/ocr/OcrControl.h"
 #include "falcon/ocr/OcrTypes.h"
+#include "falcon/util/Hash.h"
+#include "falcon/util/String.h"
+#include "falcon/util/ThreadPool.h"
+#include "falcon/util/Trace.h"
 
 namespace falcon::ocr {
 
 namespace {
 
+constexpr std::size_t kGlyphsPerTask = 256;
+// Under an OcrControl, tasks poll for cancellation and the deadline this often.
+constexpr std::size_t kGlyphsPerCheck = 64;
+// Under a memory budget, pages are not reduced below this resolution, and this tile size is used
+// when the caller did not pick one.
+constexpr int kMinBudgetDpi = 150;
+constexpr int kBudgetTileSize = 256;
+// Cell edge, in binary-image pixels, of the grid that indexes a kept page analysis.
+constexpr int kAnalysisCellSize = 64;
+
 bool Intersects(const falcon::core::RectI& a, const falcon::core::RectI& b) {
   const bool no_overlap = a.Right() <= b.x || b.Right() <= a.x || a.Bottom() <= b.y || b.Bottom() <= a.y;
   return !no_overlap;
 }
 
-}  // namespace
+constexpr std::size_t kMaxTemplateSets = 4;
+constexpr std::size_t kMaxTemplateIndexes = 8;
+constexpr uint64_t kAllLanguages = ~uint64_t{0};
 
-OcrPage RunOcr(const falcon::core::Raster& raster, const OcrOptions& options) {
-  if (raster.Empty()) {
-    throw std::invalid_argument("RunOcr requires a non-empty raster");
+// Packs past the 64th cannot be masked out and are always admitted.
+bool AdmitsLanguage(uint64_t mask, std::size_t language) {
+  return language >= 64 || (mask & (uint64_t{1} << language)) != 0;
+}
+
+// Returns the template set for the request's language selection, merging it on a miss, and makes
+// it TemplateCache::Current(). Sets merged before a pack reload are dropped.
+OcrContext::TemplateSet& CachedTemplateSet(OcrContext& context, const OcrOptions& options) {
+  auto& sets = context.templates.sets;
+  const uint64_t generation = falcon::core::PackRegistry::Shared().Generation();
+  for (auto it = sets.begin(); it != sets.end();) {
+    if (it->generation != generation) {
+      it = sets.erase(it);
+    } else if (it->merge_pixels == options.template_merge_pixels && it->languages == options.languages) {
+      sets.splice(sets.end(), sets, it);
+      return sets.back();
+    } else {
+      ++it;
+    }
+  }
+
+  if (sets.size() >= kMaxTemplateSets) {
+    sets.pop_front();
+  }
+  OcrContext::TemplateSet set;
+  set.templates = falcon::core::PackRegistry::Shared().Select(options.languages, true, set.packs);
+  if (options.template_merge_pixels > 0) {
+    std::vector<falcon::core::GlyphTemplate> merged;
+    merged.reserve(set.templates.size());
+    for (const auto* tmpl : set.templates) {
+      merged.push_back(*tmpl);
+    }
+    falcon::core::TemplateReductionOptions reduction;
+    reduction.merge_pixels = options.template_merge_pixels;
+    set.reduced = falcon::core::ReduceTemplates(merged, {}, reduction);
+    set.packs.clear();
+    set.templates.clear();
+    for (const auto& tmpl : set.reduced) {
+      set.templates.push_back(&tmpl);
+    }
+  }
+  for (const auto* tmpl : set.templates) {
+    const auto it = std::find(set.pack_languages.begin(), set.pack_languages.end(), tmpl->language);
+    set.language_of.push_back(static_cast<std::size_t>(it - set.pack_languages.begin()));
+    if (it == set.pack_languages.end()) {
+      set.pack_languages.push_back(tmpl->language);
+    }
+  }
+  set.generation = generation;
+  set.merge_pixels = options.template_merge_pixels;
+  set.languages = options.languages;
+  sets.push_back(std::move(set));
+  return sets.back();
+}
+
+// Returns the sub-index of templates admitted by the request's charset and `language_mask`, so
+// excluded templates are never compared. Sub-indexes are cached per key within the language
+// selection's template set.
+OcrContext::TemplateIndex& CachedTemplateIndex(OcrContext::TemplateSet& set, const OcrOptions& options,
+                                               uint64_t language_mask = kAllLanguages) {
+  auto& indexes = set.indexes;
+  const auto found = std::find_if(indexes.begin(), indexes.end(), [&](const OcrContext::TemplateIndex& index) {
+    return index.ascii_only == options.ascii_only && index.language_mask == language_mask &&
+           index.charset == options.charset;
+  });
+  if (found != indexes.end()) {
+    indexes.splice(indexes.end(), indexes, found);
+    return indexes.back();
+  }
+
+  if (indexes.size() >= kMaxTemplateIndexes) {
+    indexes.pop_front();
+  }
+  OcrContext::TemplateIndex index;
+  index.charset = options.charset;
+  index.ascii_only = options.ascii_only;
+  index.language_mask = language_mask;
+  for (std::size_t i = 0; i < set.templates.size(); ++i) {
+    const auto* tmpl = set.templates[i];
+    if (options.charset.Contains(tmpl->codepoint) && (!options.ascii_only || tmpl->codepoint <= 0x7F) &&
+        AdmitsLanguage(language_mask, set.language_of[i])) {
+      index.templates.push_back(tmpl);
+    }
+  }
+  indexes.push_back(std::move(index));
+  return indexes.back();
+}
+
+// Packs that won confident probe matches, plus the builtin fallback. Returns kAllLanguages when
+// fewer than half of the probes were confident or every pack won anyway.
+uint64_t DominantLanguages(const OcrContext::TemplateSet& set,
+                           const std::vector<falcon::core::ClassificationResult>& probes, std::size_t count,
+                           float min_confidence) {
+  uint64_t mask = 0;
+  std::size_t confident = 0;
+  for (std::size_t g = 0; g < count; ++g) {
+    if (probes[g].confidence < min_confidence) {
+      continue;
+    }
+    ++confident;
+    const auto it = std::find_if(set.templates.begin(), set.templates.end(),
+                                 [&](const auto* tmpl) { return tmpl->codepoint == probes[g].codepoint; });
+    if (it == set.templates.end()) {
+      continue;
+    }
+    const auto language = set.language_of[static_cast<std::size_t>(it - set.templates.begin())];
+    mask |= language < 64 ? uint64_t{1} << language : 0;
+  }
+  if (confident * 2 < count) {
+    return kAllLanguages;
+  }
+
+  uint64_t every = 0;
+  for (std::size_t language = 0; language < set.pack_languages.size() && language < 64; ++language) {
+    every |= uint64_t{1} << language;
+    if (set.pack_languages[language] == "builtin") {
+      mask |= uint64_t{1} << language;
+    }
+  }
+  return (mask & every) == every ? kAllLanguages : mask;
+}
+
+falcon::core::RectI ScaleUp(const falcon::core::RectI& rect, int factor_x, int factor_y, falcon::core::SizeI limit) {
+  falcon::core::RectI scaled{rect.x * factor_x, rect.y * factor_y, rect.width * factor_x, rect.height * factor_y};
+  scaled.width = std::min(scaled.width, limit.width - scaled.x);
+  scaled.height = std::min(scaled.height, limit.height - scaled.y);
+  return scaled;
+}
+
+// Calls visit(cell) for every analysis grid cell that `rect` (clamped to the grid) overlaps.
+template <typename Visit>
+void ForEachCell(const OcrContext::PageAnalysis& analysis, const falcon::core::RectI& rect, Visit&& visit) {
+  const int x0 = std::max(rect.x, 0);
+  const int y0 = std::max(rect.y, 0);
+  const int x1 = std::min(rect.Right(), analysis.columns * kAnalysisCellSize);
+  const int y1 = std::min(rect.Bottom(), analysis.rows * kAnalysisCellSize);
+  if (x0 >= x1 || y0 >= y1) {
+    return;
+  }
+  for (int cy = y0 / kAnalysisCellSize; cy <= (y1 - 1) / kAnalysisCellSize; ++cy) {
+    for (int cx = x0 / kAnalysisCellSize; cx <= (x1 - 1) / kAnalysisCellSize; ++cx) {
+      visit(static_cast<std::size_t>(cy) * analysis.columns + cx);
+    }
+  }
+}
+
+// Keeps the page-wide components of a freshly segmented page and indexes them on the grid.
+void RecordAnalysis(OcrContext::PageAnalysis& analysis, const falcon::core::BinaryImage& binary,
+                    const std::vector<falcon::core::ConnectedComponent>& components) {
+  analysis.components.assign(components.begin(), components.end());
+  analysis.columns = (binary.width + kAnalysisCellSize - 1) / kAnalysisCellSize;
+  analysis.rows = (binary.height + kAnalysisCellSize - 1) / kAnalysisCellSize;
+  auto& begin = analysis.cell_begin;
+  begin.assign(static_cast<std::size_t>(analysis.columns) * analysis.rows + 1, 0);
+  for (const auto& component : components) {
+    ForEachCell(analysis, component.bounds, [&begin](std::size_t cell) { ++begin[cell + 1]; });
+  }
+  for (std::size_t cell = 1; cell < begin.size(); ++cell) {
+    begin[cell] += begin[cell - 1];
+  }
+  auto& cursor = analysis.hits;
+  cursor.assign(begin.begin(), begin.end() - 1);
+  analysis.cell_entries.resize(begin.back());
+  for (std::size_t i = 0; i < components.size(); ++i) {
+    ForEachCell(analysis, components[i].bounds,
+                [&](std::size_t cell) { analysis.cell_entries[cursor[cell]++] = static_cast<uint32_t>(i); });
+  }
+  analysis.query_stamp.assign(components.size(), 0);
+  analysis.query = 0;
+  analysis.classify_key = 0;
+  analysis.classifications.assign(components.size(), {});
+  analysis.classified_mask.assign(components.size(), 0);
+  analysis.valid = true;
+}
+
+// Fills `out` with the analyzed components that intersect `region`, in label order, i.e. exactly
+// what filtering the whole page would keep, but visiting only the grid cells under the region.
+void SelectRegion(OcrContext::PageAnalysis& analysis, const falcon::core::RectI& region,
+                  std::vector<falcon::core::ConnectedComponent>& out) {
+  auto& hits = analysis.hits;
+  hits.clear();
+  if (++analysis.query == 0) {
+    std::fill(analysis.query_stamp.begin(), analysis.query_stamp.end(), 0U);
+    analysis.query = 1;
+  }
+  ForEachCell(analysis, region, [&](std::size_t cell) {
+    for (uint32_t entry = analysis.cell_begin[cell]; entry < analysis.cell_begin[cell + 1]; ++entry) {
+      const uint32_t id = analysis.cell_entries[entry];
+      if (analysis.query_stamp[id] != analysis.query) {
+        analysis.query_stamp[id] = analysis.query;
+        if (Intersects(analysis.components[id].bounds, region)) {
+          hits.push_back(id);
+        }
+      }
+    }
+  });
+  std::sort(hits.begin(), hits.end());
+  out.clear();
+  for (const uint32_t id : hits) {
+    out.push_back(analysis.components[id]);
+  }
+}
+
+// Everything besides the glyph and the language mask that decides a classification.
+uint64_t ClassificationKey(const OcrOptions& options, const OcrContext::TemplateSet& templates) {
+  falcon::util::Hasher hasher;
+  hasher.Add(templates.generation).Add(options.template_merge_pixels).Add(options.glyph_size);
+  hasher.Add(options.ascii_only).Add(options.script_min_confidence);
+  hasher.Add(static_cast<uint64_t>(options.languages.size()));
+  for (const auto& language : options.languages) {
+    hasher.Add(std::string_view(language));
+  }
+  for (const auto& range : options.charset.Ranges()) {
+    hasher.Add(range.first).Add(range.last);
+  }
+  return hasher.Digest();
+}
+
+// Builds the page's OcrLines from recognized components. With a sink, each line is built and
+// handed over as soon as every task up to its last glyph has finished, so lines stream out in
+// reading order while later blocks are still being classified.
+class PageAssembler {
+ public:
+  PageAssembler(const OcrContext& context, OcrPage& page, int factor_x, int factor_y, LineSink* sink)
+      : context_(context), page_(page), factor_x_(factor_x), factor_y_(factor_y), sink_(sink) {
+    page_.lines.resize(context.lines.size());
+    if (sink_ != nullptr) {
+      task_done_.assign(context.tasks.size(), 0);
+    }
+  }
+
+  [[nodiscard]] bool Streaming() const noexcept { return sink_ != nullptr; }
+
+  // Called once per fully classified task, from any pool thread. Lines are built under the lock
+  // but handed to the sink outside it, by one thread at a time: whichever finds no delivery in
+  // progress keeps delivering until it catches up with the built lines.
+  void TaskDone(std::size_t task) {
+    const auto& tasks = context_.tasks;
+    const auto& lines = context_.lines;
+    std::size_t end = 0;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      task_done_[task] = 1;
+      while (next_task_ < tasks.size() && task_done_[next_task_] != 0) {
+        ++next_task_;
+      }
+      const std::size_t frontier = next_task_ < tasks.size() ? tasks[next_task_].first : context_.components.size();
+      for (; next_line_ < lines.size() && lines[next_line_].end <= frontier; ++next_line_) {
+        Build(next_line_, false);
+      }
+      if (delivering_ || delivered_ == next_line_) {
+        return;
+      }
+      delivering_ = true;
+      end = next_line_;
+    }
+    for (;;) {
+      // Built lines are never touched again, so they can be read without the lock.
+      for (; delivered_ < end; ++delivered_) {
+        sink_->OnLine(page_.lines[delivered_]);
+      }
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (delivered_ == next_line_) {
+        delivering_ = false;
+        return;
+      }
+      end = next_line_;
+    }
+  }
+
+  // Builds (and streams) the remaining lines. A partial page keeps only recognized glyphs and drops
+  // lines left empty.
+  void Finish(bool partial) {
+    for (; next_line_ < page_.lines.size(); ++next_line_) {
+      Build(next_line_, partial);
+      if (sink_ != nullptr && !page_.lines[next_line_].characters.empty()) {
+        sink_->OnLine(page_.lines[next_line_]);
+      }
+    }
+    if (partial) {
+      page_.lines.erase(std::remove_if(page_.lines.begin(), page_.lines.end(),
+                                       [](const OcrLine& line) { return line.characters.empty(); }),
+                        page_.lines.end());
+    }
+  }
+
+ private:
+  void Build(std::size_t line, bool partial) {
+    const auto& range = context_.lines[line];
+    auto& characters = page_.lines[line].characters;
+    characters.reserve(range.end - range.begin);
+    for (std::size_t i = range.begin; i < range.end; ++i) {
+      if (partial && context_.recognized[i] == 0) {
+        continue;
+      }
+      OcrChar ocr_char;
+      ocr_char.bounds = ScaleUp(context_.components[i].bounds, factor_x_, factor_y_, page_.image_size);
+      ocr_char.classification = context_.classifications[i];
+      characters.push_back(ocr_char);
+    }
+  }
+
+  const OcrContext& context_;
+  OcrPage& page_;
+  int factor_x_;
+  int factor_y_;
+  LineSink* sink_;
+  std::mutex mutex_;
+  std::vector<uint8_t> task_done_;
+  std::size_t next_task_{0};
+  std::size_t next_line_{0};   // lines built
+  std::size_t delivered_{0};   // lines handed to the sink, only advanced by the delivering thread
+  bool delivering_{false};
+};
+
+// Normalizes and classifies every component at the engine glyph size, one task per block slice.
+// In automatic language mode the first glyphs probe which packs the page uses; the rest are
+// matched against those packs only and retried against every pack when confidence drops.
+// With a control, glyphs are marked in context.recognized as they finish so a stopped call can
+// return the finished ones. With a page analysis, glyphs it already holds for the same templates
+// are copied instead of classified, and new results are added to it.
+template <int Size>
+void RecognizeComponents(const falcon::core::BinaryImage& binary, const OcrOptions& options,
+                         OcrContext::TemplateIndex& full, OcrContext& context, OcrControl* control,
+                         PageAssembler& assembler, OcrContext::PageAnalysis* analysis) {
+  auto& buffers = context.Sized<Size>();
+  const auto& components = context.components;
+  const auto& tasks = context.tasks;
+  auto& glyphs = buffers.glyphs;
+  auto& classifications = context.classifications;
+  glyphs.count = components.size();
+  glyphs.cells.resize(components.size() * falcon::core::kGlyphCellsOf<Size>);
+  classifications.resize(components.size());
+  auto& recognized = context.recognized;
+  if (control != nullptr) {
+    recognized.assign(components.size(), 0);
+    control->BeginStage(OcrStage::kRecognize, components.size());
+  }
+  const auto mark = [&](std::size_t begin, std::size_t end) {
+    std::fill(recognized.begin() + static_cast<std::ptrdiff_t>(begin),
+              recognized.begin() + static_cast<std::ptrdiff_t>(end), uint8_t{1});
+    control->AddRecognized(end - begin);
+  };
+
+  const auto& all_templates = full.Matrix<Size>();
+  // Classifies [begin, end) against `set`, retrying weak matches against every pack when `set` is
+  // narrowed to `mask`. Glyphs the page analysis holds for `mask` are copied from it.
+  const auto classify_with = [&](std::size_t begin, std::size_t end,
+                                 const falcon::core::SizedTemplateMatrix<Size>& set, uint64_t mask) {
+    const auto compute = [&](std::size_t first, std::size_t last) {
+      falcon::core::NormalizeGlyphRange(binary, components, first, last, glyphs);
+      falcon::core::ClassifyGlyphRange(glyphs, first, last, set, classifications);
+      if (&set != &all_templates) {
+        for (std::size_t g = first; g < last; ++g) {
+          if (classifications[g].confidence < options.script_min_confidence) {
+            falcon::core::ClassifyGlyphRange(glyphs, g, g + 1, all_templates, classifications);
+          }
+        }
+      }
+    };
+    if (analysis == nullptr) {
+      compute(begin, end);
+      return;
+    }
+    // Labels are 1-based positions in the page-wide component list.
+    const auto id = [&](std::size_t g) { return static_cast<std::size_t>(components[g].label - 1); };
+    for (std::size_t g = begin; g < end;) {
+      if (analysis->classified_mask[id(g)] == mask) {
+        classifications[g] = analysis->classifications[id(g)];
+        ++g;
+        continue;
+      }
+      std::size_t last = g + 1;
+      while (last < end && analysis->classified_mask[id(last)] != mask) {
+        ++last;
+      }
+      compute(g, last);
+      for (; g < last; ++g) {
+        analysis->classifications[id(g)] = classifications[g];
+        analysis->classified_mask[id(g)] = mask;
+      }
+    }
+  };
+
+  const falcon::core::SizedTemplateMatrix<Size>* templates = &all_templates;
+  uint64_t templates_mask = kAllLanguages;
+  std::size_t probed = 0;
+  if (options.languages.empty() && options.script_probe_glyphs > 0 &&
+      (control == nullptr || control->Check() == OcrStatus::kComplete)) {
+    FALCON_TRACE_SCOPE("ocr.script_probe");
+    probed = std::min(components.size(), static_cast<std::size_t>(options.script_probe_glyphs));
+    classify_with(0, probed, all_templates, kAllLanguages);
+    if (control != nullptr) {
+      mark(0, probed);
+    }
+    // The page keeps the set it started with even if a pack is reloaded meanwhile.
+    auto& set = context.templates.Current();
+    const uint64_t mask = DominantLanguages(set, classifications, probed, options.script_min_confidence);
+    if (mask != kAllLanguages) {
+      templates = &CachedTemplateIndex(set, options, mask).Matrix<Size>();
+      templates_mask = mask;
+    }
   }
+  const auto classify = [&](std::size_t begin, std::size_t end) {
+    classify_with(begin, end, *templates, templates_mask);
+  };
+  const auto recognize = [&](std::size_t task) {
+    FALCON_TRACE_SCOPE("ocr.recognize_task");
+    const std::size_t begin = std::max(tasks[task].first, probed);
+    const std::size_t end = tasks[task].second;
+    if (control == nullptr) {
+      if (begin < end) {
+        classify(begin, end);
+      }
+    } else {
+      for (std::size_t chunk = begin; chunk < end; chunk += kGlyphsPerCheck) {
+        if (control->Check() != OcrStatus::kComplete) {
+          return;
+        }
+        const std::size_t chunk_end = std::min(chunk + kGlyphsPerCheck, end);
+        classify(chunk, chunk_end);
+        mark(chunk, chunk_end);
+      }
+    }
+    if (assembler.Streaming()) {
+      assembler.TaskDone(task);
+    }
+  };
+  if (options.parallel) {
+    falcon::util::ThreadPool::Shared().ParallelFor(tasks.size(), recognize);
+  } else {
+    for (std::size_t task = 0; task < tasks.size(); ++task) {
+      recognize(task);
+    }
+  }
+}
 
-  const falcon::core::BinaryImage binary = falcon::core::BinarizeOtsu(raster);
-  auto components = falcon::core::ConnectedComponents(binary);
-  const auto templates = falcon::core::CollectGlyphTemplates(options.languages, !options.ascii_only);
-  if (templates.empty()) {
-    throw std::runtime_error("No glyph templates available for requested languages");
+// Calls step(fx, fy) for each DownscaleBox pass of a factor_x x factor_y reduction. Power-of-two
+// factors go through the SIMD 2x2 kernel one pyramid level at a time.
+template <typename Step>
+void ForEachReduction(int factor_x, int factor_y, Step&& step) {
+  while (factor_x % 2 == 0 && factor_y % 2 == 0) {
+    step(2, 2);
+    factor_x /= 2;
+    factor_y /= 2;
+  }
+  if (factor_x > 1 || factor_y > 1) {
+    step(factor_x, factor_y);
   }
+}
 
-  const falcon::core::RectI region = options.has_region ? options.region
-                                                        : falcon::core::RectI{0, 0, raster.width, raster.height};
+// Returns the raster to recognize: `raster` itself, or a copy reduced by the given factors.
+falcon::core::RasterView Reduce(const falcon::core::RasterView& raster, int factor_x, int factor_y,
+                                OcrContext& context) {
+  falcon::core::RasterView current = raster;
+  std::size_t next = 0;
+  ForEachReduction(factor_x, factor_y, [&](int fx, int fy) {
+    falcon::core::DownscaleBox(current, fx, fy, context.scaled[next]);
+    current = context.scaled[next];
+    next ^= 1U;
+  });
+  return current;
+}
+
+// Identifies a page by its pixels; strided views are hashed row by row.
+uint64_t ContentHash(const falcon::core::RasterView& raster) {
+  const auto width = static_cast<std::size_t>(raster.width);
+  if (raster.Contiguous()) {
+    return falcon::util::Hash64(raster.pixels, width * static_cast<std::size_t>(raster.height));
+  }
+  falcon::util::Hasher hasher;
+  for (int y = 0; y < raster.height; ++y) {
+    hasher.Add(raster.Row(y), width);
+  }
+  return hasher.Digest();
+}
 
-  components.erase(std::remove_if(components.begin(), components.end(), [&](const auto& component) {
-                    if (component.area < 4) {
-                      return true;
-                    }
-                    if (!options.has_region) {
-                      return false;
-                    }
-                    return !Intersects(component.bounds, region);
-                  }),
-                  components.end());
+std::size_t PixelCount(falcon::core::SizeI size) {
+  return static_cast<std::size_t>(size.width) * static_cast<std::size_t>(size.height);
+}
+
+std::string Mebibytes(std::size_t bytes) {
+  return std::to_string((bytes + (std::size_t{1} << 20) - 1) >> 20) + " MiB";
+}
+
+// How a page is preprocessed and segmented, chosen up front to fit OcrOptions::memory_budget.
+struct MemoryPlan {
+  int factor_x{1};
+  int factor_y{1};
+  int tile_size{0};      // 0 labels the whole image at once
+  int extra{1};          // reduction applied for the budget, on top of options.target_dpi
+  std::size_t bytes{0};  // estimated working set through segmentation
+};
+
+// Scratch CleanupBinaryImage keeps for a binary image of `size`: the packed image, up to four
+// packed temporaries and one padded row.
+std::size_t EstimateCleanupBytes(falcon::core::SizeI size, const falcon::core::CleanupOptions& cleanup) {
+  if (!cleanup.Enabled()) {
+    return 0;
+  }
+  const std::size_t words = (static_cast<std::size_t>(size.width) + 63) / 64;
+  const int radius = std::max({cleanup.opening.radius_x, cleanup.closing.radius_x, cleanup.despeckle_size + 1});
+  const std::size_t pad_words = static_cast<std::size_t>(radius + 63) / 64;
+  return 5 * words * sizeof(uint64_t) * static_cast<std::size_t>(size.height) +
+         (words + 2 * pad_words + 1) * sizeof(uint64_t);
+}
 
-  std::sort(components.begin(), components.end(), [](const auto& lhs, const auto& rhs) {
-    if (lhs.bounds.y == rhs.bounds.y) {
-      return lhs.bounds.x < rhs.bounds.x;
+// Working set through segmentation that follows from the page size alone: input, reduction
+// buffers (which end up holding the first two levels), binary image, cleanup scratch and labeling
+// scratch, whose BFS queue is counted at its tile-bounded worst case when tiled. What depends on
+// the ink (the untiled BFS queue and the component lists) is bounded by EstimateLabelBytes once
+// the page is binarized.
+std::size_t EstimateSegmentBytes(falcon::core::SizeI size, int factor_x, int factor_y, int tile_size,
+                                 const falcon::core::CleanupOptions& cleanup) {
+  std::size_t bytes = PixelCount(size);
+  int level = 0;
+  ForEachReduction(factor_x, factor_y, [&](int fx, int fy) {
+    size = {(size.width + fx - 1) / fx, (size.height + fy - 1) / fy};
+    if (level++ < 2) {
+      bytes += PixelCount(size);
     }
-    return lhs.bounds.y < rhs.bounds.y;
   });
+  const std::size_t pixels = PixelCount(size);
+  bytes += pixels;  // binary image
+  bytes += EstimateCleanupBytes(size, cleanup);
+  if (tile_size <= 0) {
+    return bytes + pixels;  // visited flags
+  }
+  const std::size_t tile_pixels = std::min(static_cast<std::size_t>(tile_size) * tile_size, pixels);
+  const std::size_t threads = falcon::util::ThreadPool::Shared().WorkerCount() + 1;
+  const std::size_t tiles = PixelCount({(size.width + tile_size - 1) / tile_size, (size.height + tile_size - 1) / tile_size});
+  return bytes + threads * tile_pixels * (sizeof(int32_t) + sizeof(falcon::core::PointI)) +
+         tiles * 4 * static_cast<std::size_t>(tile_size) * sizeof(int32_t);
+}
+
+// Ink pixels and horizontal ink runs of a binary image. Every 4-connected component contains at
+// least one run, so `runs` bounds the component count.
+struct InkStats {
+  std::size_t pixels{0};
+  std::size_t runs{0};
+};
+
+InkStats CountInk(const falcon::core::BinaryImage& binary) {
+  InkStats ink;
+  const auto width = static_cast<std::size_t>(binary.width);
+  for (int y = 0; y < binary.height; ++y) {
+    const uint8_t* row = binary.data.data() + static_cast<std::size_t>(y) * width;
+    uint8_t previous = 0;
+    for (std::size_t x = 0; x < width; ++x) {
+      ink.pixels += row[x];
+      ink.runs += row[x] & (previous ^ 1U);
+      previous = row[x];
+    }
+  }
+  return ink;
+}
+
+// Worst case of what labeling adds to EstimateSegmentBytes for a binary image of `size`: the
+// component list and, untiled, the BFS queue, which holds one whole component (at most every ink
+// pixel). Tiled labeling keeps every piece of a component twice (per tile, then merged) with its
+// seed and union-find entries; a run cut by tile edges is one piece per tile it crosses.
+std::size_t EstimateLabelBytes(falcon::core::SizeI size, const InkStats& ink, int tile_size) {
+  constexpr std::size_t kComponentBytes = sizeof(falcon::core::ConnectedComponent);
+  const std::size_t components = ink.runs * kComponentBytes;
+  if (tile_size <= 0) {
+    return components + ink.pixels * sizeof(falcon::core::PointI);
+  }
+  const std::size_t columns = static_cast<std::size_t>((size.width + tile_size - 1) / tile_size);
+  const std::size_t pieces = ink.runs + static_cast<std::size_t>(size.height) * (columns - 1);
+  return components + pieces * (2 * (kComponentBytes + sizeof(falcon::core::PointI)) + 2 * sizeof(uint32_t));
+}
+
+// Tile size tried under a memory budget when the configured strategy does not fit.
+int FallbackTileSize(const OcrOptions& options, int configured) {
+  return options.parallel && configured == 0 ? kBudgetTileSize : configured;
+}
+
+MemoryPlan BasePlan(int dpi_x, int dpi_y, const OcrOptions& options) {
+  MemoryPlan plan;
+  if (options.target_dpi > 0) {
+    plan.factor_x = std::max(1, dpi_x / options.target_dpi);
+    plan.factor_y = std::max(1, dpi_y / options.target_dpi);
+  }
+  plan.tile_size = options.parallel ? std::max(options.tile_size, 0) : 0;
+  return plan;
+}
+
+// Under a budget, the first of: the configured strategy, tiled labeling, and further whole-factor
+// reductions down to kMinBudgetDpi, starting at reduction `first_extra`. Leaves `plan` alone and
+// lowers `smallest` to the smallest estimate seen when nothing fits.
+bool FindPlan(falcon::core::SizeI size, int dpi_x, int dpi_y, const OcrOptions& options, int first_extra,
+              MemoryPlan& plan, std::size_t& smallest) {
+  const MemoryPlan base = BasePlan(dpi_x, dpi_y, options);
+  const int configured_tiles = base.tile_size;
+  const int fallback_tiles = FallbackTileSize(options, configured_tiles);
+  for (int extra = first_extra;; ++extra) {
+    const int factor_x = base.factor_x * extra;
+    const int factor_y = base.factor_y * extra;
+    if (extra > 1 && (dpi_x / factor_x < kMinBudgetDpi || dpi_y / factor_y < kMinBudgetDpi)) {
+      return false;
+    }
+    for (const int tile_size : {configured_tiles, fallback_tiles}) {
+      const std::size_t bytes = EstimateSegmentBytes(size, factor_x, factor_y, tile_size, options.cleanup);
+      if (bytes <= options.memory_budget) {
+        plan = MemoryPlan{factor_x, factor_y, tile_size, extra, bytes};
+        return true;
+      }
+      smallest = std::min(smallest, bytes);
+    }
+  }
+}
+
+// Reduction towards options.target_dpi, then under a budget the first plan FindPlan accepts.
+MemoryPlan PlanMemory(falcon::core::SizeI size, int dpi_x, int dpi_y, const OcrOptions& options) {
+  MemoryPlan plan = BasePlan(dpi_x, dpi_y, options);
+  if (options.memory_budget == 0) {
+    return plan;
+  }
+  std::size_t smallest = std::numeric_limits<std::size_t>::max();
+  if (FindPlan(size, dpi_x, dpi_y, options, 1, plan, smallest)) {
+    return plan;
+  }
+  throw MemoryBudgetError("A " + std::to_string(size.width) + "x" + std::to_string(size.height) +
+                              " page needs at least " + Mebibytes(smallest) + " for OCR, over the " +
+                              Mebibytes(options.memory_budget) + " memory budget",
+                          smallest, options.memory_budget);
+}
 
+// Estimate through labeling of `binary`, reduced from a `size` page as `plan` says, including what
+// grows with the ink. Switches `plan` to tiles when only a tiled pass fits options.memory_budget.
+std::size_t FitLabeling(const falcon::core::BinaryImage& binary, falcon::core::SizeI size, const OcrOptions& options,
+                        MemoryPlan& plan) {
+  const InkStats ink = CountInk(binary);
+  const falcon::core::SizeI binary_size{binary.width, binary.height};
+  const auto bytes_for = [&](int tile_size) {
+    return EstimateSegmentBytes(size, plan.factor_x, plan.factor_y, tile_size, options.cleanup) +
+           EstimateLabelBytes(binary_size, ink, tile_size);
+  };
+  std::size_t bytes = bytes_for(plan.tile_size);
+  const int fallback = FallbackTileSize(options, plan.tile_size);
+  if (bytes > options.memory_budget && fallback != plan.tile_size) {
+    const std::size_t tiled = bytes_for(fallback);
+    if (tiled <= options.memory_budget) {
+      plan.tile_size = fallback;
+    }
+    bytes = std::min(bytes, tiled);
+  }
+  plan.bytes = bytes;
+  return bytes;
+}
+
+// What recognizing `glyphs` components adds to the working set: their glyph batch and results,
+// less what `context` already holds of either.
+std::size_t RecognitionBytes(const OcrOptions& options, OcrContext& context, std::size_t glyphs) {
+  const std::size_t glyph_bytes = glyphs * static_cast<std::size_t>(options.glyph_size) * options.glyph_size;
+  const std::size_t result_bytes = glyphs * sizeof(falcon::core::ClassificationResult);
+  const auto growth = [](std::size_t needed, std::size_t held) { return needed > held ? needed - held : 0; };
+  const std::size_t held_glyph_bytes = options.glyph_size == 8    ? context.Sized<8>().glyphs.cells.capacity()
+                                       : options.glyph_size == 32 ? context.Sized<32>().glyphs.cells.capacity()
+                                                                  : context.Sized<16>().glyphs.cells.capacity();
+  return growth(glyph_bytes, held_glyph_bytes) +
+         growth(result_bytes, context.classifications.capacity() * sizeof(falcon::core::ClassificationResult));
+}
+
+falcon::core::RectI ScaleDown(const falcon::core::RectI& rect, int factor_x, int factor_y) {
+  const int x = rect.x / factor_x;
+  const int y = rect.y / factor_y;
+  return falcon::core::RectI{x, y, (rect.Right() + factor_x - 1) / factor_x - x,
+                             (rect.Bottom() + factor_y - 1) / factor_y - y};
+}
+
+OcrPage StoppedPage(const falcon::core::RasterView& raster, OcrStatus status, const OcrMemoryUsage& memory) {
   OcrPage page;
   page.image_size = raster.Size();
+  page.status = status;
+  page.memory = memory;
+  return page;
+}
 
-  const int line_merge_threshold = falcon::core::kGlyphSize * 2;
+OcrPage RunPipeline(const falcon::core::RasterView& raster, const OcrOptions& options, OcrContext& context,
+                    OcrControl* control, LineSink* sink) {
+  if (raster.Empty()) {
+    throw std::invalid_argument("RunOcr requires a non-empty raster");
+  }
+  if (!falcon::core::IsSupportedGlyphSize(options.glyph_size)) {
+    throw std::invalid_argument("RunOcr supports glyph sizes of 8, 16 and 32");
+  }
 
-  for (const auto& component : components) {
-    const falcon::core::GlyphBitmap glyph_bitmap = falcon::core::NormalizeGlyph(binary, component.bounds);
-    falcon::core::ClassificationResult classification = falcon::core::ClassifyGlyph(glyph_bitmap, templates);
+  FALCON_TRACE_SCOPE("ocr.page");
+  const auto stopped = [control] { return control != nullptr ? control->Check() : OcrStatus::kComplete; };
+  if (control != nullptr) {
+    control->BeginStage(OcrStage::kPreprocess);
+  }
+
+  const std::size_t budget = options.memory_budget;
+  const std::size_t input_bytes = PixelCount(raster.Size());
+  if (budget > 0 && input_bytes + context.ScratchBytes() > budget) {
+    // Capacity left over from a larger page would count against this one.
+    context.ReleaseScratch();
+  }
+  MemoryPlan plan = PlanMemory(raster.Size(), raster.dpi_x, raster.dpi_y, options);
+  const auto working_set = [&] { return input_bytes + context.ScratchBytes(); };
+  const auto enforce = [&](const char* stage, std::size_t bytes) {
+    if (budget > 0 && bytes > budget) {
+      throw MemoryBudgetError(std::string(stage) + " needs " + Mebibytes(bytes) + ", over the " + Mebibytes(budget) +
+                                  " memory budget",
+                              bytes, budget);
+    }
+  };
+  OcrMemoryUsage memory;
+
+  // Region requests keep the page analysis, so the next region of the same raster (identified by
+  // its pixels, not its address) skips reduction, binarization and segmentation.
+  auto& kept = context.analysis;
+  OcrContext::PageAnalysis* analysis = options.has_region ? &kept : nullptr;
+  uint64_t content_hash = 0;
+  if (analysis != nullptr) {
+    FALCON_TRACE_SCOPE("ocr.page_hash");
+    content_hash = ContentHash(raster);
+  }
+  bool reuse = analysis != nullptr && kept.valid && kept.content_hash == content_hash &&
+               kept.size.width == raster.width && kept.size.height == raster.height && kept.dpi_x == raster.dpi_x &&
+               kept.dpi_y == raster.dpi_y && kept.factor_x == plan.factor_x && kept.factor_y == plan.factor_y &&
+               kept.cleanup == options.cleanup;
+  const falcon::core::BinaryImage& binary = context.binary;
+  auto& components = context.components;
+  for (;;) {
+    if (!reuse) {
+      kept.valid = false;
+      for (;;) {
+        falcon::core::RasterView reduced = raster;
+        if (plan.factor_x > 1 || plan.factor_y > 1) {
+          FALCON_TRACE_SCOPE("ocr.reduce");
+          reduced = Reduce(raster, plan.factor_x, plan.factor_y, context);
+        }
+        {
+          FALCON_TRACE_SCOPE("ocr.binarize");
+          if (plan.tile_size > 0) {
+            falcon::core::BinarizeOtsuParallel(reduced, context.binary, plan.tile_size);
+          } else {
+            falcon::core::BinarizeOtsu(reduced, context.binary);
+          }
+        }
+        if (options.cleanup.Enabled()) {
+          FALCON_TRACE_SCOPE("ocr.cleanup");
+          falcon::core::CleanupBinaryImage(context.binary, options.cleanup, context.morphology);
+        }
+        if (budget == 0) {
+          break;
+        }
+        // The BFS queue and the component lists grow with the ink, so they are bounded from the
+        // binary image before labeling allocates them. Tiles are tried when a whole-page pass does
+        // not fit, then the next coarser plan.
+        const std::size_t bytes = FitLabeling(context.binary, raster.Size(), options, plan);
+        if (bytes <= budget) {
+          break;
+        }
+        std::size_t smallest = bytes;
+        if (!FindPlan(raster.Size(), raster.dpi_x, raster.dpi_y, options, plan.extra + 1, plan, smallest)) {
+          enforce("Segmentation", bytes);
+        }
+        // Buffers sized for the finer plan would count against the coarser one.
+        context.ReleaseScratch();
+      }
+    }
+    memory.preprocess = working_set();
+    if (const auto status = stopped(); status != OcrStatus::kComplete) {
+      return StoppedPage(raster, status, memory);
+    }
+    if (control != nullptr) {
+      control->BeginStage(OcrStage::kSegment);
+    }
+    if (reuse) {
+      SelectRegion(kept, ScaleDown(options.region, plan.factor_x, plan.factor_y), components);
+    } else {
+      FALCON_TRACE_SCOPE("ocr.segment");
+      if (plan.tile_size > 0) {
+        falcon::core::ConnectedComponentsTiled(binary, plan.tile_size, context.tiles, components);
+      } else {
+        falcon::core::ConnectedComponents(binary, context.segment, components);
+      }
+      if (analysis != nullptr) {
+        RecordAnalysis(kept, binary, components);
+        kept.content_hash = content_hash;
+        kept.size = raster.Size();
+        kept.dpi_x = raster.dpi_x;
+        kept.dpi_y = raster.dpi_y;
+        kept.factor_x = plan.factor_x;
+        kept.factor_y = plan.factor_y;
+        kept.cleanup = options.cleanup;
+        SelectRegion(kept, ScaleDown(options.region, plan.factor_x, plan.factor_y), components);
+      }
+    }
+    memory.segment = working_set();
+    // Recognition needs a glyph and a result per component on top of this; a page that labels into
+    // more glyphs than fit starts over on the next coarser plan.
+    if (reuse || budget == 0 || memory.segment + RecognitionBytes(options, context, components.size()) <= budget) {
+      break;
+    }
+    std::size_t smallest = budget;
+    if (!FindPlan(raster.Size(), raster.dpi_x, raster.dpi_y, options, plan.extra + 1, plan, smallest)) {
+      break;
+    }
+    context.ReleaseScratch();
+    if (control != nullptr) {
+      control->BeginStage(OcrStage::kPreprocess);
+    }
+  }
+  const int factor_x = plan.factor_x;
+  const int factor_y = plan.factor_y;
+  enforce("Segmentation", memory.segment);
+  auto& index = CachedTemplateIndex(CachedTemplateSet(context, options), options);
+  if (index.templates.empty()) {
+    throw std::runtime_error("No glyph templates available for requested languages and charset");
+  }
 
-    if (options.ascii_only && classification.codepoint > 0x7F) {
-      classification.codepoint = U'?';
+  if (analysis != nullptr) {
+    if (const uint64_t key = ClassificationKey(options, context.templates.Current()); key != kept.classify_key) {
+      std::fill(kept.classified_mask.begin(), kept.classified_mask.end(), uint64_t{0});
+      kept.classify_key = key;
     }
+  }
 
-    if (page.lines.empty() ||
-        component.bounds.y > page.lines.back().characters.back().bounds.y + line_merge_threshold) {
-      page.lines.push_back(OcrLine{});
+  if (const auto status = stopped(); status != OcrStatus::kComplete) {
+    return StoppedPage(raster, status, memory);
+  }
+  if (control != nullptr) {
+    control->BeginStage(OcrStage::kLayout);
+  }
+  auto& blocks = context.blocks;
+  {
+    FALCON_TRACE_SCOPE("ocr.layout");
+    falcon::core::AnalyzeLayout(components, options.layout, context.layout, blocks, context.lines);
+  }
+
+  // Blocks are independent; large ones are split so the pool stays balanced.
+  auto& tasks = context.tasks;
+  tasks.clear();
+  for (const auto& block : blocks) {
+    for (std::size_t begin = block.begin; begin < block.end; begin += kGlyphsPerTask) {
+      tasks.emplace_back(begin, std::min(begin + kGlyphsPerTask, block.end));
     }
+  }
+  memory.layout = working_set();
+  if (budget > 0) {
+    // Fail before the glyph batch is allocated rather than after.
+    enforce("Recognition", memory.layout + RecognitionBytes(options, context, components.size()));
+  }
 
-    OcrChar ocr_char;
-    ocr_char.bounds = component.bounds;
-    ocr_char.classification = classification;
-    page.lines.back().characters.push_back(ocr_char);
+  OcrPage page;
+  page.image_size = raster.Size();
+  PageAssembler assembler(context, page, factor_x, factor_y, sink);
+  FALCON_TRACE_SCOPE("ocr.recognize");
+  switch (options.glyph_size) {
+    case 8:
+      RecognizeComponents<8>(binary, options, index, context, control, assembler, analysis);
+      break;
+    case 32:
+      RecognizeComponents<32>(binary, options, index, context, control, assembler, analysis);
+      break;
+    default:
+      RecognizeComponents<16>(binary, options, index, context, control, assembler, analysis);
+      break;
+  }
+  const auto& recognized = context.recognized;
+  const bool partial =
+      control != nullptr && std::find(recognized.begin(), recognized.end(), uint8_t{0}) != recognized.end();
+  page.status = partial ? stopped() : OcrStatus::kComplete;
+  memory.recognize = working_set();
+  page.memory = memory;
+  assembler.Finish(partial);
+  if (control != nullptr) {
+    control->BeginStage(OcrStage::kDone);
   }
+  return page;
+}
+
+}  // namespace
+
+OcrPage RunOcr(const falcon::core::Raster& raster, const OcrOptions& options) {
+  return RunOcr(raster, options, ThreadLocalContext());
+}
+
+OcrPage RunOcr(const falcon::core::Raster& raster, const OcrOptions& options, OcrContext& context) {
+  return RunPipeline(raster, options, context, nullptr, nullptr);
+}
+
+OcrPage RunOcr(const falcon::core::RasterView& image, const OcrOptions& options, OcrContext& context,
+               OcrControl* control) {
+  return RunPipeline(image, options, context, control, nullptr);
+}
+
+OcrPage RunOcr(const falcon::core::Raster& raster, const OcrOptions& options, OcrControl& control) {
+  return RunPipeline(raster, options, ThreadLocalContext(), &control, nullptr);
+}
+
+OcrPage RunOcr(const falcon::core::Raster& raster, const OcrOptions& options, OcrContext& context,
+               OcrControl& control) {
+  return RunPipeline(raster, options, context, &control, nullptr);
+}
+
+OcrPage RunOcr(const falcon::core::Raster& raster, const OcrOptions& options, LineSink& sink) {
+  return RunOcr(raster, options, ThreadLocalContext(), sink);
+}
 
+OcrPage RunOcr(const falcon::core::Raster& raster, const OcrOptions& options, OcrContext& context, LineSink& sink,
+               OcrControl* control) {
+  sink.BeginPage(raster.Size());
+  OcrPage page;
+  try {
+    page = RunPipeline(raster, options, context, control, &sink);
+  } catch (...) {
+    sink.AbortPage();
+    throw;
+  }
+  sink.EndPage(page);
   return page;
 }
 
+void CheckMemoryBudget(falcon::core::SizeI size, int dpi_x, int dpi_y, const OcrOptions& options) {
+  PlanMemory(size, dpi_x, dpi_y, options);
+}
+
+PlannedReduction PlanReduction(falcon::core::SizeI size, int dpi_x, int dpi_y, const OcrOptions& options) {
+  const MemoryPlan plan = PlanMemory(size, dpi_x, dpi_y, options);
+  PlannedReduction reduction{plan.factor_x, plan.factor_y, false};
+  if (options.memory_budget == 0) {
+    return reduction;
+  }
+  // FitLabeling only moves to a coarser plan when neither tiling fits the page's ink, and RunOcr
+  // when its glyphs do not fit beside it; bound the ink by every pixel set and a run in every other
+  // column, and the glyphs by the runs.
+  falcon::core::SizeI reduced = size;
+  ForEachReduction(plan.factor_x, plan.factor_y, [&](int fx, int fy) {
+    reduced = {(reduced.width + fx - 1) / fx, (reduced.height + fy - 1) / fy};
+  });
+  const InkStats worst{PixelCount(reduced),
+                       static_cast<std::size_t>((reduced.width + 1) / 2) * static_cast<std::size_t>(reduced.height)};
+  const std::size_t glyph_bytes =
+      worst.runs * (static_cast<std::size_t>(options.glyph_size) * options.glyph_size +
+                    sizeof(falcon::core::ClassificationResult));
+  const auto bytes_for = [&](int tile_size) {
+    return EstimateSegmentBytes(size, plan.factor_x, plan.factor_y, tile_size, options.cleanup) +
+           EstimateLabelBytes(reduced, worst, tile_size) + glyph_bytes;
+  };
+  reduction.ink_dependent = std::min(bytes_for(plan.tile_size), bytes_for(FallbackTileSize(options, plan.tile_size))) >
+                            options.memory_budget;
+  return reduction;
+}
+
+falcon::core::Raster LoadImageForOcr(const std::filesystem::path& path, const OcrOptions& options) {
+  if (options.memory_budget > 0) {
+    const auto info = falcon::core::ProbeImage(path);
+    CheckMemoryBudget(info.size, info.dpi_x, info.dpi_y, options);
+  }
+  return falcon::core::LoadImage(path);
+}
+
+falcon::core::Raster DecodeImageForOcr(const std::vector<uint8_t>& bytes, const OcrOptions& options) {
+  if (options.memory_budget > 0) {
+    const auto info = falcon::core::ProbeImage(bytes);
+    CheckMemoryBudget(info.size, info.dpi_x, info.dpi_y, options);
+  }
+  return falcon::core::DecodeImage(bytes);
+}
+
+std::string PageText(const OcrPage& page) {
+  std::string text;
+  for (const auto& line : page.lines) {
+    for (const auto& ch : line.characters) {
+      falcon::util::AppendUtf8(text, ch.classification.codepoint);
+    }
+    text.push_back('\n');
+  }
+  return text;
+}
+
 }  // namespace falcon::ocr
@@ -0,0 +1,429 @@
+#include "falcon/ocr/ResultCache.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <system_error>
+#include <utility>
+
+#include "falcon/core/Image.h"
+#include "falcon/core/PackRegistry.h"
+#include "falcon/ocr/CompactPage.h"
+#include "falcon/ocr/Pipeline.h"
+#include "falcon/util/Hash.h"
+
+namespace falcon::ocr {
+
+namespace {
+
+constexpr char kEntryMagic[4] = {'F', 'O', 'C', 'R'};
+constexpr uint32_t kEntryVersion = 2;
+constexpr const char* kEntryExtension = ".page";
+constexpr const char* kTempExtension = ".tmp";
+// Writers rename their temporary file within moments; one this old belongs to a crashed writer.
+constexpr auto kStaleTempAge = std::chrono::minutes(10);
+
+void Put32(std::vector<uint8_t>& out, uint32_t value) {
+  for (int i = 0; i < 4; ++i) {
+    out.push_back(static_cast<uint8_t>(value >> (8 * i)));
+  }
+}
+
+// Little-endian reader that throws instead of running past the end.
+class Reader {
+ public:
+  Reader(const uint8_t* data, std::size_t size) : data_(data), size_(size) {}
+
+  uint32_t Get32() {
+    if (size_ - offset_ < 4) {
+      throw std::runtime_error("Cached page truncated");
+    }
+    uint32_t value = 0;
+    for (int i = 0; i < 4; ++i) {
+      value |= static_cast<uint32_t>(data_[offset_ + i]) << (8 * i);
+    }
+    offset_ += 4;
+    return value;
+  }
+
+ private:
+  const uint8_t* data_;
+  std::size_t size_;
+  std::size_t offset_{0};
+};
+
+std::string EntryName(const ResultCacheKey& key) {
+  char name[64];
+  std::snprintf(name, sizeof(name), "%016llx-%llx-%016llx", static_cast<unsigned long long>(key.content),
+                static_cast<unsigned long long>(key.content_size), static_cast<unsigned long long>(key.config));
+  return name;
+}
+
+// What the memory budget does to a page with header `info` (null if it cannot be probed): nothing
+// when it leaves the reduction to target_dpi, the reduction it plans when the ink cannot change
+// it, and the budget itself otherwise. Pages the budget rejects are never stored.
+void AddBudget(falcon::util::Hasher& hasher, const OcrOptions& options, const falcon::core::ImageInfo* info) {
+  if (options.memory_budget == 0) {
+    return;
+  }
+  if (info != nullptr) {
+    try {
+      const auto planned = PlanReduction(info->size, info->dpi_x, info->dpi_y, options);
+      if (!planned.ink_dependent) {
+        OcrOptions unbudgeted = options;
+        unbudgeted.memory_budget = 0;
+        const auto base = PlanReduction(info->size, info->dpi_x, info->dpi_y, unbudgeted);
+        if (planned.factor_x != base.factor_x || planned.factor_y != base.factor_y) {
+          hasher.Add(uint64_t{1}).Add(planned.factor_x).Add(planned.factor_y);
+        }
+        return;
+      }
+    } catch (const MemoryBudgetError&) {
+    }
+  }
+  hasher.Add(uint64_t{2}).Add(static_cast<uint64_t>(options.memory_budget));
+}
+
+}  // namespace
+
+uint64_t OptionsFingerprint(const OcrOptions& options) {
+  falcon::util::Hasher hasher(kEntryVersion);
+  hasher.Add(static_cast<uint64_t>(options.languages.size()));
+  for (const auto& language : options.languages) {
+    hasher.Add(std::string_view(language));
+  }
+  hasher.Add(options.script_probe_glyphs).Add(options.script_min_confidence);
+  hasher.Add(static_cast<uint64_t>(options.charset.Ranges().size()));
+  for (const auto& range : options.charset.Ranges()) {
+    hasher.Add(range.first).Add(range.last);
+  }
+  hasher.Add(options.ascii_only).Add(options.detect_orientation).Add(options.has_region);
+  if (options.has_region) {
+    hasher.Add(options.region.x).Add(options.region.y).Add(options.region.width).Add(options.region.height);
+  }
+  const auto& cleanup = options.cleanup;
+  for (const auto& element : {cleanup.opening, cleanup.closing}) {
+    hasher.Add(element.radius_x).Add(element.radius_y).Add(element.shape);
+  }
+  hasher.Add(cleanup.despeckle_size);
+  const auto& layout = options.layout;
+  hasher.Add(layout.reject_non_text)
+      .Add(static_cast<uint64_t>(layout.min_area))
+      .Add(layout.min_text_height)
+      .Add(layout.max_height_ratio)
+      .Add(layout.rule_length_ratio)
+      .Add(layout.rule_thickness_ratio)
+      .Add(layout.speck_ratio)
+      .Add(layout.block_gap_ratio)
+      .Add(layout.column_gap_ratio)
+      .Add(layout.min_line_spacing)
+      .Add(layout.min_line_height_ratio)
+      .Add(static_cast<uint64_t>(layout.halftone_min_components))
+      .Add(layout.halftone_height_ratio);
+  hasher.Add(options.target_dpi).Add(options.template_merge_pixels).Add(options.glyph_size);
+  return hasher.Digest();
+}
+
+uint64_t TemplateFingerprint(const std::vector<falcon::core::GlyphTemplate>& templates) {
+  falcon::util::Hasher hasher;
+  hasher.Add(static_cast<uint64_t>(templates.size()));
+  for (const auto& glyph : templates) {
+    hasher.Add(glyph.codepoint).Add(glyph.bitmap.data(), glyph.bitmap.size()).Add(std::string_view(glyph.language));
+  }
+  return hasher.Digest();
+}
+
+std::vector<uint8_t> SerializePage(const OcrPage& page) {
+  return CompactPage(page).Serialize();
+}
+
+OcrPage DeserializePage(const uint8_t* data, std::size_t size) {
+  return CompactPage::Deserialize(data, size).ToPage();
+}
+
+ResultCache::ResultCache(std::filesystem::path directory, std::size_t max_bytes)
+    : directory_(std::move(directory)), max_bytes_(max_bytes) {
+  std::filesystem::create_directories(directory_);
+  auto found = Scan();
+  std::lock_guard<std::mutex> lock(mutex_);
+  IndexLocked(std::move(found));
+  last_scan_ = std::chrono::steady_clock::now();
+  EvictLocked();
+}
+
+uint64_t ResultCache::ConfigFingerprint(const OcrOptions& options, const falcon::core::ImageInfo* info) {
+  const uint64_t generation = falcon::core::PackRegistry::Shared().Generation();
+  uint64_t templates;
+  {
+    std::lock_guard<std::mutex> lock(template_mutex_);
+    if (!template_valid_ || template_generation_ != generation || template_languages_ != options.languages) {
+      // Same selection RunOcr merges, served from the pack registry.
+      template_fingerprint_ = TemplateFingerprint(falcon::core::CollectGlyphTemplates(options.languages, true));
+      template_languages_ = options.languages;
+      template_generation_ = generation;
+      template_valid_ = true;
+    }
+    templates = template_fingerprint_;
+  }
+  falcon::util::Hasher hasher(OptionsFingerprint(options));
+  hasher.Add(templates);
+  AddBudget(hasher, options, info);
+  return hasher.Digest();
+}
+
+ResultCacheKey ResultCache::KeyFor(const std::vector<uint8_t>& file_bytes, const OcrOptions& options) {
+  ResultCacheKey key;
+  key.content = falcon::util::Hash64(file_bytes.data(), file_bytes.size());
+  key.content_size = file_bytes.size();
+  falcon::core::ImageInfo info;
+  bool probed = false;
+  if (options.memory_budget > 0) {
+    try {
+      info = falcon::core::ProbeImage(file_bytes);
+      probed = true;
+    } catch (const std::exception&) {
+      // Not an image RunOcr can read; the key only has to be stable.
+    }
+  }
+  key.config = ConfigFingerprint(options, probed ? &info : nullptr);
+  return key;
+}
+
+ResultCacheKey ResultCache::KeyFor(const falcon::core::Raster& raster, const OcrOptions& options) {
+  // Seeded apart from file hashes; DPI is part of the content since it drives reduction.
+  falcon::util::Hasher hasher(0x5241535445520000ULL);
+  hasher.Add(raster.width).Add(raster.height).Add(raster.dpi_x).Add(raster.dpi_y);
+  hasher.Add(raster.pixels.data(), raster.pixels.size());
+  ResultCacheKey key;
+  key.content = hasher.Digest();
+  key.content_size = raster.pixels.size();
+  const falcon::core::ImageInfo info{raster.Size(), raster.dpi_x, raster.dpi_y};
+  key.config = ConfigFingerprint(options, &info);
+  return key;
+}
+
+bool ResultCache::Lookup(const ResultCacheKey& key, OcrPage& page) {
+  const std::string name = EntryName(key);
+  bool indexed = false;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    const auto it = entries_.find(name);
+    if (it != entries_.end()) {
+      TouchLocked(name, it->second);
+      indexed = true;
+    }
+  }
+  if (!indexed) {
+    // Another process may have stored it since the directory was indexed.
+    std::error_code error;
+    const auto size = std::filesystem::file_size(PathFor(name), error);
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (error) {
+      ++stats_.misses;
+      return false;
+    }
+    auto it = entries_.find(name);
+    if (it == entries_.end()) {
+      it = entries_.emplace(name, Entry{static_cast<std::size_t>(size), 0}).first;
+      bytes_ += it->second.bytes;
+    }
+    TouchLocked(name, it->second);
+  }
+
+  std::vector<uint8_t> bytes;
+  {
+    std::ifstream file(PathFor(name), std::ios::binary);
+    bytes.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+  }
+  try {
+    if (bytes.size() < 8 || std::memcmp(bytes.data(), kEntryMagic, sizeof(kEntryMagic)) != 0) {
+      throw std::runtime_error("Not a cached page");
+    }
+    Reader header(bytes.data() + 4, 4);
+    if (header.Get32() != kEntryVersion) {
+      throw std::runtime_error("Cached page version mismatch");
+    }
+    page = DeserializePage(bytes.data() + 8, bytes.size() - 8);
+  } catch (const std::exception&) {
+    // Removed by another process, or damaged: recompute and let Store replace it.
+    std::lock_guard<std::mutex> lock(mutex_);
+    EraseLocked(name);
+    ++stats_.misses;
+    return false;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    ++stats_.hits;
+  }
+  TouchFile(name);
+  return true;
+}
+
+void ResultCache::Store(const ResultCacheKey& key, const OcrPage& page) {
+  if (page.status != OcrStatus::kComplete) {
+    return;
+  }
+  const std::string name = EntryName(key);
+  std::vector<uint8_t> bytes(std::begin(kEntryMagic), std::end(kEntryMagic));
+  Put32(bytes, kEntryVersion);
+  const auto body = SerializePage(page);
+  bytes.insert(bytes.end(), body.begin(), body.end());
+  if (bytes.size() > max_bytes_) {
+    return;
+  }
+
+  std::filesystem::path temp;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (entries_.count(name) != 0) {
+      return;
+    }
+    temp = directory_ / (name + kTempExtension + std::to_string(++temp_counter_) + "-" +
+                         std::to_string(reinterpret_cast<std::uintptr_t>(this)));
+  }
+  std::error_code exists_error;
+  if (std::filesystem::exists(PathFor(name), exists_error)) {
+    return;  // stored by another process
+  }
+  {
+    std::ofstream file(temp, std::ios::binary);
+    file.write(reinterpret_cast<const char*>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+    if (!file) {
+      std::error_code error;
+      std::filesystem::remove(temp, error);
+      return;
+    }
+  }
+  std::error_code error;
+  std::filesystem::rename(temp, PathFor(name), error);
+  if (error) {
+    std::filesystem::remove(temp, error);
+    return;
+  }
+
+  const auto now = std::chrono::steady_clock::now();
+  bool rescan = false;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    ++stats_.stores;
+    if (entries_.count(name) == 0) {
+      const Entry entry{bytes.size(), ++clock_};
+      bytes_ += entry.bytes;
+      recency_.emplace(entry.stamp, name);
+      entries_.emplace(name, entry);
+    }
+    rescan = now - last_scan_ >= kRescanInterval;
+    if (rescan) {
+      last_scan_ = now;
+    } else {
+      EvictLocked();
+    }
+  }
+  if (rescan) {
+    // Other processes' entries count against max_bytes too; pick up what they stored meanwhile.
+    auto found = Scan();
+    std::lock_guard<std::mutex> lock(mutex_);
+    IndexLocked(std::move(found));
+    EvictLocked();
+  }
+}
+
+std::size_t ResultCache::Bytes() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return bytes_;
+}
+
+std::size_t ResultCache::Entries() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return entries_.size();
+}
+
+ResultCacheStats ResultCache::Stats() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return stats_;
+}
+
+std::vector<ResultCache::DiskEntry> ResultCache::Scan() {
+  std::vector<DiskEntry> found;
+  const auto now = std::filesystem::file_time_type::clock::now();
+  std::error_code error;
+  for (const auto& file : std::filesystem::directory_iterator(directory_, error)) {
+    if (!file.is_regular_file(error)) {
+      continue;
+    }
+    const auto extension = file.path().extension().string();
+    const auto time = file.last_write_time(error);
+    if (error) {
+      continue;
+    }
+    if (extension.compare(0, std::strlen(kTempExtension), kTempExtension) == 0) {
+      if (now - time > kStaleTempAge) {
+        std::filesystem::remove(file.path(), error);
+      }
+      continue;
+    }
+    if (extension != kEntryExtension) {
+      continue;
+    }
+    const auto bytes = file.file_size(error);
+    if (!error) {
+      found.push_back({time, file.path().stem().string(), static_cast<std::size_t>(bytes)});
+    }
+  }
+  std::sort(found.begin(), found.end(), [](const DiskEntry& a, const DiskEntry& b) { return a.time < b.time; });
+  return found;
+}
+
+void ResultCache::IndexLocked(std::vector<DiskEntry> found) {
+  entries_.clear();
+  recency_.clear();
+  bytes_ = 0;
+  for (auto& file : found) {
+    Entry entry{file.bytes, ++clock_};
+    bytes_ += entry.bytes;
+    recency_.emplace(entry.stamp, file.name);
+    entries_.emplace(std::move(file.name), entry);
+  }
+}
+
+std::filesystem::path ResultCache::PathFor(const std::string& name) const {
+  return directory_ / (name + kEntryExtension);
+}
+
+void ResultCache::TouchLocked(const std::string& name, Entry& entry) {
+  recency_.erase(entry.stamp);
+  entry.stamp = ++clock_;
+  recency_.emplace(entry.stamp, name);
+}
+
+void ResultCache::TouchFile(const std::string& name) const {
+  // Carries the recency over to the next process that indexes the directory.
+  std::error_code error;
+  std::filesystem::last_write_time(PathFor(name), std::filesystem::file_time_type::clock::now(), error);
+}
+
+void ResultCache::EraseLocked(const std::string& name) {
+  const auto it = entries_.find(name);
+  if (it == entries_.end()) {
+    return;
+  }
+  bytes_ -= it->second.bytes;
+  recency_.erase(it->second.stamp);
+  entries_.erase(it);
+  std::error_code error;
+  std::filesystem::remove(PathFor(name), error);
+}
+
+void ResultCache::EvictLocked() {
+  while (bytes_ > max_bytes_ && !recency_.empty()) {
+    const std::string name = recency_.begin()->second;
+    EraseLocked(name);
+    ++stats_.evictions;
+  }
+}
+
+}  // namespace falcon::ocr
@@ -0,0 +1,585 @@
+#include "falcon/ocr/Server.h"
+
+#ifndef _WIN32
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <deque>
+#include <stdexcept>
+#include <utility>
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "falcon/core/GlyphDB.h"
+#include "falcon/core/Image.h"
+#include "falcon/core/PackRegistry.h"
+#include "falcon/ocr/Pipeline.h"
+#include "falcon/util/ThreadPool.h"
+#include "falcon/util/Trace.h"
+
+namespace falcon::ocr {
+
+namespace {
+
+constexpr int kStopCheckMs = 100;
+constexpr int kListenBacklog = 128;
+constexpr std::size_t kMaxLineBytes = 64 * 1024;
+
+#ifdef MSG_NOSIGNAL
+constexpr int kSendFlags = MSG_NOSIGNAL;
+#else
+constexpr int kSendFlags = 0;
+#endif
+
+std::runtime_error SocketError(const std::string& what) {
+  return std::runtime_error(what + ": " + std::strerror(errno));
+}
+
+bool WriteAll(int fd, const char* data, std::size_t size) {
+  while (size > 0) {
+    const ssize_t written = send(fd, data, size, kSendFlags);
+    if (written < 0 && errno == EINTR) {
+      continue;
+    }
+    if (written <= 0) {
+      return false;
+    }
+    data += written;
+    size -= static_cast<std::size_t>(written);
+  }
+  return true;
+}
+
+bool WriteFrame(int fd, const std::string& header, const std::string& body) {
+  const std::string frame = header + ' ' + std::to_string(body.size()) + '\n' + body;
+  return WriteAll(fd, frame.data(), frame.size());
+}
+
+// Appends whatever the socket has to `buffer`; false on EOF or error.
+bool Fill(int fd, std::string& buffer) {
+  char chunk[64 * 1024];
+  for (;;) {
+    const ssize_t got = recv(fd, chunk, sizeof(chunk), 0);
+    if (got < 0 && errno == EINTR) {
+      continue;
+    }
+    if (got <= 0) {
+      return false;
+    }
+    buffer.append(chunk, static_cast<std::size_t>(got));
+    return true;
+  }
+}
+
+bool ReadLine(int fd, std::string& buffer, std::string& line) {
+  std::size_t end;
+  while ((end = buffer.find('\n')) == std::string::npos) {
+    if (buffer.size() > kMaxLineBytes || !Fill(fd, buffer)) {
+      return false;
+    }
+  }
+  line.assign(buffer, 0, end);
+  buffer.erase(0, end + 1);
+  if (!line.empty() && line.back() == '\r') {
+    line.pop_back();
+  }
+  return true;
+}
+
+bool ReadExact(int fd, std::string& buffer, std::size_t size, std::vector<uint8_t>& out) {
+  while (buffer.size() < size) {
+    if (!Fill(fd, buffer)) {
+      return false;
+    }
+  }
+  out.assign(buffer.begin(), buffer.begin() + static_cast<std::ptrdiff_t>(size));
+  buffer.erase(0, size);
+  return true;
+}
+
+bool Readable(int fd) {
+  pollfd descriptor{fd, POLLIN, 0};
+  return poll(&descriptor, 1, 0) > 0;
+}
+
+// Parses the byte count of `DATA <n>`, `OK <n>` and `ERR <n>` lines.
+bool ParseLength(const std::string& text, std::size_t& length) {
+  if (text.empty() || text.size() > 19 ||
+      !std::all_of(text.begin(), text.end(), [](char ch) { return ch >= '0' && ch <= '9'; })) {
+    return false;
+  }
+  length = static_cast<std::size_t>(std::stoull(text));
+  return true;
+}
+
+void SetCloseOnExec(int fd) {
+  fcntl(fd, F_SETFD, FD_CLOEXEC);
+}
+
+// Makes send() give up, failing the connection, once the client has taken nothing for `timeout`.
+void SetSendTimeout(int fd, std::chrono::milliseconds timeout) {
+  if (timeout.count() <= 0) {
+    return;
+  }
+  timeval value{};
+  value.tv_sec = static_cast<time_t>(timeout.count() / 1000);
+  value.tv_usec = static_cast<suseconds_t>(timeout.count() % 1000 * 1000);
+  setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &value, sizeof(value));
+}
+
+}  // namespace
+
+OcrServer::OcrServer(ServerOptions options)
+    : options_(std::move(options)), queue_(std::max<std::size_t>(options_.max_pending, 1)) {}
+
+OcrServer::~OcrServer() {
+  Stop();
+}
+
+void OcrServer::Start() {
+  if (batcher_.joinable()) {
+    return;
+  }
+  if (!options_.path_root.empty()) {
+    path_root_ = std::filesystem::canonical(options_.path_root);
+  }
+  Warm();
+  Bind();
+  if (options_.watch_packs) {
+    watcher_ = std::make_unique<falcon::core::PackWatcher>();
+    watcher_->Start();
+  }
+  stopping_ = false;
+  batcher_ = std::thread([this] { BatchLoop(); });
+  acceptor_ = std::thread([this] { AcceptLoop(); });
+}
+
+void OcrServer::Stop() {
+  if (!batcher_.joinable()) {
+    return;
+  }
+  stopping_ = true;
+  acceptor_.join();
+  close(listen_fd_);
+  listen_fd_ = -1;
+  if (!options_.socket_path.empty()) {
+    std::error_code error;
+    std::filesystem::remove(options_.socket_path, error);
+  }
+  {
+    // Unblocks connections waiting for their next request; queued work is still answered. A
+    // connection blocked sending to a client that stopped reading only wakes when its socket is
+    // shut down for writing too.
+    std::unique_lock<std::mutex> lock(connections_mutex_);
+    for (auto& connection : connections_) {
+      shutdown(connection.fd, SHUT_RD);
+    }
+    const auto all_done = [this] {
+      return std::all_of(connections_.begin(), connections_.end(),
+                         [](const Connection& connection) { return connection.done.load(); });
+    };
+    if (!connections_done_.wait_for(lock, options_.stop_grace, all_done)) {
+      for (auto& connection : connections_) {
+        if (!connection.done) {
+          shutdown(connection.fd, SHUT_RDWR);
+        }
+      }
+    }
+  }
+  ReapConnections(true);
+  queue_.Close();
+  batcher_.join();
+  if (watcher_) {
+    watcher_->Stop();
+    watcher_.reset();
+  }
+}
+
+ServerStats OcrServer::Stats() const {
+  ServerStats stats;
+  stats.requests = requests_.load();
+  stats.failed = failed_.load();
+  stats.batches = batches_.load();
+  stats.rejected_connections = rejected_.load();
+  return stats;
+}
+
+// Loads the packs and builds the template index of every pool thread up front, so the first
+// requests do not pay for parsing. Recognizing a blank page also validates the options.
+void OcrServer::Warm() {
+  auto& registry = falcon::core::PackRegistry::Shared();
+  registry.Warm(options_.ocr.languages.empty() ? falcon::core::DiscoverLanguagePacks() : options_.ocr.languages);
+
+  falcon::core::Raster blank;
+  blank.width = 8;
+  blank.height = 8;
+  blank.pixels.assign(64, 0);
+  RunOcr(blank, options_.ocr);
+  auto options = options_.ocr;
+  options.parallel = false;
+  auto& pool = falcon::util::ThreadPool::Shared();
+  pool.ParallelFor(pool.WorkerCount() + 1, [&](std::size_t) { RunOcr(blank, options); });
+}
+
+void OcrServer::Bind() {
+  if (!options_.socket_path.empty()) {
+    const std::string path = options_.socket_path.string();
+    sockaddr_un address{};
+    if (path.size() >= sizeof(address.sun_path)) {
+      throw std::runtime_error("Socket path too long: " + path);
+    }
+    address.sun_family = AF_UNIX;
+    std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+    listen_fd_ = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listen_fd_ < 0) {
+      throw SocketError("socket");
+    }
+    // A socket file left behind by a previous run would make bind fail.
+    std::error_code error;
+    if (std::filesystem::is_socket(options_.socket_path, error)) {
+      std::filesystem::remove(options_.socket_path, error);
+    }
+    if (bind(listen_fd_, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0) {
+      const auto failure = SocketError("Cannot bind " + path);
+      close(listen_fd_);
+      listen_fd_ = -1;
+      throw failure;
+    }
+  } else {
+    listen_fd_ = socket(AF_INET, SOCK_STREAM, 0);
+    if (listen_fd_ < 0) {
+      throw SocketError("socket");
+    }
+    const int enable = 1;
+    setsockopt(listen_fd_, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable));
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = htons(static_cast<uint16_t>(options_.tcp_port));
+    if (bind(listen_fd_, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0) {
+      const auto failure = SocketError("Cannot bind 127.0.0.1:" + std::to_string(options_.tcp_port));
+      close(listen_fd_);
+      listen_fd_ = -1;
+      throw failure;
+    }
+    socklen_t length = sizeof(address);
+    getsockname(listen_fd_, reinterpret_cast<sockaddr*>(&address), &length);
+    port_ = ntohs(address.sin_port);
+  }
+  SetCloseOnExec(listen_fd_);
+  if (listen(listen_fd_, kListenBacklog) != 0) {
+    const auto failure = SocketError("listen");
+    close(listen_fd_);
+    listen_fd_ = -1;
+    throw failure;
+  }
+}
+
+void OcrServer::AcceptLoop() {
+  while (!stopping_) {
+    pollfd descriptor{listen_fd_, POLLIN, 0};
+    const int ready = poll(&descriptor, 1, kStopCheckMs);
+    ReapConnections(false);
+    if (ready <= 0) {
+      continue;
+    }
+    const int fd = accept(listen_fd_, nullptr, nullptr);
+    if (fd < 0) {
+      continue;
+    }
+    SetCloseOnExec(fd);
+    SetSendTimeout(fd, options_.send_timeout);
+    std::lock_guard<std::mutex> lock(connections_mutex_);
+    if (connections_.size() >= options_.max_connections) {
+      ++rejected_;
+      WriteFrame(fd, "ERR", "server busy");
+      close(fd);
+      continue;
+    }
+    auto& connection = connections_.emplace_back();
+    connection.fd = fd;
+    connection.thread = std::thread([this, &connection] {
+      falcon::util::Tracer::SetThreadName("server connection");
+      Serve(connection);
+      {
+        std::lock_guard<std::mutex> done_lock(connections_mutex_);
+        connection.done = true;
+      }
+      connections_done_.notify_all();
+    });
+  }
+}
+
+void OcrServer::ReapConnections(bool all) {
+  std::list<Connection> finished;
+  {
+    std::lock_guard<std::mutex> lock(connections_mutex_);
+    for (auto it = connections_.begin(); it != connections_.end();) {
+      const auto next = std::next(it);
+      if (all || it->done) {
+        finished.splice(finished.end(), connections_, it);
+      }
+      it = next;
+    }
+  }
+  for (auto& connection : finished) {
+    connection.thread.join();
+    close(connection.fd);
+  }
+}
+
+// Reads requests off one connection. Pipelined requests are decoded and queued as they arrive;
+// answers are written in request order whenever the client has nothing more buffered, so a burst
+// of requests reaches the batcher together.
+void OcrServer::Serve(Connection& connection) {
+  const int fd = connection.fd;
+  std::string buffer;
+  std::deque<std::future<Reply>> pending;
+  bool writable = true;
+  const auto answer = [&] {
+    while (!pending.empty()) {
+      const Reply reply = pending.front().get();
+      pending.pop_front();
+      if (!reply.ok) {
+        ++failed_;
+      }
+      writable = writable && WriteFrame(fd, reply.ok ? "OK" : "ERR", reply.body);
+    }
+    return writable;
+  };
+  const auto fail = [](std::string message) {
+    std::promise<Reply> promise;
+    promise.set_value(Reply{false, std::move(message)});
+    return promise.get_future();
+  };
+
+  std::string line;
+  std::vector<uint8_t> data;
+  for (;;) {
+    if (!pending.empty() &&
+        (pending.size() >= std::max<std::size_t>(options_.max_pipelined, 1) || (buffer.empty() && !Readable(fd)))) {
+      if (!answer()) {
+        break;
+      }
+    }
+    if (!ReadLine(fd, buffer, line) || line == "QUIT") {
+      break;
+    }
+    ++requests_;
+    const std::size_t space = line.find(' ');
+    const std::string command = line.substr(0, space);
+    const std::string argument = space == std::string::npos ? std::string() : line.substr(space + 1);
+    if (command == "PATH") {
+      try {
+        pending.push_back(Submit(LoadImageForOcr(ResolveRequestPath(argument), options_.ocr)));
+      } catch (const std::exception& ex) {
+        pending.push_back(fail(ex.what()));
+      }
+    } else if (command == "DATA") {
+      std::size_t size = 0;
+      if (!ParseLength(argument, size) || size > options_.max_request_bytes) {
+        // The payload cannot be skipped reliably, so the connection ends after this answer.
+        pending.push_back(fail("invalid or oversized DATA request"));
+        break;
+      }
+      if (!ReadExact(fd, buffer, size, data)) {
+        break;
+      }
+      try {
+        pending.push_back(Submit(DecodeImageForOcr(data, options_.ocr)));
+      } catch (const std::exception& ex) {
+        pending.push_back(fail(ex.what()));
+      }
+    } else {
+      pending.push_back(fail("unknown command: " + command));
+    }
+  }
+  answer();
+}
+
+std::filesystem::path OcrServer::ResolveRequestPath(const std::string& argument) const {
+  if (path_root_.empty()) {
+    if (options_.socket_path.empty()) {
+      throw std::runtime_error("PATH requests need a Unix socket or a path root; send DATA instead");
+    }
+    return argument;
+  }
+  std::error_code error;
+  const auto path = std::filesystem::canonical(path_root_ / argument, error);
+  if (error) {
+    throw std::runtime_error("Cannot open " + argument);
+  }
+  if (std::mismatch(path_root_.begin(), path_root_.end(), path.begin(), path.end()).first != path_root_.end()) {
+    throw std::runtime_error("PATH outside the served directory: " + argument);
+  }
+  return path;
+}
+
+std::future<OcrServer::Reply> OcrServer::Submit(falcon::core::Raster raster) {
+  Job job;
+  job.raster = std::move(raster);
+  auto future = job.reply.get_future();
+  if (!queue_.Push(std::move(job))) {
+    std::promise<Reply> promise;
+    promise.set_value(Reply{false, "server stopping"});
+    return promise.get_future();
+  }
+  return future;
+}
+
+void OcrServer::BatchLoop() {
+  falcon::util::Tracer::SetThreadName("server batcher");
+  std::vector<Job> batch;
+  Job job;
+  const std::size_t max_batch = std::max<std::size_t>(options_.max_batch, 1);
+  while (queue_.Pop(job)) {
+    batch.clear();
+    batch.push_back(std::move(job));
+    const auto deadline = std::chrono::steady_clock::now() + options_.batch_window;
+    while (batch.size() < max_batch && queue_.PopUntil(job, deadline)) {
+      batch.push_back(std::move(job));
+    }
+    Recognize(batch);
+  }
+}
+
+// A lone page is split across the pool as usual; a batch gives each pool thread whole pages,
+// which avoids a fork/join per page when the pages are small.
+void OcrServer::Recognize(std::vector<Job>& batch) {
+  FALCON_TRACE_SCOPE("server.batch");
+  ++batches_;
+  auto options = options_.ocr;
+  options.parallel = batch.size() == 1 && options.parallel;
+  falcon::util::ThreadPool::Shared().ParallelFor(batch.size(), [&](std::size_t i) {
+    Reply reply;
+    try {
+      reply.body = PageText(RunOcr(batch[i].raster, options));
+      reply.ok = true;
+    } catch (const std::exception& ex) {
+      reply.body = ex.what();
+    }
+    batch[i].raster = {};
+    batch[i].reply.set_value(std::move(reply));
+  });
+}
+
+OcrClient OcrClient::ConnectUnix(const std::filesystem::path& socket_path) {
+  const std::string path = socket_path.string();
+  sockaddr_un address{};
+  if (path.size() >= sizeof(address.sun_path)) {
+    throw std::runtime_error("Socket path too long: " + path);
+  }
+  address.sun_family = AF_UNIX;
+  std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+  const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0) {
+    throw SocketError("socket");
+  }
+  if (connect(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0) {
+    const auto failure = SocketError("Cannot connect to " + path);
+    close(fd);
+    throw failure;
+  }
+  SetCloseOnExec(fd);
+  return OcrClient(fd);
+}
+
+OcrClient OcrClient::ConnectTcp(int port) {
+  const int fd = socket(AF_INET, SOCK_STREAM, 0);
+  if (fd < 0) {
+    throw SocketError("socket");
+  }
+  sockaddr_in address{};
+  address.sin_family = AF_INET;
+  address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  address.sin_port = htons(static_cast<uint16_t>(port));
+  if (connect(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0) {
+    const auto failure = SocketError("Cannot connect to 127.0.0.1:" + std::to_string(port));
+    close(fd);
+    throw failure;
+  }
+  SetCloseOnExec(fd);
+  return OcrClient(fd);
+}
+
+OcrClient::OcrClient(OcrClient&& other) noexcept
+    : fd_(std::exchange(other.fd_, -1)), buffer_(std::move(other.buffer_)) {}
+
+OcrClient& OcrClient::operator=(OcrClient&& other) noexcept {
+  if (this != &other) {
+    if (fd_ >= 0) {
+      close(fd_);
+    }
+    fd_ = std::exchange(other.fd_, -1);
+    buffer_ = std::move(other.buffer_);
+  }
+  return *this;
+}
+
+OcrClient::~OcrClient() {
+  if (fd_ >= 0) {
+    WriteAll(fd_, "QUIT\n", 5);
+    close(fd_);
+  }
+}
+
+std::string OcrClient::RecognizeFile(const std::filesystem::path& path) {
+  SendFile(path);
+  return Receive();
+}
+
+std::string OcrClient::RecognizeBytes(const std::vector<uint8_t>& bytes) {
+  SendBytes(bytes);
+  return Receive();
+}
+
+void OcrClient::SendFile(const std::filesystem::path& path) {
+  const std::string text = path.string();
+  if (text.find('\n') != std::string::npos) {
+    throw std::invalid_argument("Path contains a newline");
+  }
+  const std::string request = "PATH " + text + '\n';
+  if (!WriteAll(fd_, request.data(), request.size())) {
+    throw SocketError("send");
+  }
+}
+
+void OcrClient::SendBytes(const std::vector<uint8_t>& bytes) {
+  const std::string header = "DATA " + std::to_string(bytes.size()) + '\n';
+  if (!WriteAll(fd_, header.data(), header.size()) ||
+      !WriteAll(fd_, reinterpret_cast<const char*>(bytes.data()), bytes.size())) {
+    throw SocketError("send");
+  }
+}
+
+std::string OcrClient::Receive() {
+  std::string line;
+  if (!ReadLine(fd_, buffer_, line)) {
+    throw std::runtime_error("Connection closed by OCR server");
+  }
+  const std::size_t space = line.find(' ');
+  const std::string status = line.substr(0, space);
+  std::size_t size = 0;
+  std::vector<uint8_t> body;
+  if (space == std::string::npos || (status != "OK" && status != "ERR") || !ParseLength(line.substr(space + 1), size) ||
+      !ReadExact(fd_, buffer_, size, body)) {
+    throw std::runtime_error("Malformed reply from OCR server");
+  }
+  std::string text(body.begin(), body.end());
+  if (status == "ERR") {
+    throw std::runtime_error("OCR server: " + text);
+  }
+  return text;
+}
+
+}  // namespace falcon::ocr
+
+#endif  // _WIN32
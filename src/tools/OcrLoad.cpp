@@ -0,0 +1,150 @@
+// Load generator for the OCR daemon (falcon_app --serve):
+//   falcon_ocr_load (--socket PATH | --port N) [--clients C] [--requests N] [--pipeline P] [--inline]
+//                   <image>...
+// Each client connection sends N requests cycling through the images, P at a time, and the
+// combined throughput and latency percentiles are printed. --inline sends the image bytes instead
+// of their paths, which a TCP server only accepts when started with --path-root.
+#include "falcon/ocr/Server.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+int Usage() {
+  std::cerr << "Usage: falcon_ocr_load (--socket PATH | --port N) [--clients C] [--requests N]"
+               " [--pipeline P] [--inline] <image>..."
+            << std::endl;
+  return 2;
+}
+
+double Percentile(std::vector<double>& values, double fraction) {
+  if (values.empty()) {
+    return 0.0;
+  }
+  const auto rank = static_cast<std::size_t>(fraction * static_cast<double>(values.size() - 1) + 0.5);
+  std::nth_element(values.begin(), values.begin() + static_cast<std::ptrdiff_t>(rank), values.end());
+  return values[rank];
+}
+
+}  // namespace
+
+#ifndef _WIN32
+int main(int argc, char** argv) {
+  std::filesystem::path socket_path;
+  int port = 0;
+  int clients = 4;
+  int requests = 100;
+  int pipeline = 1;
+  bool send_inline = false;
+  std::vector<std::filesystem::path> images;
+  for (int i = 1; i < argc; ++i) {
+    const std::string_view arg = argv[i];
+    const bool has_value = i + 1 < argc;
+    if (arg == "--socket" && has_value) {
+      socket_path = argv[++i];
+    } else if (arg == "--port" && has_value) {
+      port = std::atoi(argv[++i]);
+    } else if (arg == "--clients" && has_value) {
+      clients = std::max(std::atoi(argv[++i]), 1);
+    } else if (arg == "--requests" && has_value) {
+      requests = std::max(std::atoi(argv[++i]), 1);
+    } else if (arg == "--pipeline" && has_value) {
+      pipeline = std::max(std::atoi(argv[++i]), 1);
+    } else if (arg == "--inline") {
+      send_inline = true;
+    } else if (arg.empty() || arg.front() == '-') {
+      return Usage();
+    } else {
+      images.emplace_back(std::filesystem::absolute(std::filesystem::path(arg)));
+    }
+  }
+  if (images.empty() || (socket_path.empty() && port <= 0)) {
+    return Usage();
+  }
+
+  std::vector<std::vector<uint8_t>> payloads;
+  if (send_inline) {
+    for (const auto& image : images) {
+      std::ifstream file(image, std::ios::binary);
+      if (!file) {
+        std::cerr << "Cannot read " << image << std::endl;
+        return 1;
+      }
+      payloads.emplace_back(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    }
+  }
+
+  std::mutex mutex;
+  std::vector<double> latencies;
+  std::size_t failures = 0;
+  const auto start = Clock::now();
+  std::vector<std::thread> threads;
+  for (int c = 0; c < clients; ++c) {
+    threads.emplace_back([&, c] {
+      std::vector<double> local;
+      std::size_t failed = 0;
+      try {
+        auto client = socket_path.empty() ? falcon::ocr::OcrClient::ConnectTcp(port)
+                                          : falcon::ocr::OcrClient::ConnectUnix(socket_path);
+        for (int sent = 0; sent < requests;) {
+          const int window = std::min(pipeline, requests - sent);
+          const auto window_start = Clock::now();
+          for (int k = 0; k < window; ++k) {
+            const std::size_t image = static_cast<std::size_t>(c + sent + k) % images.size();
+            if (send_inline) {
+              client.SendBytes(payloads[image]);
+            } else {
+              client.SendFile(images[image]);
+            }
+          }
+          for (int k = 0; k < window; ++k) {
+            try {
+              client.Receive();
+            } catch (const std::exception&) {
+              ++failed;
+            }
+            local.push_back(std::chrono::duration<double, std::milli>(Clock::now() - window_start).count());
+          }
+          sent += window;
+        }
+      } catch (const std::exception& ex) {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::cerr << "client " << c << ": " << ex.what() << std::endl;
+        failed += static_cast<std::size_t>(requests) - local.size();
+      }
+      std::lock_guard<std::mutex> lock(mutex);
+      latencies.insert(latencies.end(), local.begin(), local.end());
+      failures += failed;
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  const double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+  const std::size_t total = static_cast<std::size_t>(clients) * static_cast<std::size_t>(requests);
+  std::cout << total << " requests (" << failures << " failed) from " << clients << " clients in " << seconds
+            << " s, " << (seconds > 0.0 ? static_cast<double>(total) / seconds : 0.0) << " req/s\n";
+  std::cout << "Latency ms: p50 " << Percentile(latencies, 0.5) << ", p95 " << Percentile(latencies, 0.95)
+            << ", p99 " << Percentile(latencies, 0.99) << std::endl;
+  return failures == 0 ? 0 : 1;
+}
+#else
+int main() {
+  std::cerr << "falcon_ocr_load requires a POSIX system" << std::endl;
+  return Usage();
+}
+#endif
@@ -0,0 +1,96 @@
+// Offline prototype reduction for glyph packs:
+//   falcon_reduce_pack <input.txt|pack_dir> <output.txt> [--validation <file|dir>]
+//                      [--merge-pixels N] [--tolerance T]
+#include "falcon/core/GlyphDB.h"
+#include "falcon/core/TemplateReduction.h"
+
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace {
+
+std::vector<falcon::core::GlyphTemplate> LoadTemplates(const std::filesystem::path& path) {
+  std::vector<falcon::core::GlyphTemplate> templates;
+  if (std::filesystem::is_directory(path)) {
+    const std::string language = path.filename().string();
+    for (const auto& entry : std::filesystem::directory_iterator(path)) {
+      if (entry.is_regular_file() && entry.path().extension() == ".txt") {
+        auto pack = falcon::core::LoadGlyphPack(entry.path(), language);
+        templates.insert(templates.end(), pack.begin(), pack.end());
+      }
+    }
+  } else {
+    templates = falcon::core::LoadGlyphPack(path, path.stem().string());
+  }
+  return templates;
+}
+
+int Usage() {
+  std::cerr << "Usage: falcon_reduce_pack <input.txt|pack_dir> <output.txt> [--validation <file|dir>]"
+               " [--merge-pixels N] [--tolerance T]"
+            << std::endl;
+  return 2;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  if (argc < 3) {
+    return Usage();
+  }
+
+  const std::filesystem::path input = argv[1];
+  const std::filesystem::path output = argv[2];
+  std::filesystem::path validation_path;
+  falcon::core::TemplateReductionOptions options;
+  for (int i = 3; i < argc; ++i) {
+    const std::string_view arg = argv[i];
+    if (i + 1 >= argc) {
+      return Usage();
+    }
+    if (arg == "--validation") {
+      validation_path = argv[++i];
+    } else if (arg == "--merge-pixels") {
+      options.merge_pixels = std::atoi(argv[++i]);
+    } else if (arg == "--tolerance") {
+      options.accuracy_tolerance = std::atof(argv[++i]);
+    } else {
+      return Usage();
+    }
+  }
+
+  const auto templates = LoadTemplates(input);
+  if (templates.empty()) {
+    std::cerr << "No glyph templates found in " << input << std::endl;
+    return 1;
+  }
+  std::vector<falcon::core::GlyphTemplate> validation;
+  if (!validation_path.empty()) {
+    validation = LoadTemplates(validation_path);
+    if (validation.empty()) {
+      std::cerr << "No validation glyphs found in " << validation_path << std::endl;
+      return 1;
+    }
+  }
+
+  falcon::core::TemplateReductionReport report;
+  const auto reduced = falcon::core::ReduceTemplates(templates, validation, options, &report);
+
+  std::ofstream stream(output);
+  if (!stream.is_open()) {
+    std::cerr << "Cannot write " << output << std::endl;
+    return 1;
+  }
+  stream << "# Reduced from " << input.filename().string() << ": " << report.input_count << " -> "
+         << report.output_count << " templates\n";
+  falcon::core::WriteGlyphPack(stream, reduced);
+
+  std::cout << report.input_count << " -> " << report.output_count << " templates, accuracy "
+            << report.full_accuracy * 100.0 << "% -> " << report.reduced_accuracy * 100.0 << "%" << std::endl;
+  return 0;
+}
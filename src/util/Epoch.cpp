@@ -0,0 +1,90 @@
+#include "falcon/util/Epoch.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace falcon::util {
+
+namespace {
+
+std::array<std::atomic<bool>, kMaxThreadSlots> g_slot_claimed{};
+
+struct SlotOwner {
+  std::size_t index;
+
+  SlotOwner() : index(kMaxThreadSlots) {
+    for (std::size_t i = 0; i < kMaxThreadSlots; ++i) {
+      bool expected = false;
+      if (g_slot_claimed[i].compare_exchange_strong(expected, true)) {
+        index = i;
+        return;
+      }
+    }
+    throw std::runtime_error("Too many threads reading epoch-protected data");
+  }
+
+  ~SlotOwner() { g_slot_claimed[index].store(false); }
+};
+
+}  // namespace
+
+std::size_t ThisThreadSlot() {
+  thread_local SlotOwner owner;
+  return owner.index;
+}
+
+EpochDomain::Guard::Guard(EpochDomain& domain) : domain_(domain), slot_(ThisThreadSlot()) {
+  Slot& slot = domain_.slots_[slot_];
+  if (slot.depth++ == 0) {
+    // Sequentially consistent so a writer scanning slots after unpublishing either sees this pin or
+    // the reader sees the new pointer.
+    slot.epoch.store(domain_.epoch_.load());
+  }
+}
+
+EpochDomain::Guard::~Guard() {
+  Slot& slot = domain_.slots_[slot_];
+  if (--slot.depth == 0) {
+    slot.epoch.store(kIdle, std::memory_order_release);
+  }
+}
+
+EpochDomain::~EpochDomain() {
+  for (const Retired& retired : retired_) {
+    retired.destroy(retired.object);
+  }
+}
+
+void EpochDomain::RetireErased(void* object, void (*destroy)(void*)) {
+  {
+    std::lock_guard<std::mutex> lock(retired_mutex_);
+    retired_.push_back(Retired{object, destroy, epoch_.fetch_add(1)});
+  }
+  Reclaim();
+}
+
+void EpochDomain::Reclaim() {
+  uint64_t oldest = kIdle;
+  for (const Slot& slot : slots_) {
+    oldest = std::min(oldest, slot.epoch.load());
+  }
+
+  std::vector<Retired> ready;
+  {
+    std::lock_guard<std::mutex> lock(retired_mutex_);
+    const auto split = std::partition(retired_.begin(), retired_.end(),
+                                      [oldest](const Retired& retired) { return retired.epoch >= oldest; });
+    ready.assign(split, retired_.end());
+    retired_.erase(split, retired_.end());
+  }
+  for (const Retired& retired : ready) {
+    retired.destroy(retired.object);
+  }
+}
+
+std::size_t EpochDomain::PendingCount() const {
+  std::lock_guard<std::mutex> lock(retired_mutex_);
+  return retired_.size();
+}
+
+}  // namespace falcon::util
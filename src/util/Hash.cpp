@@ -0,0 +1,81 @@
+#include "falcon/util/Hash.h"
+
+#include <cstring>
+
+namespace falcon::util {
+
+namespace {
+
+constexpr uint64_t kPrime1 = 0x9E3779B185EBCA87ULL;
+constexpr uint64_t kPrime2 = 0xC2B2AE3D27D4EB4FULL;
+constexpr uint64_t kPrime3 = 0x165667B19E3779F9ULL;
+constexpr uint64_t kPrime4 = 0x85EBCA77C2B2AE63ULL;
+constexpr uint64_t kPrime5 = 0x27D4EB2F165667C5ULL;
+
+constexpr uint64_t RotateLeft(uint64_t value, int bits) noexcept {
+  return (value << bits) | (value >> (64 - bits));
+}
+
+uint64_t Load64(const uint8_t* bytes) noexcept {
+  uint64_t value;
+  std::memcpy(&value, bytes, sizeof(value));
+  return value;
+}
+
+uint32_t Load32(const uint8_t* bytes) noexcept {
+  uint32_t value;
+  std::memcpy(&value, bytes, sizeof(value));
+  return value;
+}
+
+constexpr uint64_t Round(uint64_t lane, uint64_t input) noexcept {
+  return RotateLeft(lane + input * kPrime2, 31) * kPrime1;
+}
+
+constexpr uint64_t MergeRound(uint64_t hash, uint64_t lane) noexcept {
+  return (hash ^ Round(0, lane)) * kPrime1 + kPrime4;
+}
+
+}  // namespace
+
+uint64_t Hash64(const void* data, std::size_t size, uint64_t seed) noexcept {
+  const auto* bytes = static_cast<const uint8_t*>(data);
+  const uint8_t* const end = bytes + size;
+  uint64_t hash;
+
+  if (size >= 32) {
+    uint64_t lanes[4] = {seed + kPrime1 + kPrime2, seed + kPrime2, seed, seed - kPrime1};
+    for (; end - bytes >= 32; bytes += 32) {
+      for (int i = 0; i < 4; ++i) {
+        lanes[i] = Round(lanes[i], Load64(bytes + 8 * i));
+      }
+    }
+    hash = RotateLeft(lanes[0], 1) + RotateLeft(lanes[1], 7) + RotateLeft(lanes[2], 12) + RotateLeft(lanes[3], 18);
+    for (const uint64_t lane : lanes) {
+      hash = MergeRound(hash, lane);
+    }
+  } else {
+    hash = seed + kPrime5;
+  }
+  hash += static_cast<uint64_t>(size);
+
+  for (; end - bytes >= 8; bytes += 8) {
+    hash = RotateLeft(hash ^ Round(0, Load64(bytes)), 27) * kPrime1 + kPrime4;
+  }
+  if (end - bytes >= 4) {
+    hash = RotateLeft(hash ^ (static_cast<uint64_t>(Load32(bytes)) * kPrime1), 23) * kPrime2 + kPrime3;
+    bytes += 4;
+  }
+  for (; bytes < end; ++bytes) {
+    hash = RotateLeft(hash ^ (*bytes * kPrime5), 11) * kPrime1;
+  }
+
+  hash ^= hash >> 33;
+  hash *= kPrime2;
+  hash ^= hash >> 29;
+  hash *= kPrime3;
+  hash ^= hash >> 32;
+  return hash;
+}
+
+}  // namespace falcon::util
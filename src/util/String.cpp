@@ -4,9 +4,7 @@
 
 namespace falcon::util {
 
-namespace {
-
-void AppendCodepoint(std::string& out, char32_t codepoint) {
+void AppendUtf8Multibyte(std::string& out, char32_t codepoint) {
   if (codepoint <= 0x7F) {
     out.push_back(static_cast<char>(codepoint));
   } else if (codepoint <= 0x7FF) {
@@ -26,12 +24,63 @@ void AppendCodepoint(std::string& out, char32_t codepoint) {
   }
 }
 
-}  // namespace
-
 std::string ToUtf8(std::u32string_view input) {
   std::string output;
+  output.reserve(input.size());
   for (char32_t ch : input) {
-    AppendCodepoint(output, ch);
+    AppendUtf8(output, ch);
+  }
+  return output;
+}
+
+std::u32string FromUtf8(std::string_view input) {
+  std::u32string output;
+  std::size_t i = 0;
+  while (i < input.size()) {
+    const auto lead = static_cast<unsigned char>(input[i]);
+    if (lead < 0x80) {
+      output.push_back(lead);
+      ++i;
+      continue;
+    }
+    // RFC 3629 well-formed sequences: the lead byte fixes the length, and the range of the second
+    // byte excludes overlong forms, UTF-16 surrogates (U+D800-DFFF) and values past U+10FFFF.
+    int length = 0;
+    char32_t codepoint = 0;
+    unsigned char second_min = 0x80;
+    unsigned char second_max = 0xBF;
+    if (lead >= 0xC2 && lead <= 0xDF) {
+      length = 2;
+      codepoint = lead & 0x1F;
+    } else if (lead >= 0xE0 && lead <= 0xEF) {
+      length = 3;
+      codepoint = lead & 0x0F;
+      second_min = lead == 0xE0 ? 0xA0 : 0x80;
+      second_max = lead == 0xED ? 0x9F : 0xBF;
+    } else if (lead >= 0xF0 && lead <= 0xF4) {
+      length = 4;
+      codepoint = lead & 0x07;
+      second_min = lead == 0xF0 ? 0x90 : 0x80;
+      second_max = lead == 0xF4 ? 0x8F : 0xBF;
+    } else {
+      throw std::invalid_argument("Invalid UTF-8 lead byte");
+    }
+    if (i + static_cast<std::size_t>(length) > input.size()) {
+      throw std::invalid_argument("Truncated UTF-8 sequence");
+    }
+    const auto second = static_cast<unsigned char>(input[i + 1]);
+    if ((second & 0xC0) == 0x80 && (second < second_min || second > second_max)) {
+      throw std::invalid_argument("Overlong, surrogate or out-of-range UTF-8 sequence");
+    }
+    for (int k = 1; k < length; ++k) {
+      const auto next = static_cast<unsigned char>(input[i + static_cast<std::size_t>(k)]);
+      if ((next & 0xC0) != 0x80) {
+        throw std::invalid_argument("Invalid UTF-8 continuation byte");
+      }
+      codepoint = (codepoint << 6) | (next & 0x3F);
+    }
+    output.push_back(codepoint);
+    i += static_cast<std::size_t>(length);
   }
   return output;
 }
@@ -0,0 +1,118 @@
+#include "falcon/util/ThreadPool.h"
+
+#include "falcon/util/Sync.h"
+#include "falcon/util/Trace.h"
+
+namespace falcon::util {
+
+ThreadPool::ThreadPool(std::size_t worker_count) {
+  workers_.reserve(worker_count);
+  for (std::size_t i = 0; i < worker_count; ++i) {
+    workers_.emplace_back([this] { WorkerLoop(); });
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  work_available_.notify_all();
+  for (auto& worker : workers_) {
+    worker.join();
+  }
+}
+
+ThreadPool& ThreadPool::Shared() {
+  static ThreadPool pool([] {
+    const unsigned hardware = std::thread::hardware_concurrency();
+    return static_cast<std::size_t>(hardware > 1 ? hardware - 1 : 0);
+  }());
+  return pool;
+}
+
+void ThreadPool::Run(Job& job) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  if (tail_ != nullptr) {
+    tail_->link = &job;
+  } else {
+    head_ = &job;
+  }
+  tail_ = &job;
+  work_available_.notify_all();
+
+  // Help with our own job until every index is claimed, then wait for stragglers.
+  while (job.next < job.count) {
+    const std::size_t index = job.next++;
+    if (job.next == job.count) {
+      // Fully claimed jobs leave the queue; ours may sit behind other callers' jobs.
+      Job** slot = &head_;
+      Job* previous = nullptr;
+      while (*slot != &job) {
+        previous = *slot;
+        slot = &(*slot)->link;
+      }
+      *slot = job.link;
+      if (tail_ == &job) {
+        tail_ = previous;
+      }
+    }
+    Execute(job, index, lock);
+  }
+  WaitFor(job_finished_, lock, [&job] { return job.done == job.count; });
+
+  if (job.error) {
+    std::rethrow_exception(job.error);
+  }
+}
+
+bool ThreadPool::ClaimLocked(Job*& job, std::size_t& index) {
+  if (head_ == nullptr) {
+    return false;
+  }
+  job = head_;
+  index = job->next++;
+  if (job->next == job->count) {
+    head_ = job->link;
+    if (head_ == nullptr) {
+      tail_ = nullptr;
+    }
+  }
+  return true;
+}
+
+void ThreadPool::Execute(Job& job, std::size_t index, std::unique_lock<std::mutex>& lock) {
+  lock.unlock();
+  std::exception_ptr error;
+  try {
+    job.invoke(job.context, index);
+  } catch (...) {
+    error = std::current_exception();
+  }
+  lock.lock();
+  if (error && !job.error) {
+    job.error = error;
+  }
+  // The owner may return as soon as done reaches count, so this is the last touch of `job`.
+  if (++job.done == job.count) {
+    job_finished_.notify_all();
+  }
+}
+
+void ThreadPool::WorkerLoop() {
+  Tracer::SetThreadName("pool worker");
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    WaitFor(work_available_, lock, [this] { return stopping_ || head_ != nullptr; });
+    if (stopping_ && head_ == nullptr) {
+      return;
+    }
+    Job* job = nullptr;
+    std::size_t index = 0;
+    if (ClaimLocked(job, index)) {
+      Execute(*job, index, lock);
+    }
+  }
+}
+
+}  // namespace falcon::util
@@ -0,0 +1,195 @@
+#include "falcon/util/Trace.h"
+
+#include <array>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace falcon::util {
+
+std::atomic<bool> Tracer::enabled_{false};
+
+namespace {
+
+constexpr std::size_t kEventsPerChunk = 4096;
+constexpr std::size_t kMaxChunksPerThread = 256;  // about a million events per thread
+
+struct TraceEvent {
+  const char* name;
+  int64_t begin_ns;
+  int64_t duration_ns;
+};
+
+struct TraceChunk {
+  std::array<TraceEvent, kEventsPerChunk> events;
+};
+
+// Written only by its thread. `count` is published with release so a reader sees complete events.
+struct ThreadBuffer {
+  uint32_t id{0};
+  std::atomic<const char*> name{nullptr};
+  std::array<std::unique_ptr<TraceChunk>, kMaxChunksPerThread> chunks;
+  std::atomic<std::size_t> count{0};
+  std::atomic<std::size_t> dropped{0};
+};
+
+// Buffers outlive their threads so their events can still be written after the thread exits.
+struct TraceRegistry {
+  std::mutex mutex;
+  std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+  Tracer::Clock::time_point origin{Tracer::Clock::now()};
+
+  // Never destroyed, so threads still recording during static destruction stay safe.
+  static TraceRegistry& Shared() {
+    static auto* registry = new TraceRegistry;
+    return *registry;
+  }
+};
+
+ThreadBuffer& LocalBuffer() {
+  thread_local ThreadBuffer* buffer = [] {
+    auto& registry = TraceRegistry::Shared();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    registry.buffers.push_back(std::make_unique<ThreadBuffer>());
+    registry.buffers.back()->id = static_cast<uint32_t>(registry.buffers.size());
+    return registry.buffers.back().get();
+  }();
+  return *buffer;
+}
+
+void WriteJsonString(std::ostream& stream, const char* text) {
+  stream << '"';
+  for (const char* ch = text; *ch != '\0'; ++ch) {
+    if (*ch == '"' || *ch == '\\') {
+      stream << '\\' << *ch;
+    } else if (static_cast<unsigned char>(*ch) < 0x20) {
+      char escaped[8];
+      std::snprintf(escaped, sizeof(escaped), "\\u%04x", static_cast<unsigned>(*ch));
+      stream << escaped;
+    } else {
+      stream << *ch;
+    }
+  }
+  stream << '"';
+}
+
+}  // namespace
+
+void Tracer::Start() {
+  // Fixes the time origin before the first event can be stamped.
+  TraceRegistry::Shared();
+  enabled_.store(true, std::memory_order_relaxed);
+}
+
+void Tracer::SetThreadName(const char* name) {
+  if (Enabled()) {
+    LocalBuffer().name.store(name, std::memory_order_release);
+  }
+}
+
+void Tracer::Record(const char* name, Clock::time_point begin, Clock::time_point end) noexcept {
+  ThreadBuffer& buffer = LocalBuffer();
+  const std::size_t index = buffer.count.load(std::memory_order_relaxed);
+  const std::size_t chunk = index / kEventsPerChunk;
+  if (chunk >= kMaxChunksPerThread) {
+    buffer.dropped.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+  if (!buffer.chunks[chunk]) {
+    try {
+      buffer.chunks[chunk] = std::make_unique<TraceChunk>();
+    } catch (const std::bad_alloc&) {
+      buffer.dropped.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+  }
+  const auto origin = TraceRegistry::Shared().origin;
+  buffer.chunks[chunk]->events[index % kEventsPerChunk] =
+      TraceEvent{name, std::chrono::duration_cast<std::chrono::nanoseconds>(begin - origin).count(),
+                 std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin).count()};
+  buffer.count.store(index + 1, std::memory_order_release);
+}
+
+void Tracer::WriteJson(std::ostream& stream) {
+  auto& registry = TraceRegistry::Shared();
+  std::lock_guard<std::mutex> lock(registry.mutex);
+  const auto micros = [](int64_t ns) {
+    char text[32];
+    std::snprintf(text, sizeof(text), "%lld.%03lld", static_cast<long long>(ns / 1000),
+                  static_cast<long long>(ns % 1000));
+    return std::string(text);
+  };
+
+  stream << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+  bool first = true;
+  const auto separator = [&] {
+    if (!first) {
+      stream << ",\n";
+    }
+    first = false;
+  };
+  for (const auto& buffer : registry.buffers) {
+    if (const char* name = buffer->name.load(std::memory_order_acquire); name != nullptr) {
+      separator();
+      stream << "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":" << buffer->id << ",\"args\":{\"name\":";
+      WriteJsonString(stream, name);
+      stream << "}}";
+    }
+    const std::size_t count = buffer->count.load(std::memory_order_acquire);
+    for (std::size_t i = 0; i < count; ++i) {
+      const TraceEvent& event = buffer->chunks[i / kEventsPerChunk]->events[i % kEventsPerChunk];
+      separator();
+      stream << "{\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer->id << ",\"name\":";
+      WriteJsonString(stream, event.name);
+      stream << ",\"ts\":" << micros(event.begin_ns) << ",\"dur\":" << micros(event.duration_ns) << '}';
+    }
+  }
+  stream << "\n]}\n";
+}
+
+void Tracer::WriteJson(const std::filesystem::path& path) {
+  std::ofstream stream(path, std::ios::binary);
+  if (!stream) {
+    throw std::runtime_error("Cannot write trace " + path.string());
+  }
+  WriteJson(stream);
+  if (!stream) {
+    throw std::runtime_error("Cannot write trace " + path.string());
+  }
+}
+
+void Tracer::Clear() {
+  auto& registry = TraceRegistry::Shared();
+  std::lock_guard<std::mutex> lock(registry.mutex);
+  for (auto& buffer : registry.buffers) {
+    buffer->count.store(0, std::memory_order_relaxed);
+    buffer->dropped.store(0, std::memory_order_relaxed);
+  }
+}
+
+std::size_t Tracer::EventCount() {
+  auto& registry = TraceRegistry::Shared();
+  std::lock_guard<std::mutex> lock(registry.mutex);
+  std::size_t total = 0;
+  for (const auto& buffer : registry.buffers) {
+    total += buffer->count.load(std::memory_order_acquire);
+  }
+  return total;
+}
+
+std::size_t Tracer::DroppedCount() {
+  auto& registry = TraceRegistry::Shared();
+  std::lock_guard<std::mutex> lock(registry.mutex);
+  std::size_t total = 0;
+  for (const auto& buffer : registry.buffers) {
+    total += buffer->dropped.load(std::memory_order_relaxed);
+  }
+  return total;
+}
+
+}  // namespace falcon::util
@@ -1,18 +1,134 @@
 #include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <future>
+#include <iterator>
+#include <new>
+#include <sstream>
+#include <stdexcept>
 #include <string>
+#include <thread>
+#include <utility>
 
 #include <gtest/gtest.h>
 
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+#include "falcon/app/Batch.h"
+#include "falcon/core/Binarize.h"
+#include "falcon/core/Charset.h"
 #include "falcon/core/Classifier.h"
+#include "falcon/core/Color.h"
 #include "falcon/core/GlyphDB.h"
+#include "falcon/core/Image.h"
+#include "falcon/core/Morphology.h"
+#include "falcon/core/PackRegistry.h"
+#include "falcon/core/PackWatcher.h"
 #include "falcon/core/Raster.h"
+#include "falcon/core/Segment.h"
+#include "falcon/core/TemplateReduction.h"
+#include "falcon/falcon_c.h"
+#include "falcon/ocr/AsyncOcr.h"
+#include "falcon/ocr/CompactPage.h"
+#include "falcon/ocr/OcrControl.h"
+#include "falcon/ocr/OutputWriter.h"
+#include "falcon/ocr/PageStream.h"
+#include "falcon/ocr/ResultCache.h"
 #include "falcon/ocr/Pipeline.h"
+#include "falcon/ocr/Server.h"
+#include "falcon/util/BoundedQueue.h"
+#include "falcon/util/Epoch.h"
+#include "falcon/util/Hash.h"
 #include "falcon/util/String.h"
+#include "falcon/util/ThreadPool.h"
+#include "falcon/util/Trace.h"
 
 using namespace falcon;
 
 namespace {
 
+std::atomic<std::size_t> g_allocation_count{0};
+
+}  // namespace
+
+void* operator new(std::size_t size) {
+  g_allocation_count.fetch_add(1, std::memory_order_relaxed);
+  if (void* ptr = std::malloc(size == 0 ? 1 : size)) {
+    return ptr;
+  }
+  throw std::bad_alloc();
+}
+
+// GCC cannot see that operator new above is malloc-backed once delete expressions are inlined.
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+
+void operator delete(void* ptr) noexcept { std::free(ptr); }
+void operator delete(void* ptr, std::size_t) noexcept { std::free(ptr); }
+
+namespace {
+
+const core::GlyphTemplate& FindGlyph(const std::vector<core::GlyphTemplate>& glyphs, char32_t codepoint) {
+  const auto it = std::find_if(glyphs.begin(), glyphs.end(), [codepoint](const core::GlyphTemplate& glyph) {
+    return glyph.codepoint == codepoint;
+  });
+  if (it == glyphs.end()) {
+    throw std::runtime_error("Glyph not found");
+  }
+  return *it;
+}
+
+// Lays out one template per character, 4px apart, with lines ('\n') `line_advance` px apart.
+core::Raster RasterFromText(const std::u32string& text, const std::vector<core::GlyphTemplate>& glyphs,
+                            int line_advance = core::kGlyphSize * 3) {
+  constexpr int kAdvance = core::kGlyphSize + 4;
+  int columns = 0;
+  int rows = 1;
+  int current = 0;
+  for (char32_t ch : text) {
+    if (ch == U'\n') {
+      ++rows;
+      current = 0;
+    } else {
+      columns = std::max(columns, ++current);
+    }
+  }
+
+  core::Raster raster;
+  raster.width = columns * kAdvance + 8;
+  raster.height = rows * line_advance + 8;
+  raster.pixels.assign(static_cast<std::size_t>(raster.width) * raster.height, 0);
+  int origin_x = 4;
+  int origin_y = 4;
+  for (char32_t ch : text) {
+    if (ch == U'\n') {
+      origin_x = 4;
+      origin_y += line_advance;
+      continue;
+    }
+    const auto& glyph = FindGlyph(glyphs, ch);
+    for (int y = 0; y < core::kGlyphSize; ++y) {
+      for (int x = 0; x < core::kGlyphSize; ++x) {
+        raster.pixels[static_cast<std::size_t>(origin_y + y) * raster.width + origin_x + x] =
+            glyph.bitmap[static_cast<std::size_t>(y) * core::kGlyphSize + x];
+      }
+    }
+    origin_x += kAdvance;
+  }
+  return raster;
+}
+
 core::Raster RasterFromGlyph(const core::GlyphTemplate& glyph) {
   core::Raster raster;
   raster.width = core::kGlyphSize;
@@ -66,3 +182,1609 @@ TEST(OcrPipeline, RecognizesSingleGlyph) {
   ASSERT_FALSE(recognized.empty());
   EXPECT_GT(page.lines.front().characters.front().classification.confidence, 0.0f);
 }
+
+TEST(OcrPipeline, ContextReuseOnlyAllocatesResult) {
+  const auto glyphs = core::CollectGlyphTemplates(std::vector<std::string>{}, true);
+  const auto raster = RasterFromText(U"HELLO\nWORLD", glyphs);
+
+  ocr::OcrContext context;
+  const auto first = ocr::RunOcr(raster, {}, context);
+  ASSERT_EQ(first.lines.size(), 2u);
+  const std::size_t reserved = context.ReservedBytes();
+
+  const std::size_t before = g_allocation_count.load();
+  const auto second = ocr::RunOcr(raster, {}, context);
+  const std::size_t allocations = g_allocation_count.load() - before;
+
+  // One allocation for the line vector plus one per line's character vector.
+  EXPECT_EQ(allocations, 1 + second.lines.size());
+  EXPECT_EQ(context.ReservedBytes(), reserved);
+  ASSERT_EQ(second.lines.size(), first.lines.size());
+  for (std::size_t i = 0; i < first.lines.size(); ++i) {
+    EXPECT_EQ(second.lines[i].characters.size(), first.lines[i].characters.size());
+  }
+}
+
+TEST(Classifier, BatchedPathMatchesPerGlyphPath) {
+  const auto glyphs = core::CollectGlyphTemplates(std::vector<std::string>{}, true);
+  const auto raster = RasterFromText(U"Quick 0123\nBROWN fox", glyphs);
+  const auto binary = core::BinarizeOtsu(raster);
+  auto components = core::ConnectedComponents(binary);
+  // Odd-shaped boxes that hang over the image border exercise clamping in the sample tables.
+  components.push_back(core::ConnectedComponent{0, core::RectI{raster.width - 3, 2, 9, 40}, 1});
+  components.push_back(core::ConnectedComponent{0, core::RectI{0, raster.height - 1, 57, 1}, 1});
+  ASSERT_GT(components.size(), 20u);
+
+  core::GlyphMatrix matrix;
+  core::NormalizeGlyphs(binary, components, matrix);
+  std::vector<core::ClassificationResult> batched;
+  core::ClassifyGlyphs(matrix, core::BuildTemplateMatrix(glyphs), batched);
+  ASSERT_EQ(batched.size(), components.size());
+
+  for (std::size_t i = 0; i < components.size(); ++i) {
+    const auto bitmap = core::NormalizeGlyph(binary, components[i].bounds);
+    ASSERT_TRUE(std::equal(bitmap.begin(), bitmap.end(), matrix.Glyph(i)));
+    const auto single = core::ClassifyGlyph(bitmap, glyphs);
+    EXPECT_EQ(batched[i].codepoint, single.codepoint);
+    EXPECT_FLOAT_EQ(batched[i].confidence, single.confidence);
+  }
+}
+
+TEST(Normalize, ResamplesStoredTemplatesToEngineSizes) {
+  core::GlyphBitmap source{};
+  for (std::size_t i = 0; i < source.size(); ++i) {
+    source[i] = static_cast<uint8_t>((i * 7 + i / core::kGlyphSize) % 3 == 0 ? 1 : 0);
+  }
+  // Growing replicates every stored pixel into a 2x2 block; nothing finer is invented.
+  const auto grown = core::ResampleGlyph<32>(source);
+  for (int y = 0; y < 32; ++y) {
+    for (int x = 0; x < 32; ++x) {
+      EXPECT_EQ(grown[static_cast<std::size_t>(y) * 32 + x],
+                source[static_cast<std::size_t>(y / 2) * core::kGlyphSize + x / 2]);
+    }
+  }
+  const auto shrunk = core::ResampleGlyph<8>(source);
+  for (int y = 0; y < 8; ++y) {
+    for (int x = 0; x < 8; ++x) {
+      int sum = 0;
+      for (int d = 0; d < 4; ++d) {
+        sum += source[static_cast<std::size_t>(y * 2 + d / 2) * core::kGlyphSize + x * 2 + d % 2];
+      }
+      EXPECT_EQ(shrunk[static_cast<std::size_t>(y) * 8 + x], (sum + 2) / 4);
+    }
+  }
+  EXPECT_EQ(core::ResampleGlyph<16>(source), source);
+}
+
+TEST(Normalize, SamplesThePixelUnderEachCellCentre) {
+  // A box already at glyph size maps one pixel to one cell; rounding the cell centre instead of
+  // taking the pixel that contains it would shift the glyph by a pixel.
+  core::BinaryImage image;
+  image.width = core::kGlyphSize + 2;
+  image.height = core::kGlyphSize + 2;
+  image.data.assign(static_cast<std::size_t>(image.width) * image.height, 0);
+  core::GlyphBitmap expected{};
+  for (int y = 0; y < core::kGlyphSize; ++y) {
+    for (int x = 0; x < core::kGlyphSize; ++x) {
+      const bool ink = x == 0 || y == 0 || (x * 3 + y * 5) % 7 < 3;
+      image.data[static_cast<std::size_t>(y + 1) * image.width + x + 1] = ink ? 1 : 0;
+      expected[static_cast<std::size_t>(y) * core::kGlyphSize + x] = ink ? 255 : 0;
+    }
+  }
+  EXPECT_EQ(core::NormalizeGlyph(image, {1, 1, core::kGlyphSize, core::kGlyphSize}), expected);
+}
+
+TEST(Layout, SeparatesColumnsAndDropsNonText) {
+  const auto glyphs = core::CollectGlyphTemplates(std::vector<std::string>{}, true);
+  // Letters whose 5x7 shapes stay 4-connected when upscaled, so each is a single component.
+  // Normal leading (20px between 16px lines) must still split into separate lines.
+  auto raster = RasterFromText(U"TIE    HELL\nLIFE   FILE", glyphs, core::kGlyphSize * 9 / 4);
+  const int text_width = raster.width;
+  // Extend the page with a horizontal rule and a solid picture block below the text.
+  const int old_height = raster.height;
+  raster.height += 120;
+  raster.pixels.resize(static_cast<std::size_t>(raster.width) * raster.height, 0);
+  for (int x = 4; x < text_width - 4; ++x) {
+    raster.pixels[static_cast<std::size_t>(old_height + 4) * raster.width + x] = 255;
+  }
+  for (int y = old_height + 20; y < old_height + 110; ++y) {
+    for (int x = 10; x < 90; ++x) {
+      raster.pixels[static_cast<std::size_t>(y) * raster.width + x] = 255;
+    }
+  }
+
+  ocr::OcrOptions options;
+  options.parallel = false;
+  const auto page = ocr::RunOcr(raster, options);
+  std::vector<std::u32string> lines;
+  for (const auto& line : page.lines) {
+    std::u32string text;
+    for (const auto& ch : line.characters) {
+      text.push_back(ch.classification.codepoint);
+    }
+    lines.push_back(text);
+  }
+  // Reading order is column by column; the rule and the picture never reach the classifier.
+  EXPECT_EQ(lines, (std::vector<std::u32string>{U"TIE", U"LIFE", U"HELL", U"FILE"}));
+}
+
+TEST(ThreadPool, ParallelForVisitsEveryIndexAndRethrows) {
+  util::ThreadPool pool(3);
+  std::vector<int> visits(1000, 0);
+  pool.ParallelFor(visits.size(), [&](std::size_t i) { ++visits[i]; });
+  EXPECT_TRUE(std::all_of(visits.begin(), visits.end(), [](int v) { return v == 1; }));
+
+  EXPECT_THROW(pool.ParallelFor(64,
+                                [](std::size_t i) {
+                                  if (i == 17) {
+                                    throw std::runtime_error("boom");
+                                  }
+                                }),
+               std::runtime_error);
+}
+
+TEST(Image, DownscaleBoxAveragesBlocks) {
+  core::Raster src;
+  src.width = 71;  // odd sizes cover the partial-block edges and the SIMD tail
+  src.height = 9;
+  src.dpi_x = 600;
+  src.dpi_y = 600;
+  for (int i = 0; i < src.width * src.height; ++i) {
+    src.pixels.push_back(static_cast<uint8_t>((i * 37) % 256));
+  }
+
+  for (const auto& [fx, fy] : std::vector<std::pair<int, int>>{{2, 2}, {3, 2}, {4, 4}}) {
+    const auto out = core::DownscaleBox(src, fx, fy);
+    ASSERT_EQ(out.width, (src.width + fx - 1) / fx);
+    ASSERT_EQ(out.height, (src.height + fy - 1) / fy);
+    EXPECT_EQ(out.dpi_x, 600 / fx);
+    for (int y = 0; y < out.height; ++y) {
+      for (int x = 0; x < out.width; ++x) {
+        int sum = 0;
+        int count = 0;
+        for (int sy = y * fy; sy < std::min(src.height, (y + 1) * fy); ++sy) {
+          for (int sx = x * fx; sx < std::min(src.width, (x + 1) * fx); ++sx) {
+            sum += src.pixels[static_cast<std::size_t>(sy) * src.width + sx];
+            ++count;
+          }
+        }
+        ASSERT_EQ(out.pixels[static_cast<std::size_t>(y) * out.width + x], (sum + count / 2) / count)
+            << "factor " << fx << "x" << fy << " at " << x << "," << y;
+      }
+    }
+  }
+
+  const auto pyramid = core::BuildPyramid(src, 3);
+  ASSERT_EQ(pyramid.size(), 3u);
+  EXPECT_EQ(pyramid[2].width, 18);
+  EXPECT_EQ(pyramid[2].height, 3);
+}
+
+TEST(OcrPipeline, TargetDpiDownscalesAndKeepsSourceCoordinates) {
+  const auto glyphs = core::CollectGlyphTemplates(std::vector<std::string>{}, true);
+  const auto base = RasterFromText(U"TIE", glyphs);
+  auto scan = core::ResizeNearest(base, base.width * 4, base.height * 4);
+  scan.dpi_x = 1200;
+  scan.dpi_y = 1200;
+
+  ocr::OcrOptions options;
+  const auto expected = ocr::RunOcr(base, options);
+  options.target_dpi = 300;
+  const auto page = ocr::RunOcr(scan, options);
+
+  ASSERT_EQ(page.lines.size(), expected.lines.size());
+  ASSERT_EQ(page.lines[0].characters.size(), expected.lines[0].characters.size());
+  for (std::size_t i = 0; i < page.lines[0].characters.size(); ++i) {
+    const auto& got = page.lines[0].characters[i];
+    const auto& want = expected.lines[0].characters[i];
+    EXPECT_EQ(got.classification.codepoint, want.classification.codepoint);
+    EXPECT_EQ(got.bounds, (core::RectI{want.bounds.x * 4, want.bounds.y * 4, want.bounds.width * 4,
+                                       want.bounds.height * 4}));
+  }
+}
+
+TEST(OcrPipeline, GlyphSizesRecognizeTheSameText) {
+  const auto glyphs = core::CollectGlyphTemplates(std::vector<std::string>{}, true);
+  const auto raster = RasterFromText(U"LIFE TIE", glyphs);
+
+  ocr::OcrOptions options;
+  const auto reference = ocr::RunOcr(raster, options);
+  for (const int size : {8, 32}) {
+    options.glyph_size = size;
+    const auto page = ocr::RunOcr(raster, options);
+    ASSERT_EQ(page.lines.size(), reference.lines.size());
+    ASSERT_EQ(page.lines[0].characters.size(), reference.lines[0].characters.size());
+    for (std::size_t i = 0; i < page.lines[0].characters.size(); ++i) {
+      EXPECT_EQ(page.lines[0].characters[i].classification.codepoint,
+                reference.lines[0].characters[i].classification.codepoint)
+          << "glyph size " << size;
+    }
+  }
+
+  options.glyph_size = 12;
+  EXPECT_THROW(ocr::RunOcr(raster, options), std::invalid_argument);
+}
+
+TEST(TemplateReduction, MergesNearDuplicatesAndKeepsAccuracy) {
+  const auto builtin = core::CollectGlyphTemplates(std::vector<std::string>{}, true);
+  std::vector<core::GlyphTemplate> templates;
+  std::vector<core::GlyphTemplate> validation;
+  for (const char32_t codepoint : {U'E', U'F', U'L'}) {
+    const auto& base = FindGlyph(builtin, codepoint);
+    // Three "fonts" differing by a few pixels each.
+    for (int variant = 0; variant < 3; ++variant) {
+      core::GlyphTemplate tmpl = base;
+      for (int i = 0; i <= variant; ++i) {
+        tmpl.bitmap[static_cast<std::size_t>(variant * 37 + i * 5)] ^= 255;
+      }
+      templates.push_back(tmpl);
+    }
+    validation.push_back(base);
+  }
+
+  core::TemplateReductionReport report;
+  const auto reduced = core::ReduceTemplates(templates, validation, {}, &report);
+  EXPECT_EQ(report.input_count, 9U);
+  EXPECT_EQ(reduced.size(), 3U);
+  EXPECT_DOUBLE_EQ(report.reduced_accuracy, report.full_accuracy);
+  EXPECT_DOUBLE_EQ(core::MeasureAccuracy(reduced, validation), 1.0);
+
+  std::stringstream pack;
+  core::WriteGlyphPack(pack, reduced);
+  const auto path = std::filesystem::temp_directory_path() / "falcon_reduced_pack.txt";
+  std::ofstream(path) << pack.str();
+  const auto reloaded = core::LoadGlyphPack(path, "reduced");
+  std::filesystem::remove(path);
+  ASSERT_EQ(reloaded.size(), reduced.size());
+  for (std::size_t i = 0; i < reduced.size(); ++i) {
+    EXPECT_EQ(reloaded[i].codepoint, reduced[i].codepoint);
+  }
+}
+
+#ifndef _WIN32
+TEST(GlyphDB, FirstRootWithPackShadowsLaterRoots) {
+  const auto base = std::filesystem::temp_directory_path() / "falcon_pack_roots";
+  std::filesystem::remove_all(base);
+  const auto write_pack = [&](const std::string& root, const std::u32string& codepoints) {
+    std::vector<core::GlyphTemplate> templates;
+    for (const char32_t codepoint : codepoints) {
+      templates.push_back({codepoint, FindGlyph(core::BuiltInGlyphTemplates(), codepoint).bitmap, "shadowed"});
+    }
+    std::filesystem::create_directories(base / root / "shadowed");
+    std::ofstream stream(base / root / "shadowed" / "glyphs.txt");
+    core::WriteGlyphPack(stream, templates);
+  };
+  write_pack("user", U"A");
+  write_pack("stock", U"AB");
+
+  const char* saved = std::getenv("FALCON_LANG_PATHS");
+  const std::string previous = saved != nullptr ? saved : "";
+  ::setenv("FALCON_LANG_PATHS", ((base / "user").string() + ":" + (base / "stock").string()).c_str(), 1);
+  const auto templates = core::LoadLanguagePack("shadowed");
+  core::PackRegistry registry;
+  const auto collected = registry.Collect({"shadowed"}, false);
+  if (saved != nullptr) {
+    ::setenv("FALCON_LANG_PATHS", previous.c_str(), 1);
+  } else {
+    ::unsetenv("FALCON_LANG_PATHS");
+  }
+  std::filesystem::remove_all(base);
+
+  ASSERT_EQ(templates.size(), 1U);
+  EXPECT_EQ(templates[0].codepoint, U'A');
+  ASSERT_EQ(collected.size(), 1U);
+  EXPECT_EQ(collected[0].codepoint, U'A');
+}
+#endif
+
+TEST(Utf8, DecodesOnlyWellFormedSequences) {
+  const std::u32string text = U"A\u00E9\u0800\uFFFD\U00010000\U0010FFFF";
+  EXPECT_EQ(util::FromUtf8(util::ToUtf8(text)), text);
+  EXPECT_EQ(util::FromUtf8("\xED\x9F\xBF"), U"\uD7FF");
+
+  const std::vector<std::string> malformed = {
+      "\xC0\xAF",          // overlong '/' (two-byte lead that can only encode ASCII)
+      "\xC1\xBF",          // overlong U+007F
+      "\xE0\x80\xAF",      // overlong '/' in three bytes
+      "\xE0\x9F\xBF",      // overlong U+07FF
+      "\xF0\x8F\xBF\xBF",  // overlong U+FFFF
+      "\xED\xA0\x80",      // high surrogate U+D800
+      "\xED\xBF\xBF",      // low surrogate U+DFFF
+      "\xF4\x90\x80\x80",  // U+110000
+      "\xF5\x80\x80\x80",  // lead bytes F5-FF never occur
+      "\xF8\x88\x80\x80\x80",
+      "\xFF",
+      "\x80",              // stray continuation byte
+      "\xE2\x82",          // truncated
+      "\xE2\x28\xA1",      // bad continuation byte
+  };
+  for (const auto& bytes : malformed) {
+    EXPECT_THROW(util::FromUtf8(bytes), std::invalid_argument) << testing::PrintToString(bytes);
+  }
+}
+
+TEST(Charset, ParsesWhitelistsAndRestrictsRecognition) {
+  const auto greek = core::Charset::Parse("U+0391-U+03A9, U+20AC, xy");
+  EXPECT_TRUE(greek.Contains(U'\u0394'));
+  EXPECT_TRUE(greek.Contains(U'\u20AC'));
+  EXPECT_TRUE(greek.Contains(U'y'));
+  EXPECT_FALSE(greek.Contains(U'z'));
+  EXPECT_EQ(core::Charset::Parse("digits"), core::Charset::Digits());
+  EXPECT_EQ(core::Charset::FromCodepoints(U"0123456789"), core::Charset::Digits());
+  EXPECT_THROW(core::Charset::Parse(""), std::invalid_argument);
+
+  const auto glyphs = core::CollectGlyphTemplates(std::vector<std::string>{}, true);
+  const auto raster = RasterFromText(U"LIFE", glyphs);
+  ocr::OcrOptions options;
+  options.charset = core::Charset::Parse("E,F,I,L");
+  auto page = ocr::RunOcr(raster, options);
+  ASSERT_EQ(page.lines.size(), 1U);
+  std::u32string text;
+  for (const auto& ch : page.lines[0].characters) {
+    text.push_back(ch.classification.codepoint);
+  }
+  EXPECT_EQ(text, U"LIFE");
+
+  options.charset = core::Charset::Digits();
+  page = ocr::RunOcr(raster, options);
+  ASSERT_EQ(page.lines.size(), 1U);
+  for (const auto& ch : page.lines[0].characters) {
+    EXPECT_TRUE(ch.classification.codepoint >= U'0' && ch.classification.codepoint <= U'9');
+  }
+}
+
+TEST(OcrPipeline, ScriptProbeNarrowsAutomaticLanguages) {
+  const auto glyphs = core::CollectGlyphTemplates(std::vector<std::string>{}, true);
+  const auto raster = RasterFromText(U"LIFE TIE FILE", glyphs);
+
+  ocr::OcrOptions options;
+  options.script_probe_glyphs = 0;
+  const auto expected = ocr::RunOcr(raster, options);
+
+  ocr::OcrContext context;
+  options.script_probe_glyphs = 4;
+  const auto page = ocr::RunOcr(raster, options, context);
+  ASSERT_EQ(page.lines.size(), expected.lines.size());
+  ASSERT_EQ(page.lines[0].characters.size(), expected.lines[0].characters.size());
+  for (std::size_t i = 0; i < page.lines[0].characters.size(); ++i) {
+    EXPECT_EQ(page.lines[0].characters[i].classification.codepoint,
+              expected.lines[0].characters[i].classification.codepoint);
+  }
+
+  // The probes only match builtin Latin templates, so the rest of the page skips other packs.
+  if (!core::DiscoverLanguagePacks().empty()) {
+    const auto& narrowed = context.templates.Current().indexes.back();
+    EXPECT_NE(narrowed.language_mask, ~uint64_t{0});
+    EXPECT_LT(narrowed.templates.size(), context.templates.Current().templates.size());
+    for (const auto* tmpl : narrowed.templates) {
+      EXPECT_EQ(tmpl->language, "builtin");
+    }
+  }
+}
+
+TEST(OcrContext, KeepsTemplateSetsPerLanguageSelection) {
+  const auto languages = core::DiscoverLanguagePacks();
+  if (languages.empty()) {
+    GTEST_SKIP() << "needs a language pack";
+  }
+  const auto glyphs = core::CollectGlyphTemplates(std::vector<std::string>{}, true);
+  const auto raster = RasterFromText(U"LIFE", glyphs);
+
+  ocr::OcrContext context;
+  ocr::OcrOptions every;
+  ocr::OcrOptions single;
+  single.languages = {languages[0]};
+  ocr::RunOcr(raster, every, context);
+  const auto* every_set = &context.templates.Current();
+  ocr::RunOcr(raster, single, context);
+  const auto* single_set = &context.templates.Current();
+  ocr::RunOcr(raster, every, context);
+  EXPECT_EQ(context.templates.sets.size(), 2U);
+  EXPECT_EQ(&context.templates.Current(), every_set);
+
+  // Templates point into the registry's pack and the built-in table instead of being copied.
+  const auto& builtin = core::BuiltInGlyphTemplates();
+  ASSERT_EQ(single_set->packs.size(), 1U);
+  const auto& pack = single_set->packs[0]->templates;
+  for (const auto* tmpl : single_set->templates) {
+    const bool in_builtin = tmpl >= builtin.data() && tmpl < builtin.data() + builtin.size();
+    const bool in_pack = tmpl >= pack.data() && tmpl < pack.data() + pack.size();
+    EXPECT_TRUE(in_builtin || in_pack);
+  }
+}
+
+TEST(PackRegistry, SharesPacksAndEvictsUnusedOnesOverBudget) {
+  const auto languages = core::DiscoverLanguagePacks();
+  if (languages.size() < 2) {
+    GTEST_SKIP() << "needs at least two language packs";
+  }
+
+  core::PackRegistry registry;
+  registry.Warm(languages);
+  EXPECT_EQ(registry.ResidentPacks(), languages.size());
+
+  const auto held = registry.Acquire(languages[0]);
+  EXPECT_EQ(registry.Acquire(languages[0]).get(), held.get());
+  EXPECT_FALSE(held->templates.empty());
+
+  registry.SetMemoryBudget(0);
+  EXPECT_EQ(registry.ResidentPacks(), 1U);
+  EXPECT_EQ(registry.ResidentBytes(), held->Bytes());
+
+  // Evicted packs reload on demand; merged results match the uncached loader.
+  const std::vector<std::string> pair{languages[1], languages[0]};
+  const auto merged = registry.Collect(pair, false);
+  std::size_t expected = 0;
+  for (const auto& language : pair) {
+    expected += core::LoadLanguagePack(language).size();
+  }
+  EXPECT_EQ(merged.size(), expected);
+}
+
+TEST(EpochDomain, DefersReclaimUntilReadersUnpin) {
+  struct Tracked {
+    std::atomic<int>* destroyed;
+    ~Tracked() { ++*destroyed; }
+  };
+  std::atomic<int> destroyed{0};
+  util::EpochDomain domain;
+  {
+    const auto guard = domain.Pin();
+    const auto nested = domain.Pin();
+    domain.Retire(new Tracked{&destroyed});
+    domain.Reclaim();
+    EXPECT_EQ(destroyed.load(), 0);
+    EXPECT_EQ(domain.PendingCount(), 1U);
+  }
+  domain.Reclaim();
+  EXPECT_EQ(destroyed.load(), 1);
+  EXPECT_EQ(domain.PendingCount(), 0U);
+}
+
+TEST(PackWatcher, ReloadsChangedPackWithoutDisturbingHeldHandles) {
+  const auto path = std::filesystem::temp_directory_path() / "falcon_hot_pack.txt";
+  const auto glyphs = core::CollectGlyphTemplates(std::vector<std::string>{}, true);
+  const auto write_pack = [&](const std::u32string& codepoints, int age_seconds) {
+    std::vector<core::GlyphTemplate> pack;
+    for (const char32_t codepoint : codepoints) {
+      pack.push_back(FindGlyph(glyphs, codepoint));
+    }
+    std::ofstream stream(path);
+    core::WriteGlyphPack(stream, pack);
+    stream.close();
+    std::filesystem::last_write_time(path, std::filesystem::file_time_type::clock::now() -
+                                               std::chrono::seconds(age_seconds));
+  };
+
+  write_pack(U"E", 20);
+  core::PackRegistry registry;
+  core::PackWatcher watcher(registry, std::chrono::milliseconds(100));
+  const auto before = registry.Acquire(path.string());
+  ASSERT_EQ(before->templates.size(), 1U);
+  EXPECT_EQ(watcher.Poll(), 0U);
+
+  const auto generation = registry.Generation();
+  write_pack(U"EF", 10);
+  EXPECT_EQ(watcher.Poll(), 1U);
+  EXPECT_GT(registry.Generation(), generation);
+  EXPECT_EQ(registry.Acquire(path.string())->templates.size(), 2U);
+  EXPECT_EQ(before->templates.size(), 1U);
+
+  // The background thread notices the next edit on its own.
+  watcher.Start();
+  const auto started = registry.Generation();
+  write_pack(U"EFL", 0);
+  const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+  while (registry.Generation() == started && std::chrono::steady_clock::now() < deadline) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  }
+  watcher.Stop();
+  EXPECT_EQ(registry.Acquire(path.string())->templates.size(), 3U);
+  std::filesystem::remove(path);
+
+  // Stop() wakes the thread rather than waiting out the poll interval.
+  core::PackWatcher idle(registry, std::chrono::hours(1));
+  idle.Start();
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  const auto stopping = std::chrono::steady_clock::now();
+  idle.Stop();
+  EXPECT_LT(std::chrono::steady_clock::now() - stopping, std::chrono::seconds(1));
+}
+
+TEST(GlyphDB, BuiltInFontIsExpandedFromTheTable) {
+  const auto& templates = core::BuiltInGlyphTemplates();
+  ASSERT_FALSE(templates.empty());
+  EXPECT_EQ(templates.front().language, "builtin");
+
+  // Row 0 of 'T' is solid and column 0 below it is empty.
+  const auto& t = FindGlyph(templates, U'T');
+  EXPECT_EQ(t.bitmap[0], 255);
+  EXPECT_EQ(t.bitmap[core::kGlyphSize - 1], 255);
+  EXPECT_EQ(t.bitmap[static_cast<std::size_t>(core::kGlyphSize) * (core::kGlyphSize - 1)], 0);
+  EXPECT_THROW(FindGlyph(templates, U'€'), std::runtime_error);
+}
+
+TEST(BoundedQueue, BlocksProducersAndDrainsAfterClose) {
+  util::BoundedQueue<int> queue(2);
+  std::atomic<int> pushed{0};
+  std::thread producer([&] {
+    for (int i = 0; i < 100; ++i) {
+      ASSERT_TRUE(queue.Push(i));
+      ++pushed;
+    }
+    queue.Close();
+  });
+
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  EXPECT_LE(pushed.load(), 3);
+  int expected = 0;
+  int value = 0;
+  while (queue.Pop(value)) {
+    EXPECT_EQ(value, expected++);
+  }
+  producer.join();
+  EXPECT_EQ(expected, 100);
+  EXPECT_FALSE(queue.Push(1));
+}
+
+TEST(Image, LoadsBinaryPgmFromFirstPixel) {
+  const auto path = std::filesystem::temp_directory_path() / "falcon_binary.pgm";
+  {
+    std::ofstream stream(path, std::ios::binary);
+    stream << "P5\n3 2\n255\n";
+    const char pixels[] = {1, 2, 3, 4, 5, 6};
+    stream.write(pixels, sizeof(pixels));
+  }
+  const auto raster = core::LoadImage(path);
+  std::filesystem::remove(path);
+  ASSERT_EQ(raster.width, 3);
+  ASSERT_EQ(raster.height, 2);
+  EXPECT_EQ(raster.pixels, (std::vector<uint8_t>{1, 2, 3, 4, 5, 6}));
+}
+
+TEST(Color, GrayKernelsMatchScalarReference) {
+  std::vector<uint8_t> src(4 * 80);
+  uint32_t seed = 12345;
+  for (auto& byte : src) {
+    seed = seed * 1103515245 + 12345;
+    byte = static_cast<uint8_t>(seed >> 16);
+  }
+  std::fill(src.begin(), src.begin() + 8, 255);
+  for (const auto format : {core::PixelFormat::kGray8, core::PixelFormat::kRgb24, core::PixelFormat::kBgr24,
+                            core::PixelFormat::kBgrx32, core::PixelFormat::kRgbx32}) {
+    const auto kernel = core::GrayRowKernelFor(format);
+    const auto scalar = core::ScalarGrayRowKernelFor(format);
+    for (std::size_t width = 1; width <= 80; ++width) {
+      std::vector<uint8_t> fast(width);
+      std::vector<uint8_t> reference(width);
+      kernel(src.data(), width, fast.data());
+      scalar(src.data(), width, reference.data());
+      ASSERT_EQ(fast, reference) << "format " << static_cast<int>(format) << " width " << width;
+    }
+  }
+  std::vector<uint8_t> gray(1);
+  core::ScalarGrayRowKernelFor(core::PixelFormat::kRgb24)(src.data(), 1, gray.data());
+  EXPECT_EQ(gray[0], 255);
+}
+
+TEST(Image, DecodesPaletteAndThirtyTwoBitBmp) {
+  const auto bmp = [](uint16_t bpp, int32_t width, int32_t height, const std::vector<uint8_t>& palette,
+                      const std::vector<uint8_t>& pixels) {
+    const uint32_t offset = 54 + static_cast<uint32_t>(palette.size());
+    std::vector<uint8_t> bytes(offset);
+    const auto put = [&bytes](std::size_t at, uint32_t value, int size) {
+      for (int i = 0; i < size; ++i) {
+        bytes[at + i] = static_cast<uint8_t>(value >> (8 * i));
+      }
+    };
+    put(0, 0x4D42, 2);
+    put(10, offset, 4);
+    put(14, 40, 4);
+    put(18, static_cast<uint32_t>(width), 4);
+    put(22, static_cast<uint32_t>(height), 4);
+    put(26, 1, 2);
+    put(28, bpp, 2);
+    put(46, static_cast<uint32_t>(palette.size() / 4), 4);
+    std::copy(palette.begin(), palette.end(), bytes.begin() + 54);
+    bytes.insert(bytes.end(), pixels.begin(), pixels.end());
+    return bytes;
+  };
+
+  // Top-down 2x2, 8-bit palette: black, white, pure red (BGRx entries). Rows pad to 4 bytes.
+  const auto palette_image = core::DecodeImage(
+      bmp(8, 2, -2, {0, 0, 0, 0, 255, 255, 255, 0, 0, 0, 255, 0}, {0, 1, 0, 0, 2, 1, 0, 0}));
+  EXPECT_EQ(palette_image.pixels, (std::vector<uint8_t>{0, 255, core::GrayFromRgb(255, 0, 0), 255}));
+
+  // Bottom-up 17x1 at 32 bpp spans one full vector step plus a scalar tail.
+  std::vector<uint8_t> pixels;
+  std::vector<uint8_t> expected;
+  for (int x = 0; x < 17; ++x) {
+    const auto b = static_cast<uint8_t>(x * 15);
+    const auto g = static_cast<uint8_t>(255 - x * 7);
+    const auto r = static_cast<uint8_t>(x * 3);
+    pixels.insert(pixels.end(), {b, g, r, 0xAA});
+    expected.push_back(static_cast<uint8_t>(core::GrayFromRgb(r, g, b)));
+  }
+  const auto wide = core::DecodeImage(bmp(32, 17, 1, {}, pixels));
+  EXPECT_EQ(wide.pixels, expected);
+
+  // Resolution is stored in pixels per metre and rounds to the nearest DPI.
+  auto high_res = bmp(32, 17, 1, {}, pixels);
+  high_res[38] = 0x46;  // 23622 px/m
+  high_res[39] = 0x5C;
+  high_res[42] = 0x23;  // 11811 px/m
+  high_res[43] = 0x2E;
+  const auto decoded = core::DecodeImage(high_res);
+  EXPECT_EQ(decoded.dpi_x, 600);
+  EXPECT_EQ(decoded.dpi_y, 300);
+  const auto probed = core::ProbeImage(high_res);
+  EXPECT_EQ(probed.dpi_x, 600);
+  EXPECT_EQ(probed.dpi_y, 300);
+
+  auto truncated = bmp(32, 17, 1, {}, pixels);
+  truncated.resize(truncated.size() - 4);
+  EXPECT_THROW(core::DecodeImage(truncated), std::runtime_error);
+}
+
+#ifndef _WIN32
+// A fresh directory per run, so concurrent test runs never share socket or image paths.
+std::filesystem::path MakeTempDirectory() {
+  std::string pattern = (std::filesystem::temp_directory_path() / "falcon_test_XXXXXX").string();
+  if (mkdtemp(pattern.data()) == nullptr) {
+    throw std::runtime_error("mkdtemp failed");
+  }
+  return pattern;
+}
+
+std::string PgmFromRaster(const core::Raster& raster) {
+  std::string pgm = "P5\n" + std::to_string(raster.width) + " " + std::to_string(raster.height) + "\n255\n";
+  pgm.append(raster.pixels.begin(), raster.pixels.end());
+  return pgm;
+}
+
+TEST(OcrServer, AnswersPipelinedPathAndInlineRequestsInOrder) {
+  const auto glyphs = core::CollectGlyphTemplates(std::vector<std::string>{}, true);
+  const auto raster = RasterFromText(U"LIFE", glyphs);
+  const std::string expected = ocr::PageText(ocr::RunOcr(raster, {}));
+  const std::string pgm = PgmFromRaster(raster);
+  const std::vector<uint8_t> bytes(pgm.begin(), pgm.end());
+  const auto directory = MakeTempDirectory();
+  const auto image_path = directory / "page.pgm";
+  std::ofstream(image_path, std::ios::binary) << pgm;
+
+  ocr::ServerOptions options;
+  options.socket_path = directory / "server.sock";
+  options.watch_packs = false;
+  ocr::OcrServer server(options);
+  server.Start();
+  {
+    auto client = ocr::OcrClient::ConnectUnix(options.socket_path);
+    EXPECT_EQ(client.RecognizeFile(image_path), expected);
+    for (int i = 0; i < 4; ++i) {
+      client.SendBytes(bytes);
+    }
+    client.SendFile(image_path.string() + ".missing");
+    for (int i = 0; i < 4; ++i) {
+      EXPECT_EQ(client.Receive(), expected);
+    }
+    EXPECT_THROW(client.Receive(), std::runtime_error);
+    EXPECT_EQ(client.RecognizeBytes(bytes), expected);
+  }
+  server.Stop();
+
+  const auto stats = server.Stats();
+  EXPECT_EQ(stats.requests, 7u);
+  EXPECT_EQ(stats.failed, 1u);
+  EXPECT_LE(stats.batches, 6u);
+  EXPECT_FALSE(std::filesystem::exists(options.socket_path));
+  std::filesystem::remove_all(directory);
+}
+
+TEST(OcrServer, StopsWhileAClientIgnoresItsAnswers) {
+  const auto directory = MakeTempDirectory();
+  ocr::ServerOptions options;
+  options.socket_path = directory / "server.sock";
+  options.watch_packs = false;
+  options.stop_grace = std::chrono::milliseconds(100);
+  ocr::OcrServer server(options);
+  server.Start();
+
+  // Unknown commands are echoed back in the error, so long ones fill the reply buffers quickly.
+  const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  ASSERT_GE(fd, 0);
+  sockaddr_un address{};
+  address.sun_family = AF_UNIX;
+  std::strncpy(address.sun_path, options.socket_path.c_str(), sizeof(address.sun_path) - 1);
+  ASSERT_EQ(connect(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)), 0);
+  fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+  const std::string request = "X" + std::string(60000, 'x') + "\n";
+  // Keep sending until the server stops reading for a while: it is then stuck sending answers.
+  std::size_t sent = 0;
+  std::size_t offset = 0;
+  for (int stalls = 0; stalls < 20 && sent < (std::size_t{64} << 20);) {
+    const ssize_t written = send(fd, request.data() + offset, request.size() - offset, MSG_NOSIGNAL);
+    if (written <= 0) {
+      ++stalls;
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+      continue;
+    }
+    stalls = 0;
+    sent += static_cast<std::size_t>(written);
+    offset = (offset + static_cast<std::size_t>(written)) % request.size();
+  }
+  EXPECT_GT(sent, request.size() * 4);
+
+  auto stopped = std::async(std::launch::async, [&server] { server.Stop(); });
+  EXPECT_EQ(stopped.wait_for(std::chrono::seconds(10)), std::future_status::ready);
+  close(fd);
+  stopped.wait();
+  std::filesystem::remove_all(directory);
+}
+
+TEST(OcrServer, ConfinesPathRequestsOverTcp) {
+  const auto glyphs = core::CollectGlyphTemplates(std::vector<std::string>{}, true);
+  const auto raster = RasterFromText(U"LIFE", glyphs);
+  const std::string expected = ocr::PageText(ocr::RunOcr(raster, {}));
+  const auto directory = MakeTempDirectory();
+  std::filesystem::create_directory(directory / "root");
+  std::ofstream(directory / "root" / "page.pgm", std::ios::binary) << PgmFromRaster(raster);
+  std::ofstream(directory / "outside.pgm", std::ios::binary) << PgmFromRaster(raster);
+  std::filesystem::create_symlink(directory / "outside.pgm", directory / "root" / "link.pgm");
+
+  ocr::ServerOptions options;
+  options.watch_packs = false;
+  {
+    ocr::OcrServer server(options);
+    server.Start();
+    auto client = ocr::OcrClient::ConnectTcp(server.Port());
+    EXPECT_THROW(client.RecognizeFile(directory / "root" / "page.pgm"), std::runtime_error);
+  }
+
+  options.path_root = directory / "root";
+  ocr::OcrServer server(options);
+  server.Start();
+  auto client = ocr::OcrClient::ConnectTcp(server.Port());
+  EXPECT_EQ(client.RecognizeFile("page.pgm"), expected);
+  EXPECT_EQ(client.RecognizeFile(directory / "root" / "page.pgm"), expected);
+  EXPECT_THROW(client.RecognizeFile(directory / "outside.pgm"), std::runtime_error);
+  EXPECT_THROW(client.RecognizeFile("../outside.pgm"), std::runtime_error);
+  EXPECT_THROW(client.RecognizeFile("link.pgm"), std::runtime_error);
+  server.Stop();
+  std::filesystem::remove_all(directory);
+}
+
+TEST(Batch, RecognizesDirectoryInputsInInputOrder) {
+  const auto glyphs = core::CollectGlyphTemplates(std::vector<std::string>{}, true);
+  const auto directory = MakeTempDirectory();
+  const auto pages = directory / "pages";
+  std::filesystem::create_directories(pages / "nested.pgm");
+  const std::u32string texts[] = {U"LIFE", U"TIE", U"FILE TIE", U"IF"};
+  std::vector<std::string> expected;
+  for (std::size_t i = 0; i < std::size(texts); ++i) {
+    const auto raster = RasterFromText(texts[i], glyphs);
+    std::ofstream(pages / ("page" + std::to_string(i) + ".pgm"), std::ios::binary) << PgmFromRaster(raster);
+    std::ostringstream formatted;
+    ocr::MakeOutputWriter(ocr::OutputFormat::kText, formatted)->WritePage(ocr::RunOcr(raster, {}));
+    expected.push_back(formatted.str());
+  }
+  std::ofstream(pages / "broken.PGM", std::ios::binary) << "P5\n8 8\n255\n";
+  std::ofstream(pages / "notes.txt") << "not an image\n";
+  // A two-page PNM: both pages go into that file's output.
+  std::ofstream(directory / "multi.pnm", std::ios::binary)
+      << PgmFromRaster(RasterFromText(texts[1], glyphs)) << "\n# page 2\n" << PgmFromRaster(RasterFromText(texts[2], glyphs));
+  expected.push_back(expected[1] + expected[2]);
+  std::ofstream(directory / "list.txt") << (pages / "page3.pgm").string() << "\n" << (directory / "multi.pnm").string() << "\n";
+  EXPECT_TRUE(core::IsImagePath("scan.BMP"));
+  EXPECT_TRUE(core::IsPnmPath("scan.PnM"));
+  EXPECT_FALSE(core::IsPnmPath("scan.bmp"));
+  EXPECT_FALSE(core::IsImagePath("scan.txt"));
+
+  std::istringstream manifest("# comment\n" + (pages / "page0.pgm").string() + "\r\n\n");
+  const auto inputs = app::CollectBatchInputs({pages.string(), "-", "@" + (directory / "list.txt").string()}, manifest);
+  const std::vector<std::filesystem::path> expected_inputs = {
+      pages / "broken.PGM", pages / "page0.pgm", pages / "page1.pgm", pages / "page2.pgm",
+      pages / "page3.pgm",  pages / "page0.pgm", pages / "page3.pgm", directory / "multi.pnm"};
+  ASSERT_EQ(inputs, expected_inputs);
+  EXPECT_THROW(app::CollectBatchInputs({"@" + (directory / "missing.txt").string()}, manifest), std::runtime_error);
+
+  // More workers than queue slots, so results arrive out of order and the writer has to reorder.
+  app::BatchOptions options;
+  options.queue_depth = 1;
+  options.ocr_workers = 3;
+  std::ostringstream output;
+  const auto report = app::RunBatch(inputs, options, output);
+  ASSERT_EQ(report.files.size(), inputs.size());
+  EXPECT_EQ(report.failed, 1u);
+  EXPECT_FALSE(report.files[0].error.empty());
+  std::string expected_output;
+  for (std::size_t i = 1; i < inputs.size(); ++i) {
+    EXPECT_EQ(report.files[i].path, inputs[i]);
+    EXPECT_TRUE(report.files[i].error.empty());
+    const char last = inputs[i].stem().string().back();
+    const std::size_t page = std::isdigit(static_cast<unsigned char>(last)) ? static_cast<std::size_t>(last - '0') : 4;
+    expected_output += "==> " + inputs[i].string() + " <==\n" + expected[page];
+  }
+  EXPECT_EQ(output.str(), expected_output);
+
+  // Multi-page files decode from the bytes the cache hashed, and are never served from it.
+  options.cache_dir = directory / "cache";
+  for (int run = 0; run < 2; ++run) {
+    std::ostringstream cached_output;
+    const auto cached = app::RunBatch(inputs, options, cached_output);
+    EXPECT_EQ(cached_output.str(), expected_output);
+    EXPECT_FALSE(cached.files.back().cached);
+    if (run == 1) {
+      EXPECT_EQ(cached.cache_hits, inputs.size() - 2);  // all but the broken and the multi-page file
+    }
+  }
+  options.cache_dir.clear();
+
+  options.output_dir = directory / "out";
+  std::ostringstream unused;
+  EXPECT_EQ(app::RunBatch(inputs, options, unused).failed, 1u);
+  EXPECT_TRUE(unused.str().empty());
+  for (std::size_t i = 0; i <= std::size(texts); ++i) {
+    const std::string name = i < std::size(texts) ? "page" + std::to_string(i) + ".txt" : "multi.txt";
+    std::ifstream written(options.output_dir / name, std::ios::binary);
+    EXPECT_EQ(std::string(std::istreambuf_iterator<char>(written), std::istreambuf_iterator<char>()), expected[i]);
+  }
+  EXPECT_FALSE(std::filesystem::exists(options.output_dir / "broken.txt"));
+  std::filesystem::remove_all(directory);
+}
+#endif
+
+TEST(OcrControl, CancelledRunReturnsRecognizedPrefix) {
+  const auto glyphs = core::CollectGlyphTemplates(std::vector<std::string>{}, true);
+  std::u32string text;
+  for (int line = 0; line < 12; ++line) {
+    text += U"LIFE TIE FILE HEEL\n";
+  }
+  const auto raster = RasterFromText(text, glyphs);
+  ocr::OcrOptions options;
+  options.parallel = false;
+  const auto full = ocr::RunOcr(raster, options);
+
+  ocr::OcrControl control;
+  control.SetProgressCallback([&control](const ocr::OcrProgress& progress) {
+    if (progress.glyphs_done >= 64) {
+      control.Cancel();
+    }
+  });
+  const auto partial = ocr::RunOcr(raster, options, control);
+  EXPECT_EQ(full.status, ocr::OcrStatus::kComplete);
+  EXPECT_EQ(partial.status, ocr::OcrStatus::kCancelled);
+  const auto count = [](const ocr::OcrPage& page) {
+    std::size_t total = 0;
+    for (const auto& line : page.lines) {
+      total += line.characters.size();
+    }
+    return total;
+  };
+  EXPECT_GE(count(partial), 64u);
+  EXPECT_LT(count(partial), count(full));
+  EXPECT_EQ(partial.lines.front().characters.front().classification.codepoint,
+            full.lines.front().characters.front().classification.codepoint);
+
+  ocr::OcrControl expired;
+  expired.SetDeadline(ocr::OcrControl::Clock::now());
+  const auto timed_out = ocr::RunOcr(raster, options, expired);
+  EXPECT_EQ(timed_out.status, ocr::OcrStatus::kTimedOut);
+  EXPECT_TRUE(timed_out.lines.empty());
+}
+
+TEST(OcrControl, AsyncRunCompletesWithProgressAndCallback) {
+  const auto glyphs = core::CollectGlyphTemplates(std::vector<std::string>{}, true);
+  const auto raster = RasterFromText(U"LIFE TIE\nFILE", glyphs);
+  const auto expected = ocr::PageText(ocr::RunOcr(raster, {}));
+
+  std::atomic<bool> completed{false};
+  ocr::AsyncOcrOptions async;
+  async.timeout = std::chrono::seconds(30);
+  async.on_complete = [&completed](const ocr::OcrPage& page, std::exception_ptr error) {
+    completed = !error && page.status == ocr::OcrStatus::kComplete;
+  };
+  auto task = ocr::RunOcrAsync(raster, {}, std::move(async));
+  const auto page = task.result.get();
+  EXPECT_TRUE(completed);
+  EXPECT_EQ(ocr::PageText(page), expected);
+  const auto progress = task.control->Progress();
+  EXPECT_EQ(progress.stage, ocr::OcrStage::kDone);
+  EXPECT_EQ(progress.glyphs_done, progress.glyphs_total);
+
+  auto failing = ocr::RunOcrAsync(core::Raster{}, {});
+  EXPECT_THROW(failing.result.get(), std::invalid_argument);
+}
+
+TEST(OcrControl, AsyncQueueRejectsPagesInsteadOfBlocking) {
+  // Park both workers in on_complete, then queue cheap pages until one is turned away.
+  std::promise<void> release;
+  const auto released = release.get_future().share();
+  std::atomic<int> parked{0};
+  std::vector<ocr::OcrTask> tasks;
+  for (int i = 0; i < 2; ++i) {
+    ocr::AsyncOcrOptions async;
+    async.on_complete = [&parked, released](const ocr::OcrPage&, std::exception_ptr) {
+      ++parked;
+      released.wait();
+    };
+    tasks.push_back(ocr::RunOcrAsync(core::Raster{}, {}, std::move(async)));
+  }
+  while (parked < 2) {
+    std::this_thread::yield();
+  }
+
+  // With the workers parked nothing queued can finish, so the first ready result is the rejection.
+  const auto caller = std::this_thread::get_id();
+  std::atomic<bool> completed_on_caller{false};
+  bool rejected = false;
+  for (int i = 0; i < 4096 && !rejected; ++i) {
+    ocr::AsyncOcrOptions async;
+    async.on_complete = [&completed_on_caller, caller](const ocr::OcrPage&, std::exception_ptr error) {
+      if (error && std::this_thread::get_id() == caller) {
+        completed_on_caller = true;
+      }
+    };
+    tasks.push_back(ocr::RunOcrAsync(core::Raster{}, {}, std::move(async)));
+    rejected = tasks.back().result.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+  }
+  release.set_value();
+  ASSERT_TRUE(rejected);
+  EXPECT_TRUE(completed_on_caller);
+  EXPECT_THROW(tasks.back().result.get(), ocr::AsyncQueueFullError);
+  for (std::size_t i = 0; i + 1 < tasks.size(); ++i) {
+    EXPECT_THROW(tasks[i].result.get(), std::invalid_argument);
+  }
+}
+
+TEST(OcrPipeline, StreamsLinesInReadingOrder) {
+  const auto glyphs = core::CollectGlyphTemplates(std::vector<std::string>{}, true);
+  std::u32string text;
+  for (int line = 0; line < 40; ++line) {
+    text += (line % 2 == 0) ? U"LIFE TIE FILE\n" : U"HEEL FILL TILE\n";
+  }
+  const auto raster = RasterFromText(text, glyphs);
+
+  struct RecordingSink : ocr::LineSink {
+    void BeginPage(core::SizeI size) override { began = size.width > 0; }
+    void OnLine(const ocr::OcrLine& line) override {
+      lines.push_back(line);
+      ended_early = ended_early || ended;
+    }
+    void EndPage(const ocr::OcrPage&) override { ended = true; }
+    bool began{false};
+    bool ended{false};
+    bool ended_early{false};
+    std::vector<ocr::OcrLine> lines;
+  } sink;
+  const auto page = ocr::RunOcr(raster, {}, sink);
+  EXPECT_TRUE(sink.began);
+  EXPECT_TRUE(sink.ended);
+  EXPECT_FALSE(sink.ended_early);
+  ASSERT_EQ(sink.lines.size(), page.lines.size());
+  for (std::size_t i = 0; i < page.lines.size(); ++i) {
+    ASSERT_EQ(sink.lines[i].characters.size(), page.lines[i].characters.size());
+    EXPECT_EQ(sink.lines[i].characters.front().bounds.y, page.lines[i].characters.front().bounds.y);
+  }
+  EXPECT_EQ(ocr::PageText(page), ocr::PageText(ocr::RunOcr(raster, {})));
+
+  // A page that fails after BeginPage is still closed, so the output stays well-formed.
+  ocr::OcrOptions invalid;
+  invalid.glyph_size = 12;
+  for (const auto format : {ocr::OutputFormat::kJson, ocr::OutputFormat::kHocr}) {
+    std::ostringstream stream;
+    const auto writer = ocr::MakeOutputWriter(format, stream);
+    EXPECT_THROW(ocr::RunOcr(raster, invalid, *writer), std::invalid_argument);
+    if (format == ocr::OutputFormat::kJson) {
+      EXPECT_EQ(stream.str(), "{\"width\":" + std::to_string(raster.width) + ",\"height\":" +
+                                  std::to_string(raster.height) + ",\"lines\":[],\"status\":\"failed\"}\n");
+    } else {
+      EXPECT_NE(stream.str().find("</div>\n</body>\n</html>\n"), std::string::npos);
+    }
+  }
+}
+
+TEST(OutputWriter, EscapesAndEncodesEachFormat) {
+  ocr::OcrPage page;
+  page.image_size = {100, 40};
+  page.lines.resize(1);
+  int x = 10;
+  for (const char32_t codepoint : std::u32string(U"a\"<\t\u00e9\u4e2d")) {
+    ocr::OcrChar ch;
+    ch.bounds = core::RectI{x, 5, 8, 10};
+    ch.classification.codepoint = codepoint;
+    ch.classification.confidence = 0.9f;
+    page.lines[0].characters.push_back(ch);
+    x += 10;
+  }
+  const auto render = [&page](ocr::OutputFormat format) {
+    std::ostringstream stream;
+    ocr::MakeOutputWriter(format, stream)->WritePage(page);
+    return stream.str();
+  };
+
+  EXPECT_EQ(render(ocr::OutputFormat::kText), "a\"<\t\xC3\xA9\xE4\xB8\xAD\n");
+  EXPECT_EQ(render(ocr::OutputFormat::kTsv),
+            "page\tline\tleft\ttop\twidth\theight\tconfidence\ttext\n"
+            "1\t1\t10\t5\t58\t10\t90\ta\"<\\t\xC3\xA9\xE4\xB8\xAD\n");
+  EXPECT_EQ(render(ocr::OutputFormat::kJson),
+            "{\"width\":100,\"height\":40,\"lines\":[{\"bbox\":[10,5,58,10],\"confidence\":90,"
+            "\"text\":\"a\\\"<\\u0009\xC3\xA9\xE4\xB8\xAD\"}],\"status\":\"complete\"}\n");
+  const auto hocr = render(ocr::OutputFormat::kHocr);
+  EXPECT_NE(hocr.find("title=\"bbox 0 0 100 40\""), std::string::npos);
+  EXPECT_NE(hocr.find("<span class=\"ocr_line\" id=\"line_1_1\" title=\"bbox 10 5 68 15; x_wconf 90\">"
+                      "a&quot;&lt;\t\xC3\xA9\xE4\xB8\xAD</span>"),
+            std::string::npos);
+  EXPECT_THROW(ocr::ParseOutputFormat("xml"), std::invalid_argument);
+}
+
+TEST(TiledSegment, MatchesWholeImageLabeling) {
+  const auto glyphs = core::CollectGlyphTemplates(std::vector<std::string>{}, true);
+  auto raster = RasterFromText(U"LIFE TIE FILE\nHEEL TILE FILL", glyphs);
+  // A staircase and a frame that cross many tiles, meeting and leaving tile borders at odd places.
+  for (int i = 0; i + 1 < raster.width && i + 1 < raster.height; ++i) {
+    raster.pixels[static_cast<std::size_t>(i) * raster.width + i] = 255;
+    raster.pixels[static_cast<std::size_t>(i) * raster.width + i + 1] = 255;
+  }
+  for (int x = 0; x < raster.width; ++x) {
+    raster.pixels[x] = 255;
+    raster.pixels[static_cast<std::size_t>(raster.height - 1) * raster.width + x] = 255;
+  }
+
+  const auto binary = core::BinarizeOtsu(raster);
+  core::BinaryImage parallel;
+  core::BinarizeOtsuParallel(raster, parallel, 5);
+  EXPECT_EQ(parallel.data, binary.data);
+
+  const auto expected = core::ConnectedComponents(binary);
+  ASSERT_GT(expected.size(), 10u);
+  core::TiledSegmentScratch scratch;
+  std::vector<core::ConnectedComponent> tiled;
+  for (const int tile_size : {1, 7, 16, 33, 4096}) {
+    core::ConnectedComponentsTiled(binary, tile_size, scratch, tiled);
+    ASSERT_EQ(tiled.size(), expected.size()) << tile_size;
+    for (std::size_t i = 0; i < expected.size(); ++i) {
+      EXPECT_EQ(tiled[i].label, expected[i].label) << tile_size;
+      EXPECT_EQ(tiled[i].bounds, expected[i].bounds) << tile_size;
+      EXPECT_EQ(tiled[i].area, expected[i].area) << tile_size;
+    }
+  }
+}
+
+TEST(OcrPipeline, TiledRunMatchesUntiledText) {
+  const auto glyphs = core::CollectGlyphTemplates(std::vector<std::string>{}, true);
+  const auto raster = RasterFromText(U"LIFE TIE FILE\nHEEL", glyphs);
+  ocr::OcrOptions options;
+  options.tile_size = 24;
+  EXPECT_EQ(ocr::PageText(ocr::RunOcr(raster, options)), ocr::PageText(ocr::RunOcr(raster, {})));
+}
+
+TEST(PageStream, RecognizesMultiPagePnmInPageOrder) {
+  const auto glyphs = core::CollectGlyphTemplates(std::vector<std::string>{}, true);
+  const std::vector<std::u32string> texts{U"LIFE", U"TIE FILE", U"HEEL", U"FILL", U"TILE"};
+  std::string document;
+  std::vector<std::string> expected;
+  for (std::size_t i = 0; i < texts.size(); ++i) {
+    const auto raster = RasterFromText(texts[i], glyphs);
+    expected.push_back(ocr::PageText(ocr::RunOcr(raster, {})));
+    if (i % 2 == 0) {
+      document += "P5\n" + std::to_string(raster.width) + " " + std::to_string(raster.height) + "\n255\n";
+      document.append(raster.pixels.begin(), raster.pixels.end());
+    } else {
+      // Plain PGM with a 16-bit range and a comment between pages.
+      document += "# page " + std::to_string(i) + "\nP2 " + std::to_string(raster.width) + " " +
+                  std::to_string(raster.height) + " 65535\n";
+      for (const uint8_t value : raster.pixels) {
+        document += std::to_string(value * 257) + " ";
+      }
+    }
+    document += "\n";
+  }
+
+  std::istringstream stream(document, std::ios::binary);
+  core::PnmPageReader reader(stream);
+  std::atomic<std::size_t> decoded{0};
+  std::atomic<std::size_t> delivered{0};
+  std::size_t max_resident = 0;
+  const ocr::PageSource source = [&](core::Raster& page) {
+    if (!reader.Next(page)) {
+      return false;
+    }
+    ++decoded;
+    return true;
+  };
+  ocr::PageStreamOptions options;
+  options.workers = 2;
+  options.max_pages_in_flight = 2;
+  std::vector<std::string> texts_out;
+  const auto count = ocr::RunOcrPages(source, options, [&](std::size_t index, ocr::OcrPage& page) {
+    EXPECT_EQ(index, texts_out.size());
+    max_resident = std::max(max_resident, decoded.load() - delivered.load());
+    texts_out.push_back(ocr::PageText(page));
+    ++delivered;
+  });
+  EXPECT_EQ(count, texts.size());
+  EXPECT_EQ(reader.PagesRead(), texts.size());
+  EXPECT_EQ(texts_out, expected);
+  EXPECT_LE(max_resident, 2u);
+
+  // A page that fails to decode stops the stream after the pages before it.
+  std::istringstream truncated(document.substr(0, document.find("P5", 1) + 10), std::ios::binary);
+  core::PnmPageReader broken(truncated);
+  std::size_t before_error = 0;
+  EXPECT_THROW(ocr::RunOcrPages([&broken](core::Raster& page) { return broken.Next(page); }, options,
+                                [&before_error](std::size_t, ocr::OcrPage&) { ++before_error; }),
+               std::runtime_error);
+  EXPECT_EQ(before_error, 2u);
+}
+
+TEST(OcrPipeline, MemoryBudgetReducesPagesOrFailsFast) {
+  const auto glyphs = core::CollectGlyphTemplates(std::vector<std::string>{}, true);
+  const auto base = RasterFromText(U"LIFE TIE", glyphs);
+  auto scan = core::ResizeNearest(base, base.width * 2, base.height * 2);
+  scan.dpi_x = 600;
+  scan.dpi_y = 600;
+  const std::size_t pixels = scan.pixels.size();
+
+  ocr::OcrContext context;
+  const auto unbounded = ocr::RunOcr(scan, {}, context);
+  // Input, binary image and visited flags at full resolution.
+  EXPECT_GE(unbounded.memory.segment, 3 * pixels);
+  EXPECT_GE(unbounded.memory.Peak(), unbounded.memory.preprocess);
+
+  // Too small for the full-resolution page, so it is halved to 300 DPI.
+  ocr::OcrOptions options;
+  options.memory_budget = 2 * pixels;
+  options.parallel = false;
+  ocr::OcrContext bounded;
+  const auto page = ocr::RunOcr(scan, options, bounded);
+  EXPECT_EQ(ocr::PageText(page), ocr::PageText(unbounded));
+  EXPECT_LE(page.memory.Peak(), options.memory_budget);
+
+  options.memory_budget = pixels;
+  EXPECT_THROW(ocr::RunOcr(scan, options, bounded), ocr::MemoryBudgetError);
+  options.memory_budget = std::size_t{64} << 20;
+  try {
+    ocr::CheckMemoryBudget({20000, 30000}, 96, 96, options);
+    ADD_FAILURE() << "expected MemoryBudgetError";
+  } catch (const ocr::MemoryBudgetError& error) {
+    EXPECT_GT(error.Required(), error.Budget());
+    EXPECT_NE(std::string(error.what()).find("20000x30000"), std::string::npos);
+  }
+
+  // A solid page is one component as large as the page, whose BFS queue alone is over the budget:
+  // it is labeled in tiles, or rejected before labeling allocates anything when tiles are off.
+  core::Raster solid;
+  solid.width = 2048;
+  solid.height = 2048;
+  solid.pixels.assign(std::size_t{2048} * 2048, 255);
+  ocr::OcrOptions solid_options;
+  solid_options.memory_budget = 10 * solid.pixels.size();
+  ocr::OcrContext solid_context;
+  EXPECT_LE(ocr::RunOcr(solid, solid_options, solid_context).memory.Peak(), solid_options.memory_budget);
+  EXPECT_EQ(solid_context.segment.queue.capacity(), 0u);
+  solid_options.parallel = false;
+  EXPECT_THROW(ocr::RunOcr(solid, solid_options, solid_context), ocr::MemoryBudgetError);
+  EXPECT_EQ(solid_context.segment.queue.capacity(), 0u);
+
+  // Cleanup scratch and the glyphs a noisy page labels into are planned for too: a speckled 600 DPI
+  // page with despeckling is reduced to fit rather than failing after the plan was accepted.
+  core::Raster noisy;
+  noisy.width = 1200;
+  noisy.height = 1200;
+  noisy.dpi_x = 600;
+  noisy.dpi_y = 600;
+  noisy.pixels.assign(std::size_t{1200} * 1200, 0);
+  uint32_t state = 12345;
+  for (auto& pixel : noisy.pixels) {
+    state = state * 1664525u + 1013904223u;
+    if ((state >> 24) < 16) {
+      pixel = 255;
+    }
+  }
+  ocr::OcrOptions noisy_options;
+  noisy_options.memory_budget = 4 * noisy.pixels.size();
+  noisy_options.parallel = false;
+  noisy_options.cleanup = core::CleanupOptions::Parse("despeckle=2");
+  ocr::OcrContext noisy_context;
+  ocr::OcrPage noisy_page;
+  ASSERT_NO_THROW(noisy_page = ocr::RunOcr(noisy, noisy_options, noisy_context));
+  EXPECT_LE(noisy_page.memory.Peak(), noisy_options.memory_budget);
+
+  // An in-memory image is checked from its header, and a header cannot promise more pixels than
+  // the payload holds.
+  const std::string header = "P5 100000 100000 255\n";
+  const std::vector<uint8_t> bomb(header.begin(), header.end());
+  EXPECT_EQ(core::ProbeImage(bomb).size.width, 100000);
+  EXPECT_THROW(ocr::DecodeImageForOcr(bomb, options), ocr::MemoryBudgetError);
+  EXPECT_THROW(core::DecodeImage(bomb), std::runtime_error);
+}
+
+#if FALCON_TRACING
+TEST(Trace, RecordsPipelineStagesAsChromeTraceEvents) {
+  const auto glyphs = core::CollectGlyphTemplates(std::vector<std::string>{}, true);
+  const auto raster = RasterFromText(U"LIFE TIE", glyphs);
+  ocr::RunOcr(raster, {});  // warm templates outside the trace
+
+  util::Tracer::Clear();
+  util::Tracer::Start();
+  util::Tracer::SetThreadName("test \"main\"");
+  ocr::RunOcr(raster, {});
+  util::Tracer::Stop();
+  ocr::RunOcr(raster, {});  // not recorded
+
+  const std::size_t events = util::Tracer::EventCount();
+  EXPECT_GE(events, 5u);
+  std::ostringstream json;
+  util::Tracer::WriteJson(json);
+  const std::string trace = json.str();
+  EXPECT_EQ(trace.rfind("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[", 0), 0u);
+  for (const char* stage : {"ocr.page", "ocr.binarize", "ocr.segment", "ocr.layout", "ocr.recognize_task"}) {
+    EXPECT_NE(trace.find(std::string("\"name\":\"") + stage + "\""), std::string::npos) << stage;
+  }
+  EXPECT_NE(trace.find("\"args\":{\"name\":\"test \\\"main\\\"\"}"), std::string::npos);
+  EXPECT_EQ(util::Tracer::EventCount(), events);
+  util::Tracer::Clear();
+  EXPECT_EQ(util::Tracer::EventCount(), 0u);
+}
+#endif
+
+TEST(Hash, MatchesReferenceVectorsAndChainsValues) {
+  EXPECT_EQ(util::Hash64("", 0), 0xEF46DB3751D8E999ULL);
+  EXPECT_EQ(util::Hash64("abc", 3), 0x44BC2CF5AD770999ULL);
+  std::vector<uint8_t> bytes(1000, 7);
+  const uint64_t full = util::Hash64(bytes.data(), bytes.size());
+  bytes[999] = 8;
+  EXPECT_NE(util::Hash64(bytes.data(), bytes.size()), full);
+  EXPECT_NE(util::Hasher().Add("ab").Add("c").Digest(), util::Hasher().Add("a").Add("bc").Digest());
+}
+
+TEST(ResultCache, ServesStoredPagesAcrossInstancesAndEvictsOldest) {
+  const auto glyphs = core::CollectGlyphTemplates(std::vector<std::string>{}, true);
+  const auto raster = RasterFromText(U"LIFE TIE", glyphs);
+  const auto page = ocr::RunOcr(raster, {});
+  const auto directory = std::filesystem::temp_directory_path() / "falcon_result_cache_test";
+  std::filesystem::remove_all(directory);
+
+  const auto encoded = ocr::SerializePage(page);
+  EXPECT_EQ(ocr::PageText(ocr::DeserializePage(encoded.data(), encoded.size())), ocr::PageText(page));
+  EXPECT_THROW(ocr::DeserializePage(encoded.data(), encoded.size() - 1), std::runtime_error);
+
+  ocr::ResultCacheKey key;
+  std::size_t entry_bytes = 0;
+  {
+    ocr::ResultCache cache(directory);
+    key = cache.KeyFor(raster, {});
+    ocr::OcrOptions digits;
+    digits.charset = core::Charset::Digits();
+    EXPECT_NE(cache.KeyFor(raster, digits).config, key.config);
+    ocr::OcrOptions tiled;
+    tiled.tile_size = 64;
+    EXPECT_EQ(cache.KeyFor(raster, tiled), key);
+
+    ocr::OcrPage cached;
+    EXPECT_FALSE(cache.Lookup(key, cached));
+    cache.Store(key, page);
+    EXPECT_EQ(cache.Entries(), 1u);
+    entry_bytes = cache.Bytes();
+  }
+  // Temporary files of crashed writers are deleted once stale; a live writer's file is not.
+  const auto stale = directory / "crashed.tmp1-1";
+  const auto live = directory / "writing.tmp2-1";
+  std::ofstream(stale) << "partial";
+  std::ofstream(live) << "partial";
+  std::filesystem::last_write_time(stale, std::filesystem::file_time_type::clock::now() - std::chrono::hours(1));
+  {
+    // A fresh instance finds the entry on disk; the cap admits only one more entry than that.
+    ocr::ResultCache cache(directory, entry_bytes * 2 - 1);
+    EXPECT_FALSE(std::filesystem::exists(stale));
+    EXPECT_TRUE(std::filesystem::exists(live));
+    EXPECT_EQ(cache.Bytes(), entry_bytes);
+    ocr::OcrPage cached;
+    ASSERT_TRUE(cache.Lookup(key, cached));
+    EXPECT_EQ(ocr::PageText(cached), ocr::PageText(page));
+    EXPECT_EQ(cached.image_size.width, page.image_size.width);
+
+    auto other = key;
+    other.content ^= 1;
+    cache.Store(other, page);
+    EXPECT_EQ(cache.Entries(), 1u);
+    EXPECT_EQ(cache.Stats().evictions, 1u);
+    EXPECT_FALSE(cache.Lookup(key, cached));
+    EXPECT_TRUE(cache.Lookup(other, cached));
+  }
+  std::filesystem::remove_all(directory);
+
+  {
+    // Two live instances, as two processes would be: each finds the other's entries, and the cap
+    // applies to the directory as a whole.
+    ocr::ResultCache first(directory, entry_bytes * 2 - 1);
+    ocr::ResultCache second(directory, entry_bytes * 2 - 1);
+    first.Store(key, page);
+    ocr::OcrPage cached;
+    ASSERT_TRUE(second.Lookup(key, cached));
+    EXPECT_EQ(ocr::PageText(cached), ocr::PageText(page));
+
+    auto other = key;
+    other.content ^= 1;
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    second.Store(other, page);
+    EXPECT_EQ(second.Entries(), 1u);
+    EXPECT_FALSE(first.Lookup(key, cached));
+    EXPECT_TRUE(first.Lookup(other, cached));
+  }
+  std::filesystem::remove_all(directory);
+
+  // The budget only enters the key through the reduction it plans.
+  ocr::ResultCache cache(directory);
+  ocr::OcrOptions roomy;
+  roomy.memory_budget = std::size_t{1} << 30;
+  ocr::OcrOptions roomier;
+  roomier.memory_budget = std::size_t{2} << 30;
+  EXPECT_EQ(cache.KeyFor(raster, roomy), key);
+  EXPECT_EQ(cache.KeyFor(raster, roomier), key);
+  auto scanned = raster;
+  scanned.dpi_x = scanned.dpi_y = 1200;
+  ocr::OcrOptions tight;
+  tight.memory_budget = scanned.pixels.size() * 3 / 2;
+  const auto planned = ocr::PlanReduction(scanned.Size(), 1200, 1200, tight);
+  EXPECT_GT(planned.factor_x, 1);
+  EXPECT_NE(cache.KeyFor(scanned, tight).config, cache.KeyFor(scanned, {}).config);
+  std::filesystem::remove_all(directory);
+}
+
+TEST(OcrPipeline, RegionRequestsReusePageAnalysis) {
+  const auto glyphs = core::CollectGlyphTemplates(std::vector<std::string>{}, true);
+  auto raster = RasterFromText(U"LIFE TIE\nFILE HELL", glyphs);
+  const auto region_text = [&](ocr::OcrContext& context, core::RectI region) {
+    ocr::OcrOptions options;
+    options.region = region;
+    options.has_region = true;
+    return ocr::PageText(ocr::RunOcr(raster, options, context));
+  };
+  const auto fresh_text = [&](core::RectI region) {
+    ocr::OcrContext fresh;
+    return region_text(fresh, region);
+  };
+  const core::RectI first_line{0, 0, raster.width, 40};
+  const core::RectI left_half{0, 0, 90, raster.height};
+  const core::RectI second_line{0, 40, raster.width, raster.height - 40};
+
+  ocr::OcrContext context;
+  EXPECT_EQ(region_text(context, first_line), "LIFE\nTIE\n");
+  const auto& analysis = context.analysis;
+  ASSERT_TRUE(analysis.valid);
+  const auto classified = [&] {
+    return std::count_if(analysis.classified_mask.begin(), analysis.classified_mask.end(),
+                         [](uint64_t mask) { return mask != 0; });
+  };
+  EXPECT_EQ(classified(), 7);
+  EXPECT_EQ(analysis.components.size(), 15u);
+
+  // Adjusted selections match a cold run and only add the glyphs they newly cover.
+  EXPECT_EQ(region_text(context, left_half), fresh_text(left_half));
+  EXPECT_EQ(classified(), 11);
+  EXPECT_EQ(region_text(context, second_line), fresh_text(second_line));
+  EXPECT_EQ(classified(), 15);
+
+  // Edited pixels are a different page, even at the same address.
+  std::fill(raster.pixels.begin() + raster.width * 40, raster.pixels.end(), uint8_t{0});
+  EXPECT_EQ(region_text(context, second_line), "");
+  EXPECT_EQ(analysis.components.size(), 7u);
+
+  // A page without a region drops the analysis.
+  ocr::RunOcr(raster, {}, context);
+  EXPECT_FALSE(analysis.valid);
+}
+
+TEST(CompactPage, RoundTripsPagesAndStoresCharactersCompactly) {
+  const auto glyphs = core::CollectGlyphTemplates(std::vector<std::string>{}, true);
+  const auto page = ocr::RunOcr(RasterFromText(U"LIFE TIE\nFILE", glyphs), {});
+  const ocr::CompactPage compact(page);
+  ASSERT_EQ(compact.LineCount(), page.lines.size());
+  EXPECT_TRUE(compact.NarrowBoxes());
+  EXPECT_EQ(ocr::PageText(compact), ocr::PageText(page));
+  std::size_t line_index = 0;
+  for (const auto line : compact.Lines()) {
+    const auto& expected = page.lines[line_index++].characters;
+    ASSERT_EQ(line.Size(), expected.size());
+    std::size_t i = 0;
+    for (const auto ch : line) {
+      EXPECT_EQ(ch.Codepoint(), expected[i].classification.codepoint);
+      EXPECT_EQ(ch.Bounds(), expected[i].bounds);
+      ++i;
+    }
+  }
+
+  const auto encoded = compact.Serialize();
+  const auto restored = ocr::CompactPage::Deserialize(encoded.data(), encoded.size()).ToPage();
+  EXPECT_EQ(ocr::PageText(restored), ocr::PageText(page));
+  EXPECT_EQ(restored.image_size.width, page.image_size.width);
+  EXPECT_EQ(restored.image_size.height, page.image_size.height);
+  EXPECT_THROW(ocr::CompactPage::Deserialize(encoded.data(), encoded.size() - 1), std::runtime_error);
+
+  // One box past 16 bits moves the whole page to full-width boxes.
+  ocr::CompactPage wide;
+  ocr::OcrLine line;
+  line.characters.push_back({{1, 2, 3, 4}, {U'A', 0.5f}});
+  line.characters.push_back({{70000, 2, 3, 4}, {U'B', 0.25f}});
+  wide.AppendLine(line);
+  EXPECT_FALSE(wide.NarrowBoxes());
+  EXPECT_EQ(wide.Line(0)[0].Bounds(), (core::RectI{1, 2, 3, 4}));
+  EXPECT_EQ(wide.Line(0)[1].Bounds().x, 70000);
+  const auto wide_encoded = wide.Serialize();
+  EXPECT_EQ(ocr::CompactPage::Deserialize(wide_encoded.data(), wide_encoded.size()).Line(0)[1].Confidence(), 0.25f);
+
+  ocr::CompactPage large;
+  ocr::OcrLine row;
+  row.characters.assign(500, {{10, 20, 16, 16}, {U'x', 0.9f}});
+  for (int i = 0; i < 100; ++i) {
+    large.AppendLine(row);
+  }
+  EXPECT_EQ(large.CharCount(), 50000u);
+  EXPECT_LT(large.Bytes(), large.CharCount() * sizeof(ocr::OcrChar));
+}
+
+TEST(Morphology, PackedOperationsMatchPixelReference) {
+  core::BinaryImage image;
+  image.width = 131;
+  image.height = 23;
+  image.data.resize(static_cast<std::size_t>(image.width) * image.height);
+  uint32_t seed = 99;
+  for (auto& pixel : image.data) {
+    seed = seed * 1103515245 + 12345;
+    pixel = static_cast<uint8_t>((seed >> 16) % 3 != 0);
+  }
+  // Outside pixels read as ink for erosion and as background for dilation.
+  const auto reference = [&](const core::StructuringElement& element, bool erode) {
+    core::BinaryImage out = image;
+    for (int y = 0; y < image.height; ++y) {
+      for (int x = 0; x < image.width; ++x) {
+        bool value = erode;
+        for (int dy = -element.radius_y; dy <= element.radius_y; ++dy) {
+          for (int dx = -element.radius_x; dx <= element.radius_x; ++dx) {
+            if (element.shape == core::StructuringShape::kCross && dx != 0 && dy != 0) {
+              continue;
+            }
+            const int sx = x + dx;
+            const int sy = y + dy;
+            const bool inside = sx >= 0 && sy >= 0 && sx < image.width && sy < image.height;
+            const bool ink = inside ? image.data[static_cast<std::size_t>(sy) * image.width + sx] != 0 : erode;
+            value = erode ? (value && ink) : (value || ink);
+          }
+        }
+        out.data[static_cast<std::size_t>(y) * image.width + x] = value ? 1 : 0;
+      }
+    }
+    return out.data;
+  };
+
+  core::MorphologyScratch scratch;
+  core::PackedBinaryImage packed;
+  core::PackedBinaryImage result;
+  core::BinaryImage unpacked;
+  core::PackBinaryImage(image, packed);
+  core::UnpackBinaryImage(packed, unpacked);
+  EXPECT_EQ(unpacked.data, image.data);
+  for (const auto& element : {core::StructuringElement{1, 1}, core::StructuringElement{2, 0},
+                              core::StructuringElement{0, 3}, core::StructuringElement{70, 1},
+                              core::StructuringElement{2, 2, core::StructuringShape::kCross}}) {
+    core::Erode(packed, element, result, scratch);
+    core::UnpackBinaryImage(result, unpacked);
+    EXPECT_EQ(unpacked.data, reference(element, true)) << element.radius_x << "x" << element.radius_y;
+    core::Dilate(packed, element, result, scratch);
+    core::UnpackBinaryImage(result, unpacked);
+    EXPECT_EQ(unpacked.data, reference(element, false)) << element.radius_x << "x" << element.radius_y;
+  }
+
+  const auto options = core::CleanupOptions::Parse("open=cross2x1,close=1,despeckle=3");
+  EXPECT_EQ(options.opening, (core::StructuringElement{2, 1, core::StructuringShape::kCross}));
+  EXPECT_EQ(options.closing, (core::StructuringElement{1, 1}));
+  EXPECT_EQ(options.despeckle_size, 3);
+  EXPECT_THROW(core::CleanupOptions::Parse("erode=1"), std::invalid_argument);
+}
+
+TEST(OcrPipeline, DespeckleRemovesNoiseComponents) {
+  const auto glyphs = core::CollectGlyphTemplates(std::vector<std::string>{}, true);
+  const auto clean = RasterFromText(U"LIFE TIE\nFILE HELL", glyphs);
+  auto noisy = clean;
+  // 4x4 specks between the text lines and along the bottom border, too large for the layout's
+  // relative speck filter.
+  for (int x = 0; x + 4 <= noisy.width; x += 11) {
+    for (const int top : {27, noisy.height - 4}) {
+      for (int y = top; y < top + 4; ++y) {
+        std::fill_n(noisy.pixels.begin() + static_cast<std::ptrdiff_t>(y) * noisy.width + x, 4, uint8_t{255});
+      }
+    }
+  }
+  const std::string expected = ocr::PageText(ocr::RunOcr(clean, {}));
+  const auto noisy_page = ocr::RunOcr(noisy, {});
+  EXPECT_NE(ocr::PageText(noisy_page), expected);
+
+  ocr::OcrOptions options;
+  options.cleanup.despeckle_size = 4;
+  EXPECT_EQ(ocr::PageText(ocr::RunOcr(noisy, options)), expected);
+  EXPECT_EQ(ocr::PageText(ocr::RunOcr(clean, options)), expected);
+}
+
+TEST(CApi, RecognizesStridedCallerBuffersFromManyThreads) {
+  const auto glyphs = core::CollectGlyphTemplates(std::vector<std::string>{}, true);
+  const auto raster = RasterFromText(U"LIFE TIE\nFILE", glyphs);
+  const auto expected = ocr::RunOcr(raster, {});
+  // Gray rows padded to a 64-byte stride, and the same page as BGRX.
+  const std::size_t stride = (static_cast<std::size_t>(raster.width) + 63) / 64 * 64;
+  std::vector<uint8_t> gray(stride * raster.height, 0x5A);
+  std::vector<uint8_t> bgrx(static_cast<std::size_t>(raster.width) * 4 * raster.height);
+  for (int y = 0; y < raster.height; ++y) {
+    for (int x = 0; x < raster.width; ++x) {
+      const uint8_t value = raster.pixels[static_cast<std::size_t>(y) * raster.width + x];
+      gray[y * stride + x] = value;
+      std::fill_n(bgrx.begin() + (static_cast<std::ptrdiff_t>(y) * raster.width + x) * 4, 4, value);
+    }
+  }
+  EXPECT_EQ(ocr::PageText(ocr::RunOcr(core::RasterView(gray.data(), raster.width, raster.height, stride), {},
+                                      ocr::ThreadLocalContext())),
+            ocr::PageText(expected));
+
+  EXPECT_EQ(falcon_abi_version(), static_cast<uint32_t>(FALCON_C_ABI_VERSION));
+  falcon_engine* engine = nullptr;
+  ASSERT_EQ(falcon_engine_create(nullptr, &engine), FALCON_OK);
+  const falcon_image images[] = {
+      {gray.data(), raster.width, raster.height, stride, FALCON_PIXEL_GRAY8, 0, 0},
+      {bgrx.data(), raster.width, raster.height, static_cast<std::size_t>(raster.width) * 4, FALCON_PIXEL_BGRX32, 0, 0},
+  };
+  std::vector<std::thread> threads;
+  std::atomic<int> matches{0};
+  for (int t = 0; t < 4; ++t) {
+    threads.emplace_back([&, t] {
+      falcon_result* result = nullptr;
+      if (falcon_recognize(engine, &images[t % 2], nullptr, &result) != FALCON_OK) {
+        return;
+      }
+      const bool same = std::string(result->text, result->text_size) == ocr::PageText(expected) &&
+                        result->line_count == expected.lines.size() &&
+                        result->lines[0].char_count == expected.lines[0].characters.size() &&
+                        result->chars[0].codepoint == expected.lines[0].characters[0].classification.codepoint &&
+                        result->chars[0].bounds.x == expected.lines[0].characters[0].bounds.x;
+      matches += same ? 1 : 0;
+      falcon_result_free(result);
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  EXPECT_EQ(matches.load(), 4);
+
+  falcon_result* result = nullptr;
+  const falcon_rect first_line{0, 0, raster.width, 30};
+  ASSERT_EQ(falcon_recognize(engine, &images[0], &first_line, &result), FALCON_OK);
+  EXPECT_EQ(std::string(result->text), "LIFE\nTIE\n");
+  falcon_result_free(result);
+
+  falcon_image short_stride = images[1];
+  short_stride.stride = static_cast<std::size_t>(raster.width);
+  EXPECT_EQ(falcon_recognize(engine, &short_stride, nullptr, &result), FALCON_ERROR_INVALID_ARGUMENT);
+  EXPECT_EQ(result, nullptr);
+  EXPECT_NE(std::string(falcon_last_error()), "");
+
+  // Released scratch is allocated again on the next call.
+  falcon_thread_release();
+  ASSERT_EQ(falcon_recognize(engine, &images[1], nullptr, &result), FALCON_OK);
+  EXPECT_EQ(std::string(result->text), ocr::PageText(expected));
+  falcon_result_free(result);
+  falcon_thread_release();
+  falcon_engine_destroy(engine);
+
+  // A color page over the budget fails before it is converted.
+  falcon_engine_options options;
+  falcon_engine_options_init(&options);
+  options.memory_budget = 1024;
+  ASSERT_EQ(falcon_engine_create(&options, &engine), FALCON_OK);
+  EXPECT_EQ(falcon_recognize(engine, &images[1], nullptr, &result), FALCON_ERROR_MEMORY_BUDGET);
+  EXPECT_EQ(result, nullptr);
+  falcon_engine_destroy(engine);
+
+  falcon_engine_options_init(&options);
+  options.glyph_size = 12;
+  EXPECT_EQ(falcon_engine_create(&options, &engine), FALCON_ERROR_INVALID_ARGUMENT);
+  EXPECT_EQ(engine, nullptr);
+}